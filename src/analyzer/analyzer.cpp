@@ -0,0 +1,203 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GNUC__) && !defined(__APPLE__)
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include "../pcap_reader.h"
+#include "../rtp.h"
+#include "st2110_21.h"
+
+namespace
+{
+struct FlowItem
+{
+   size_t flow /*! Index of the flow, in discovery order */;
+   FlowKey key;
+   FlowPacket packet;
+};
+
+/*!
+   @brief Bounded queue of packet batches from the capture reader to an analysis worker
+
+   @detail The reader waits while the queue is full, so the packets in flight do not depend on the length of the
+   capture.
+*/
+class FlowItemQueue
+{
+public:
+   static constexpr size_t batch_size = 4096;
+   static constexpr size_t max_nb_batches = 16;
+
+   void push(std::vector<FlowItem>&& batch /*!< [in] Batch to hand over, empty to signal the end of the capture*/)
+   {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_not_full.wait(lock, [&]() { return m_batches.size() < max_nb_batches; });
+      m_batches.push_back(std::move(batch));
+      m_not_empty.notify_one();
+   }
+
+   std::vector<FlowItem> pop()
+   {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_not_empty.wait(lock, [&]() { return !m_batches.empty(); });
+      std::vector<FlowItem> batch = std::move(m_batches.front());
+      m_batches.pop_front();
+      m_not_full.notify_one();
+      return batch;
+   }
+
+private:
+   std::mutex m_mutex;
+   std::condition_variable m_not_full;
+   std::condition_variable m_not_empty;
+   std::deque<std::vector<FlowItem>> m_batches;
+};
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      std::cout << "Usage: " << argv[0] << " <capture.pcap|capture.pcapng> [destination ip:port]" << std::endl;
+      return -1;
+   }
+
+   const std::string capture_path = argv[1];
+   Ipv4Endpoint destination_filter = {};
+   if (argc > 2 && !Ipv4Endpoint::parse(argv[2], destination_filter))
+   {
+      std::cout << "Invalid destination " << argv[2] << std::endl;
+      return -1;
+   }
+
+   std::cout << "DELTA-IP ST2110-21 CAPTURE ANALYZER\n(c) "
+                "DELTACAST\n--------------------------------------------------------"
+             << std::endl
+             << std::endl;
+
+   const auto start = std::chrono::steady_clock::now();
+
+   PcapReader reader;
+   if (!reader.open(capture_path))
+      return -1;
+
+   // The flows are spread over the workers as they are discovered and analyzed while the capture is read, the packets
+   // keep pointing into the mapped capture
+   const size_t nb_workers = std::max(1u, std::thread::hardware_concurrency());
+   std::vector<FlowItemQueue> queues(nb_workers);
+   std::vector<std::vector<FlowItem>> batches(nb_workers);
+   std::vector<std::vector<std::pair<size_t, FlowReport>>> worker_reports(nb_workers);
+   std::vector<std::thread> workers(nb_workers);
+   for (size_t worker_index = 0; worker_index < nb_workers; worker_index++)
+   {
+      workers[worker_index] = std::thread([&, worker_index]() {
+         std::unordered_map<size_t, St2110_21FlowAnalyzer> analyzers;
+         for (std::vector<FlowItem> batch = queues[worker_index].pop(); !batch.empty();
+              batch = queues[worker_index].pop())
+         {
+            for (const FlowItem& item : batch)
+               analyzers.try_emplace(item.flow, item.key).first->second.add_packet(item.packet);
+         }
+         for (auto& analyzer : analyzers)
+            worker_reports[worker_index].emplace_back(analyzer.first, analyzer.second.finish());
+      });
+   }
+
+   std::unordered_map<FlowKey, size_t, FlowKeyHash> flow_indexes;
+   std::vector<FlowKey> flow_keys;
+   PcapPacket packet;
+   UdpDatagram datagram;
+   uint64_t nb_packets = 0, first_timestamp_ns = 0, last_timestamp_ns = 0;
+
+   while (reader.next(packet))
+   {
+      if (nb_packets++ == 0)
+         first_timestamp_ns = packet.timestamp_ns;
+      last_timestamp_ns = packet.timestamp_ns;
+
+      if (!parse_udp_datagram(packet, datagram) || datagram.payload_size < 12 || (datagram.payload[0] >> 6) != 2)
+         continue;
+      if (destination_filter.port != 0 && datagram.destination != destination_filter)
+         continue;
+
+      const uint8_t* ssrc = datagram.payload + 8;
+      const FlowKey key = {datagram.source, datagram.destination,
+                           (static_cast<uint32_t>(ssrc[0]) << 24) | (static_cast<uint32_t>(ssrc[1]) << 16) |
+                               (static_cast<uint32_t>(ssrc[2]) << 8) | ssrc[3]};
+      auto flow = flow_indexes.find(key);
+      if (flow == flow_indexes.end())
+      {
+         flow = flow_indexes.emplace(key, flow_keys.size()).first;
+         flow_keys.push_back(key);
+      }
+
+      const size_t worker_index = flow->second % nb_workers;
+      batches[worker_index].push_back(
+          {flow->second, key, {packet.timestamp_ns, datagram.payload, datagram.payload_size}});
+      if (batches[worker_index].size() >= FlowItemQueue::batch_size)
+      {
+         queues[worker_index].push(std::move(batches[worker_index]));
+         batches[worker_index].clear();
+      }
+   }
+
+   for (size_t worker_index = 0; worker_index < nb_workers; worker_index++)
+   {
+      if (!batches[worker_index].empty())
+         queues[worker_index].push(std::move(batches[worker_index]));
+      queues[worker_index].push({});
+   }
+   for (auto& worker : workers)
+      worker.join();
+
+   if (reader.position() != reader.file_size())
+      std::cout << "Warning: capture truncated or corrupted after " << reader.position() << " bytes" << std::endl;
+
+   std::vector<FlowReport> reports(flow_keys.size());
+   for (auto& flow_reports : worker_reports)
+   {
+      for (auto& flow_report : flow_reports)
+         reports[flow_report.first] = flow_report.second;
+   }
+
+   for (const FlowReport& report : reports)
+   {
+      print_flow_report(report);
+      std::cout << std::endl;
+   }
+
+   const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   const double capture_duration_s = (last_timestamp_ns - first_timestamp_ns) / 1e9;
+   std::cout << nb_packets << " packets, " << flow_keys.size() << " RTP flows, " << reader.file_size() / 1000000
+             << " MB analyzed in " << elapsed_s << " s for " << capture_duration_s << " s of capture" << std::endl;
+
+   return 0;
+}
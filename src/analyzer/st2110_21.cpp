@@ -0,0 +1,379 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "st2110_21.h"
+
+namespace
+{
+   const double beta = 1.1; // Scaling factor of the network compatibility model drain
+
+   uint32_t most_frequent(std::vector<uint32_t>::const_iterator begin, std::vector<uint32_t>::const_iterator end)
+   {
+      std::map<uint32_t, uint32_t> histogram;
+      for (auto it = begin; it != end; ++it)
+         histogram[*it]++;
+      return std::max_element(histogram.begin(), histogram.end(),
+                              [](const auto& a, const auto& b) { return a.second < b.second; })
+          ->first;
+   }
+
+   uint32_t at_least(uint32_t minimum, double value)
+   {
+      return std::max(minimum, static_cast<uint32_t>(std::floor(value)));
+   }
+
+   bool is_same_geometry(const PixelGroup& lhs, const PixelGroup& rhs)
+   {
+      return lhs.size == rhs.size && lhs.nb_pixels == rhs.nb_pixels;
+   }
+
+   // The samplings and depths of the same bytes per pixel, whose sample row data of whole lines look the same
+   std::string get_video_format_names(const PixelGroup& pgroup)
+   {
+      std::string names;
+      for (VHD_ST2110_20_SAMPLING sampling : video_samplings)
+      {
+         for (VHD_ST2110_20_DEPTH depth : video_depths)
+         {
+            const PixelGroup other = get_pixel_group({sampling, depth});
+            if (other.size * pgroup.nb_pixels == pgroup.size * other.nb_pixels)
+               names += (names.empty() ? "" : ", ") + std::string(get_sampling_name(sampling)) + " " +
+                        std::to_string(get_component_depth(depth)) + "-bit";
+         }
+      }
+      return names;
+   }
+}
+
+const char* to_string(St2110_21SenderType sender_type)
+{
+   switch (sender_type)
+   {
+   case St2110_21SenderType::narrow: return "narrow (N)";
+   case St2110_21SenderType::narrow_linear: return "narrow linear (NL)";
+   case St2110_21SenderType::wide: return "wide (W)";
+   case St2110_21SenderType::not_compliant: return "not compliant";
+   default: return "unknown";
+   }
+}
+
+St2110_21FlowAnalyzer::St2110_21FlowAnalyzer(const FlowKey& key)
+{
+   m_report.key = key;
+
+   // The format of the VideoMaster boards comes first, to be kept when others give the same video standard
+   m_format_candidates.push_back({get_pixel_group(default_video_format)});
+   for (VHD_ST2110_20_SAMPLING sampling : video_samplings)
+   {
+      for (VHD_ST2110_20_DEPTH depth : video_depths)
+      {
+         const PixelGroup pgroup = get_pixel_group({sampling, depth});
+         if (pgroup.size && std::none_of(m_format_candidates.begin(), m_format_candidates.end(),
+                                         [&](const St2110_21FormatCandidate& candidate) {
+                                            return is_same_geometry(candidate.pgroup, pgroup);
+                                         }))
+            m_format_candidates.push_back({pgroup});
+      }
+   }
+}
+
+void St2110_21FlowAnalyzer::add_packet(const FlowPacket& flow_packet)
+{
+   m_report.nb_packets++;
+
+   St2110_20Packet packet;
+   if (!parse_st2110_20_packet(flow_packet.payload, flow_packet.payload_size, packet))
+   {
+      m_report.nb_invalid_packets++;
+      return;
+   }
+
+   if (m_has_sequence_number && packet.sequence_number != m_previous_sequence_number + 1)
+      m_report.nb_sequence_errors++;
+   m_previous_sequence_number = packet.sequence_number;
+   m_has_sequence_number = true;
+
+   if (m_format_detected)
+   {
+      if (m_report.video_standard)
+         measure(flow_packet, packet);
+      return;
+   }
+
+   // Detect the format from the sample row data headers and the RTP timestamps
+   for (uint32_t i = 0; i < packet.nb_sample_row_data; i++)
+   {
+      const St2110_20SampleRowData& sample_row_data = packet.sample_row_data[i];
+      m_field_seen = m_field_seen || sample_row_data.field;
+      m_max_row = std::max<uint32_t>(m_max_row, sample_row_data.row_number);
+      for (St2110_21FormatCandidate& candidate : m_format_candidates)
+      {
+         candidate.is_aligned = candidate.is_aligned && sample_row_data.length % candidate.pgroup.size == 0 &&
+                                sample_row_data.offset % candidate.pgroup.nb_pixels == 0;
+         candidate.max_pixel =
+             std::max(candidate.max_pixel, sample_row_data.offset + sample_row_data.length / candidate.pgroup.size *
+                                                                        candidate.pgroup.nb_pixels);
+      }
+   }
+
+   if (!m_detection_packets.empty() && packet.timestamp != m_detection_timestamp)
+   {
+      m_frame_sizes.push_back(m_frame_size);
+      const uint32_t delta = packet.timestamp - m_detection_timestamp;
+      if (delta < rtp_clock_rate)
+         m_timestamp_delta_ticks.add(delta);
+      m_frame_size = 0;
+   }
+   m_detection_timestamp = packet.timestamp;
+   m_frame_size++;
+   m_detection_packets.push_back(flow_packet);
+
+   // The first frame is usually cut by the start of the capture
+   if (m_frame_sizes.size() > detection_frames || m_detection_packets.size() >= max_detection_packets)
+      detect_format();
+}
+
+FlowReport St2110_21FlowAnalyzer::finish()
+{
+   if (!m_format_detected)
+      detect_format();
+
+   // The frame in progress is usually cut by the stop of the capture, its measurements are not kept
+   if (m_report.nb_frames == 0)
+      m_report.sender_type = St2110_21SenderType::unknown;
+   else if (m_report.cmax <= m_report.cmax_narrow && m_report.vrx_gapped_max <= m_report.vrx_full_narrow)
+      m_report.sender_type = St2110_21SenderType::narrow;
+   else if (m_report.cmax <= m_report.cmax_narrow_linear && m_report.vrx_linear_max <= m_report.vrx_full_narrow)
+      m_report.sender_type = St2110_21SenderType::narrow_linear;
+   else if (m_report.cmax <= m_report.cmax_wide && m_report.vrx_gapped_max <= m_report.vrx_full_wide)
+      m_report.sender_type = St2110_21SenderType::wide;
+   else
+      m_report.sender_type = St2110_21SenderType::not_compliant;
+
+   return m_report;
+}
+
+void St2110_21FlowAnalyzer::detect_format()
+{
+   m_format_detected = true;
+   std::vector<FlowPacket> detection_packets;
+   detection_packets.swap(m_detection_packets);
+
+   // The sizes of the frames held, the first and the last ones being left out as possibly cut
+   std::vector<uint32_t> frame_sizes = m_frame_sizes;
+   if (!detection_packets.empty())
+      frame_sizes.push_back(m_frame_size);
+   m_frame_sizes.clear();
+   const bool is_aligned = std::any_of(m_format_candidates.begin(), m_format_candidates.end(),
+                                       [](const St2110_21FormatCandidate& candidate) { return candidate.is_aligned; });
+   if (frame_sizes.size() < 3 || !is_aligned || m_timestamp_delta_ticks.count == 0)
+      return;
+
+   m_report.is_video = true;
+   m_report.nb_packets_per_frame = most_frequent(frame_sizes.begin() + 1, frame_sizes.end() - 1);
+   m_report.interlaced = m_field_seen;
+
+   // The first pixel groups whose frame size and rate are the ones of a video standard
+   const double period_ticks = m_timestamp_delta_ticks.mean();
+   double best_error = 0.01;
+   for (const St2110_21FormatCandidate& candidate : m_format_candidates)
+   {
+      if (!candidate.is_aligned)
+         continue;
+      const uint32_t frame_width = candidate.max_pixel;
+      const uint32_t frame_height = (m_max_row + 1) * (m_field_seen ? 2 : 1);
+      for (uint32_t i = 0; i < nb_video_standard_infos; i++)
+      {
+         const VideoStandardInfo& info = video_standard_infos[i];
+         if (info.frame_width != frame_width || info.frame_height != frame_height ||
+             info.interlaced != m_report.interlaced)
+            continue;
+         const double ticks = rtp_clock_rate * (info.is_us ? 1.001 : 1.0) / info.frame_rate;
+         const double error = std::abs(ticks - period_ticks) / ticks;
+         if (error < best_error)
+         {
+            best_error = error;
+            m_report.video_standard = &info;
+            m_report.pgroup = candidate.pgroup;
+            m_report.frame_width = frame_width;
+            m_report.frame_height = frame_height;
+         }
+      }
+   }
+
+   // Without its pixel groups, the frame size of the flow is unknown and it is not measured
+   m_report.rate = rtp_clock_rate / period_ticks;
+   if (!m_report.video_standard)
+      return;
+
+   m_period = FramePeriod{m_report.video_standard->frame_rate * 1000ull,
+                          m_report.video_standard->is_us ? 1001ull : 1000ull};
+   m_report.rate = static_cast<double>(m_period.numerator) / static_cast<double>(m_period.denominator);
+
+   // Timing model, per frame for progressive video and per field for interlaced video
+   const St2110_21Timing timing =
+       get_st2110_21_timing(m_period, m_report.frame_height, m_report.interlaced, m_report.nb_packets_per_frame);
+   const double nb_packets_per_frame = m_report.nb_packets_per_frame;
+   m_report.tframe_ns = timing.tframe_ns;
+   m_report.trs_ns = timing.trs_ns;
+   m_report.tro_ns = timing.tro_ns;
+   m_trs_linear_ns = m_report.tframe_ns / nb_packets_per_frame;
+   m_tdrain_ns = m_report.tframe_ns / nb_packets_per_frame / beta;
+
+   const double tframe_s = m_report.tframe_ns / 1e9;
+   m_report.cmax_narrow = timing.cmax_narrow;
+   m_report.cmax_narrow_linear = at_least(4, nb_packets_per_frame / (43200 * tframe_s));
+   m_report.cmax_wide = at_least(16, nb_packets_per_frame / (21600 * tframe_s));
+   m_report.vrx_full_narrow = at_least(8, nb_packets_per_frame / (27000 * tframe_s));
+   m_report.vrx_full_wide = at_least(720, nb_packets_per_frame / (300 * tframe_s));
+
+   // The packets held are measured, the following ones will be as they come
+   St2110_20Packet packet;
+   for (const FlowPacket& flow_packet : detection_packets)
+   {
+      if (parse_st2110_20_packet(flow_packet.payload, flow_packet.payload_size, packet))
+         measure(flow_packet, packet);
+   }
+}
+
+void St2110_21FlowAnalyzer::measure(const FlowPacket& flow_packet, const St2110_20Packet& packet)
+{
+   // Network compatibility model over the whole flow, virtual receiver buffer per complete frame
+   const uint64_t time_ns = flow_packet.timestamp_ns;
+
+   if (m_has_previous)
+   {
+      const double inter_packet_ns = static_cast<double>(time_ns - m_previous_time_ns);
+      m_report.inter_packet_ns.add(inter_packet_ns);
+      m_bucket = std::max(0.0, m_bucket - inter_packet_ns / m_tdrain_ns);
+   }
+   m_bucket += 1.0;
+   m_report.cmax = std::max(m_report.cmax, static_cast<uint32_t>(m_bucket));
+
+   if (!m_has_previous || packet.timestamp != m_frame_timestamp)
+   {
+      if (m_has_previous)
+      {
+         end_frame();
+         m_frame_index++;
+      }
+      m_frame_timestamp = packet.timestamp;
+      m_nb_received = 0;
+
+      if (m_frame_index > 0)
+      {
+         const uint64_t epoch_index = m_period.index_at(time_ns);
+         m_tpr0_ns = m_period.epoch_ns(epoch_index) + static_cast<uint64_t>(m_report.tro_ns);
+         m_frame_rtp_offset_ticks = static_cast<int32_t>(packet.timestamp - m_period.epoch_rtp_time(epoch_index));
+         m_frame_first_packet_latency_ns =
+             static_cast<int32_t>(to_rtp_time(time_ns) - packet.timestamp) * 1e9 / rtp_clock_rate;
+         m_frame_vrx_gapped_max = 0;
+         m_frame_vrx_gapped_min = 0;
+         m_frame_vrx_linear_max = 0;
+      }
+   }
+   m_previous_time_ns = time_ns;
+   m_has_previous = true;
+
+   if (m_frame_index == 0)
+      return;
+
+   // The receiver reads one packet every TRS from TPR0 on. The buffer is assumed empty at the start of every
+   // frame, which holds for the compliant senders this is meant to tell apart.
+   m_nb_received++;
+   const double elapsed_ns = (time_ns >= m_tpr0_ns) ? static_cast<double>(time_ns - m_tpr0_ns) : -1.0;
+   const int64_t nb_read_gapped =
+       elapsed_ns < 0 ? 0
+                      : std::min<int64_t>(m_report.nb_packets_per_frame,
+                                          1 + static_cast<int64_t>(elapsed_ns / m_report.trs_ns));
+   const int64_t nb_read_linear =
+       elapsed_ns < 0 ? 0
+                      : std::min<int64_t>(m_report.nb_packets_per_frame,
+                                          1 + static_cast<int64_t>(elapsed_ns / m_trs_linear_ns));
+   const int64_t vrx_gapped = m_nb_received - nb_read_gapped;
+   const int64_t vrx_linear = m_nb_received - nb_read_linear;
+   m_frame_vrx_gapped_max = std::max(m_frame_vrx_gapped_max, vrx_gapped);
+   m_frame_vrx_gapped_min = std::min(m_frame_vrx_gapped_min, vrx_gapped);
+   m_frame_vrx_linear_max = std::max(m_frame_vrx_linear_max, vrx_linear);
+}
+
+void St2110_21FlowAnalyzer::end_frame()
+{
+   // The first frame is usually cut by the start of the capture
+   if (m_frame_index == 0)
+      return;
+
+   m_report.rtp_offset_ticks.add(m_frame_rtp_offset_ticks);
+   m_report.first_packet_latency_ns.add(m_frame_first_packet_latency_ns);
+   m_report.vrx_gapped_max = std::max(m_report.vrx_gapped_max, m_frame_vrx_gapped_max);
+   m_report.vrx_gapped_min = std::min(m_report.vrx_gapped_min, m_frame_vrx_gapped_min);
+   m_report.vrx_linear_max = std::max(m_report.vrx_linear_max, m_frame_vrx_linear_max);
+   m_report.nb_frames++;
+}
+
+void print_flow_report(const FlowReport& report)
+{
+   std::cout << "Flow " << to_chars(report.key.source).c_str() << " -> " << to_chars(report.key.destination).c_str()
+             << " SSRC 0x" << std::hex << report.key.ssrc << std::dec << std::endl;
+   if (!report.is_video)
+   {
+      std::cout << "   Not a ST 2110-20 flow (" << report.nb_packets << " packets), skipped" << std::endl;
+      return;
+   }
+
+   std::cout << std::fixed << std::setprecision(2);
+   if (!report.video_standard)
+   {
+      std::cout << "   Format: no pixel groups give a supported video standard at " << report.rate
+                << (report.interlaced ? " fields/s" : " frames/s") << " (" << report.nb_packets
+                << " packets), skipped" << std::endl;
+      std::cout << std::defaultfloat;
+      return;
+   }
+   std::cout << "   Format: " << report.frame_width << "x" << report.frame_height << (report.interlaced ? "i" : "p")
+             << " at " << report.rate << (report.interlaced ? " fields/s" : " frames/s") << ", pixel groups of "
+             << report.pgroup.size << " bytes for " << report.pgroup.nb_pixels << " pixels ("
+             << get_video_format_names(report.pgroup) << ")" << std::endl;
+   std::cout << "   Packets: " << report.nb_packets << " (" << report.nb_invalid_packets << " invalid, "
+             << report.nb_sequence_errors << " sequence errors), " << report.nb_packets_per_frame
+             << " packets per " << (report.interlaced ? "field" : "frame") << ", " << report.nb_frames
+             << " complete " << (report.interlaced ? "fields" : "frames") << std::endl;
+   std::cout << "   TFRAME = " << report.tframe_ns / 1000 << " us, TRS = " << report.trs_ns / 1000
+             << " us, TRO = " << report.tro_ns / 1000 << " us" << std::endl;
+   std::cout << "   Inter-packet arrival: min " << report.inter_packet_ns.min / 1000 << " us, mean "
+             << report.inter_packet_ns.mean() / 1000 << " us, max " << report.inter_packet_ns.max / 1000 << " us"
+             << std::endl;
+   std::cout << "   CMAX: " << report.cmax << " (narrow " << report.cmax_narrow << ", narrow linear "
+             << report.cmax_narrow_linear << ", wide " << report.cmax_wide << ")" << std::endl;
+   std::cout << "   VRX: gapped " << report.vrx_gapped_max << ", linear " << report.vrx_linear_max << " (narrow "
+             << report.vrx_full_narrow << ", wide " << report.vrx_full_wide << ")" << std::endl;
+   if (report.vrx_gapped_min < 0)
+      std::cout << "   VRX underrun: packets arrived up to " << -report.vrx_gapped_min
+                << " drain periods after the virtual receiver read them" << std::endl;
+   std::cout << "   RTP offset vs PTP epoch: min " << report.rtp_offset_ticks.min << ", mean "
+             << report.rtp_offset_ticks.mean() << ", max " << report.rtp_offset_ticks.max << " ticks" << std::endl;
+   std::cout << "   First packet vs RTP timestamp: min " << report.first_packet_latency_ns.min / 1000 << " us, mean "
+             << report.first_packet_latency_ns.mean() / 1000 << " us, max "
+             << report.first_packet_latency_ns.max / 1000 << " us" << std::endl;
+   std::cout << "   Sender type: " << to_string(report.sender_type) << std::endl;
+   std::cout << std::defaultfloat;
+}
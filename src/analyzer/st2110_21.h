@@ -0,0 +1,243 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file st2110_21.h
+   @brief This file contains the ST 2110-21 timing model analysis of a captured ST 2110-20 flow.
+
+   @detail A capture does not carry the SDP of its flows: the pixel groups of a flow are taken as the first ones, among
+   the samplings and depths of video_format.h and YCbCr-4:2:2 10-bit first, that give a known video standard at the
+   measured rate. Several samplings and depths share the same pixel groups (e.g. RGB 8-bit and YCbCr-4:4:4 8-bit) and
+   cannot be told apart. A flow that no pixel groups fit is reported as not recognised and not measured. For interlaced video, every RTP timestamp is a field
+   and the timing model is applied per field. A flow is analyzed as its packets are read: only the packets of the first frames are held, until the format
+   is detected.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <cstddef>
+#include <vector>
+
+#include "../st2110_timing.h"
+
+#include "../ipv4.h"
+#include "../rtp.h"
+#include "../tools.h"
+#include "../video_format.h"
+
+/*!
+   @brief Identifier of a RTP flow in a capture
+*/
+struct FlowKey
+{
+   Ipv4Endpoint source;
+   Ipv4Endpoint destination;
+   uint32_t ssrc;
+
+   bool operator==(const FlowKey& other) const
+   {
+      return source == other.source && destination == other.destination && ssrc == other.ssrc;
+   }
+};
+
+struct FlowKeyHash
+{
+   size_t operator()(const FlowKey& key) const
+   {
+      uint64_t hash = (static_cast<uint64_t>(key.source.address.value()) << 32) | key.destination.address.value();
+      hash ^= (static_cast<uint64_t>(key.source.port) << 48) | (static_cast<uint64_t>(key.destination.port) << 32) |
+              key.ssrc;
+      return static_cast<size_t>(hash * 0x9e3779b97f4a7c15ull);
+   }
+};
+
+/*!
+   @brief Captured RTP packet of a flow, pointing into the mapped capture
+*/
+struct FlowPacket
+{
+   uint64_t timestamp_ns /*! Capture timestamp, expected to be PTP time */;
+   const uint8_t* payload /*! UDP payload */;
+   uint32_t payload_size;
+};
+
+/*!
+   @brief Minimum, mean and maximum of a series of values
+*/
+struct Statistic
+{
+   double min = 0.0;
+   double max = 0.0;
+   double sum = 0.0;
+   uint64_t count = 0;
+
+   void add(double value)
+   {
+      min = (count == 0 || value < min) ? value : min;
+      max = (count == 0 || value > max) ? value : max;
+      sum += value;
+      count++;
+   }
+   double mean() const { return count ? sum / count : 0.0; }
+};
+
+/*!
+   @brief ST 2110-21 compliance of a flow
+*/
+enum class St2110_21SenderType
+{
+   narrow /*! Type N, narrow gapped */,
+   narrow_linear /*! Type NL */,
+   wide /*! Type W */,
+   not_compliant,
+   unknown /*! Not enough complete frames to tell */
+};
+
+/*!
+   @brief Result of the analysis of a flow
+*/
+struct FlowReport
+{
+   FlowKey key = {};
+   bool is_video = false /*! False if the flow does not look like a ST 2110-20 flow */;
+
+   // Format, detected from the sample row data headers and the RTP timestamps
+   const VideoStandardInfo* video_standard = nullptr /*! Matching entry of video_standard_infos, the flow is not
+                                                         measured without it */;
+   PixelGroup pgroup = {} /*! Pixel groups that give video_standard */;
+   uint32_t frame_width = 0;
+   uint32_t frame_height = 0;
+   bool interlaced = false;
+   double rate = 0.0 /*! Frames per second, fields per second for interlaced video */;
+
+   // Counters
+   uint64_t nb_packets = 0;
+   uint64_t nb_invalid_packets = 0;
+   uint64_t nb_sequence_errors = 0 /*! Number of discontinuities of the extended sequence number */;
+   uint64_t nb_frames = 0 /*! Number of complete frames (or fields) taken into account */;
+   uint32_t nb_packets_per_frame = 0 /*! NPACKETS */;
+
+   // Timing model parameters
+   double tframe_ns = 0.0;
+   double trs_ns = 0.0 /*! Gapped model drain period */;
+   double tro_ns = 0.0 /*! Default read offset */;
+
+   // Measurements
+   Statistic inter_packet_ns;
+   uint32_t cmax = 0 /*! Largest network compatibility model bucket occupancy */;
+   int64_t vrx_gapped_max = 0 /*! Largest virtual receiver buffer occupancy, gapped model */;
+   int64_t vrx_linear_max = 0 /*! Largest virtual receiver buffer occupancy, linear model */;
+   int64_t vrx_gapped_min = 0 /*! Negative when a packet arrived after the receiver should have read it */;
+   Statistic rtp_offset_ticks /*! RTP timestamp of the frame minus the RTP time of its PTP epoch */;
+   Statistic first_packet_latency_ns /*! First packet of the frame versus the time of its RTP timestamp */;
+
+   // Limits
+   uint32_t cmax_narrow = 0;
+   uint32_t cmax_narrow_linear = 0;
+   uint32_t cmax_wide = 0;
+   uint32_t vrx_full_narrow = 0;
+   uint32_t vrx_full_wide = 0;
+
+   St2110_21SenderType sender_type = St2110_21SenderType::unknown;
+};
+
+const char* to_string(St2110_21SenderType sender_type /*!< [in] Sender type to convert*/);
+
+/*!
+   @brief Pixel groups a flow is checked against during the format detection
+*/
+struct St2110_21FormatCandidate
+{
+   PixelGroup pgroup;
+   uint32_t max_pixel = 0 /*! End of the widest sample row data, in pixels */;
+   bool is_aligned = true /*! Every sample row data holds whole pixel groups */;
+};
+
+/*!
+   @brief Detect the format of a flow and measure it against the ST 2110-21 timing models, one packet at a time
+
+   @detail The packets of the first detection_frames complete frames are held to detect the format (the number of
+   packets per frame is the most frequent one among them), then replayed through the timing models, which see every
+   following packet as it is added. The memory used does not depend on the length of the capture.
+
+   The capture timestamps are taken as PTP time: the frame epochs and the RTP offsets are only meaningful on
+   captures timestamped by a PTP-locked capture device.
+*/
+class St2110_21FlowAnalyzer
+{
+public:
+   static constexpr uint32_t detection_frames = 8;
+   static constexpr size_t max_detection_packets = 1 << 20; /*! Flows that do not complete their frames */
+
+   explicit St2110_21FlowAnalyzer(const FlowKey& key /*!< [in] Flow to analyze*/);
+
+   /*!
+      @brief Add the next packet of the flow, in capture order
+   */
+   void add_packet(const FlowPacket& flow_packet /*!< [in] Packet of the flow*/);
+
+   /*!
+      @brief End the analysis at the end of the capture
+
+      @detail The last frame, usually cut by the stop of the capture, is not taken into account.
+   */
+   FlowReport finish();
+
+private:
+   void detect_format();
+   void measure(const FlowPacket& flow_packet, const St2110_20Packet& packet);
+   void end_frame();
+
+   FlowReport m_report;
+   bool m_has_sequence_number = false;
+   uint32_t m_previous_sequence_number = 0;
+
+   // Format detection
+   bool m_format_detected = false;
+   std::vector<FlowPacket> m_detection_packets;
+   uint32_t m_max_row = 0;
+   bool m_field_seen = false;
+   std::vector<St2110_21FormatCandidate> m_format_candidates;
+   uint32_t m_detection_timestamp = 0;
+   uint32_t m_frame_size = 0;
+   std::vector<uint32_t> m_frame_sizes /*! Packets of the frames ended so far */;
+   Statistic m_timestamp_delta_ticks;
+
+   // Timing models
+   FramePeriod m_period = {};
+   double m_trs_linear_ns = 0.0;
+   double m_tdrain_ns = 0.0;
+   double m_bucket = 0.0;
+   bool m_has_previous = false;
+   uint64_t m_previous_time_ns = 0;
+   uint32_t m_frame_timestamp = 0;
+   uint64_t m_frame_index = 0;
+   uint64_t m_tpr0_ns = 0;
+   int64_t m_nb_received = 0;
+
+   // Measurements of the current frame, kept once the next frame starts
+   double m_frame_rtp_offset_ticks = 0.0;
+   double m_frame_first_packet_latency_ns = 0.0;
+   int64_t m_frame_vrx_gapped_max = 0;
+   int64_t m_frame_vrx_gapped_min = 0;
+   int64_t m_frame_vrx_linear_max = 0;
+};
+
+void print_flow_report(const FlowReport& report /*!< [in] Analysis to print*/);
@@ -0,0 +1,225 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "async_log_gate.h"
+
+namespace
+{
+   // The producers notify the writer without taking its mutex, a missed notification is caught up by the next poll
+   const std::chrono::milliseconds writer_poll_period(10);
+}
+
+AsyncLogGate::AsyncLogGate(slog::base_gate& gate, uint32_t capacity)
+    : m_gate(gate)
+    , m_capacity(capacity)
+{
+   if (!m_capacity)
+      return;
+
+   m_records.reset(new Record[m_capacity]);
+   for (uint32_t i = 0; i < m_capacity; i++)
+      m_records[i].sequence.store(i, std::memory_order_relaxed);
+   m_thread = std::thread([this] { run(); });
+}
+
+AsyncLogGate::~AsyncLogGate()
+{
+   if (!m_thread.joinable())
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+   }
+   m_condition.notify_all();
+   m_thread.join();
+}
+
+bool AsyncLogGate::pertinent(slog::severity level) const
+{
+   if (!m_gate.pertinent(level))
+      return false;
+   if (!m_capacity)
+      return true;
+
+   // A record that would be dropped is not formatted at all
+   if (m_enqueue_position.load(std::memory_order_relaxed) - m_dequeue_position.load(std::memory_order_relaxed) >=
+       m_capacity)
+   {
+      m_nb_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+   }
+   return true;
+}
+
+void AsyncLogGate::log(const slog::log_message& message) const
+{
+   if (!m_capacity)
+   {
+      m_gate.log(message);
+      m_nb_records.fetch_add(1, std::memory_order_relaxed);
+      m_nb_written.fetch_add(1, std::memory_order_relaxed);
+      return;
+   }
+
+   if (!push(message))
+   {
+      m_nb_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+   }
+   m_condition.notify_one();
+}
+
+void AsyncLogGate::flush() const
+{
+   while (m_thread.joinable() &&
+          m_nb_written.load(std::memory_order_acquire) < m_nb_records.load(std::memory_order_acquire))
+   {
+      m_condition.notify_one();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+}
+
+AsyncLogStatistics AsyncLogGate::get_statistics() const
+{
+   AsyncLogStatistics statistics;
+   statistics.nb_records = m_nb_records.load(std::memory_order_relaxed);
+   statistics.nb_written = m_nb_written.load(std::memory_order_relaxed);
+   statistics.nb_dropped = m_nb_dropped.load(std::memory_order_relaxed);
+   statistics.max_backlog = m_max_backlog.load(std::memory_order_relaxed);
+   statistics.capacity = m_capacity;
+   return statistics;
+}
+
+void AsyncLogGate::print_statistics() const
+{
+   if (!m_capacity)
+      return;
+
+   const AsyncLogStatistics statistics = get_statistics();
+   std::cout << "Log: " << statistics.nb_records << " records - " << statistics.nb_written << " written - "
+             << statistics.nb_dropped << " dropped (queue full) - max backlog " << statistics.max_backlog << "/"
+             << statistics.capacity << std::endl;
+}
+
+bool AsyncLogGate::push(const slog::log_message& message) const
+{
+   // Bounded multi-producer queue: a cell is claimed by moving the enqueue position past it, and published to the
+   // writer by its sequence once filled
+   uint64_t position = m_enqueue_position.load(std::memory_order_relaxed);
+   Record* record = nullptr;
+   while (!record)
+   {
+      Record& cell = m_records[position % m_capacity];
+      const uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+      const int64_t difference = static_cast<int64_t>(sequence - position);
+      if (difference == 0)
+      {
+         if (m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            record = &cell;
+      }
+      else if (difference < 0)
+         return false;
+      else
+         position = m_enqueue_position.load(std::memory_order_relaxed);
+   }
+
+   record->level = message.level();
+   record->file = message.file();
+   record->line = message.line();
+   record->function = message.function();
+   record->text = message.str();
+   record->sequence.store(position + 1, std::memory_order_release);
+
+   m_nb_records.fetch_add(1, std::memory_order_release);
+   const uint32_t backlog =
+       static_cast<uint32_t>(position + 1 - m_dequeue_position.load(std::memory_order_relaxed));
+   uint32_t max_backlog = m_max_backlog.load(std::memory_order_relaxed);
+   while (backlog > max_backlog &&
+          !m_max_backlog.compare_exchange_weak(max_backlog, backlog, std::memory_order_relaxed))
+   {
+   }
+   return true;
+}
+
+bool AsyncLogGate::pop(Record& record)
+{
+   const uint64_t position = m_dequeue_position.load(std::memory_order_relaxed);
+   Record& cell = m_records[position % m_capacity];
+   if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+      return false;
+
+   record.level = cell.level;
+   record.file = cell.file;
+   record.line = cell.line;
+   record.function = cell.function;
+   record.text.swap(cell.text);
+   cell.sequence.store(position + m_capacity, std::memory_order_release);
+   m_dequeue_position.store(position + 1, std::memory_order_relaxed);
+   return true;
+}
+
+void AsyncLogGate::write(const Record& record) const
+{
+   // The record is written with the timestamp and the thread of the writer
+   slog::log_message message(record.file, record.line, record.function, record.level);
+   message.stream() << record.text;
+   m_gate.log(message);
+}
+
+void AsyncLogGate::report_dropped()
+{
+   const uint64_t nb_dropped = m_nb_dropped.load(std::memory_order_relaxed);
+   if (nb_dropped == m_nb_reported_dropped)
+      return;
+
+   slog::log<slog::severities::warning>(m_gate, SLOG_FLF)
+       << nb_dropped - m_nb_reported_dropped << " log records dropped, the log queue is full";
+   m_nb_reported_dropped = nb_dropped;
+}
+
+void AsyncLogGate::run()
+{
+   Record record;
+   while (true)
+   {
+      while (pop(record))
+      {
+         write(record);
+         m_nb_written.fetch_add(1, std::memory_order_release);
+      }
+      report_dropped();
+
+      if (m_stop)
+      {
+         // The records pushed before the stop are still written
+         while (pop(record))
+         {
+            write(record);
+            m_nb_written.fetch_add(1, std::memory_order_release);
+         }
+         break;
+      }
+
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait_for(lock, writer_poll_period, [this] {
+         const uint64_t position = m_dequeue_position.load(std::memory_order_relaxed);
+         return m_stop || m_records[position % m_capacity].sequence.load(std::memory_order_acquire) == position + 1;
+      });
+   }
+}
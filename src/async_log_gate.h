@@ -0,0 +1,115 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file async_log_gate.h
+   @brief This file contains the log gate that hands the log records over to a background writer.
+
+   @detail The threads that log (the HTTP server handling the IS-05 requests, the node behaviour) only format their
+   record and push it into a bounded lock-free queue. A background thread writes the records through the wrapped
+   gate, so that writing to std::cerr and inserting into the log model never delays them. When the queue is full, the
+   record is dropped and counted, and the writer reports how many records were dropped.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "nmos/slog.h"
+
+struct AsyncLogStatistics
+{
+   uint64_t nb_records = 0 /*! Records pushed into the queue */;
+   uint64_t nb_written = 0 /*! Records written through the wrapped gate */;
+   uint64_t nb_dropped = 0 /*! Records dropped because the queue was full */;
+   uint32_t max_backlog = 0 /*! Highest number of records waiting in the queue */;
+   uint32_t capacity = 0 /*! Capacity of the queue, 0 when the records are written synchronously */;
+};
+
+/*!
+   @brief Log gate writing the records of the wrapped gate from a background thread
+
+   @detail The pertinence of a record is the one of the wrapped gate. A record is also not pertinent while the queue
+   is full, so that a record about to be dropped is not even formatted.
+*/
+class AsyncLogGate : public slog::base_gate
+{
+public:
+   AsyncLogGate(slog::base_gate& gate /*!< [in] Gate the records are written through*/,
+                uint32_t capacity /*!< [in] Records the queue holds, 0 to write them synchronously*/);
+
+   /*!
+      @brief Write the records still queued and stop the writer
+   */
+   ~AsyncLogGate() override;
+
+   AsyncLogGate(const AsyncLogGate&) = delete;
+   AsyncLogGate& operator=(const AsyncLogGate&) = delete;
+
+   bool pertinent(slog::severity level) const override;
+   void log(const slog::log_message& message) const override;
+
+   /*!
+      @brief Wait until the records queued so far are written
+   */
+   void flush() const;
+
+   AsyncLogStatistics get_statistics() const;
+   void print_statistics() const;
+
+private:
+   struct Record
+   {
+      std::atomic<uint64_t> sequence{0} /*! Position the cell is free for (sequence == position) or ready at (+1) */;
+      slog::severity level = 0;
+      const char* file = nullptr;
+      int line = 0;
+      const char* function = nullptr;
+      std::string text;
+   };
+
+   bool push(const slog::log_message& message) const;
+   bool pop(Record& record);
+   void write(const Record& record) const;
+   void report_dropped();
+   void run();
+
+   slog::base_gate& m_gate;
+   const uint32_t m_capacity;
+   std::unique_ptr<Record[]> m_records;
+
+   alignas(64) mutable std::atomic<uint64_t> m_enqueue_position{0};
+   alignas(64) std::atomic<uint64_t> m_dequeue_position{0};
+
+   mutable std::atomic<uint64_t> m_nb_records{0};
+   mutable std::atomic<uint64_t> m_nb_written{0};
+   mutable std::atomic<uint64_t> m_nb_dropped{0};
+   mutable std::atomic<uint32_t> m_max_backlog{0};
+   uint64_t m_nb_reported_dropped = 0;
+
+   mutable std::mutex m_mutex;
+   mutable std::condition_variable m_condition;
+   std::atomic<bool> m_stop{false};
+   std::thread m_thread;
+};
@@ -0,0 +1,409 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && !defined(__APPLE__)
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include "ipv4_parsing.h"
+#include "../frame_hash.h"
+#include "../pixel_conversion.h"
+#include "../realtime.h"
+#include "../sender/pattern.h"
+#include "../tools.h"
+
+namespace
+{
+   struct BenchmarkResult
+   {
+      std::string name;
+      const VideoStandardInfo* video_standard_info;
+      uint64_t bytes_per_frame /*! Bytes written, or read for the hash */;
+      uint64_t nb_iterations;
+      double mean_ns;
+      double min_ns;
+   };
+
+   struct JitterResult
+   {
+      std::string scheduling;
+      uint64_t nb_wakeups;
+      double p50_ns;
+      double p99_ns;
+      double max_ns;
+   };
+
+   // Keeps the results of the benchmarked functions alive
+   volatile uint64_t sink = 0;
+
+   std::string get_video_standard_name(const VideoStandardInfo& info)
+   {
+      std::ostringstream name;
+      name << info.frame_width << "x" << info.frame_height << (info.interlaced ? "i" : "p");
+      if (info.is_us)
+         name << std::fixed << std::setprecision(2) << info.frame_rate / 1.001;
+      else
+         name << info.frame_rate;
+      return name.str();
+   }
+
+   // A slot holds a frame, and frame_rate is the field rate of interlaced standards
+   double get_frame_period_ns(const VideoStandardInfo& info)
+   {
+      return 1e9 * (info.is_us ? 1.001 : 1.0) * (info.interlaced ? 2 : 1) / info.frame_rate;
+   }
+
+   template <typename Function>
+   BenchmarkResult run_benchmark(const std::string& name, const VideoStandardInfo& info, uint64_t bytes_per_frame,
+                                 std::chrono::milliseconds min_time, Function&& function)
+   {
+      // The first run faults the pages of the buffers in
+      function(0);
+
+      BenchmarkResult result = {name, &info, bytes_per_frame, 0, 0.0, 0.0};
+      double total_ns = 0.0;
+      const auto start = std::chrono::steady_clock::now();
+      while (result.nb_iterations < 3 || std::chrono::steady_clock::now() - start < min_time)
+      {
+         const auto iteration_start = std::chrono::steady_clock::now();
+         function(result.nb_iterations);
+         const double iteration_ns =
+             std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - iteration_start).count();
+         result.min_ns = result.nb_iterations ? std::min(result.min_ns, iteration_ns) : iteration_ns;
+         total_ns += iteration_ns;
+         result.nb_iterations++;
+      }
+      result.mean_ns = total_ns / result.nb_iterations;
+      return result;
+   }
+
+   void run_video_standard_benchmarks(const VideoStandardInfo& info, std::chrono::milliseconds min_time,
+                                      std::vector<BenchmarkResult>& results)
+   {
+      const uint32_t w = info.frame_width, h = info.frame_height;
+      const uint64_t nb_pixels = static_cast<uint64_t>(w) * h;
+      const uint32_t nb_pgroups = static_cast<uint32_t>(nb_pixels / pgroup_pixels);
+
+      std::vector<uint8_t> pattern(nb_pixels * yuv422_8_bytes_per_pixel);
+      std::vector<uint8_t> slot_8(pattern.size());
+      std::vector<uint8_t> pgroups(static_cast<uint64_t>(nb_pgroups) * pgroup_size);
+      std::vector<uint8_t> frame_10(nb_pixels * yuv422_10_bytes_per_pixel);
+      std::vector<uint8_t> slot_10(frame_10.size());
+
+      results.push_back(run_benchmark("create_color_bar_pattern", info, pattern.size(), min_time, [&](uint64_t) {
+         create_color_bar_pattern(pattern.data(), h, w);
+      }));
+
+      results.push_back(run_benchmark("draw_white_line", info, w * yuv422_8_bytes_per_pixel, min_time,
+                                      [&](uint64_t iteration) {
+                                         draw_white_line(slot_8.data(), static_cast<uint32_t>(iteration % h), h, w,
+                                                         info.interlaced);
+                                      }));
+
+      results.push_back(run_benchmark("slot_copy_yuv422_8", info, slot_8.size(), min_time, [&](uint64_t) {
+         std::memcpy(slot_8.data(), pattern.data(), slot_8.size());
+      }));
+
+      results.push_back(run_benchmark("pack_yuv422_8_to_pgroups", info, pgroups.size(), min_time, [&](uint64_t) {
+         pack_yuv422_8_to_pgroups(pattern.data(), pgroups.data(), nb_pgroups);
+      }));
+
+      results.push_back(run_benchmark("unpack_pgroups_to_yuv422_10", info, frame_10.size(), min_time, [&](uint64_t) {
+         unpack_pgroups_to_yuv422_10(pgroups.data(), frame_10.data(), nb_pgroups);
+      }));
+
+      results.push_back(run_benchmark("slot_copy_yuv422_10", info, slot_10.size(), min_time, [&](uint64_t) {
+         std::memcpy(slot_10.data(), frame_10.data(), slot_10.size());
+      }));
+
+      results.push_back(run_benchmark("hash_frame_yuv422_10", info, frame_10.size(), min_time, [&](uint64_t) {
+         sink = sink + hash_frame(frame_10.data(), frame_10.size());
+      }));
+
+      sink = sink + slot_8[nb_pixels / 2] + slot_10[nb_pixels / 2] + pgroups[nb_pgroups / 2];
+   }
+
+   /*!
+      @brief Pack every video format from the 8-bit host layout and unpack it to the 16-bit one, a line (a line pair
+      for YCbCr-4:2:0) at a time as the packetizer and the depacketizer do
+   */
+   void run_video_format_benchmarks(const VideoStandardInfo& info, std::chrono::milliseconds min_time,
+                                    std::vector<BenchmarkResult>& results)
+   {
+      const uint32_t w = info.frame_width, h = info.frame_height;
+      for (VHD_ST2110_20_SAMPLING sampling : video_samplings)
+      {
+         for (VHD_ST2110_20_DEPTH depth : video_depths)
+         {
+            const VideoFormat format = {sampling, depth};
+            const PixelGroup pgroup = get_pixel_group(format);
+            const uint32_t nb_pgroups_per_line = w / pgroup.nb_pixels;
+            const uint64_t pgroups_line_size = static_cast<uint64_t>(nb_pgroups_per_line) * pgroup.size;
+            const uint64_t line_size_8 =
+                static_cast<uint64_t>(w) * get_host_bytes_per_pixel(sampling, HostComponent::byte);
+            const uint64_t line_size_16 =
+                static_cast<uint64_t>(w) * get_host_bytes_per_pixel(sampling, HostComponent::word);
+
+            std::vector<uint8_t> frame_8(line_size_8 * h);
+            for (size_t i = 0; i < frame_8.size(); i++)
+               frame_8[i] = static_cast<uint8_t>(i * 7 + i / line_size_8);
+            std::vector<uint8_t> pgroups(pgroups_line_size * (h / pgroup.nb_lines));
+            std::vector<uint8_t> frame_16(line_size_16 * h);
+
+            const std::string format_name = std::string(get_sampling_name(sampling)) + "_" +
+                                            std::to_string(get_component_depth(depth));
+            results.push_back(
+                run_benchmark("pack_pgroups_" + format_name, info, pgroups.size(), min_time, [&](uint64_t) {
+                   for (uint32_t line = 0; line + pgroup.nb_lines <= h; line += pgroup.nb_lines)
+                      pack_pgroups(format, frame_8.data() + line * line_size_8, HostComponent::byte, line_size_8,
+                                   pgroups.data() + line / pgroup.nb_lines * pgroups_line_size, nb_pgroups_per_line);
+                }));
+            results.push_back(
+                run_benchmark("unpack_pgroups_" + format_name, info, frame_16.size(), min_time, [&](uint64_t) {
+                   for (uint32_t line = 0; line + pgroup.nb_lines <= h; line += pgroup.nb_lines)
+                      unpack_pgroups(format, pgroups.data() + line / pgroup.nb_lines * pgroups_line_size,
+                                     frame_16.data() + line * line_size_16, HostComponent::word, line_size_16,
+                                     nb_pgroups_per_line);
+                }));
+
+            sink = sink + pgroups[pgroups.size() / 2] + frame_16[frame_16.size() / 2];
+         }
+      }
+   }
+
+   /*!
+      @brief Measure how late a thread wakes up at periodic deadlines, as the slot loop does at every slot
+
+      @detail The load threads spin on every CPU with the default scheduling, standing for the NMOS and HTTP
+      threads competing with the slot loop.
+   */
+   JitterResult measure_wakeup_jitter(const std::string& scheduling_name, const RealtimeConfig& config,
+                                      std::chrono::microseconds period, std::chrono::milliseconds duration,
+                                      uint32_t nb_load_threads)
+   {
+      std::atomic<bool> stop_load(false);
+      std::vector<std::thread> load_threads;
+      for (uint32_t i = 0; i < nb_load_threads; i++)
+      {
+         load_threads.emplace_back([&] {
+            uint64_t counter = 0;
+            while (!stop_load.load(std::memory_order_relaxed))
+               counter++;
+            sink = sink + counter;
+         });
+      }
+
+      JitterResult result = {scheduling_name, 0, 0.0, 0.0, 0.0};
+      std::thread measurement([&] {
+         apply_thread_scheduling(ThreadRole::slot_loop, config, std::cerr);
+
+         std::vector<double> lateness_ns;
+         lateness_ns.reserve(duration / period + 1);
+         const auto end = std::chrono::steady_clock::now() + duration;
+         for (auto deadline = std::chrono::steady_clock::now() + period; deadline < end; deadline += period)
+         {
+            std::this_thread::sleep_until(deadline);
+            lateness_ns.push_back(
+                std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - deadline).count());
+         }
+         if (lateness_ns.empty())
+            return;
+
+         std::sort(lateness_ns.begin(), lateness_ns.end());
+         result.nb_wakeups = lateness_ns.size();
+         result.p50_ns = lateness_ns[lateness_ns.size() / 2];
+         result.p99_ns = lateness_ns[lateness_ns.size() * 99 / 100];
+         result.max_ns = lateness_ns.back();
+      });
+      measurement.join();
+
+      stop_load = true;
+      for (auto& load_thread : load_threads)
+         load_thread.join();
+      return result;
+   }
+
+   void write_json(std::ostream& output, const std::vector<BenchmarkResult>& results,
+                   const std::vector<JitterResult>& jitter_results,
+                   const std::vector<Ipv4BenchmarkResult>& ipv4_results, std::chrono::milliseconds min_time)
+   {
+      output << std::fixed << std::setprecision(1);
+      output << "{\n";
+      output << "  \"context\": {\"hardware_threads\": " << std::thread::hardware_concurrency()
+             << ", \"min_time_ms\": " << min_time.count() << ", \"optimized\": "
+#if defined(NDEBUG)
+             << "true"
+#else
+             << "false"
+#endif
+             << "},\n";
+      output << "  \"benchmarks\": [\n";
+      for (size_t i = 0; i < results.size(); i++)
+      {
+         const BenchmarkResult& result = results[i];
+         const VideoStandardInfo& info = *result.video_standard_info;
+         const double frame_period_ns = get_frame_period_ns(info);
+         output << "    {\"name\": \"" << result.name << "\", \"video_standard\": \""
+                << get_video_standard_name(info) << "\", \"frame_width\": " << info.frame_width
+                << ", \"frame_height\": " << info.frame_height
+                << ", \"interlaced\": " << (info.interlaced ? "true" : "false")
+                << ", \"iterations\": " << result.nb_iterations << ", \"bytes_per_frame\": " << result.bytes_per_frame
+                << ", \"ns_per_frame\": " << result.mean_ns << ", \"min_ns_per_frame\": " << result.min_ns
+                << ", \"bytes_per_second\": " << result.bytes_per_frame * 1e9 / result.mean_ns
+                << ", \"frame_period_ns\": " << frame_period_ns << ", \"budget_fraction\": " << std::setprecision(6)
+                << result.mean_ns / frame_period_ns << std::setprecision(1)
+                << ", \"fits_single_core\": " << (result.mean_ns <= frame_period_ns ? "true" : "false") << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
+      }
+      output << "  ],\n";
+      output << "  \"wakeup_jitter\": [\n";
+      for (size_t i = 0; i < jitter_results.size(); i++)
+      {
+         const JitterResult& result = jitter_results[i];
+         output << "    {\"scheduling\": \"" << result.scheduling << "\", \"wakeups\": " << result.nb_wakeups
+                << ", \"p50_late_ns\": " << result.p50_ns << ", \"p99_late_ns\": " << result.p99_ns
+                << ", \"max_late_ns\": " << result.max_ns << "}" << (i + 1 < jitter_results.size() ? "," : "")
+                << "\n";
+      }
+      output << "  ],\n";
+      output << "  \"ipv4\": [\n";
+      for (size_t i = 0; i < ipv4_results.size(); i++)
+      {
+         const Ipv4BenchmarkResult& result = ipv4_results[i];
+         output << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.nb_iterations
+                << ", \"ns_per_call\": " << result.ns_per_call
+                << ", \"baseline_ns_per_call\": " << result.baseline_ns_per_call << "}"
+                << (i + 1 < ipv4_results.size() ? "," : "") << "\n";
+      }
+      output << "  ]\n}\n";
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   std::chrono::milliseconds min_time(100);
+   std::string filter, output_path;
+   bool video_formats = false;
+   std::chrono::milliseconds jitter_time(0);
+   std::chrono::microseconds jitter_period(1000);
+   uint32_t nb_jitter_load_threads = 0;
+   bool ipv4 = false;
+   uint64_t nb_ipv4_fuzz_inputs = 1000000;
+   RealtimeConfig realtime_config;
+   realtime_config.slot_loop = {SchedulingPolicy::fifo, 80, ""};
+
+   for (int i = 1; i < argc; i++)
+   {
+      const std::string argument = argv[i];
+      if (argument == "--min-time-ms" && i + 1 < argc)
+         min_time = std::chrono::milliseconds(std::stoul(argv[++i]));
+      else if (argument == "--filter" && i + 1 < argc)
+         filter = argv[++i];
+      else if (argument == "--video-formats")
+         video_formats = true;
+      else if (argument == "--output" && i + 1 < argc)
+         output_path = argv[++i];
+      else if (argument == "--jitter-ms" && i + 1 < argc)
+         jitter_time = std::chrono::milliseconds(std::stoul(argv[++i]));
+      else if (argument == "--jitter-period-us" && i + 1 < argc)
+         jitter_period = std::chrono::microseconds(std::max(1ul, std::stoul(argv[++i])));
+      else if (argument == "--jitter-load" && i + 1 < argc)
+         nb_jitter_load_threads = std::stoul(argv[++i]);
+      else if (argument == "--realtime-priority" && i + 1 < argc)
+         realtime_config.slot_loop.priority = std::stoi(argv[++i]);
+      else if (argument == "--realtime-cpus" && i + 1 < argc)
+         realtime_config.slot_loop.cpus = argv[++i];
+      else if (argument == "--ipv4")
+         ipv4 = true;
+      else if (argument == "--ipv4-fuzz" && i + 1 < argc)
+         nb_ipv4_fuzz_inputs = std::stoull(argv[++i]);
+      else
+      {
+         std::cout << "Usage: " << argv[0] << " [--min-time-ms <ms>] [--filter <video standard>] [--video-formats] [--output <file.json>]"
+                   << " [--jitter-ms <ms> [--jitter-period-us <us>] [--jitter-load <threads>]"
+                   << " [--realtime-priority <1-99>] [--realtime-cpus <cpulist>]]"
+                   << " [--ipv4 [--ipv4-fuzz <inputs>]]" << std::endl;
+         return -1;
+      }
+   }
+
+   std::vector<BenchmarkResult> results;
+   for (uint32_t i = 0; i < nb_video_standard_infos; i++)
+   {
+      const VideoStandardInfo& info = video_standard_infos[i];
+      const std::string video_standard_name = get_video_standard_name(info);
+      if (!filter.empty() && video_standard_name.find(filter) == std::string::npos)
+         continue;
+
+      std::cerr << "Benchmarking " << video_standard_name << "..." << std::endl;
+      run_video_standard_benchmarks(info, min_time, results);
+      if (video_formats)
+         run_video_format_benchmarks(info, min_time, results);
+   }
+
+   // The wakeup jitter of the default scheduling is compared with the one of the real-time scheduling of the slot
+   // loop, on the CPUs given, e.g. isolated with isolcpus
+   std::vector<JitterResult> jitter_results;
+   if (jitter_time.count() > 0)
+   {
+      std::cerr << "Measuring the wakeup jitter..." << std::endl;
+      jitter_results.push_back(
+          measure_wakeup_jitter("default", RealtimeConfig(), jitter_period, jitter_time, nb_jitter_load_threads));
+      const ThreadScheduling& realtime = realtime_config.slot_loop;
+      jitter_results.push_back(measure_wakeup_jitter(
+          std::string(to_string(realtime.policy)) + " " + std::to_string(realtime.priority) +
+              (realtime.cpus.empty() ? "" : " on CPUs " + realtime.cpus),
+          realtime_config, jitter_period, jitter_time, nb_jitter_load_threads));
+   }
+
+   // The IPv4 parsing is checked against the baseline parser before it is measured, a failed check fails the tool
+   std::vector<Ipv4BenchmarkResult> ipv4_results;
+   if (ipv4)
+   {
+      std::cerr << "Checking the IPv4 parsing on " << nb_ipv4_fuzz_inputs << " fuzzed inputs..." << std::endl;
+      if (!check_ipv4_parsing(nb_ipv4_fuzz_inputs, std::cerr))
+         return -1;
+      std::cerr << "Benchmarking the IPv4 parsing..." << std::endl;
+      ipv4_results = run_ipv4_benchmarks(min_time);
+   }
+
+   if (output_path.empty())
+      write_json(std::cout, results, jitter_results, ipv4_results, min_time);
+   else
+   {
+      std::ofstream output(output_path);
+      if (!output)
+      {
+         std::cout << "Cannot open " << output_path << std::endl;
+         return -1;
+      }
+      write_json(output, results, jitter_results, ipv4_results, min_time);
+   }
+   return 0;
+}
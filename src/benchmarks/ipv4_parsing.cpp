@@ -0,0 +1,340 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+#include "ipv4_parsing.h"
+#include "../ipv4.h"
+
+namespace
+{
+   struct Ipv4AddressCase
+   {
+      const char* text;
+      bool accepted /*! By Ipv4Address::parse */;
+      uint32_t value /*! Address parsed by Ipv4Address::parse */;
+      uint32_t baseline_value /*! Address returned by the baseline parser, 0 if rejected */;
+   };
+
+   const Ipv4AddressCase address_cases[] = {
+       {"192.168.0.2", true, 0xc0a80002, 0xc0a80002},
+       {"0.0.0.0", true, 0x00000000, 0x00000000},
+       {"255.255.255.255", true, 0xffffffff, 0xffffffff},
+       {"239.10.10.1", true, 0xef0a0a01, 0xef0a0a01},
+       {"01.002.3.004", true, 0x01020304, 0x01020304}, // Leading zeros, within three digits
+       {"256.1.1.1", false, 0, 0},                     // Octets over 255
+       {"1.300.3.4", false, 0, 0},
+       {"1.2.3.999", false, 0, 0},
+       {"", false, 0, 0}, // Empty fields
+       {"1..3.4", false, 0, 0},
+       {".1.2.3", false, 0, 0},
+       {"1.2.3.", false, 0, 0},
+       {"1.2.3", false, 0, 0},
+       {"...", false, 0, 0},
+       {"-1.2.3.4", false, 0, 0},
+       {"a.b.c.d", false, 0, 0},
+       {"99999999999999999999.1.1.1", false, 0, 0},
+       {"0001.2.3.4", false, 0, 0x01020304},       // More than three digits
+       {"4294967296.1.1.1", false, 0, 0x00010101}, // The baseline truncates the std::stoul result to 32 bits
+       {"1.2.3.4.5", false, 0, 0x01020304},        // Fifth octet
+       {"1.2.3.4.", false, 0, 0x01020304},         // Trailing dot
+       {"1.2.3.4:5004", false, 0, 0x01020304},     // Port
+       {"1.2.3.4abc", false, 0, 0x01020304},       // Trailing text
+       {"1.2.3.4 ", false, 0, 0x01020304},
+       {" 1.2.3.4", false, 0, 0x01020304}, // Whitespace and sign skipped by std::stoul
+       {"1.2. 3.4", false, 0, 0x01020304},
+       {"+1.2.3.4", false, 0, 0x01020304},
+   };
+
+   struct Ipv4EndpointCase
+   {
+      const char* text;
+      bool accepted /*! By Ipv4Endpoint::parse */;
+      uint32_t address;
+      uint16_t port;
+   };
+
+   const Ipv4EndpointCase endpoint_cases[] = {
+       {"239.10.10.1:1025", true, 0xef0a0a01, 1025},
+       {"0.0.0.0:0", true, 0x00000000, 0},
+       {"1.2.3.4:65535", true, 0x01020304, 65535},
+       {"1.2.3.4:00080", true, 0x01020304, 80},
+       {"1.2.3.4:65536", false, 0, 0},
+       {"1.2.3.4:123456", false, 0, 0},
+       {"1.2.3.4:", false, 0, 0},
+       {":1025", false, 0, 0},
+       {"1.2.3.4", false, 0, 0},
+       {"1.2.3:80", false, 0, 0},
+       {"256.2.3.4:80", false, 0, 0},
+       {"1.2.3.4:80:80", false, 0, 0},
+       {"1.2.3.4: 80", false, 0, 0},
+       {"1.2.3.4:+80", false, 0, 0},
+       {"1.2.3.4:0x10", false, 0, 0},
+   };
+
+   // Inputs the baseline accepts and Ipv4Address::parse rejects on purpose, see ipv4_parsing.h
+   bool is_rejected_by_strict_parsing(const std::string& text)
+   {
+      if (std::count(text.begin(), text.end(), '.') != 3)
+         return true;
+      size_t nb_digits = 0;
+      for (char character : text)
+      {
+         if (character == '.')
+            nb_digits = 0;
+         else if (character < '0' || character > '9' || ++nb_digits > 3)
+            return true;
+      }
+      return false;
+   }
+
+   std::string make_random_address(std::mt19937_64& generator)
+   {
+      std::string text;
+      for (int i = 0; i < 4; i++)
+      {
+         std::string octet = std::to_string(generator() % 300); // Octets over 255 included
+         if (generator() % 8 == 0)
+            octet.insert(0, generator() % 3, '0');
+         text += (i ? "." : "") + octet;
+      }
+      return text;
+   }
+
+   // Random text, or a dotted-decimal address with a few insertions, deletions and replacements
+   std::string make_fuzz_input(std::mt19937_64& generator)
+   {
+      static const char alphabet[] = "01234567890123456789012345678901234567890123456789......:: +-x";
+      const auto random_character = [&] { return alphabet[generator() % (sizeof(alphabet) - 1)]; };
+
+      std::string text;
+      if (generator() % 2 == 0)
+      {
+         const size_t length = generator() % 25;
+         for (size_t i = 0; i < length; i++)
+            text += random_character();
+         return text;
+      }
+
+      text = make_random_address(generator);
+      const uint64_t nb_mutations = generator() % 4;
+      for (uint64_t i = 0; i < nb_mutations; i++)
+      {
+         const size_t position = generator() % (text.size() + 1);
+         const uint64_t mutation = generator() % 3;
+         if (mutation == 0)
+            text.insert(position, 1, random_character());
+         else if (position < text.size() && mutation == 1)
+            text.erase(position, 1);
+         else if (position < text.size())
+            text[position] = random_character();
+      }
+      return text;
+   }
+
+   template <typename Function>
+   double measure_ns_per_call(std::chrono::milliseconds min_time, size_t nb_inputs, Function&& function,
+                              uint64_t& nb_calls)
+   {
+      for (size_t i = 0; i < nb_inputs; i++)
+         function(i);
+
+      nb_calls = 0;
+      const auto start = std::chrono::steady_clock::now();
+      std::chrono::steady_clock::duration elapsed{};
+      while (elapsed < min_time)
+      {
+         for (size_t i = 0; i < nb_inputs; i++)
+            function(i);
+         nb_calls += nb_inputs;
+         elapsed = std::chrono::steady_clock::now() - start;
+      }
+      return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(nb_calls);
+   }
+
+   // Keeps the results of the benchmarked functions alive
+   volatile uint64_t sink = 0;
+}
+
+uint32_t baseline_string_to_ipv4(const std::string& text)
+{
+   uint32_t ipv4_network_byte_order = 0;
+   std::istringstream iss(text);
+   std::vector<uint32_t> octets;
+   std::string octet;
+
+   while (std::getline(iss, octet, '.'))
+   {
+      if (octets.size() >= 4)
+         break;
+      try
+      {
+         uint32_t value = std::stoul(octet);
+         if (value > 255)
+            return 0;
+         octets.push_back(value);
+      }
+      catch (...)
+      {
+         return 0;
+      }
+   }
+
+   if (octets.size() == 4)
+      ipv4_network_byte_order = (octets[0] << 24) | (octets[1] << 16) | (octets[2] << 8) | octets[3];
+   return ipv4_network_byte_order;
+}
+
+std::string baseline_ipv4_to_string(uint32_t address)
+{
+   std::stringstream ss;
+   ss << ((address >> 24) & 0xFF) << "." << ((address >> 16) & 0xFF) << "." << ((address >> 8) & 0xFF) << "."
+      << (address & 0xFF);
+   return ss.str();
+}
+
+bool check_ipv4_parsing(uint64_t nb_fuzz_inputs, std::ostream& output)
+{
+   const uint64_t max_reported_failures = 10;
+   uint64_t nb_failures = 0;
+   const auto fail = [&](const char* check, const std::string& text, const std::string& detail) {
+      if (nb_failures++ < max_reported_failures)
+         output << "IPv4 " << check << " failed for \"" << text << "\": " << detail << std::endl;
+   };
+
+   for (const Ipv4AddressCase& test_case : address_cases)
+   {
+      Ipv4Address address;
+      const bool accepted = Ipv4Address::parse(test_case.text, address);
+      if (accepted != test_case.accepted || (accepted && address.value() != test_case.value))
+         fail("address case", test_case.text, accepted ? "accepted as " + std::string(to_chars(address).view())
+                                                         : std::string("rejected"));
+      const uint32_t baseline_value = baseline_string_to_ipv4(test_case.text);
+      if (baseline_value != test_case.baseline_value)
+         fail("baseline address case", test_case.text, "gave " + baseline_ipv4_to_string(baseline_value));
+   }
+
+   for (const Ipv4EndpointCase& test_case : endpoint_cases)
+   {
+      Ipv4Endpoint endpoint;
+      const bool accepted = Ipv4Endpoint::parse(test_case.text, endpoint);
+      if (accepted != test_case.accepted ||
+          (accepted && (endpoint.address.value() != test_case.address || endpoint.port != test_case.port)))
+         fail("endpoint case", test_case.text, accepted ? "accepted as " + std::string(to_chars(endpoint).view())
+                                                         : std::string("rejected"));
+   }
+
+   std::mt19937_64 generator(0x2110);
+   for (uint64_t i = 0; i < nb_fuzz_inputs; i++)
+   {
+      // Both parsers give the same address, but for the inputs ipv4.h rejects on purpose
+      const std::string text = make_fuzz_input(generator);
+      Ipv4Address address;
+      const bool accepted = Ipv4Address::parse(text, address);
+      const uint32_t baseline_value = baseline_string_to_ipv4(text);
+      if (accepted && address.value() != baseline_value)
+         fail("differential address parsing", text,
+              "accepted as " + std::string(to_chars(address).view()) + ", baseline " +
+                  baseline_ipv4_to_string(baseline_value));
+      else if (!accepted && baseline_value != 0 && !is_rejected_by_strict_parsing(text))
+         fail("differential address parsing", text, "rejected, baseline " + baseline_ipv4_to_string(baseline_value));
+
+      // An endpoint is an accepted address, a colon and a port up to 65535
+      const uint32_t port = static_cast<uint32_t>(generator() % 70000);
+      const std::string endpoint_text = text + ":" + std::to_string(port);
+      Ipv4Endpoint endpoint;
+      const bool endpoint_accepted = Ipv4Endpoint::parse(endpoint_text, endpoint);
+      if (endpoint_accepted != (accepted && port <= 0xFFFF) ||
+          (endpoint_accepted && (endpoint.address != address || endpoint.port != port)))
+         fail("endpoint parsing", endpoint_text, endpoint_accepted ? "accepted" : "rejected");
+
+      // Formatting gives the text of the baseline, and parses back to the same address and port
+      const Ipv4Endpoint value = {Ipv4Address(static_cast<uint32_t>(generator())), static_cast<uint16_t>(generator())};
+      const std::string baseline_text = baseline_ipv4_to_string(value.address.value());
+      if (to_chars(value.address).view() != baseline_text)
+         fail("address formatting", baseline_text, "gave " + std::string(to_chars(value.address).view()));
+      Ipv4Endpoint parsed_value;
+      if (!Ipv4Endpoint::parse(to_chars(value).view(), parsed_value) || parsed_value != value)
+         fail("endpoint formatting", std::string(to_chars(value).view()), "does not parse back");
+   }
+
+   if (nb_failures > max_reported_failures)
+      output << nb_failures - max_reported_failures << " more IPv4 failures" << std::endl;
+   return nb_failures == 0;
+}
+
+std::vector<Ipv4BenchmarkResult> run_ipv4_benchmarks(std::chrono::milliseconds min_time)
+{
+   const size_t nb_inputs = 256;
+   std::mt19937_64 generator(0x2110);
+   std::vector<Ipv4Endpoint> values(nb_inputs);
+   std::vector<std::string> addresses(nb_inputs), endpoints(nb_inputs);
+   for (size_t i = 0; i < nb_inputs; i++)
+   {
+      values[i] = {Ipv4Address(static_cast<uint32_t>(generator())), static_cast<uint16_t>(generator())};
+      addresses[i] = std::string(to_chars(values[i].address).view());
+      endpoints[i] = std::string(to_chars(values[i]).view());
+   }
+
+   std::vector<Ipv4BenchmarkResult> results;
+   const auto add_result = [&](const std::string& name, auto&& function, auto&& baseline_function) {
+      Ipv4BenchmarkResult result = {name, 0, 0.0, 0.0};
+      uint64_t nb_baseline_calls = 0;
+      result.ns_per_call = measure_ns_per_call(min_time, nb_inputs, function, result.nb_iterations);
+      result.baseline_ns_per_call = measure_ns_per_call(min_time, nb_inputs, baseline_function, nb_baseline_calls);
+      results.push_back(result);
+   };
+
+   add_result(
+       "parse_address",
+       [&](size_t i) {
+          Ipv4Address address;
+          Ipv4Address::parse(addresses[i], address);
+          sink = sink + address.value();
+       },
+       [&](size_t i) { sink = sink + baseline_string_to_ipv4(addresses[i]); });
+
+   // The baseline had no endpoint parser, the port was read by the callers with std::stoul
+   add_result(
+       "parse_endpoint",
+       [&](size_t i) {
+          Ipv4Endpoint endpoint;
+          Ipv4Endpoint::parse(endpoints[i], endpoint);
+          sink = sink + endpoint.address.value() + endpoint.port;
+       },
+       [&](size_t i) {
+          const size_t colon = endpoints[i].rfind(':');
+          sink = sink + baseline_string_to_ipv4(endpoints[i].substr(0, colon)) +
+                 std::stoul(endpoints[i].substr(colon + 1));
+       });
+
+   add_result(
+       "format_address",
+       [&](size_t i) { sink = sink + to_chars(values[i].address).length; },
+       [&](size_t i) { sink = sink + baseline_ipv4_to_string(values[i].address.value()).size(); });
+
+   add_result(
+       "format_endpoint",
+       [&](size_t i) { sink = sink + to_chars(values[i]).length; },
+       [&](size_t i) {
+          const std::string endpoint =
+              baseline_ipv4_to_string(values[i].address.value()) + ":" + std::to_string(values[i].port);
+          sink = sink + endpoint.size();
+       });
+
+   return results;
+}
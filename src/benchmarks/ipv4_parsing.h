@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file ipv4_parsing.h
+   @brief This file contains the checks and the microbenchmark of the IPv4 parsing and formatting of ipv4.h against
+   the iostream-based string_to_ipv4 and ipv4_to_string they replaced.
+
+   @detail The parser of ipv4.h is deliberately stricter than the baseline one: it rejects text after the fourth
+   octet (a fifth octet, a port, a trailing dot or other characters), octets of more than three digits and the
+   whitespace or sign that std::stoul skips. Every other input must give the same address with both parsers.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*!
+   @brief Time of one call of a parsing or formatting function, compared with its baseline
+*/
+struct Ipv4BenchmarkResult
+{
+   std::string name;
+   uint64_t nb_iterations /*! Calls of each function */;
+   double ns_per_call;
+   double baseline_ns_per_call;
+};
+
+/*!
+   @brief Baseline parser: the std::getline and std::stoul based string_to_ipv4 of the samples before ipv4.h
+
+   @returns The address, 0 if the text was rejected
+*/
+uint32_t baseline_string_to_ipv4(const std::string& text /*!< [in] Dotted-decimal address*/);
+
+/*!
+   @brief Baseline formatter: the std::stringstream based ipv4_to_string of the samples before ipv4.h
+*/
+std::string baseline_ipv4_to_string(uint32_t address /*!< [in] Address to format*/);
+
+/*!
+   @brief Run the table of parsing cases, then compare the parsers on random and mutated inputs and check that
+   formatting round-trips
+
+   @returns True if every check passed, the failures are printed to output
+*/
+bool check_ipv4_parsing(uint64_t nb_fuzz_inputs /*!< [in] Random inputs of the differential fuzzing*/,
+                        std::ostream& output /*!< [in] Stream the failures are printed to*/);
+
+/*!
+   @brief Measure the parsing and formatting of addresses and endpoints, and of their baselines
+*/
+std::vector<Ipv4BenchmarkResult> run_ipv4_benchmarks(
+    std::chrono::milliseconds min_time /*!< [in] Minimum time spent in each function and in its baseline*/);
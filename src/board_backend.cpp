@@ -0,0 +1,170 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "board_backend.h"
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Ip_Board.h"
+#else
+#include "VideoMasterHD_Ip_Board.h"
+#endif
+
+namespace
+{
+   std::unique_ptr<BoardBackend>& selected_backend()
+   {
+      static std::unique_ptr<BoardBackend> backend = std::make_unique<VideoMasterBackend>();
+      return backend;
+   }
+}
+
+BoardBackend& board_backend()
+{
+   return *selected_backend();
+}
+
+void select_board_backend(std::unique_ptr<BoardBackend> backend)
+{
+   if (backend)
+      selected_backend() = std::move(backend);
+}
+
+VHD_ERRORCODE VideoMasterBackend::get_api_info(ULONG* dll_version, ULONG* nb_boards)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_GetApiInfo(dll_version, nb_boards));
+}
+
+VHD_ERRORCODE VideoMasterBackend::open_board_handle(ULONG board_index, HANDLE* board_handle,
+                                                    HANDLE state_change_event, ULONG state_change_mask)
+{
+   return static_cast<VHD_ERRORCODE>(
+       VHD_OpenBoardHandle(board_index, board_handle, state_change_event, state_change_mask));
+}
+
+VHD_ERRORCODE VideoMasterBackend::close_board_handle(HANDLE board_handle)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_CloseBoardHandle(board_handle));
+}
+
+VHD_ERRORCODE VideoMasterBackend::set_board_property(HANDLE board_handle, ULONG property, ULONG value)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_SetBoardProperty(board_handle, property, value));
+}
+
+VHD_ERRORCODE VideoMasterBackend::get_board_property(HANDLE board_handle, ULONG property, ULONG* value)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_GetBoardProperty(board_handle, property, value));
+}
+
+VHD_ERRORCODE VideoMasterBackend::get_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property,
+                                                             ULONG* value)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_GetEthernetPortProperty(board_handle, port, property, value));
+}
+
+VHD_ERRORCODE VideoMasterBackend::set_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property,
+                                                             ULONG value)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_SetEthernetPortProperty(board_handle, port, property, value));
+}
+
+VHD_ERRORCODE VideoMasterBackend::enable_dhcp(HANDLE board_handle, ULONG port)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_EnableDHCP(board_handle, port));
+}
+
+VHD_ERRORCODE VideoMasterBackend::disable_dhcp(HANDLE board_handle, ULONG port)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_DisableDHCP(board_handle, port));
+}
+
+VHD_ERRORCODE VideoMasterBackend::join_multicast_group(HANDLE board_handle, ULONG port, ULONG group)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_JoinMulticastGroup(board_handle, port, group));
+}
+
+VHD_ERRORCODE VideoMasterBackend::leave_multicast_group(HANDLE board_handle, ULONG port, ULONG group)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_LeaveMulticastGroup(board_handle, port, group));
+}
+
+VHD_ERRORCODE VideoMasterBackend::get_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION* configuration)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_GetPTPConfiguration(board_handle, configuration));
+}
+
+VHD_ERRORCODE VideoMasterBackend::set_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION configuration)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_SetPTPConfiguration(board_handle, configuration));
+}
+
+VHD_ERRORCODE VideoMasterBackend::get_ptp_port_state(HANDLE board_handle, VHD_PTP_PORT_STATE* state, BOOL32* locked)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_GetPTPPortState(board_handle, state, locked));
+}
+
+VHD_ERRORCODE VideoMasterBackend::get_ptp_offset(HANDLE board_handle, LONG* offset_sec, LONG* offset_nsec)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_GetPTPOffset(board_handle, offset_sec, offset_nsec));
+}
+
+VHD_ERRORCODE VideoMasterBackend::open_stream_handle(HANDLE board_handle, ULONG stream_type, ULONG processing_mode,
+                                                     BOOL32* setup_lock, HANDLE* stream_handle,
+                                                     HANDLE data_ready_event)
+{
+   return static_cast<VHD_ERRORCODE>(
+       VHD_OpenStreamHandle(board_handle, stream_type, processing_mode, setup_lock, stream_handle, data_ready_event));
+}
+
+VHD_ERRORCODE VideoMasterBackend::close_stream_handle(HANDLE stream_handle)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_CloseStreamHandle(stream_handle));
+}
+
+VHD_ERRORCODE VideoMasterBackend::set_stream_property(HANDLE stream_handle, ULONG property, ULONG value)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(stream_handle, property, value));
+}
+
+VHD_ERRORCODE VideoMasterBackend::get_stream_property(HANDLE stream_handle, ULONG property, ULONG* value)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_GetStreamProperty(stream_handle, property, value));
+}
+
+VHD_ERRORCODE VideoMasterBackend::start_stream(HANDLE stream_handle)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_StartStream(stream_handle));
+}
+
+VHD_ERRORCODE VideoMasterBackend::stop_stream(HANDLE stream_handle)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_StopStream(stream_handle));
+}
+
+VHD_ERRORCODE VideoMasterBackend::lock_slot_handle(HANDLE stream_handle, HANDLE* slot_handle)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_LockSlotHandle(stream_handle, slot_handle));
+}
+
+VHD_ERRORCODE VideoMasterBackend::get_slot_buffer(HANDLE slot_handle, ULONG buffer_type, uint8_t** buffer,
+                                                  ULONG* buffer_size)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_GetSlotBuffer(slot_handle, buffer_type, buffer, buffer_size));
+}
+
+VHD_ERRORCODE VideoMasterBackend::unlock_slot_handle(HANDLE slot_handle)
+{
+   return static_cast<VHD_ERRORCODE>(VHD_UnlockSlotHandle(slot_handle));
+}
@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file board_backend.h
+   @brief This file contains the abstraction of the board and stream calls of the VideoMaster API.
+
+   @detail Every call that reaches a board (board, Ethernet port, PTP, stream and slot calls) goes through the
+   selected BoardBackend, so that the sample loops run unchanged on a DELTACAST IP Card or on a simulated board.
+   The host-side calls of the VideoMaster API (SDP parser, string conversions) are called directly. The methods
+   keep the parameters of the VideoMaster functions they replace.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <memory>
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Core.h"
+#include "VideoMasterHD/VideoMasterHD_PTP.h"
+#else
+#include "VideoMasterHD_Core.h"
+#include "VideoMasterHD_PTP.h"
+#endif
+
+class BoardBackend
+{
+public:
+   virtual ~BoardBackend() = default;
+
+   virtual const char* get_name() const = 0;
+
+   // Boards
+   virtual VHD_ERRORCODE get_api_info(ULONG* dll_version, ULONG* nb_boards) = 0;
+   virtual VHD_ERRORCODE open_board_handle(ULONG board_index, HANDLE* board_handle, HANDLE state_change_event,
+                                           ULONG state_change_mask) = 0;
+   virtual VHD_ERRORCODE close_board_handle(HANDLE board_handle) = 0;
+   virtual VHD_ERRORCODE set_board_property(HANDLE board_handle, ULONG property, ULONG value) = 0;
+   virtual VHD_ERRORCODE get_board_property(HANDLE board_handle, ULONG property, ULONG* value) = 0;
+
+   // Ethernet port
+   virtual VHD_ERRORCODE get_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property,
+                                                    ULONG* value) = 0;
+   virtual VHD_ERRORCODE set_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property,
+                                                    ULONG value) = 0;
+   virtual VHD_ERRORCODE enable_dhcp(HANDLE board_handle, ULONG port) = 0;
+   virtual VHD_ERRORCODE disable_dhcp(HANDLE board_handle, ULONG port) = 0;
+   virtual VHD_ERRORCODE join_multicast_group(HANDLE board_handle, ULONG port, ULONG group) = 0;
+   virtual VHD_ERRORCODE leave_multicast_group(HANDLE board_handle, ULONG port, ULONG group) = 0;
+
+   // PTP
+   virtual VHD_ERRORCODE get_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION* configuration) = 0;
+   virtual VHD_ERRORCODE set_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION configuration) = 0;
+   virtual VHD_ERRORCODE get_ptp_port_state(HANDLE board_handle, VHD_PTP_PORT_STATE* state, BOOL32* locked) = 0;
+   virtual VHD_ERRORCODE get_ptp_offset(HANDLE board_handle, LONG* offset_sec, LONG* offset_nsec) = 0;
+
+   // Streams and slots
+   virtual VHD_ERRORCODE open_stream_handle(HANDLE board_handle, ULONG stream_type, ULONG processing_mode,
+                                            BOOL32* setup_lock, HANDLE* stream_handle, HANDLE data_ready_event) = 0;
+   virtual VHD_ERRORCODE close_stream_handle(HANDLE stream_handle) = 0;
+   virtual VHD_ERRORCODE set_stream_property(HANDLE stream_handle, ULONG property, ULONG value) = 0;
+   virtual VHD_ERRORCODE get_stream_property(HANDLE stream_handle, ULONG property, ULONG* value) = 0;
+   virtual VHD_ERRORCODE start_stream(HANDLE stream_handle) = 0;
+   virtual VHD_ERRORCODE stop_stream(HANDLE stream_handle) = 0;
+   virtual VHD_ERRORCODE lock_slot_handle(HANDLE stream_handle, HANDLE* slot_handle) = 0;
+   virtual VHD_ERRORCODE get_slot_buffer(HANDLE slot_handle, ULONG buffer_type, uint8_t** buffer,
+                                         ULONG* buffer_size) = 0;
+   virtual VHD_ERRORCODE unlock_slot_handle(HANDLE slot_handle) = 0;
+};
+
+/*!
+   @brief Backend forwarding every call to the VideoMaster API
+*/
+class VideoMasterBackend : public BoardBackend
+{
+public:
+   const char* get_name() const override { return "VideoMaster"; }
+
+   VHD_ERRORCODE get_api_info(ULONG* dll_version, ULONG* nb_boards) override;
+   VHD_ERRORCODE open_board_handle(ULONG board_index, HANDLE* board_handle, HANDLE state_change_event,
+                                   ULONG state_change_mask) override;
+   VHD_ERRORCODE close_board_handle(HANDLE board_handle) override;
+   VHD_ERRORCODE set_board_property(HANDLE board_handle, ULONG property, ULONG value) override;
+   VHD_ERRORCODE get_board_property(HANDLE board_handle, ULONG property, ULONG* value) override;
+
+   VHD_ERRORCODE get_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property, ULONG* value) override;
+   VHD_ERRORCODE set_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property, ULONG value) override;
+   VHD_ERRORCODE enable_dhcp(HANDLE board_handle, ULONG port) override;
+   VHD_ERRORCODE disable_dhcp(HANDLE board_handle, ULONG port) override;
+   VHD_ERRORCODE join_multicast_group(HANDLE board_handle, ULONG port, ULONG group) override;
+   VHD_ERRORCODE leave_multicast_group(HANDLE board_handle, ULONG port, ULONG group) override;
+
+   VHD_ERRORCODE get_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION* configuration) override;
+   VHD_ERRORCODE set_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION configuration) override;
+   VHD_ERRORCODE get_ptp_port_state(HANDLE board_handle, VHD_PTP_PORT_STATE* state, BOOL32* locked) override;
+   VHD_ERRORCODE get_ptp_offset(HANDLE board_handle, LONG* offset_sec, LONG* offset_nsec) override;
+
+   VHD_ERRORCODE open_stream_handle(HANDLE board_handle, ULONG stream_type, ULONG processing_mode,
+                                    BOOL32* setup_lock, HANDLE* stream_handle, HANDLE data_ready_event) override;
+   VHD_ERRORCODE close_stream_handle(HANDLE stream_handle) override;
+   VHD_ERRORCODE set_stream_property(HANDLE stream_handle, ULONG property, ULONG value) override;
+   VHD_ERRORCODE get_stream_property(HANDLE stream_handle, ULONG property, ULONG* value) override;
+   VHD_ERRORCODE start_stream(HANDLE stream_handle) override;
+   VHD_ERRORCODE stop_stream(HANDLE stream_handle) override;
+   VHD_ERRORCODE lock_slot_handle(HANDLE stream_handle, HANDLE* slot_handle) override;
+   VHD_ERRORCODE get_slot_buffer(HANDLE slot_handle, ULONG buffer_type, uint8_t** buffer,
+                                 ULONG* buffer_size) override;
+   VHD_ERRORCODE unlock_slot_handle(HANDLE slot_handle) override;
+};
+
+/*!
+   @brief Get the backend the board and stream calls go through, VideoMasterBackend unless another one was selected
+*/
+BoardBackend& board_backend();
+
+/*!
+   @brief Select the backend of the board and stream calls
+
+   @detail Must be called before the first board is opened, and not while a handle of the previous backend is open.
+*/
+void select_board_backend(std::unique_ptr<BoardBackend> backend /*!< [in] Backend to use*/);
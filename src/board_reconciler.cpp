@@ -0,0 +1,311 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "board_backend.h"
+#include "board_reconciler.h"
+#include "tools.h"
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Ip_Board.h"
+#else
+#include "VideoMasterHD_Ip_Board.h"
+#endif
+
+namespace
+{
+   const char* const ptp_setting_name = "PTP configuration";
+
+   // The fields of the datasets set from the ST2059-2 profile and the parameters, the other ones are filled by the
+   // board
+   bool is_same_ptp_configuration(const VHD_PTP_CONFIGURATION& current, const VHD_PTP_CONFIGURATION& desired)
+   {
+      const VHD_PTP_DEFAULTDS& current_default_ds = current.DefaultDS;
+      const VHD_PTP_DEFAULTDS& desired_default_ds = desired.DefaultDS;
+      const VHD_PTP_PORTDS& current_port_ds = current.PortDS;
+      const VHD_PTP_PORTDS& desired_port_ds = desired.PortDS;
+      return current_default_ds.DomainNumber == desired_default_ds.DomainNumber &&
+             current_default_ds.Priority1 == desired_default_ds.Priority1 &&
+             current_default_ds.Priority2 == desired_default_ds.Priority2 &&
+             current_default_ds.SlaveOnly == desired_default_ds.SlaveOnly &&
+             current_port_ds.AnnounceReceiptTimeout == desired_port_ds.AnnounceReceiptTimeout &&
+             current_port_ds.LogAnnounceInterval == desired_port_ds.LogAnnounceInterval &&
+             current_port_ds.LogSyncInterval == desired_port_ds.LogSyncInterval &&
+             current_port_ds.LogMinDelayReqInterval == desired_port_ds.LogMinDelayReqInterval &&
+             current_port_ds.DelayMechanism == desired_port_ds.DelayMechanism;
+   }
+}
+
+BoardReconciler::BoardReconciler(HANDLE board_handle, const std::string& state_directory)
+    : m_board_handle(board_handle)
+{
+   if (state_directory.empty())
+      return;
+
+   std::string mac_address;
+   if (get_nic_mac_address(m_board_handle, mac_address) != VHDERR_NOERROR)
+   {
+      std::cout << "The board state is not kept, the board cannot be identified" << std::endl;
+      return;
+   }
+   std::error_code error;
+   std::filesystem::create_directories(state_directory, error);
+   if (error)
+   {
+      std::cout << "Error when creating the board state directory " << state_directory << " [" << error.message()
+                << "]" << std::endl;
+      return;
+   }
+
+   m_state_path = (std::filesystem::path(state_directory) / ("board_" + mac_address + ".txt")).string();
+   load_state();
+}
+
+std::string BoardReconciler::get_default_state_directory()
+{
+#if defined(_WIN32)
+   const char* local_app_data = std::getenv("LOCALAPPDATA");
+   return local_app_data ? (std::filesystem::path(local_app_data) / "nmos-vhd").string() : "";
+#else
+   const char* state_home = std::getenv("XDG_STATE_HOME");
+   if (state_home && *state_home)
+      return (std::filesystem::path(state_home) / "nmos-vhd").string();
+   const char* home = std::getenv("HOME");
+   return home ? (std::filesystem::path(home) / ".local" / "state" / "nmos-vhd").string() : "";
+#endif
+}
+
+VHD_ERRORCODE BoardReconciler::reconcile_nic(const NicSettings& settings)
+{
+   const clock::time_point begin = clock::now();
+   VHD_ERRORCODE result = VHDERR_NOERROR;
+
+   // An unreadable DHCP state is considered different from the desired one
+   ULONG dhcp = 0;
+   const bool dhcp_known = board_backend().get_ethernet_port_property(m_board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0,
+                                                                      VHD_IP_BRD_EP_DHCP_ENABLED,
+                                                                      &dhcp) == VHDERR_NOERROR;
+   const clock::time_point apply_begin = clock::now();
+   if (dhcp_known && (dhcp != 0) == settings.dhcp)
+      record("DHCP", false, apply_begin);
+   else
+   {
+      result = settings.dhcp ? board_backend().enable_dhcp(m_board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0)
+                             : board_backend().disable_dhcp(m_board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0);
+      if (result != VHDERR_NOERROR)
+         std::cout << "Error " << (settings.dhcp ? "enabling" : "disabling") << " DHCP: " << to_string(result)
+                   << std::endl;
+      else
+         record("DHCP", true, apply_begin);
+   }
+
+   if (result == VHDERR_NOERROR && !settings.dhcp)
+      result = reconcile_ethernet_port_property("IP address", VHD_IP_BRD_EP_IP_ADDR, settings.ip_address);
+   if (result == VHDERR_NOERROR && !settings.dhcp)
+      result = reconcile_ethernet_port_property("subnet mask", VHD_IP_BRD_EP_SUBNET_MASK, settings.subnet_mask);
+   if (result == VHDERR_NOERROR && !settings.dhcp)
+      result = reconcile_ethernet_port_property("gateway", VHD_IP_BRD_EP_GATEWAY_ADDR, settings.gateway);
+
+   m_reconcile_time += std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - begin);
+   return result;
+}
+
+VHD_ERRORCODE BoardReconciler::reconcile_ptp(uint8_t domain_number, uint8_t announce_receipt_timeout, bool& applied)
+{
+   const clock::time_point begin = clock::now();
+   applied = false;
+
+   VHD_PTP_CONFIGURATION current, desired;
+   VHD_ERRORCODE result = board_backend().get_ptp_configuration(m_board_handle, &current);
+   if (result != VHDERR_NOERROR)
+   {
+      std::cout << "Error when getting the PTP config" << " [" << to_string(result) << "]" << std::endl;
+      return result;
+   }
+   result = make_ptp_configuration(m_board_handle, domain_number, announce_receipt_timeout, desired);
+   if (result != VHDERR_NOERROR)
+      return result;
+
+   const bool in_place = is_same_ptp_configuration(current, desired);
+
+   const clock::time_point apply_begin = clock::now();
+   if (in_place)
+      record(ptp_setting_name, false, apply_begin);
+   else
+   {
+      result = board_backend().set_ptp_configuration(m_board_handle, desired);
+      if (result != VHDERR_NOERROR)
+      {
+         std::cout << "Error when setting the PTP config" << " [" << to_string(result) << "]" << std::endl;
+         return result;
+      }
+      applied = true;
+      record(ptp_setting_name, true, apply_begin);
+   }
+
+   m_reconcile_time += std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - begin);
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE BoardReconciler::reconcile_clock_system(bool is_us)
+{
+   const clock::time_point begin = clock::now();
+   bool applied = false;
+   const VHD_ERRORCODE result = reconcile_board_property(m_board_handle, VHD_SDI_BP_CLOCK_SYSTEM,
+                                                         is_us ? VHD_CLOCKDIV_1001 : VHD_CLOCKDIV_1, &applied);
+   if (result != VHDERR_NOERROR)
+      std::cout << "Error setting clock system: " << to_string(result) << std::endl;
+   else
+      record("clock system", applied, begin);
+
+   m_reconcile_time += std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - begin);
+   return result;
+}
+
+void BoardReconciler::add_ptp_lock_time(std::chrono::microseconds lock_time)
+{
+   auto setting = std::find_if(m_settings.rbegin(), m_settings.rend(), [](const ReconciledSetting& setting) {
+      return setting.name == ptp_setting_name && setting.applied;
+   });
+   if (setting == m_settings.rend())
+      return;
+
+   setting->cost += lock_time;
+   m_costs_us[setting->name] = setting->cost.count();
+   save_state();
+}
+
+void BoardReconciler::print_summary() const
+{
+   uint32_t nb_applied = 0, nb_unknown_costs = 0;
+   std::chrono::microseconds saved(0);
+   std::string applied_names;
+   for (const ReconciledSetting& setting : m_settings)
+   {
+      if (setting.applied)
+      {
+         applied_names += (nb_applied++ ? ", " : "") + setting.name;
+         continue;
+      }
+      if (setting.cost_known)
+         saved += setting.cost;
+      else
+         nb_unknown_costs++;
+   }
+
+   std::cout << "Board state: " << nb_applied << " of " << m_settings.size() << " settings applied";
+   if (nb_applied)
+      std::cout << " (" << applied_names << ")";
+   std::cout << ", " << m_settings.size() - nb_applied << " already in place - reconciled in " << std::fixed
+             << std::setprecision(1) << m_reconcile_time.count() / 1000.0 << " ms";
+   if (nb_applied < m_settings.size())
+   {
+      std::cout << " - " << std::setprecision(3) << saved.count() / 1e6 << " s saved";
+      if (nb_unknown_costs)
+         std::cout << " (" << nb_unknown_costs << " setting(s) never timed)";
+   }
+   std::cout << std::defaultfloat << std::endl;
+}
+
+VHD_ERRORCODE BoardReconciler::reconcile_ethernet_port_property(const char* name, ULONG property, ULONG value)
+{
+   ULONG current = 0;
+   const bool in_place = board_backend().get_ethernet_port_property(m_board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0,
+                                                                    property, &current) == VHDERR_NOERROR &&
+                         current == value;
+   const clock::time_point apply_begin = clock::now();
+   if (in_place)
+   {
+      record(name, false, apply_begin);
+      return VHDERR_NOERROR;
+   }
+
+   const VHD_ERRORCODE result =
+       board_backend().set_ethernet_port_property(m_board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, property, value);
+   if (result != VHDERR_NOERROR)
+      std::cout << "Error setting " << name << ": " << to_string(result) << std::endl;
+   else
+      record(name, true, apply_begin);
+   return result;
+}
+
+void BoardReconciler::record(const std::string& name, bool applied, clock::time_point apply_begin)
+{
+   ReconciledSetting setting = {name, applied, std::chrono::microseconds(0), false};
+   if (applied)
+   {
+      setting.cost = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - apply_begin);
+      setting.cost_known = true;
+      m_costs_us[name] = setting.cost.count();
+      save_state();
+   }
+   else
+   {
+      auto cost = m_costs_us.find(name);
+      if (cost != m_costs_us.end())
+      {
+         setting.cost = std::chrono::microseconds(cost->second);
+         setting.cost_known = true;
+      }
+   }
+   m_settings.push_back(setting);
+}
+
+void BoardReconciler::load_state()
+{
+   if (m_state_path.empty())
+      return;
+   std::ifstream state(m_state_path);
+   std::string line;
+   while (std::getline(state, line))
+   {
+      // "cost\t<setting>\t<microseconds>"
+      const size_t first_tab = line.find('\t'), last_tab = line.rfind('\t');
+      if (first_tab == std::string::npos || last_tab == first_tab)
+         continue;
+      const std::string kind = line.substr(0, first_tab);
+      const std::string middle = line.substr(first_tab + 1, last_tab - first_tab - 1);
+      const std::string last = line.substr(last_tab + 1);
+      try
+      {
+         if (kind == "cost")
+            m_costs_us[middle] = std::stoll(last);
+      }
+      catch (const std::exception&)
+      {
+         // A malformed line is ignored, its setting is applied again
+      }
+   }
+}
+
+void BoardReconciler::save_state() const
+{
+   if (m_state_path.empty())
+      return;
+   std::ofstream state(m_state_path, std::ios::trunc);
+   if (!state)
+   {
+      std::cout << "Error when writing the board state file " << m_state_path << std::endl;
+      return;
+   }
+   for (const auto& cost : m_costs_us)
+      state << "cost\t" << cost.first << "\t" << cost.second << "\n";
+}
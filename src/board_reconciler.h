@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file board_reconciler.h
+   @brief This file contains the reconciliation of the NIC, PTP and clock settings of a board with the desired ones.
+
+   @detail The reconciler reads the current state of the board, compares it with the desired settings and only
+   applies the differences, so that restarting a sample on a board that is already configured neither bounces the
+   link nor resets the PTP servo. The time a setting took when it was last applied (for the PTP configuration, up
+   to the lock) is kept in a state file across runs, and counted as saved when the setting is already in place.
+
+   The PTP datasets also hold fields the board fills itself (clock and port identities, port state), so the PTP
+   configuration is compared field by field on the ones the ST2059-2 profile sets and on the domain and announce
+   receipt timeout. The state file is kept per board, named after the factory MAC address of its ethernet port.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Core.h"
+#include "VideoMasterHD/VideoMasterHD_PTP.h"
+#else
+#include "VideoMasterHD_Core.h"
+#include "VideoMasterHD_PTP.h"
+#endif
+
+/*!
+   @brief Desired configuration of the media NIC
+*/
+struct NicSettings
+{
+   uint32_t ip_address;
+   uint32_t subnet_mask;
+   uint32_t gateway;
+   bool dhcp /*! The address, mask and gateway are ignored when DHCP is enabled */;
+};
+
+/*!
+   @brief Setting compared by the reconciler
+*/
+struct ReconciledSetting
+{
+   std::string name;
+   bool applied /*! False if the board already had the desired value */;
+   std::chrono::microseconds cost /*! Time to apply, measured now if applied, else on the last run that applied it */;
+   bool cost_known /*! False if the setting was never applied with a state file */;
+};
+
+class BoardReconciler
+{
+public:
+   BoardReconciler(HANDLE board_handle /*!< [in] Board handle*/,
+                   const std::string& state_directory /*!< [in] Directory of the state files kept across runs, empty
+                                                           to keep nothing*/);
+
+   BoardReconciler(const BoardReconciler&) = delete;
+   BoardReconciler& operator=(const BoardReconciler&) = delete;
+
+   /*!
+      @brief Directory of the state files of the user: $XDG_STATE_HOME/nmos-vhd, ~/.local/state/nmos-vhd or
+      %LOCALAPPDATA%\nmos-vhd on Windows, empty if none of them is defined
+   */
+   static std::string get_default_state_directory();
+
+   /*!
+      @brief Reconcile another handle of the board from now on, e.g. once it is reopened
+   */
+   void set_board_handle(HANDLE board_handle /*!< [in] New board handle*/) { m_board_handle = board_handle; }
+
+   /*!
+      @brief Enable or disable DHCP, and set the address, mask and gateway that differ from the desired ones
+   */
+   VHD_ERRORCODE reconcile_nic(const NicSettings& settings /*!< [in] Desired NIC configuration*/);
+
+   /*!
+      @brief Set the ST2059-2 PTP configuration with the given parameters if the board does not hold it already
+
+      @detail When the configuration is set, the caller restarts its lock detection and reports the time to lock
+      with add_ptp_lock_time().
+   */
+   VHD_ERRORCODE reconcile_ptp(uint8_t domain_number /*!< [in] Domain number of the PTP service*/,
+                               uint8_t announce_receipt_timeout /*!< [in] Announce receipt timeout in seconds*/,
+                               bool& applied /*!< [out] True if the configuration was set*/);
+
+   /*!
+      @brief Set the clock system of the board if it differs, VHD_CLOCKDIV_1001 for the US video standards
+   */
+   VHD_ERRORCODE reconcile_clock_system(bool is_us /*!< [in] True for a 1000/1001 frame rate*/);
+
+   /*!
+      @brief Add the time the PTP took to lock after reconcile_ptp() set its configuration to the cost of the setting
+   */
+   void add_ptp_lock_time(std::chrono::microseconds lock_time /*!< [in] Time from the configuration to the lock*/);
+
+   /*!
+      @brief Settings compared so far, in order
+   */
+   const std::vector<ReconciledSetting>& get_settings() const { return m_settings; }
+
+   /*!
+      @brief Print the settings applied and skipped, the time spent and the time saved by the skipped settings
+   */
+   void print_summary() const;
+
+private:
+   using clock = std::chrono::steady_clock;
+
+   VHD_ERRORCODE reconcile_ethernet_port_property(const char* name, ULONG property, ULONG value);
+   void record(const std::string& name, bool applied, clock::time_point apply_begin);
+   void load_state();
+   void save_state() const;
+
+   HANDLE m_board_handle;
+   std::string m_state_path;
+   std::map<std::string, int64_t> m_costs_us /*! Last measured cost of the settings, from the state file */;
+   std::vector<ReconciledSetting> m_settings;
+   std::chrono::microseconds m_reconcile_time{0} /*! Time spent reading, comparing and applying */;
+};
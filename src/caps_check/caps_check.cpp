@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iostream>
+#include <set>
+#include <tuple>
+
+#include "nmos/capabilities.h"
+#include "nmos/interlace_mode.h"
+#include "nmos/rational.h"
+
+#include "../nmos_tools.h"
+
+namespace
+{
+   // width, height, interlace mode and grain rate of a video format
+   typedef std::tuple<int64_t, int64_t, utility::string_t, nmos::rational> VideoFormat;
+
+   struct ReferenceVideoFormat
+   {
+      const char* name;
+      int64_t frame_width;
+      int64_t frame_height;
+      bool interlaced;
+      int64_t grain_rate_numerator;
+      int64_t grain_rate_denominator;
+   };
+
+   // The video formats of the VideoMaster ST 2110-20 video standards, written from their SMPTE names independently of
+   // video_standard_infos that the constraint sets are built from. The grain of an interlaced standard is a frame.
+   const ReferenceVideoFormat reference_video_formats[] = {
+      {"720x480i59.94", 720, 480, true, 30000, 1001},    {"720x487i59.94", 720, 487, true, 30000, 1001},
+      {"720x576i50", 720, 576, true, 25, 1},              {"1280x720p50", 1280, 720, false, 50, 1},
+      {"1280x720p59.94", 1280, 720, false, 60000, 1001}, {"1280x720p60", 1280, 720, false, 60, 1},
+      {"1920x1080i50", 1920, 1080, true, 25, 1},          {"1920x1080i59.94", 1920, 1080, true, 30000, 1001},
+      {"1920x1080i60", 1920, 1080, true, 30, 1},          {"1920x1080p23.98", 1920, 1080, false, 24000, 1001},
+      {"1920x1080p24", 1920, 1080, false, 24, 1},         {"1920x1080p25", 1920, 1080, false, 25, 1},
+      {"1920x1080p29.97", 1920, 1080, false, 30000, 1001}, {"1920x1080p30", 1920, 1080, false, 30, 1},
+      {"1920x1080p50", 1920, 1080, false, 50, 1},         {"1920x1080p59.94", 1920, 1080, false, 60000, 1001},
+      {"1920x1080p60", 1920, 1080, false, 60, 1},         {"2048x1080p23.98", 2048, 1080, false, 24000, 1001},
+      {"2048x1080p24", 2048, 1080, false, 24, 1},         {"2048x1080p25", 2048, 1080, false, 25, 1},
+      {"2048x1080p29.97", 2048, 1080, false, 30000, 1001}, {"2048x1080p30", 2048, 1080, false, 30, 1},
+      {"2048x1080p47.95", 2048, 1080, false, 48000, 1001}, {"2048x1080p48", 2048, 1080, false, 48, 1},
+      {"2048x1080p50", 2048, 1080, false, 50, 1},         {"2048x1080p59.94", 2048, 1080, false, 60000, 1001},
+      {"2048x1080p60", 2048, 1080, false, 60, 1},         {"3840x2160p23.98", 3840, 2160, false, 24000, 1001},
+      {"3840x2160p24", 3840, 2160, false, 24, 1},         {"3840x2160p25", 3840, 2160, false, 25, 1},
+      {"3840x2160p29.97", 3840, 2160, false, 30000, 1001}, {"3840x2160p30", 3840, 2160, false, 30, 1},
+      {"3840x2160p50", 3840, 2160, false, 50, 1},         {"3840x2160p59.94", 3840, 2160, false, 60000, 1001},
+      {"3840x2160p60", 3840, 2160, false, 60, 1},         {"4096x2160p23.98", 4096, 2160, false, 24000, 1001},
+      {"4096x2160p24", 4096, 2160, false, 24, 1},         {"4096x2160p25", 4096, 2160, false, 25, 1},
+      {"4096x2160p29.97", 4096, 2160, false, 30000, 1001}, {"4096x2160p30", 4096, 2160, false, 30, 1},
+      {"4096x2160p47.95", 4096, 2160, false, 48000, 1001}, {"4096x2160p48", 4096, 2160, false, 48, 1},
+      {"4096x2160p50", 4096, 2160, false, 50, 1},         {"4096x2160p59.94", 4096, 2160, false, 60000, 1001},
+      {"4096x2160p60", 4096, 2160, false, 60, 1},
+   };
+
+   const web::json::array& get_constraint_enum(const web::json::value& constraint_set, const utility::string_t& cap)
+   {
+      return constraint_set.at(cap).at(nmos::fields::constraint_enum.key).as_array();
+   }
+
+   // every combination of the enums of a constraint set is accepted by the receiver
+   std::set<VideoFormat> get_accepted_video_formats(const web::json::value& constraint_sets)
+   {
+      std::set<VideoFormat> formats;
+      for (const auto& constraint_set : constraint_sets.as_array())
+      {
+         for (const auto& frame_width : get_constraint_enum(constraint_set, nmos::caps::format::frame_width.key))
+            for (const auto& frame_height : get_constraint_enum(constraint_set, nmos::caps::format::frame_height.key))
+               for (const auto& interlace_mode :
+                    get_constraint_enum(constraint_set, nmos::caps::format::interlace_mode.key))
+                  for (const auto& grain_rate :
+                       get_constraint_enum(constraint_set, nmos::caps::format::grain_rate.key))
+                     formats.emplace(frame_width.as_integer(), frame_height.as_integer(), interlace_mode.as_string(),
+                                     nmos::parse_rational(grain_rate));
+      }
+      return formats;
+   }
+
+   VideoFormat to_video_format(const ReferenceVideoFormat& format)
+   {
+      return VideoFormat(format.frame_width, format.frame_height,
+                         format.interlaced ? nmos::interlace_modes::interlaced_bff.name
+                                           : nmos::interlace_modes::progressive.name,
+                         nmos::rational(format.grain_rate_numerator, format.grain_rate_denominator));
+   }
+
+   void print(const VideoFormat& format)
+   {
+      std::cout << std::get<0>(format) << "x" << std::get<1>(format) << " "
+                << utility::conversions::to_utf8string(std::get<2>(format)) << " " << std::get<3>(format).numerator()
+                << "/" << std::get<3>(format).denominator();
+   }
+}
+
+int main()
+{
+   const web::json::value constraint_sets = nmos_tools::make_video_constraint_sets();
+   const std::set<VideoFormat> accepted_formats = get_accepted_video_formats(constraint_sets);
+
+   uint32_t nb_errors = 0;
+   std::set<VideoFormat> reference_formats;
+   for (const ReferenceVideoFormat& reference_format : reference_video_formats)
+   {
+      const VideoFormat format = to_video_format(reference_format);
+      reference_formats.insert(format);
+      if (accepted_formats.count(format) == 0)
+      {
+         std::cout << "Not accepted by the receiver caps: " << reference_format.name << std::endl;
+         nb_errors++;
+      }
+   }
+   for (const VideoFormat& format : accepted_formats)
+   {
+      if (reference_formats.count(format) == 0)
+      {
+         std::cout << "Accepted by the receiver caps but not supported: ";
+         print(format);
+         std::cout << std::endl;
+         nb_errors++;
+      }
+   }
+
+   std::cout << constraint_sets.as_array().size() << " constraint sets accepting " << accepted_formats.size()
+             << " video formats, " << reference_formats.size() << " supported: "
+             << (nb_errors ? "FAILED" : "OK") << std::endl;
+   return nb_errors ? -1 : 0;
+}
@@ -0,0 +1,427 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "depacketizer.h"
+#include "pixel_conversion.h"
+#include "rtp.h"
+
+namespace
+{
+   bool is_second_field(const St2110_20Packet& packet)
+   {
+      return packet.nb_sample_row_data > 0 && packet.sample_row_data[0].field;
+   }
+}
+
+St2110_20Depacketizer::St2110_20Depacketizer(uint32_t frame_width, uint32_t frame_height, bool interlaced,
+                                             const VideoFormat& video_format, uint32_t nb_threads)
+    : m_frame_width(frame_width), m_frame_height(frame_height), m_interlaced(interlaced), m_video_format(video_format),
+      m_pgroup(get_pixel_group(video_format)),
+      m_nb_threads(nb_threads ? nb_threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+bool St2110_20Depacketizer::is_supported(const VideoFormat& video_format)
+{
+   return video_format.sampling == VHD_ST2110_20_SAMPLING_YUV_422 && get_component_depth(video_format.depth);
+}
+
+uint64_t St2110_20Depacketizer::get_frame_size(uint32_t frame_width, uint32_t frame_height)
+{
+   return static_cast<uint64_t>(frame_width) * frame_height * yuv422_10_bytes_per_pixel;
+}
+
+void St2110_20Depacketizer::set_worker_setup(const std::function<void()>& worker_setup)
+{
+   m_worker_setup = worker_setup;
+}
+
+void St2110_20Depacketizer::set_line_blocks(uint32_t nb_blocks, const LineBlockCallback& on_block)
+{
+   m_nb_line_blocks = nb_blocks;
+   m_on_line_block = on_block;
+}
+
+LineBlockStatistics St2110_20Depacketizer::get_line_block_statistics() const
+{
+   return m_line_block_statistics;
+}
+
+uint64_t St2110_20Depacketizer::run(PcapReader& reader, const Ipv4Endpoint& destination,
+                                    const FrameCallback& on_frame)
+{
+   m_line_block_statistics = {};
+   if (m_nb_line_blocks && m_on_line_block)
+      return run_line_blocks(reader, destination, on_frame);
+
+   struct Job
+   {
+      std::vector<FramePacket> packets;
+      DepacketizedFrame frame;
+      bool done = false;
+   };
+
+   // Two frames per worker keep the workers busy while the calling thread reads and delivers
+   std::vector<Job> jobs(2 * m_nb_threads + 1);
+   for (Job& job : jobs)
+   {
+      job.frame.buffer.resize(get_frame_size(m_frame_width, m_frame_height));
+      job.frame.missing_pixels.resize(m_frame_height);
+   }
+
+   std::mutex mutex;
+   std::condition_variable job_queued, job_done;
+   std::deque<size_t> queued_jobs, jobs_in_order, free_jobs;
+   bool stop = false;
+   for (size_t i = 0; i < jobs.size(); i++)
+      free_jobs.push_back(i);
+
+   std::vector<std::thread> workers(m_nb_threads);
+   for (auto& worker : workers)
+   {
+      worker = std::thread([&]() {
+         if (m_worker_setup)
+            m_worker_setup();
+
+         std::unique_lock lock(mutex);
+         while (true)
+         {
+            job_queued.wait(lock, [&] { return stop || !queued_jobs.empty(); });
+            if (queued_jobs.empty())
+               return;
+            Job& job = jobs[queued_jobs.front()];
+            queued_jobs.pop_front();
+            lock.unlock();
+            unpack(job.packets, job.frame);
+            lock.lock();
+            job.done = true;
+            job_done.notify_all();
+         }
+      });
+   }
+
+   uint64_t nb_frames = 0;
+   bool consumer_stopped = false;
+
+   // Hand the oldest frame to the callback once it is unpacked
+   auto deliver_oldest = [&]() {
+      std::unique_lock lock(mutex);
+      const size_t index = jobs_in_order.front();
+      job_done.wait(lock, [&] { return jobs[index].done; });
+      jobs_in_order.pop_front();
+      lock.unlock();
+
+      if (!consumer_stopped)
+      {
+         consumer_stopped = !on_frame(jobs[index].frame);
+         nb_frames++;
+      }
+
+      lock.lock();
+      free_jobs.push_back(index);
+   };
+
+   Job* current = nullptr;
+   size_t current_index = 0;
+   bool has_second_field = false, has_previous = false;
+   uint32_t previous_sequence_number = 0, current_timestamp = 0;
+
+   auto submit_current = [&]() {
+      if (!current)
+         return;
+      std::lock_guard lock(mutex);
+      current->done = false;
+      queued_jobs.push_back(current_index);
+      jobs_in_order.push_back(current_index);
+      job_queued.notify_one();
+      current = nullptr;
+   };
+
+   PcapPacket captured_packet;
+   UdpDatagram datagram;
+   St2110_20Packet packet;
+   while (!consumer_stopped && reader.next(captured_packet))
+   {
+      if (!parse_udp_datagram(captured_packet, datagram) || datagram.destination != destination ||
+          !parse_st2110_20_packet(datagram.payload, datagram.payload_size, packet))
+         continue;
+
+      // A new frame starts on a new RTP timestamp, except for the second field of an interlaced frame
+      const bool second_field = m_interlaced && is_second_field(packet);
+      if (current && packet.timestamp != current_timestamp && !(second_field && !has_second_field))
+         submit_current();
+
+      if (!current)
+      {
+         bool no_free_job;
+         {
+            std::lock_guard lock(mutex);
+            no_free_job = free_jobs.empty();
+         }
+         if (no_free_job)
+            deliver_oldest();
+         if (consumer_stopped)
+            break;
+
+         std::lock_guard lock(mutex);
+         current_index = free_jobs.front();
+         free_jobs.pop_front();
+         current = &jobs[current_index];
+         current->packets.clear();
+         current->frame.rtp_timestamp = packet.timestamp;
+         current->frame.timestamp_ns = captured_packet.timestamp_ns;
+         current->frame.nb_lost_packets = 0;
+         current->frame.marker = false;
+         current_timestamp = packet.timestamp;
+         has_second_field = false;
+      }
+      if (second_field && !has_second_field)
+      {
+         // The frame keeps the RTP timestamp of its first field
+         has_second_field = true;
+         current_timestamp = packet.timestamp;
+      }
+
+      if (has_previous && packet.sequence_number != previous_sequence_number + 1)
+         current->frame.nb_lost_packets += packet.sequence_number - previous_sequence_number - 1;
+      previous_sequence_number = packet.sequence_number;
+      has_previous = true;
+
+      current->packets.push_back({datagram.payload, datagram.payload_size});
+      current->frame.end_timestamp_ns = captured_packet.timestamp_ns;
+      // For interlaced video, the marker bit of the first field does not end the frame
+      current->frame.marker = packet.marker && (!m_interlaced || second_field);
+      if (current->frame.marker)
+         submit_current();
+   }
+   submit_current();
+
+   while (true)
+   {
+      {
+         std::lock_guard lock(mutex);
+         if (jobs_in_order.empty())
+            break;
+      }
+      deliver_oldest();
+   }
+
+   {
+      std::lock_guard lock(mutex);
+      stop = true;
+   }
+   job_queued.notify_all();
+   for (auto& worker : workers)
+      worker.join();
+
+   return nb_frames;
+}
+
+uint64_t St2110_20Depacketizer::run_line_blocks(PcapReader& reader, const Ipv4Endpoint& destination,
+                                                const FrameCallback& on_frame)
+{
+   const uint32_t nb_fields = m_interlaced ? 2 : 1;
+   const uint32_t field_height = m_frame_height / nb_fields;
+   const uint32_t blocks_per_field = std::min(field_height, std::max(1u, m_nb_line_blocks / nb_fields));
+   const uint32_t nb_blocks = blocks_per_field * nb_fields;
+   const uint64_t line_size = static_cast<uint64_t>(m_frame_width) * yuv422_10_bytes_per_pixel;
+
+   // First row of a block in its field, the block after the last one of a field starting at field_height
+   auto get_first_row = [&](uint32_t block_in_field) { return block_in_field * field_height / blocks_per_field; };
+
+   DepacketizedFrame frame;
+   frame.buffer.resize(get_frame_size(m_frame_width, m_frame_height));
+   frame.missing_pixels.resize(m_frame_height);
+   std::vector<uint64_t> completion_timestamps_ns(nb_blocks);
+
+   uint64_t nb_frames = 0;
+   uint32_t nb_delivered_blocks = 0;
+   bool in_frame = false, consumer_stopped = false;
+   double advance_sum_ns = 0.0, first_block_advance_sum_ns = 0.0;
+
+   // Hand the blocks before end_block over, in order, the last packet unpacked being the last one of the blocks
+   auto deliver_blocks = [&](uint32_t end_block) {
+      for (; !consumer_stopped && nb_delivered_blocks < end_block; nb_delivered_blocks++)
+      {
+         const uint32_t field = nb_delivered_blocks / blocks_per_field;
+         const uint32_t first_row = get_first_row(nb_delivered_blocks % blocks_per_field);
+         LineBlock block;
+         block.rtp_timestamp = frame.rtp_timestamp;
+         block.index = nb_delivered_blocks;
+         block.nb_blocks = nb_blocks;
+         block.first_line = first_row * nb_fields + field;
+         block.nb_lines = get_first_row(nb_delivered_blocks % blocks_per_field + 1) - first_row;
+         block.line_stride = line_size * nb_fields;
+         block.line_size = line_size;
+         block.data = frame.buffer.data() + block.first_line * line_size;
+         block.nb_incomplete_lines = 0;
+         for (uint32_t line = 0; line < block.nb_lines; line++)
+            block.nb_incomplete_lines += frame.missing_pixels[block.first_line + line * nb_fields] != 0;
+         block.frame_timestamp_ns = frame.timestamp_ns;
+         block.completion_timestamp_ns = frame.end_timestamp_ns;
+         completion_timestamps_ns[nb_delivered_blocks] = frame.end_timestamp_ns;
+         consumer_stopped = !m_on_line_block(block);
+      }
+   };
+
+   auto end_frame = [&]() {
+      if (!in_frame)
+         return;
+      in_frame = false;
+      deliver_blocks(nb_blocks);
+      if (consumer_stopped)
+         return;
+
+      // The whole frame is only available once its last packet is unpacked
+      for (uint32_t i = 0; i < nb_blocks; i++)
+         advance_sum_ns += static_cast<double>(frame.end_timestamp_ns - completion_timestamps_ns[i]);
+      first_block_advance_sum_ns += static_cast<double>(frame.end_timestamp_ns - completion_timestamps_ns[0]);
+      m_line_block_statistics.nb_blocks += nb_blocks;
+
+      frame.nb_incomplete_lines = count_incomplete_lines(frame);
+      consumer_stopped = !on_frame(frame);
+      nb_frames++;
+   };
+
+   bool has_second_field = false, has_previous = false;
+   uint32_t previous_sequence_number = 0, current_timestamp = 0;
+
+   PcapPacket captured_packet;
+   UdpDatagram datagram;
+   St2110_20Packet packet;
+   while (!consumer_stopped && reader.next(captured_packet))
+   {
+      if (!parse_udp_datagram(captured_packet, datagram) || datagram.destination != destination ||
+          !parse_st2110_20_packet(datagram.payload, datagram.payload_size, packet))
+         continue;
+
+      // A new frame starts on a new RTP timestamp, except for the second field of an interlaced frame
+      const bool second_field = m_interlaced && is_second_field(packet);
+      if (in_frame && packet.timestamp != current_timestamp && !(second_field && !has_second_field))
+         end_frame();
+      if (consumer_stopped)
+         break;
+
+      if (!in_frame)
+      {
+         std::fill(frame.missing_pixels.begin(), frame.missing_pixels.end(), static_cast<uint16_t>(m_frame_width));
+         frame.rtp_timestamp = packet.timestamp;
+         frame.timestamp_ns = captured_packet.timestamp_ns;
+         frame.end_timestamp_ns = captured_packet.timestamp_ns;
+         frame.nb_packets = 0;
+         frame.nb_lost_packets = 0;
+         frame.marker = false;
+         current_timestamp = packet.timestamp;
+         has_second_field = false;
+         nb_delivered_blocks = 0;
+         in_frame = true;
+      }
+      if (second_field && !has_second_field)
+      {
+         // The frame keeps the RTP timestamp of its first field
+         has_second_field = true;
+         current_timestamp = packet.timestamp;
+      }
+
+      if (has_previous && packet.sequence_number != previous_sequence_number + 1)
+         frame.nb_lost_packets += packet.sequence_number - previous_sequence_number - 1;
+      previous_sequence_number = packet.sequence_number;
+      has_previous = true;
+
+      // The lines are sent in order: the blocks ending before the first row of the packet are complete
+      if (packet.nb_sample_row_data)
+      {
+         const uint32_t field = packet.sample_row_data[0].field && m_interlaced ? 1 : 0;
+         const uint32_t row = packet.sample_row_data[0].row_number;
+         uint32_t end_block = field * blocks_per_field;
+         while (end_block < (field + 1) * blocks_per_field &&
+                get_first_row(end_block % blocks_per_field + 1) <= row)
+            end_block++;
+         deliver_blocks(end_block);
+         if (consumer_stopped)
+            break;
+      }
+
+      unpack_packet(packet, frame);
+      frame.nb_packets++;
+      frame.end_timestamp_ns = captured_packet.timestamp_ns;
+
+      // For interlaced video, the marker bit of the first field does not end the frame
+      frame.marker = packet.marker && (!m_interlaced || second_field);
+      if (frame.marker)
+         end_frame();
+   }
+   end_frame();
+
+   m_line_block_statistics.nb_frames = nb_frames;
+   if (nb_frames)
+   {
+      m_line_block_statistics.mean_advance_ns = advance_sum_ns / m_line_block_statistics.nb_blocks;
+      m_line_block_statistics.mean_first_block_advance_ns = first_block_advance_sum_ns / nb_frames;
+   }
+   return nb_frames;
+}
+
+void St2110_20Depacketizer::unpack(const std::vector<FramePacket>& packets, DepacketizedFrame& frame) const
+{
+   std::fill(frame.missing_pixels.begin(), frame.missing_pixels.end(), static_cast<uint16_t>(m_frame_width));
+   frame.nb_packets = 0;
+
+   St2110_20Packet packet;
+   for (const FramePacket& frame_packet : packets)
+   {
+      if (!parse_st2110_20_packet(frame_packet.payload, frame_packet.payload_size, packet))
+         continue;
+      frame.nb_packets++;
+      unpack_packet(packet, frame);
+   }
+
+   frame.nb_incomplete_lines = count_incomplete_lines(frame);
+}
+
+void St2110_20Depacketizer::unpack_packet(const St2110_20Packet& packet, DepacketizedFrame& frame) const
+{
+   const uint64_t line_size = static_cast<uint64_t>(m_frame_width) * yuv422_10_bytes_per_pixel;
+   for (uint32_t i = 0; i < packet.nb_sample_row_data; i++)
+   {
+      const St2110_20SampleRowData& sample_row_data = packet.sample_row_data[i];
+      const uint32_t line = m_interlaced ? sample_row_data.row_number * 2u + (sample_row_data.field ? 1u : 0u)
+                                         : sample_row_data.row_number;
+      if (line >= m_frame_height || sample_row_data.offset >= m_frame_width)
+         continue;
+
+      const uint32_t nb_pgroups =
+          std::min<uint32_t>(sample_row_data.length / m_pgroup.size,
+                             (m_frame_width - sample_row_data.offset) / m_pgroup.nb_pixels);
+      unpack_pgroups(m_video_format, sample_row_data.data,
+                     frame.buffer.data() + line * line_size + sample_row_data.offset * yuv422_10_bytes_per_pixel,
+                     HostComponent::word, line_size, nb_pgroups);
+      frame.missing_pixels[line] =
+          static_cast<uint16_t>(frame.missing_pixels[line] - std::min<uint32_t>(frame.missing_pixels[line],
+                                                                                nb_pgroups * m_pgroup.nb_pixels));
+   }
+}
+
+uint32_t St2110_20Depacketizer::count_incomplete_lines(const DepacketizedFrame& frame) const
+{
+   return static_cast<uint32_t>(std::count_if(frame.missing_pixels.begin(), frame.missing_pixels.end(),
+                                              [](uint16_t missing) { return missing != 0; }));
+}
@@ -0,0 +1,180 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file depacketizer.h
+   @brief This file contains a software ST 2110-20 depacketizer rebuilding the frames of a captured flow.
+
+   @detail The frames are rebuilt in the VHD_BUFPACK_VIDEO_YUV422_10 layout returned by VHD_GetSlotBuffer on a
+   reception stream (displayed as ycbcr_422_10_le_msb by the viewer): every 10-bit component is stored in a
+   16-bit little-endian word, aligned on the most significant bits, in the Cb Y0 Cr Y1 order of the ST 2110-20
+   YCbCr-4:2:2 pixel groups. The pixel groups may be of 8, 10 or 12 bits per component.
+
+   In line-block mode, the packets are unpacked as they are read and the frame is also handed over in blocks of
+   lines, each one as soon as the packets of the following lines start to arrive, so that the consumers can start
+   working on a frame before its last packet.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <functional>
+#include <vector>
+
+#include "ipv4.h"
+#include "pcap_reader.h"
+#include "video_format.h"
+
+/*!
+   @brief Frame rebuilt by the depacketizer
+*/
+struct DepacketizedFrame
+{
+   uint32_t rtp_timestamp /*! RTP timestamp of the frame (of its first field for interlaced video) */;
+   uint64_t timestamp_ns /*! Capture timestamp of the first packet of the frame */;
+   uint64_t end_timestamp_ns /*! Capture timestamp of the last packet of the frame */;
+   std::vector<uint8_t> buffer /*! Frame in the VHD_BUFPACK_VIDEO_YUV422_10 layout */;
+   std::vector<uint16_t> missing_pixels /*! Loss map: number of pixels not received, per line */;
+   uint32_t nb_packets /*! Number of packets received for the frame */;
+   uint32_t nb_lost_packets /*! Number of packets missing in the sequence numbers of the frame */;
+   uint32_t nb_incomplete_lines /*! Number of lines of the loss map with missing pixels */;
+   bool marker /*! Marker bit received on the last packet of the frame */;
+};
+
+/*!
+   @brief Block of lines of a frame being rebuilt, in line-block mode
+
+   @detail The blocks split each field of interlaced video, so that the lines of a block are one line apart in the
+   frame buffer.
+*/
+struct LineBlock
+{
+   uint32_t rtp_timestamp /*! RTP timestamp of the frame */;
+   uint32_t index /*! Index of the block in the frame */;
+   uint32_t nb_blocks /*! Number of blocks of the frame */;
+   uint32_t first_line /*! First line of the block in the frame */;
+   uint32_t nb_lines /*! Number of lines of the block */;
+   uint64_t line_stride /*! Bytes from a line of the block to the next one */;
+   uint64_t line_size /*! Bytes of a line */;
+   const uint8_t* data /*! First line of the block, in the VHD_BUFPACK_VIDEO_YUV422_10 layout */;
+   uint32_t nb_incomplete_lines /*! Lines of the block with missing pixels */;
+   uint64_t frame_timestamp_ns /*! Capture timestamp of the first packet of the frame */;
+   uint64_t completion_timestamp_ns /*! Capture timestamp of the last packet of the block */;
+};
+
+/*!
+   @brief How much earlier the line blocks are available than the whole frames
+*/
+struct LineBlockStatistics
+{
+   uint64_t nb_frames = 0;
+   uint64_t nb_blocks = 0;
+   double mean_advance_ns = 0.0 /*! Mean time from a block completion to the end of its frame */;
+   double mean_first_block_advance_ns = 0.0 /*! Same for the first block of the frames */;
+};
+
+struct St2110_20Packet;
+
+/*!
+   @brief Rebuild the frames of a ST 2110-20 YCbCr-4:2:2 10-bit flow from a capture
+
+   @detail The capture is read and the packets are grouped per frame on the calling thread; the pixel groups of
+   each frame are unpacked by a pool of worker threads and the frames are handed back in order on the calling
+   thread. Frame buffers are recycled, so the pixels of a lost packet keep the content of an older frame.
+*/
+class St2110_20Depacketizer
+{
+public:
+   /*!
+      @brief Called for every rebuilt frame, in order. Return false to stop the depacketization.
+   */
+   using FrameCallback = std::function<bool(const DepacketizedFrame& frame)>;
+
+   /*!
+      @brief Called for every completed line block, in order. Return false to stop the depacketization.
+   */
+   using LineBlockCallback = std::function<bool(const LineBlock& block)>;
+
+   St2110_20Depacketizer(uint32_t frame_width /*!< [in] Width of the video frame in pixels*/,
+                         uint32_t frame_height /*!< [in] Height of the video frame in pixels*/,
+                         bool interlaced /*!< [in] True if the video is interlaced*/,
+                         const VideoFormat& video_format = default_video_format /*!< [in] Format of the pixel groups, see is_supported()*/,
+                         uint32_t nb_threads = 0 /*!< [in] Number of unpacking threads, 0 for one per core*/);
+
+   /*!
+      @brief Whether the frames can be rebuilt from a video format: YCbCr-4:2:2, the sampling of the rebuilt frames
+   */
+   static bool is_supported(const VideoFormat& video_format /*!< [in] Format of the pixel groups*/);
+
+   /*!
+      @brief Size of a frame in the VHD_BUFPACK_VIDEO_YUV422_10 layout
+   */
+   static uint64_t get_frame_size(uint32_t frame_width, uint32_t frame_height);
+
+   /*!
+      @brief Set the function called first on every unpacking thread (e.g. to set its scheduling)
+   */
+   void set_worker_setup(const std::function<void()>& worker_setup /*!< [in] Setup of a worker thread*/);
+
+   /*!
+      @brief Enable the line-block mode: the frames are unpacked on the calling thread as their packets are read,
+      and handed to on_block in nb_blocks blocks of lines before being handed to the frame callback
+
+      @detail nb_blocks is rounded down to an even number for interlaced video, 0 disables the line-block mode.
+   */
+   void set_line_blocks(uint32_t nb_blocks /*!< [in] Blocks per frame, e.g. 8*/,
+                        const LineBlockCallback& on_block /*!< [in] Line block consumer*/);
+
+   /*!
+      @brief Statistics of the line blocks handed over by the last run
+   */
+   LineBlockStatistics get_line_block_statistics() const;
+
+   /*!
+      @brief Depacketize the flow sent to a destination until the end of the capture
+
+      @returns The number of frames handed to the callback
+   */
+   uint64_t run(PcapReader& reader /*!< [in] Opened capture*/,
+                const Ipv4Endpoint& destination /*!< [in] Destination of the flow to depacketize*/,
+                const FrameCallback& on_frame /*!< [in] Frame consumer*/);
+
+private:
+   struct FramePacket
+   {
+      const uint8_t* payload;
+      uint32_t payload_size;
+   };
+
+   uint64_t run_line_blocks(PcapReader& reader, const Ipv4Endpoint& destination, const FrameCallback& on_frame);
+   void unpack(const std::vector<FramePacket>& packets, DepacketizedFrame& frame) const;
+   void unpack_packet(const St2110_20Packet& packet, DepacketizedFrame& frame) const;
+   uint32_t count_incomplete_lines(const DepacketizedFrame& frame) const;
+
+   const uint32_t m_frame_width;
+   const uint32_t m_frame_height;
+   const bool m_interlaced;
+   const VideoFormat m_video_format;
+   const PixelGroup m_pgroup;
+   const uint32_t m_nb_threads;
+   std::function<void()> m_worker_setup;
+   uint32_t m_nb_line_blocks = 0;
+   LineBlockCallback m_on_line_block;
+   LineBlockStatistics m_line_block_statistics;
+};
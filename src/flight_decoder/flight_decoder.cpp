@@ -0,0 +1,245 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#if defined(__GNUC__) && !defined(__APPLE__)
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include "../flight_recorder.h"
+#include "../ipv4.h"
+#include "../stream_watchdog.h"
+#include "../tools.h"
+
+namespace
+{
+   std::string format_time(uint64_t time_ns)
+   {
+      const std::time_t seconds = static_cast<std::time_t>(time_ns / 1000000000);
+      char buffer[32] = {};
+      std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", std::gmtime(&seconds));
+      std::ostringstream time;
+      time << buffer << "." << std::setw(3) << std::setfill('0') << (time_ns / 1000000) % 1000;
+      return time.str();
+   }
+
+   const char* to_string(FlightStopReason reason)
+   {
+      switch (reason)
+      {
+      case FlightStopReason::user: return "stopped by the user";
+      case FlightStopReason::node_disabled: return "connection disabled";
+      case FlightStopReason::transport_changed: return "transport parameters changed";
+      case FlightStopReason::sdp_changed: return "SDP changed";
+      case FlightStopReason::error: return "error";
+      default: return "unknown reason";
+      }
+   }
+
+   std::string format_video_standard(uint32_t video_standard)
+   {
+      const VideoStandardInfo* info =
+          find_video_standard_info(static_cast<VHD_ST2110_20_VIDEO_STANDARD>(video_standard));
+      if (!info)
+         return "video standard " + std::to_string(video_standard);
+      return std::to_string(info->frame_width) + "x" + std::to_string(info->frame_height) +
+             (info->interlaced ? "i" : "p") + std::to_string(info->frame_rate) + (info->is_us ? "/1.001" : "");
+   }
+
+   std::string format_ptp(const FlightRecorderContent& content, const FlightRecordData& data)
+   {
+      if (data.ptp_state == flight_recorder_no_ptp_state)
+         return "not monitored";
+      std::string state = data.ptp_state < content.ptp_state_names.size()
+                              ? content.ptp_state_names[data.ptp_state]
+                              : "";
+      if (state.empty())
+         state = "state " + std::to_string(data.ptp_state);
+      return state + (data.ptp_locked ? " locked" : " unlocked") + " offset " + std::to_string(data.ptp_offset_ns) +
+             " ns";
+   }
+
+   /*!
+      @brief Follows the counters of a stream from sample to sample, they restart from 0 with the stream
+   */
+   struct StreamCounters
+   {
+      bool is_valid = false;
+      FlightRecordData previous = {};
+
+      uint32_t get_increase(uint32_t value, uint32_t previous_value) const
+      {
+         return is_valid && value > previous_value ? value - previous_value : 0;
+      }
+   };
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      std::cout << "Usage: " << argv[0] << " <flight recorder file> [--csv] [--incidents] [--last <records>]"
+                << std::endl;
+      return -1;
+   }
+
+   const std::string path = argv[1];
+   bool csv = false;
+   bool incidents_only = false;
+   uint64_t nb_last_records = 0;
+   for (int i = 2; i < argc; i++)
+   {
+      const std::string argument = argv[i];
+      if (argument == "--csv")
+         csv = true;
+      else if (argument == "--incidents")
+         incidents_only = true;
+      else if (argument == "--last" && i + 1 < argc)
+         nb_last_records = std::stoull(argv[++i]);
+      else
+      {
+         std::cout << "Unknown argument " << argument << std::endl;
+         return -1;
+      }
+   }
+
+   FlightRecorderContent content;
+   if (!read_flight_recorder(path, content))
+      return -1;
+
+   const size_t first_record = nb_last_records && nb_last_records < content.records.size()
+                                   ? content.records.size() - nb_last_records
+                                   : 0;
+
+   if (csv)
+      std::cout << "sequence,time,type,slots_count,slots_dropped,jitter_max,datagram_count,slot_timeouts,ptp_state,"
+                   "ptp_locked,ptp_offset_ns,address,port,value,status"
+                << std::endl;
+
+   StreamCounters counters;
+   uint64_t nb_sessions = 0;
+   uint64_t nb_dropped_slots = 0;
+   uint64_t nb_slot_timeouts = 0;
+   uint64_t nb_recoveries = 0;
+   uint64_t time_to_recovery_sum_ms = 0;
+   for (size_t i = 0; i < content.records.size(); i++)
+   {
+      const FlightRecordEntry& entry = content.records[i];
+      const FlightRecordData& data = entry.data;
+      const auto type = static_cast<FlightRecordType>(data.type);
+
+      // The incidents are the drops, the timeouts and the PTP state and lock changes between two samples
+      uint32_t dropped = 0;
+      uint32_t timeouts = 0;
+      bool is_incident = type != FlightRecordType::stream_sample;
+      if (type == FlightRecordType::stream_sample)
+      {
+         dropped = counters.get_increase(data.slots_dropped, counters.previous.slots_dropped);
+         timeouts = counters.get_increase(data.slot_timeouts, counters.previous.slot_timeouts);
+         is_incident = dropped || timeouts || !counters.is_valid ||
+                       data.ptp_state != counters.previous.ptp_state ||
+                       data.ptp_locked != counters.previous.ptp_locked;
+         counters.is_valid = true;
+         counters.previous = data;
+      }
+      else if (type == FlightRecordType::session_start || type == FlightRecordType::activation)
+         counters.is_valid = false;
+
+      nb_sessions += type == FlightRecordType::session_start;
+      if (type == FlightRecordType::recovered)
+      {
+         nb_recoveries++;
+         time_to_recovery_sum_ms += data.value;
+      }
+      nb_dropped_slots += dropped;
+      nb_slot_timeouts += timeouts;
+
+      if (i < first_record || (incidents_only && !is_incident))
+         continue;
+
+      const std::string address = Ipv4String(Ipv4Address(data.address)).c_str();
+      if (csv)
+      {
+         std::cout << entry.sequence << "," << format_time(data.time_ns) << "," << data.type << ","
+                   << data.slots_count << "," << data.slots_dropped << "," << data.jitter_max << ","
+                   << data.datagram_count << "," << data.slot_timeouts << "," << unsigned(data.ptp_state) << ","
+                   << unsigned(data.ptp_locked) << "," << data.ptp_offset_ns << "," << address << "," << data.port
+                   << "," << data.value << "," << data.status << std::endl;
+         continue;
+      }
+
+      std::cout << format_time(data.time_ns) << " #" << entry.sequence << " ";
+      switch (type)
+      {
+      case FlightRecordType::session_start:
+         std::cout << "session start (pid " << data.value << ")";
+         break;
+      case FlightRecordType::stream_sample:
+         std::cout << "SlotCount: " << data.slots_count << " - SlotDropped: " << data.slots_dropped;
+         if (dropped)
+            std::cout << " (+" << dropped << ")";
+         std::cout << " - JitterMax: " << data.jitter_max << " - DatagramCount: " << data.datagram_count
+                   << " - Timeout: " << data.slot_timeouts;
+         if (timeouts)
+            std::cout << " (+" << timeouts << ")";
+         break;
+      case FlightRecordType::activation:
+         std::cout << "activation " << address << ":" << data.port << " " << format_video_standard(data.value);
+         break;
+      case FlightRecordType::deactivation:
+         std::cout << "deactivation (" << to_string(static_cast<FlightStopReason>(data.value)) << ")";
+         break;
+      case FlightRecordType::ptp_configured:
+         std::cout << "PTP configuration applied, domain " << data.value;
+         break;
+      case FlightRecordType::ptp_locked:
+         std::cout << "PTP locked in " << data.value << " ms";
+         break;
+      case FlightRecordType::stall_recovery:
+         std::cout << "stall recovery: " << to_string(static_cast<StreamRecoveryStage>(data.value))
+                   << (data.status ? " failed (error " + std::to_string(data.status) + ")" : " done");
+         break;
+      case FlightRecordType::recovered:
+         std::cout << "recovered in " << data.value << " ms";
+         break;
+      default:
+         std::cout << "record of unknown type " << data.type;
+         break;
+      }
+      std::cout << " - PTP: " << format_ptp(content, data) << std::endl;
+   }
+
+   if (csv)
+      return 0;
+
+   std::cout << content.records.size() << " records of the " << (content.role.empty() ? "?" : content.role)
+             << " (ring of " << content.nb_records << ")";
+   if (!content.records.empty())
+      std::cout << " from " << format_time(content.records.front().data.time_ns) << " to "
+                << format_time(content.records.back().data.time_ns);
+   std::cout << " - sessions: " << nb_sessions << " - slots dropped: " << nb_dropped_slots
+             << " - slot timeouts: " << nb_slot_timeouts << " - recoveries: " << nb_recoveries;
+   if (nb_recoveries)
+      std::cout << " (mean time to recovery " << time_to_recovery_sum_ms / nb_recoveries << " ms)";
+   std::cout << " - overwritten: " << content.nb_overwritten
+             << " - torn: " << content.nb_torn << std::endl;
+   return 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "flight_recorder.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the record sequences must be lock-free to be read back from the file");
+
+namespace
+{
+   const uint64_t recorder_alignment = 4096;
+
+   uint64_t round_up(uint64_t value, uint64_t multiple)
+   {
+      return (value + multiple - 1) / multiple * multiple;
+   }
+
+   void copy_string(char* destination, size_t destination_size, const std::string& value)
+   {
+      const size_t size = std::min(value.size(), destination_size - 1);
+      std::memcpy(destination, value.data(), size);
+      destination[size] = '\0';
+   }
+}
+
+FlightRecorder::~FlightRecorder()
+{
+   close();
+}
+
+bool FlightRecorder::open(const std::string& path, uint32_t nb_records, const std::string& role)
+{
+   close();
+
+#if defined(_WIN32)
+   (void)path;
+   (void)nb_records;
+   (void)role;
+   std::cout << "The flight recorder is only available on POSIX systems" << std::endl;
+   return false;
+#else
+   if (!nb_records)
+   {
+      std::cout << "Invalid flight recorder: 0 records" << std::endl;
+      return false;
+   }
+
+   const uint64_t record_offset = round_up(sizeof(FlightRecorderHeader), recorder_alignment);
+   const uint64_t memory_size = record_offset + static_cast<uint64_t>(nb_records) * sizeof(FlightRecord);
+
+   const int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+   if (fd < 0)
+   {
+      std::cout << "Error opening the flight recorder " << path << ": " << std::strerror(errno) << std::endl;
+      return false;
+   }
+   struct stat status;
+   bool is_reused = fstat(fd, &status) == 0 && static_cast<uint64_t>(status.st_size) == memory_size;
+   if (!is_reused && (ftruncate(fd, 0) != 0 || ftruncate(fd, static_cast<off_t>(memory_size)) != 0))
+   {
+      std::cout << "Error sizing the flight recorder " << path << ": " << std::strerror(errno) << std::endl;
+      ::close(fd);
+      return false;
+   }
+
+   int flags = MAP_SHARED;
+#if defined(__linux__)
+   // The pages are faulted in now rather than by the first records
+   flags |= MAP_POPULATE;
+#endif
+   void* memory = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, flags, fd, 0);
+   ::close(fd);
+   if (memory == MAP_FAILED)
+   {
+      std::cout << "Error mapping the flight recorder " << path << ": " << std::strerror(errno) << std::endl;
+      return false;
+   }
+
+   m_memory = static_cast<uint8_t*>(memory);
+   m_memory_size = memory_size;
+   m_header = reinterpret_cast<FlightRecorderHeader*>(m_memory);
+   m_records = reinterpret_cast<FlightRecord*>(m_memory + record_offset);
+
+   // The records of a previous run are kept, e.g. the ones before a crash, if they have the same layout
+   is_reused = is_reused && m_header->magic.load(std::memory_order_acquire) == flight_recorder_magic &&
+               m_header->version == flight_recorder_version && m_header->record_size == sizeof(FlightRecord) &&
+               m_header->nb_records == nb_records && m_header->record_offset == record_offset;
+   if (!is_reused)
+   {
+      std::memset(m_memory, 0, memory_size);
+      m_header->version = flight_recorder_version;
+      m_header->record_size = sizeof(FlightRecord);
+      m_header->nb_records = nb_records;
+      m_header->record_offset = record_offset;
+      m_header->next_sequence.store(0, std::memory_order_relaxed);
+      m_header->magic.store(flight_recorder_magic, std::memory_order_release);
+   }
+   copy_string(m_header->role, sizeof(m_header->role), role);
+
+   uint32_t named_ptp_states = 0;
+   for (uint32_t state = 0; state < flight_recorder_max_ptp_states; state++)
+   {
+      if (m_header->ptp_state_names[state][0])
+         named_ptp_states |= 1u << state;
+   }
+   m_named_ptp_states.store(named_ptp_states, std::memory_order_relaxed);
+
+   const uint64_t nb_previous_records = m_header->next_sequence.load(std::memory_order_relaxed);
+   std::cout << "Flight recorder " << path << ": " << nb_records << " records";
+   if (nb_previous_records)
+      std::cout << ", appending after the " << nb_previous_records << " records of the previous runs";
+   std::cout << std::endl;
+
+   record_event(FlightRecordType::session_start, static_cast<uint32_t>(getpid()));
+   return true;
+#endif
+}
+
+void FlightRecorder::set_ptp_source(const std::function<FlightPtpStatus()>& ptp_source,
+                                    const std::function<std::string(uint32_t)>& ptp_state_name)
+{
+   m_ptp_source = ptp_source;
+   m_ptp_state_name = ptp_state_name;
+}
+
+void FlightRecorder::record_stream_sample(const FlightStreamSample& sample)
+{
+   if (!m_header)
+      return;
+
+   FlightRecordData data = {};
+   data.type = static_cast<uint16_t>(FlightRecordType::stream_sample);
+   data.slots_count = sample.slots_count;
+   data.slots_dropped = sample.slots_dropped;
+   data.jitter_max = sample.jitter_max;
+   data.datagram_count = sample.datagram_count;
+   data.slot_timeouts = sample.slot_timeouts;
+   append(data);
+}
+
+void FlightRecorder::record_event(FlightRecordType type, uint32_t value, uint32_t address, uint16_t port,
+                                  uint32_t status)
+{
+   if (!m_header)
+      return;
+
+   FlightRecordData data = {};
+   data.type = static_cast<uint16_t>(type);
+   data.value = value;
+   data.address = address;
+   data.port = port;
+   data.status = status;
+   append(data);
+}
+
+void FlightRecorder::append(FlightRecordData& data)
+{
+   data.time_ns = static_cast<uint64_t>(
+       std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+           .count());
+
+   data.ptp_state = flight_recorder_no_ptp_state;
+   if (m_ptp_source)
+   {
+      const FlightPtpStatus ptp_status = m_ptp_source();
+      data.ptp_state = static_cast<uint8_t>(ptp_status.state);
+      data.ptp_locked = ptp_status.locked;
+      data.ptp_offset_ns = ptp_status.offset_ns;
+
+      // The name of a state is formatted and written once, by the thread that first meets it
+      const uint32_t state_bit = ptp_status.state < flight_recorder_max_ptp_states ? 1u << ptp_status.state : 0;
+      if (state_bit && m_ptp_state_name && !(m_named_ptp_states.load(std::memory_order_relaxed) & state_bit) &&
+          !(m_named_ptp_states.fetch_or(state_bit, std::memory_order_relaxed) & state_bit))
+         copy_string(m_header->ptp_state_names[ptp_status.state], sizeof(m_header->ptp_state_names[0]),
+                     m_ptp_state_name(ptp_status.state));
+   }
+
+   // The threads of the sample claim distinct records, the odd sequence marks a record being written
+   const uint64_t sequence = m_header->next_sequence.fetch_add(1, std::memory_order_relaxed);
+   FlightRecord& record = m_records[sequence % m_header->nb_records];
+   record.sequence.store(2 * sequence + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+   record.data = data;
+   record.sequence.store(2 * sequence + 2, std::memory_order_release);
+}
+
+void FlightRecorder::close()
+{
+#if !defined(_WIN32)
+   if (!m_header)
+      return;
+
+   // The pages reach the file without it, the write-back is only started earlier
+   msync(m_memory, m_memory_size, MS_ASYNC);
+   munmap(m_memory, m_memory_size);
+#endif
+   m_memory = nullptr;
+   m_memory_size = 0;
+   m_header = nullptr;
+   m_records = nullptr;
+}
+
+bool read_flight_recorder(const std::string& path, FlightRecorderContent& content)
+{
+   std::ifstream file(path, std::ios::binary);
+   if (!file)
+   {
+      std::cout << "Error opening the flight recorder " << path << std::endl;
+      return false;
+   }
+
+   alignas(FlightRecorderHeader) char header_buffer[sizeof(FlightRecorderHeader)];
+   const FlightRecorderHeader* header = reinterpret_cast<const FlightRecorderHeader*>(header_buffer);
+   if (!file.read(header_buffer, sizeof(header_buffer)) ||
+       header->magic.load(std::memory_order_relaxed) != flight_recorder_magic)
+   {
+      std::cout << path << " is not a flight recorder file" << std::endl;
+      return false;
+   }
+   if (header->version != flight_recorder_version || header->record_size != sizeof(FlightRecord) ||
+       !header->nb_records || header->record_offset < sizeof(FlightRecorderHeader))
+   {
+      std::cout << "Unsupported flight recorder " << path << ": version " << header->version << ", "
+                << header->record_size << "-byte records" << std::endl;
+      return false;
+   }
+
+   std::vector<FlightRecord> records(header->nb_records);
+   file.seekg(static_cast<std::streamoff>(header->record_offset));
+   if (!file.read(reinterpret_cast<char*>(records.data()),
+                  static_cast<std::streamsize>(records.size() * sizeof(FlightRecord))))
+   {
+      std::cout << "The flight recorder " << path << " is truncated" << std::endl;
+      return false;
+   }
+
+   content = {};
+   content.role.assign(header->role, strnlen(header->role, sizeof(header->role)));
+   content.nb_records = header->nb_records;
+   for (const auto& name : header->ptp_state_names)
+      content.ptp_state_names.emplace_back(name, strnlen(name, sizeof(name)));
+
+   const uint64_t next_sequence = header->next_sequence.load(std::memory_order_relaxed);
+   const uint64_t first_sequence = next_sequence > header->nb_records ? next_sequence - header->nb_records : 0;
+   content.nb_overwritten = first_sequence;
+   content.records.reserve(next_sequence - first_sequence);
+   for (uint64_t sequence = first_sequence; sequence < next_sequence; sequence++)
+   {
+      const FlightRecord& record = records[sequence % header->nb_records];
+      if (record.sequence.load(std::memory_order_relaxed) != 2 * sequence + 2)
+      {
+         content.nb_torn++;
+         continue;
+      }
+      content.records.push_back({sequence, record.data});
+   }
+   return true;
+}
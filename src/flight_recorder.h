@@ -0,0 +1,218 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file flight_recorder.h
+   @brief This file contains the flight recorder of the samples: a fixed-size ring of binary records kept in a
+   memory-mapped file, for the post-mortem analysis of a glitch.
+
+   @detail The stream monitoring thread appends a sample of the stream counters and of the PTP every 100 ms, and
+   the sample loops append the activations and deactivations of the stream and the PTP events. A record is written
+   with plain stores into the mapping, without a system call: the kernel writes the pages back to the file, so the
+   records survive a crash of the process (not of the host, for the pages it has not written back yet). A recorder
+   reopening the file of a previous run keeps its records and appends after them.
+
+   Every record is protected by a sequence number (odd while it is written, even once written): a record torn by a
+   crash is detected and skipped by the reader.
+
+   Layout: a FlightRecorderHeader, then nb_records FlightRecord from record_offset.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+inline constexpr uint32_t flight_recorder_magic = 0x52464C46 /*! "FLFR" */;
+inline constexpr uint32_t flight_recorder_version = 1;
+inline constexpr uint32_t flight_recorder_max_ptp_states = 16;
+inline constexpr uint8_t flight_recorder_no_ptp_state = 0xFF /*! ptp_state of the records of a sample without PTP */;
+
+enum class FlightRecordType : uint16_t
+{
+   session_start = 1 /*! A process opened the recorder, value is its process id */,
+   stream_sample = 2 /*! Sample of the stream counters and of the PTP */,
+   activation = 3 /*! The stream was started, address and port are its destination, value its video standard */,
+   deactivation = 4 /*! The stream was stopped, value is the FlightStopReason */,
+   ptp_configured = 5 /*! A PTP configuration was applied to the board, value is the PTP domain */,
+   ptp_locked = 6 /*! The PTP locked within threshold, value is the time to lock in milliseconds */,
+   stall_recovery = 7 /*! A stall recovery stage was run, value is the StreamRecoveryStage, status its result */,
+   recovered = 8 /*! A slot completed after a stall, value is the time to recovery in milliseconds */,
+};
+
+enum class FlightStopReason : uint32_t
+{
+   user = 1 /*! Stopped from the keyboard or the viewer */,
+   node_disabled = 2 /*! The NMOS connection was disabled */,
+   transport_changed = 3 /*! New transport parameters were activated */,
+   sdp_changed = 4 /*! A new SDP was activated */,
+   error = 5 /*! The sample loop failed */,
+};
+
+/*!
+   @brief Content of a record, the fields not relevant to its type are 0
+*/
+struct FlightRecordData
+{
+   uint64_t time_ns /*! Time of the record, nanoseconds since the UNIX epoch */;
+   uint16_t type /*! FlightRecordType of the record */;
+   uint8_t ptp_state /*! VHD_PTP_PORT_STATE, its name is kept in the header, or flight_recorder_no_ptp_state */;
+   uint8_t ptp_locked /*! PTP locked within threshold */;
+   uint32_t slot_timeouts /*! Slot lock timeouts since the stream started */;
+   int64_t ptp_offset_ns /*! Offset from the PTP master */;
+   uint32_t slots_count;
+   uint32_t slots_dropped;
+   uint32_t jitter_max;
+   uint32_t datagram_count;
+   uint32_t address /*! IPv4 address of an activation */;
+   uint16_t port /*! UDP port of an activation */;
+   uint16_t reserved;
+   uint32_t value /*! Depends on the type */;
+   uint32_t status /*! VHD_ERRORCODE of a stall recovery */;
+};
+
+struct FlightRecord
+{
+   std::atomic<uint64_t> sequence /*! 2 * record sequence + 1 while the record is written, + 2 once written */;
+   FlightRecordData data;
+};
+
+static_assert(sizeof(FlightRecord) == 64, "a record fills a cache line");
+
+struct FlightRecorderHeader
+{
+   std::atomic<uint32_t> magic /*! flight_recorder_magic, written last when the file is created */;
+   uint32_t version;
+   uint32_t record_size;
+   uint32_t nb_records;
+   uint64_t record_offset /*! Offset of the first record from the start of the file */;
+   char role[16] /*! Sample that writes the records, e.g. "receiver" */;
+   char ptp_state_names[flight_recorder_max_ptp_states][24] /*! Name of each PTP state met so far */;
+   alignas(64) std::atomic<uint64_t> next_sequence /*! Sequence of the next record */;
+};
+
+/*!
+   @brief Counters of the stream for a sample
+*/
+struct FlightStreamSample
+{
+   uint32_t slots_count = 0;
+   uint32_t slots_dropped = 0;
+   uint32_t jitter_max = 0;
+   uint32_t datagram_count = 0;
+   uint32_t slot_timeouts = 0;
+};
+
+/*!
+   @brief State of the PTP recorded with every record
+*/
+struct FlightPtpStatus
+{
+   uint32_t state = 0 /*! VHD_PTP_PORT_STATE */;
+   bool locked = false;
+   int64_t offset_ns = 0;
+};
+
+/*!
+   @brief Writer of the records, shared by the threads of a sample
+*/
+class FlightRecorder
+{
+public:
+   FlightRecorder() = default;
+   ~FlightRecorder();
+
+   FlightRecorder(const FlightRecorder&) = delete;
+   FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+   /*!
+      @brief Map the recorder file, keeping the records of a previous run if its layout is the same
+
+      @returns true if the recorder is open
+   */
+   bool open(const std::string& path /*!< [in] Recorder file*/,
+             uint32_t nb_records /*!< [in] Records kept in the ring*/,
+             const std::string& role /*!< [in] Sample that writes the records, e.g. "receiver"*/);
+
+   bool is_open() const { return m_header != nullptr; }
+
+   /*!
+      @brief Set the functions the records read the PTP state from, before any record is appended
+
+      @detail Without them, the records have no PTP state. ptp_source is called for every record and must not block,
+      ptp_state_name only the first time a state is met, to keep its name in the header.
+   */
+   void set_ptp_source(const std::function<FlightPtpStatus()>& ptp_source /*!< [in] Current PTP state*/,
+                       const std::function<std::string(uint32_t)>& ptp_state_name /*!< [in] Name of a PTP state*/);
+
+   /*!
+      @brief Append a sample of the stream counters and of the PTP
+   */
+   void record_stream_sample(const FlightStreamSample& sample /*!< [in] Counters of the stream*/);
+
+   /*!
+      @brief Append an event of the stream or of the PTP
+   */
+   void record_event(FlightRecordType type /*!< [in] Type of the event*/,
+                     uint32_t value = 0 /*!< [in] Value of the event, depends on the type*/,
+                     uint32_t address = 0 /*!< [in] IPv4 address of an activation*/,
+                     uint16_t port = 0 /*!< [in] UDP port of an activation*/,
+                     uint32_t status = 0 /*!< [in] VHD_ERRORCODE of a stall recovery*/);
+
+private:
+   void append(FlightRecordData& data);
+   void close();
+
+   uint8_t* m_memory = nullptr;
+   uint64_t m_memory_size = 0;
+   FlightRecorderHeader* m_header = nullptr;
+   FlightRecord* m_records = nullptr;
+   std::function<FlightPtpStatus()> m_ptp_source;
+   std::function<std::string(uint32_t)> m_ptp_state_name;
+   std::atomic<uint32_t> m_named_ptp_states{0} /*! Bit mask of the PTP states whose name is in the header */;
+};
+
+/*!
+   @brief Record read back from a recorder file
+*/
+struct FlightRecordEntry
+{
+   uint64_t sequence = 0;
+   FlightRecordData data = {};
+};
+
+struct FlightRecorderContent
+{
+   std::string role;
+   uint32_t nb_records = 0 /*! Capacity of the ring */;
+   std::vector<std::string> ptp_state_names;
+   std::vector<FlightRecordEntry> records /*! Records still in the ring, oldest first */;
+   uint64_t nb_overwritten = 0 /*! Records overwritten by newer ones */;
+   uint64_t nb_torn = 0 /*! Records left half-written, by a crash of the writer or a write in progress */;
+};
+
+/*!
+   @brief Read the records of a recorder file, e.g. after a crash of the sample that wrote it
+
+   @returns false if the file is not a recorder file
+*/
+bool read_flight_recorder(const std::string& path /*!< [in] Recorder file*/,
+                          FlightRecorderContent& content /*!< [out] Records of the file*/);
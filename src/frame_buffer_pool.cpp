@@ -0,0 +1,236 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "frame_buffer_pool.h"
+#include "numa.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+   const size_t huge_page_size = 2 * 1024 * 1024;
+
+   size_t round_up(size_t value, size_t multiple)
+   {
+      return (value + multiple - 1) / multiple * multiple;
+   }
+}
+
+const char* to_string(FrameBufferPageType page_type)
+{
+   switch (page_type)
+   {
+   case FrameBufferPageType::huge_pages: return "2 MiB huge pages";
+   case FrameBufferPageType::transparent_huge_pages: return "transparent huge pages";
+   case FrameBufferPageType::regular_pages: return "regular pages";
+   default: return "unknown";
+   }
+}
+
+FrameBuffer::~FrameBuffer()
+{
+   release();
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) noexcept
+    : m_pool(other.m_pool), m_index(other.m_index), m_data(other.m_data), m_size(other.m_size)
+{
+   other.m_pool = nullptr;
+   other.m_data = nullptr;
+   other.m_size = 0;
+}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) noexcept
+{
+   if (this != &other)
+   {
+      release();
+      m_pool = other.m_pool;
+      m_index = other.m_index;
+      m_data = other.m_data;
+      m_size = other.m_size;
+      other.m_pool = nullptr;
+      other.m_data = nullptr;
+      other.m_size = 0;
+   }
+   return *this;
+}
+
+void FrameBuffer::release()
+{
+   if (m_pool)
+      m_pool->release(m_index);
+   m_pool = nullptr;
+   m_data = nullptr;
+   m_size = 0;
+}
+
+FrameBufferPool::~FrameBufferPool()
+{
+   free_region();
+}
+
+bool FrameBufferPool::allocate(const FrameBufferPoolConfig& config)
+{
+   std::lock_guard lock(m_mutex);
+   if (m_statistics.nb_in_use)
+   {
+      std::cout << "Error when allocating the frame buffer pool: " << m_statistics.nb_in_use << " buffers in use"
+                << std::endl;
+      return false;
+   }
+   free_region();
+   m_statistics = {};
+   if (!config.buffer_size || !config.nb_buffers)
+      return false;
+
+   m_stride = round_up(config.buffer_size, alignment);
+   m_region_size = round_up(m_stride * config.nb_buffers, huge_page_size);
+   FrameBufferPageType page_type = FrameBufferPageType::regular_pages;
+
+#if defined(__linux__)
+   void* region = MAP_FAILED;
+   if (config.use_huge_pages)
+   {
+      int huge_page_flags = MAP_HUGETLB;
+#if defined(MAP_HUGE_2MB)
+      huge_page_flags |= MAP_HUGE_2MB;
+#endif
+      region = mmap(nullptr, m_region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | huge_page_flags,
+                    -1, 0);
+      if (region != MAP_FAILED)
+         page_type = FrameBufferPageType::huge_pages;
+   }
+   if (region == MAP_FAILED)
+   {
+      // No huge page reserved: map one huge page more than needed to align the region on a huge page boundary,
+      // which transparent huge pages require
+      void* mapping = mmap(nullptr, m_region_size + huge_page_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (mapping == MAP_FAILED)
+      {
+         std::cout << "Error when allocating a " << m_region_size << " bytes frame buffer pool" << std::endl;
+         m_region_size = 0;
+         return false;
+      }
+      uint8_t* aligned = reinterpret_cast<uint8_t*>(
+          round_up(reinterpret_cast<uintptr_t>(mapping), huge_page_size));
+      const size_t head = aligned - static_cast<uint8_t*>(mapping);
+      if (head)
+         munmap(mapping, head);
+      munmap(aligned + m_region_size, huge_page_size - head);
+      region = aligned;
+
+      if (config.use_huge_pages && madvise(region, m_region_size, MADV_HUGEPAGE) == 0)
+         page_type = FrameBufferPageType::transparent_huge_pages;
+   }
+   m_region = static_cast<uint8_t*>(region);
+
+   m_statistics.numa_node = config.numa_node;
+   if (config.numa_node >= 0 && !bind_memory_to_numa_node(m_region, m_region_size, config.numa_node))
+      m_statistics.numa_node = -1;
+
+   if (config.lock_memory)
+   {
+      m_statistics.is_locked = mlock(m_region, m_region_size) == 0;
+      if (!m_statistics.is_locked)
+         std::cout << "Could not lock the frame buffer pool in memory (RLIMIT_MEMLOCK)" << std::endl;
+   }
+#else
+   m_region = static_cast<uint8_t*>(::operator new(m_region_size, std::align_val_t(alignment)));
+#endif
+
+   // Fault the pages in now so that the first frame does not pay for it
+   std::memset(m_region, 0, m_region_size);
+
+   m_free_buffers.clear();
+   m_free_buffers.reserve(config.nb_buffers);
+   for (uint32_t index = config.nb_buffers; index > 0; index--)
+      m_free_buffers.push_back(index - 1);
+
+   m_statistics.page_type = page_type;
+   m_statistics.nb_buffers = config.nb_buffers;
+   m_statistics.buffer_size = config.buffer_size;
+   m_statistics.region_size = m_region_size;
+   return true;
+}
+
+FrameBuffer FrameBufferPool::acquire()
+{
+   std::lock_guard lock(m_mutex);
+   if (m_free_buffers.empty())
+   {
+      m_statistics.nb_exhaustions++;
+      return FrameBuffer();
+   }
+
+   const uint32_t index = m_free_buffers.back();
+   m_free_buffers.pop_back();
+   m_statistics.nb_acquisitions++;
+   m_statistics.nb_in_use++;
+   if (m_statistics.nb_in_use > m_statistics.max_in_use)
+      m_statistics.max_in_use = m_statistics.nb_in_use;
+   return FrameBuffer(this, index, m_region + index * m_stride, m_statistics.buffer_size);
+}
+
+void FrameBufferPool::release(uint32_t index)
+{
+   std::lock_guard lock(m_mutex);
+   m_free_buffers.push_back(index);
+   m_statistics.nb_in_use--;
+}
+
+FrameBufferPoolStatistics FrameBufferPool::get_statistics() const
+{
+   std::lock_guard lock(m_mutex);
+   return m_statistics;
+}
+
+void FrameBufferPool::print_statistics() const
+{
+   const FrameBufferPoolStatistics statistics = get_statistics();
+   if (!statistics.nb_buffers)
+      return;
+
+   std::cout << "Frame buffer pool: " << statistics.nb_buffers << " x " << statistics.buffer_size << " bytes on "
+             << to_string(statistics.page_type) << (statistics.is_locked ? " (locked)" : "");
+   if (statistics.numa_node >= 0)
+      std::cout << ", NUMA node " << statistics.numa_node;
+   std::cout << " - in use: " << statistics.nb_in_use << " (max " << statistics.max_in_use << ")"
+             << " - acquisitions: " << statistics.nb_acquisitions
+             << " - exhaustions: " << statistics.nb_exhaustions << std::endl;
+}
+
+void FrameBufferPool::free_region()
+{
+   if (!m_region)
+      return;
+#if defined(__linux__)
+   if (m_statistics.is_locked)
+      munlock(m_region, m_region_size);
+   munmap(m_region, m_region_size);
+#else
+   ::operator delete(m_region, std::align_val_t(alignment));
+#endif
+   m_region = nullptr;
+   m_region_size = 0;
+   m_free_buffers.clear();
+}
@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file frame_buffer_pool.h
+   @brief This file contains the pool of the frame buffers of the sample loops, allocated from huge pages.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/*!
+   @brief Kind of pages backing a frame buffer pool
+*/
+enum class FrameBufferPageType
+{
+   huge_pages /*! Explicit 2 MiB huge pages (hugetlbfs) */,
+   transparent_huge_pages /*! Regular pages, 2 MiB aligned and advised for transparent huge pages */,
+   regular_pages /*! Regular pages */
+};
+
+const char* to_string(FrameBufferPageType page_type);
+
+struct FrameBufferPoolConfig
+{
+   size_t buffer_size /*! Size of a buffer in bytes */ = 0;
+   uint32_t nb_buffers /*! Number of buffers of the pool */ = 0;
+   int numa_node /*! NUMA node of the buffers, -1 for any */ = -1;
+   bool use_huge_pages /*! Try the explicit huge pages first */ = true;
+   bool lock_memory /*! Lock the buffers in memory (mlock) */ = false;
+};
+
+struct FrameBufferPoolStatistics
+{
+   FrameBufferPageType page_type = FrameBufferPageType::regular_pages;
+   bool is_locked = false;
+   int numa_node = -1;
+   uint32_t nb_buffers = 0;
+   size_t buffer_size = 0;
+   size_t region_size = 0;
+   uint32_t nb_in_use = 0;
+   uint32_t max_in_use = 0;
+   uint64_t nb_acquisitions = 0;
+   uint64_t nb_exhaustions /*! Acquisitions that failed because every buffer was in use */ = 0;
+};
+
+class FrameBufferPool;
+
+/*!
+   @brief Buffer acquired from a FrameBufferPool, given back to the pool on destruction
+*/
+class FrameBuffer
+{
+public:
+   FrameBuffer() = default;
+   ~FrameBuffer();
+
+   FrameBuffer(const FrameBuffer&) = delete;
+   FrameBuffer& operator=(const FrameBuffer&) = delete;
+   FrameBuffer(FrameBuffer&& other) noexcept;
+   FrameBuffer& operator=(FrameBuffer&& other) noexcept;
+
+   uint8_t* data() const { return m_data; }
+   size_t size() const { return m_size; }
+   explicit operator bool() const { return m_data != nullptr; }
+
+private:
+   friend class FrameBufferPool;
+   FrameBuffer(FrameBufferPool* pool, uint32_t index, uint8_t* data, size_t size)
+       : m_pool(pool), m_index(index), m_data(data), m_size(size)
+   {
+   }
+
+   void release();
+
+   FrameBufferPool* m_pool = nullptr;
+   uint32_t m_index = 0;
+   uint8_t* m_data = nullptr;
+   size_t m_size = 0;
+};
+
+/*!
+   @brief Fixed set of 64-byte aligned frame buffers carved from one region of huge pages
+
+   @detail The region is allocated once, from explicit 2 MiB huge pages when available, falling back to regular
+   pages advised for transparent huge pages, then to regular pages. It is bound to the NUMA node of the pool,
+   optionally locked in memory, and faulted in at allocation. Acquiring and releasing a buffer does not allocate.
+   The pool must outlive the buffers acquired from it.
+*/
+class FrameBufferPool
+{
+public:
+   static constexpr size_t alignment = 64;
+
+   FrameBufferPool() = default;
+   ~FrameBufferPool();
+
+   FrameBufferPool(const FrameBufferPool&) = delete;
+   FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+   /*!
+      @brief Allocate the buffers of the pool, releasing the previous ones
+
+      @returns True if the buffers have been allocated
+   */
+   bool allocate(const FrameBufferPoolConfig& config /*!< [in] Size, number and placement of the buffers*/);
+
+   /*!
+      @brief Take a buffer of the pool
+
+      @returns The buffer, empty if every buffer is in use
+   */
+   FrameBuffer acquire();
+
+   FrameBufferPoolStatistics get_statistics() const;
+   void print_statistics() const;
+
+private:
+   friend class FrameBuffer;
+   void release(uint32_t index);
+   void free_region();
+
+   uint8_t* m_region = nullptr;
+   size_t m_region_size = 0;
+   size_t m_stride = 0;
+   std::vector<uint32_t> m_free_buffers;
+
+   mutable std::mutex m_mutex;
+   FrameBufferPoolStatistics m_statistics;
+};
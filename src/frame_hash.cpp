@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+
+#include "frame_hash.h"
+
+namespace
+{
+   const uint64_t prime_1 = 0x9e3779b185ebca87ull;
+   const uint64_t prime_2 = 0xc2b2ae3d27d4eb4full;
+   const uint64_t prime_3 = 0x165667b19e3779f9ull;
+
+   inline uint64_t rotate_left(uint64_t value, int bits)
+   {
+      return (value << bits) | (value >> (64 - bits));
+   }
+
+   inline uint64_t read_u64(const uint8_t* source)
+   {
+      uint64_t value;
+      std::memcpy(&value, source, sizeof(value));
+      return value;
+   }
+
+   inline uint64_t round(uint64_t lane, uint64_t word)
+   {
+      return rotate_left(lane + word * prime_2, 31) * prime_1;
+   }
+}
+
+uint64_t hash_frame(const uint8_t* buffer, uint64_t size)
+{
+   uint64_t lanes[4] = {prime_1 + prime_2, prime_2, 0, 0 - prime_1};
+   const uint8_t* end = buffer + size;
+
+   for (; end - buffer >= 32; buffer += 32)
+   {
+      lanes[0] = round(lanes[0], read_u64(buffer));
+      lanes[1] = round(lanes[1], read_u64(buffer + 8));
+      lanes[2] = round(lanes[2], read_u64(buffer + 16));
+      lanes[3] = round(lanes[3], read_u64(buffer + 24));
+   }
+
+   uint64_t hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) +
+                   rotate_left(lanes[3], 18) + size;
+   for (; end - buffer >= 8; buffer += 8)
+      hash = rotate_left(hash ^ round(0, read_u64(buffer)), 27) * prime_1 + prime_3;
+   for (; buffer < end; buffer++)
+      hash = rotate_left(hash ^ (*buffer * prime_3), 11) * prime_1;
+
+   hash ^= hash >> 33;
+   hash *= prime_2;
+   hash ^= hash >> 29;
+   hash *= prime_3;
+   hash ^= hash >> 32;
+   return hash;
+}
@@ -0,0 +1,35 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file frame_hash.h
+   @brief This file contains the hash used to compare frames, e.g. a frame sent and the same frame received.
+
+   @detail The hash reads the frame as 64-bit words on four independent lanes, so that it runs at memory bandwidth.
+   It is not a cryptographic hash.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+/*!
+   @brief Hash a frame buffer
+
+   @returns The 64-bit hash of the buffer
+*/
+uint64_t hash_frame(const uint8_t* buffer /*!< [in] Frame buffer*/, uint64_t size /*!< [in] Size in bytes*/);
@@ -0,0 +1,210 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file ipv4.h
+   @brief This file contains allocation-free IPv4 address and endpoint value types.
+
+   @detail Parsing and formatting are constexpr and work on fixed-size character buffers, so they can be used in
+   the IS-05 callbacks without going through the heap or the iostreams.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+/*!
+   @brief IPv4 address, stored as the 32-bit value handled by the VideoMaster API (0xc0a80002 is 192.168.0.2)
+*/
+class Ipv4Address
+{
+public:
+   static constexpr size_t max_string_size = 15; /*! "255.255.255.255" */
+
+   constexpr Ipv4Address() = default;
+   constexpr explicit Ipv4Address(uint32_t value) : m_value(value) {}
+
+   constexpr uint32_t value() const { return m_value; }
+   constexpr bool is_unspecified() const { return m_value == 0; }
+   constexpr bool is_multicast() const { return (m_value & 0xF0000000) == 0xE0000000; }
+
+   constexpr bool operator==(const Ipv4Address& other) const { return m_value == other.m_value; }
+   constexpr bool operator!=(const Ipv4Address& other) const { return m_value != other.m_value; }
+
+   /*!
+      @brief Parse a dotted-decimal address "a.b.c.d"
+
+      @returns False if the text is not exactly four decimal octets separated by dots, in which case address is
+      left unchanged
+   */
+   static constexpr bool parse(std::string_view text, Ipv4Address& address)
+   {
+      uint32_t value = 0;
+      size_t position = 0;
+      for (int octet_index = 0; octet_index < 4; octet_index++)
+      {
+         if (octet_index > 0)
+         {
+            if (position >= text.size() || text[position] != '.')
+               return false;
+            position++;
+         }
+
+         uint32_t octet = 0;
+         size_t nb_digits = 0;
+         while (position < text.size() && text[position] >= '0' && text[position] <= '9' && nb_digits < 3)
+         {
+            octet = octet * 10 + static_cast<uint32_t>(text[position] - '0');
+            position++;
+            nb_digits++;
+         }
+         if (nb_digits == 0 || octet > 255)
+            return false;
+         value = (value << 8) | octet;
+      }
+
+      if (position != text.size())
+         return false;
+
+      address = Ipv4Address(value);
+      return true;
+   }
+
+   /*!
+      @brief Format the address as "a.b.c.d" into buffer, which must hold at least max_string_size characters
+
+      @returns The number of characters written, the buffer is not null-terminated
+   */
+   constexpr size_t format(char* buffer) const
+   {
+      size_t length = 0;
+      for (int shift = 24; shift >= 0; shift -= 8)
+      {
+         const uint32_t octet = (m_value >> shift) & 0xFF;
+         if (octet >= 100)
+            buffer[length++] = static_cast<char>('0' + octet / 100);
+         if (octet >= 10)
+            buffer[length++] = static_cast<char>('0' + (octet / 10) % 10);
+         buffer[length++] = static_cast<char>('0' + octet % 10);
+         if (shift > 0)
+            buffer[length++] = '.';
+      }
+      return length;
+   }
+
+private:
+   uint32_t m_value = 0;
+};
+
+/*!
+   @brief IPv4 address and UDP port
+*/
+struct Ipv4Endpoint
+{
+   static constexpr size_t max_string_size = Ipv4Address::max_string_size + 6; /*! "255.255.255.255:65535" */
+
+   Ipv4Address address;
+   uint16_t port = 0;
+
+   constexpr bool operator==(const Ipv4Endpoint& other) const
+   {
+      return address == other.address && port == other.port;
+   }
+   constexpr bool operator!=(const Ipv4Endpoint& other) const { return !(*this == other); }
+
+   /*!
+      @brief Parse an endpoint "a.b.c.d:port"
+
+      @returns False if the text is not a valid endpoint, in which case endpoint is left unchanged
+   */
+   static constexpr bool parse(std::string_view text, Ipv4Endpoint& endpoint)
+   {
+      const size_t colon = text.rfind(':');
+      if (colon == std::string_view::npos || colon + 1 == text.size() || text.size() - colon - 1 > 5)
+         return false;
+
+      Ipv4Address address;
+      if (!Ipv4Address::parse(text.substr(0, colon), address))
+         return false;
+
+      uint32_t port = 0;
+      for (size_t position = colon + 1; position < text.size(); position++)
+      {
+         if (text[position] < '0' || text[position] > '9')
+            return false;
+         port = port * 10 + static_cast<uint32_t>(text[position] - '0');
+      }
+      if (port > 0xFFFF)
+         return false;
+
+      endpoint.address = address;
+      endpoint.port = static_cast<uint16_t>(port);
+      return true;
+   }
+
+   /*!
+      @brief Format the endpoint as "a.b.c.d:port" into buffer, which must hold at least max_string_size characters
+
+      @returns The number of characters written, the buffer is not null-terminated
+   */
+   constexpr size_t format(char* buffer) const
+   {
+      size_t length = address.format(buffer);
+      buffer[length++] = ':';
+
+      char digits[5] = {};
+      size_t nb_digits = 0;
+      uint32_t value = port;
+      do
+      {
+         digits[nb_digits++] = static_cast<char>('0' + value % 10);
+         value /= 10;
+      } while (value != 0);
+      while (nb_digits > 0)
+         buffer[length++] = digits[--nb_digits];
+      return length;
+   }
+};
+
+/*!
+   @brief Null-terminated textual form of an address or an endpoint, held in a fixed-size buffer
+*/
+template <typename T>
+struct Ipv4String
+{
+   std::array<char, T::max_string_size + 1> buffer{};
+   size_t length = 0;
+
+   constexpr explicit Ipv4String(const T& value) : length(value.format(buffer.data())) { buffer[length] = '\0'; }
+
+   constexpr const char* c_str() const { return buffer.data(); }
+   constexpr std::string_view view() const { return std::string_view(buffer.data(), length); }
+};
+
+template <typename T>
+constexpr Ipv4String<T> to_chars(const T& value)
+{
+   return Ipv4String<T>(value);
+}
+
+static_assert(to_chars(Ipv4Address(0xc0a80002)).view() == "192.168.0.2");
+static_assert(to_chars(Ipv4Endpoint{Ipv4Address(0xef0a0a01), 1025}).view() == "239.10.10.1:1025");
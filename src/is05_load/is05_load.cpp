@@ -0,0 +1,424 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nmos/model.h"
+#include "nmos/log_model.h"
+#include "nmos/log_gate.h"
+#include "nmos/node_server.h"
+#include "nmos/settings.h"
+#include "cpprest/http_client.h"
+
+#include "../tools.h"
+#include "../async_log_gate.h"
+#include "../board_backend.h"
+#include "../latency_recorder.h"
+#include "../nmos_tools.h"
+#include "../numa.h"
+#include "../simulated_board.h"
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Core.h"
+#include "VideoMasterHD/VideoMasterHD_Ip_ST2110_Board.h"
+#include "VideoMasterHD/VideoMasterHD_Ip_ST2110_20.h"
+#else
+#include "VideoMasterHD_Core.h"
+#include "VideoMasterHD_Ip_ST2110_Board.h"
+#include "VideoMasterHD_Ip_ST2110_20.h"
+#endif
+
+namespace
+{
+   using clock = std::chrono::steady_clock;
+
+   struct LoadConfig
+   {
+      uint32_t nb_patches = 1000 /*! PATCH requests sent to each node */;
+      uint32_t concurrency = 4 /*! Clients sending the PATCH requests in parallel */;
+      uint32_t activation_every = 10 /*! One PATCH out of activation_every activates immediately, 0 for none */;
+      int base_port = 3300 /*! Ports of the sender node, the receiver node uses the ones 10 above */;
+      int logging_level = slog::severities::warning /*! Logging level of both nodes */;
+      uint32_t log_queue_capacity = 4096 /*! Log records waiting for the background writer, 0 for synchronous */;
+   };
+
+   struct StormResult
+   {
+      LatencyRecorder client_latencies /*! End-to-end latency of the PATCH requests, as seen by the clients */;
+      LatencyRecorder callback_latencies /*! Latency of the node callbacks and of their parts */;
+      std::map<int, uint64_t> status_codes /*! Number of responses per HTTP status code, 0 for no response */;
+      std::mutex status_codes_mutex;
+      double duration_s = 0.0;
+      nmos_tools::RegistrationStatistics registration /*! Insertion of the node resources, before the storm */;
+   };
+
+   void configure_node_settings(nmos::node_model& node_model, const utility::string_t& seed_id,
+                                const std::string& label, int http_port, int logging_level)
+   {
+      web::json::value host_addresses = web::json::value::array();
+      host_addresses[0] = web::json::value::string(U("127.0.0.1"));
+      node_model.settings[nmos::fields::host_addresses] = host_addresses;
+      nmos::insert_node_default_settings(node_model.settings);
+      node_model.settings[nmos::experimental::fields::seed_id] = web::json::value::string(seed_id);
+      node_model.settings[nmos::fields::label] = web::json::value::string(utility::conversions::to_string_t(label));
+
+      // every HTTP API of a node shares one port and every WebSocket API the next one, so that both nodes run side by
+      // side; the settings unknown to the nmos-cpp version in use are ignored
+      for (const utility::char_t* port_field : {U("node_port"), U("connection_port"), U("events_port"),
+                                                U("channelmapping_port"), U("settings_port"), U("logging_port"),
+                                                U("admin_port"), U("schemas_port"), U("manifest_port"),
+                                                U("configuration_port")})
+         node_model.settings[port_field] = web::json::value::number(http_port);
+      for (const utility::char_t* port_field : {U("events_ws_port"), U("control_protocol_ws_port")})
+         node_model.settings[port_field] = web::json::value::number(http_port + 1);
+
+      node_model.settings[nmos::fields::logging_level] = logging_level;
+   }
+
+   nmos::id find_connection_resource_id(nmos::node_model& node_model, const nmos::type& type)
+   {
+      auto lock = node_model.read_lock();
+      for (const auto& resource : node_model.connection_resources)
+      {
+         if (resource.type == type)
+            return resource.id;
+      }
+      return {};
+   }
+
+   bool wait_until_listening(const utility::string_t& base_url, const utility::string_t& path,
+                             std::chrono::milliseconds timeout)
+   {
+      web::http::client::http_client client(base_url);
+      const auto deadline = clock::now() + timeout;
+      while (clock::now() < deadline)
+      {
+         try
+         {
+            if (client.request(web::http::methods::GET, path).get().status_code() == web::http::status_codes::OK)
+               return true;
+         }
+         catch (const web::http::http_exception&)
+         {
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+      return false;
+   }
+
+   web::json::value make_activation(bool activate)
+   {
+      web::json::value activation = web::json::value::object();
+      activation[U("mode")] = activate ? web::json::value::string(U("activate_immediate")) : web::json::value::null();
+      return activation;
+   }
+
+   // every PATCH moves the flow to another multicast group, so that no activation is a no-op
+   Ipv4Endpoint get_patch_destination(uint32_t index)
+   {
+      return {Ipv4Address(0xef640000 | (index & 0xffff)), static_cast<uint16_t>(20000 + index % 1000 * 2)};
+   }
+
+   web::json::value make_sender_patch(uint32_t index, bool activate)
+   {
+      const Ipv4Endpoint destination = get_patch_destination(index);
+      web::json::value transport_params = web::json::value::object();
+      transport_params[U("destination_ip")] = web::json::value::string(nmos_tools::ipv4_to_string(destination.address));
+      transport_params[U("destination_port")] = web::json::value::number(destination.port);
+
+      web::json::value patch = web::json::value::object();
+      patch[U("master_enable")] = web::json::value::boolean(true);
+      patch[U("transport_params")] = web::json::value::array({transport_params});
+      patch[U("activation")] = make_activation(activate);
+      return patch;
+   }
+
+   web::json::value make_receiver_patch(uint32_t index, bool activate, const std::string& sdp)
+   {
+      const Ipv4Endpoint destination = get_patch_destination(index);
+      web::json::value transport_params = web::json::value::object();
+      transport_params[U("multicast_ip")] = web::json::value::string(nmos_tools::ipv4_to_string(destination.address));
+      transport_params[U("destination_port")] = web::json::value::number(destination.port);
+      transport_params[U("interface_ip")] = web::json::value::string(U("auto"));
+
+      web::json::value transport_file = web::json::value::object();
+      transport_file[U("data")] = web::json::value::string(utility::conversions::to_string_t(sdp));
+      transport_file[U("type")] = web::json::value::string(U("application/sdp"));
+
+      web::json::value patch = web::json::value::object();
+      patch[U("master_enable")] = web::json::value::boolean(true);
+      patch[U("transport_file")] = transport_file;
+      patch[U("transport_params")] = web::json::value::array({transport_params});
+      patch[U("activation")] = make_activation(activate);
+      return patch;
+   }
+
+   /*!
+      @brief Send the PATCH requests of a storm to the staged endpoint of a connection resource
+
+      @detail While the storm runs, a probe measures how long a reader waits for the node model lock.
+   */
+   void run_storm(const LoadConfig& config, nmos::node_model& node_model, const utility::string_t& base_url,
+                  const utility::string_t& staged_path,
+                  const std::function<web::json::value(uint32_t index, bool activate)>& make_patch,
+                  StormResult& result)
+   {
+      std::atomic<bool> storm_done(false);
+      std::thread lock_probe([&] {
+         while (!storm_done)
+         {
+            const auto begin = clock::now();
+            {
+               auto lock = node_model.read_lock();
+            }
+            result.callback_latencies.record("model_read_lock_wait", clock::now() - begin);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+      });
+
+      std::atomic<uint32_t> next_patch(0);
+      std::vector<std::thread> clients;
+      const auto begin = clock::now();
+      for (uint32_t i = 0; i < config.concurrency; i++)
+      {
+         clients.emplace_back([&] {
+            web::http::client::http_client client(base_url);
+            for (uint32_t index = next_patch++; index < config.nb_patches; index = next_patch++)
+            {
+               const bool activate = config.activation_every && (index + 1) % config.activation_every == 0;
+               const web::json::value patch = make_patch(index, activate);
+
+               const auto request_begin = clock::now();
+               int status_code = 0;
+               try
+               {
+                  web::http::http_response response =
+                      client.request(web::http::methods::PATCH, staged_path, patch).get();
+                  response.content_ready().wait();
+                  status_code = response.status_code();
+               }
+               catch (const web::http::http_exception&)
+               {
+               }
+               result.client_latencies.record(activate ? "activation_patch" : "stage_patch",
+                                              clock::now() - request_begin);
+
+               std::lock_guard lock(result.status_codes_mutex);
+               result.status_codes[status_code]++;
+            }
+         });
+      }
+      for (auto& client : clients)
+         client.join();
+      result.duration_s = std::chrono::duration<double>(clock::now() - begin).count();
+
+      storm_done = true;
+      lock_probe.join();
+   }
+
+   void write_storm_json(std::ostream& output, const std::string& name, const StormResult& result, bool last)
+   {
+      output << "  \"" << name << "\": {\n";
+      output << "    \"duration_s\": " << result.duration_s << ",\n";
+      output << "    \"registration\": {\"resources\": " << result.registration.nb_resources
+             << ", \"batches\": " << result.registration.nb_batches
+             << ", \"notifications\": " << result.registration.nb_notifications
+             << ", \"insertion_ms\": " << result.registration.insertion_ms << "},\n";
+      output << "    \"status_codes\": {";
+      for (auto status_code = result.status_codes.begin(); status_code != result.status_codes.end(); ++status_code)
+         output << (status_code == result.status_codes.begin() ? "" : ", ") << "\"" << status_code->first
+                << "\": " << status_code->second;
+      output << "},\n";
+      output << "    \"client\": ";
+      result.client_latencies.write_json(output, "      ");
+      output << ",\n";
+      output << "    \"callbacks\": ";
+      result.callback_latencies.write_json(output, "      ");
+      output << "\n  }" << (last ? "\n" : ",\n");
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   LoadConfig config;
+   std::string output_path;
+
+   for (int i = 1; i < argc; i++)
+   {
+      const std::string argument = argv[i];
+      if (argument == "--patches" && i + 1 < argc)
+         config.nb_patches = std::stoul(argv[++i]);
+      else if (argument == "--concurrency" && i + 1 < argc)
+         config.concurrency = std::max(1ul, std::stoul(argv[++i]));
+      else if (argument == "--activation-every" && i + 1 < argc)
+         config.activation_every = std::stoul(argv[++i]);
+      else if (argument == "--base-port" && i + 1 < argc)
+         config.base_port = std::stoi(argv[++i]);
+      else if (argument == "--logging-level" && i + 1 < argc)
+         config.logging_level = std::stoi(argv[++i]);
+      else if (argument == "--log-queue" && i + 1 < argc)
+         config.log_queue_capacity = std::stoul(argv[++i]);
+      else if (argument == "--output" && i + 1 < argc)
+         output_path = argv[++i];
+      else
+      {
+         std::cout << "Usage: " << argv[0] << " [--patches <n>] [--concurrency <n>] [--activation-every <n>]"
+                   << " [--base-port <port>] [--logging-level <level>] [--log-queue <n>] [--output <file.json>]"
+                   << std::endl;
+         return -1;
+      }
+   }
+
+   // The stream calls of the sender node are served by a simulated board, no DELTACAST IP Card is needed
+   const auto video_standard = VHD_ST2110_20_VIDEOSTD_1920x1080p60;
+   const Ipv4Endpoint destination = {Ipv4Address(0xe0000001), 1025};
+   const uint32_t destination_ssrc = 0x12345600;
+   select_board_backend(std::make_unique<SimulatedBoardBackend>());
+
+   std::vector<BoardContext> boards;
+   HANDLE board = nullptr, stream = nullptr;
+   std::string media_nic_mac_address, sdp;
+   VHD_ERRORCODE result = open_all_boards(boards, 0);
+   if (result == VHDERR_NOERROR)
+   {
+      board = boards[0].handle;
+      result = configure_nic(board, 0x7f000001, 0xff000000, 0x00000000, false);
+   }
+   if (result == VHDERR_NOERROR)
+      result = get_nic_mac_address(board, media_nic_mac_address);
+   if (result == VHDERR_NOERROR)
+      result = configure_stream(board, stream, VHD_ST_TX0, video_standard, destination, destination_ssrc);
+   if (result == VHDERR_NOERROR)
+      result = generate_sdp(board, stream, sdp);
+   if (result != VHDERR_NOERROR)
+   {
+      std::cout << "Error when configuring the simulated board" << " [" << to_string(result) << "]" << std::endl;
+      close_all_boards(boards);
+      return -1;
+   }
+
+   nmos::experimental::log_model log_model;
+   std::ostream error_log(std::cerr.rdbuf());
+   std::filebuf access_log_buf;
+   std::ostream access_log(&access_log_buf);
+   nmos::experimental::log_gate log_gate(error_log, access_log, log_model);
+   AsyncLogGate gate(log_gate, config.log_queue_capacity);
+
+   nmos::node_model sender_model;
+   configure_node_settings(sender_model, U("3bd4a0f8-5c0e-4e1c-9c36-6d0f4a8e1b21"), "IS-05 load Tx Node",
+                           config.base_port, config.logging_level);
+   log_model.settings = sender_model.settings;
+   log_model.level = nmos::fields::logging_level(log_model.settings);
+
+   nmos_tools::NodeServerSender::TransportParams sender_resolve_auto_transport_params = {
+       {Ipv4Address(0x7f000001), 2000}, destination};
+   nmos_tools::NodeServerSender::TransportParams sender_active_transport_params = sender_resolve_auto_transport_params;
+   nmos_tools::NodeServerSender sender_node(sender_model, log_model, gate, "IS-05 load Tx Device",
+                                            "IS-05 load harness TX device", board, stream,
+                                            sender_resolve_auto_transport_params, sender_active_transport_params,
+                                            "lo", media_nic_mac_address, sdp);
+
+   nmos::node_model receiver_model;
+   configure_node_settings(receiver_model, U("9a1f3c57-2e8b-4d0a-b6f4-71c2d8e0a5b3"), "IS-05 load Rx Node",
+                           config.base_port + 10, config.logging_level);
+
+   nmos_tools::NodeServerReceiver::TransportParams receiver_resolve_auto_transport_params = {
+       Ipv4Address(0x7f000001), destination, Ipv4Address()};
+   nmos_tools::NodeServerReceiver::TransportParams receiver_active_transport_params =
+       receiver_resolve_auto_transport_params;
+   nmos_tools::NodeServerReceiver receiver_node(receiver_model, log_model, gate, "IS-05 load Rx Device",
+                                                "IS-05 load harness RX device", receiver_resolve_auto_transport_params,
+                                                receiver_active_transport_params, "lo", media_nic_mac_address);
+
+   StormResult sender_storm, receiver_storm;
+   sender_node.set_latency_recorder(&sender_storm.callback_latencies);
+   receiver_node.set_latency_recorder(&receiver_storm.callback_latencies);
+
+   sender_node.start();
+   receiver_node.start();
+   bool is_ready = sender_node.node_implementation_init() && receiver_node.node_implementation_init();
+
+   const utility::string_t sender_url =
+       utility::conversions::to_string_t("http://127.0.0.1:" + std::to_string(config.base_port));
+   const utility::string_t receiver_url =
+       utility::conversions::to_string_t("http://127.0.0.1:" + std::to_string(config.base_port + 10));
+   const utility::string_t connection_api = U("/x-nmos/connection/v1.1/single/");
+   is_ready = is_ready && wait_until_listening(sender_url, connection_api + U("senders/"), std::chrono::seconds(10)) &&
+              wait_until_listening(receiver_url, connection_api + U("receivers/"), std::chrono::seconds(10));
+
+   const nmos::id sender_id = find_connection_resource_id(sender_model, nmos::types::sender);
+   const nmos::id receiver_id = find_connection_resource_id(receiver_model, nmos::types::receiver);
+   if (!is_ready || sender_id.empty() || receiver_id.empty())
+   {
+      std::cout << "Error when starting the nmos nodes" << std::endl;
+      receiver_node.stop();
+      sender_node.stop();
+      close_all_boards(boards);
+      return -1;
+   }
+
+   // The node initialization is not part of the storms
+   sender_storm.registration = sender_node.get_registration_statistics();
+   receiver_storm.registration = receiver_node.get_registration_statistics();
+   sender_storm.callback_latencies.reset();
+   receiver_storm.callback_latencies.reset();
+
+   std::cerr << "Sending " << config.nb_patches << " PATCH requests to the sender..." << std::endl;
+   run_storm(config, sender_model, sender_url, connection_api + U("senders/") + sender_id + U("/staged"),
+             make_sender_patch, sender_storm);
+
+   std::cerr << "Sending " << config.nb_patches << " PATCH requests to the receiver..." << std::endl;
+   run_storm(config, receiver_model, receiver_url, connection_api + U("receivers/") + receiver_id + U("/staged"),
+             [&sdp](uint32_t index, bool activate) { return make_receiver_patch(index, activate, sdp); },
+             receiver_storm);
+
+   receiver_node.stop();
+   sender_node.stop();
+   close_all_boards(boards);
+   gate.flush();
+   const AsyncLogStatistics log_statistics = gate.get_statistics();
+
+   std::ofstream output_file;
+   if (!output_path.empty())
+   {
+      output_file.open(output_path);
+      if (!output_file)
+      {
+         std::cout << "Cannot open " << output_path << std::endl;
+         return -1;
+      }
+   }
+   std::ostream& output = output_path.empty() ? std::cout : output_file;
+   output << "{\n";
+   output << "  \"config\": {\"patches\": " << config.nb_patches << ", \"concurrency\": " << config.concurrency
+          << ", \"activation_every\": " << config.activation_every << ", \"logging_level\": " << config.logging_level
+          << ", \"log_queue\": " << config.log_queue_capacity << "},\n";
+   output << "  \"log\": {\"records\": " << log_statistics.nb_records << ", \"dropped\": " << log_statistics.nb_dropped
+          << ", \"max_backlog\": " << log_statistics.max_backlog << "},\n";
+   write_storm_json(output, "sender", sender_storm, false);
+   write_storm_json(output, "receiver", receiver_storm, true);
+   output << "}\n";
+   return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <iomanip>
+
+#include "latency_recorder.h"
+
+namespace
+{
+   double get_percentile_us(const std::vector<int64_t>& sorted_samples_ns, double percentile)
+   {
+      const size_t index = static_cast<size_t>(percentile / 100.0 * (sorted_samples_ns.size() - 1) + 0.5);
+      return sorted_samples_ns[index] / 1000.0;
+   }
+}
+
+LatencyRecorder::Measurement::Measurement(LatencyRecorder* recorder, const char* name)
+    : m_recorder(recorder), m_name(name), m_begin(recorder ? clock::now() : clock::time_point())
+{
+}
+
+LatencyRecorder::Measurement::~Measurement()
+{
+   if (m_recorder)
+      m_recorder->record(m_name, clock::now() - m_begin);
+}
+
+LatencyRecorder::Measurement LatencyRecorder::measure(const char* name)
+{
+   return Measurement(this, name);
+}
+
+void LatencyRecorder::record(const std::string& name, clock::duration duration)
+{
+   const int64_t duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+   std::lock_guard lock(m_mutex);
+   m_samples_ns[name].push_back(duration_ns);
+}
+
+void LatencyRecorder::reset()
+{
+   std::lock_guard lock(m_mutex);
+   m_samples_ns.clear();
+}
+
+std::map<std::string, LatencyStatistics> LatencyRecorder::get_statistics() const
+{
+   std::map<std::string, std::vector<int64_t>> samples_ns;
+   {
+      std::lock_guard lock(m_mutex);
+      samples_ns = m_samples_ns;
+   }
+
+   std::map<std::string, LatencyStatistics> statistics;
+   for (auto& [name, samples] : samples_ns)
+   {
+      if (samples.empty())
+         continue;
+      std::sort(samples.begin(), samples.end());
+
+      LatencyStatistics& operation = statistics[name];
+      operation.count = samples.size();
+      int64_t total_ns = 0;
+      for (int64_t sample : samples)
+         total_ns += sample;
+      operation.total_ms = total_ns / 1e6;
+      operation.mean_us = static_cast<double>(total_ns) / samples.size() / 1000.0;
+      operation.p50_us = get_percentile_us(samples, 50.0);
+      operation.p99_us = get_percentile_us(samples, 99.0);
+      operation.max_us = samples.back() / 1000.0;
+   }
+   return statistics;
+}
+
+void LatencyRecorder::write_json(std::ostream& output, const std::string& indent) const
+{
+   const auto statistics = get_statistics();
+   output << "{" << std::fixed << std::setprecision(1);
+   for (auto operation = statistics.begin(); operation != statistics.end(); ++operation)
+   {
+      const LatencyStatistics& latency = operation->second;
+      output << (operation == statistics.begin() ? "\n" : ",\n") << indent << "\"" << operation->first
+             << "\": {\"count\": " << latency.count << ", \"mean_us\": " << latency.mean_us
+             << ", \"p50_us\": " << latency.p50_us << ", \"p99_us\": " << latency.p99_us
+             << ", \"max_us\": " << latency.max_us << ", \"total_ms\": " << latency.total_ms << "}";
+   }
+   output << (statistics.empty() ? "}" : "\n" + indent.substr(0, indent.size() >= 2 ? indent.size() - 2 : 0) + "}")
+          << std::defaultfloat;
+}
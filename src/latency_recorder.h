@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file latency_recorder.h
+   @brief This file contains the recorder of the latency samples of named operations, e.g. the NMOS callbacks.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*!
+   @brief Latency distribution of an operation
+*/
+struct LatencyStatistics
+{
+   uint64_t count = 0;
+   double mean_us = 0.0;
+   double p50_us = 0.0;
+   double p99_us = 0.0;
+   double max_us = 0.0;
+   double total_ms = 0.0;
+};
+
+/*!
+   @brief Records every latency sample of named operations, from any thread
+*/
+class LatencyRecorder
+{
+public:
+   using clock = std::chrono::steady_clock;
+
+   /*!
+      @brief Times an operation from its construction to its destruction, nothing is recorded without a recorder
+   */
+   class Measurement
+   {
+   public:
+      Measurement(LatencyRecorder* recorder, const char* name);
+      ~Measurement();
+
+      Measurement(const Measurement&) = delete;
+      Measurement& operator=(const Measurement&) = delete;
+
+   private:
+      LatencyRecorder* m_recorder;
+      const char* m_name;
+      clock::time_point m_begin;
+   };
+
+   /*!
+      @brief Start timing an operation, the operation ends when the returned object is destroyed
+   */
+   Measurement measure(const char* name /*!< [in] Name of the operation, must outlive the recorder*/);
+
+   void record(const std::string& name /*!< [in] Name of the operation*/,
+               clock::duration duration /*!< [in] Duration of one occurrence*/);
+
+   void reset();
+
+   std::map<std::string, LatencyStatistics> get_statistics() const;
+
+   /*!
+      @brief Write the statistics as a JSON object, one member per operation
+   */
+   void write_json(std::ostream& output /*!< [in] Stream to write to*/,
+                   const std::string& indent = "" /*!< [in] Indentation of the members*/) const;
+
+private:
+   mutable std::mutex m_mutex;
+   std::map<std::string, std::vector<int64_t>> m_samples_ns;
+};
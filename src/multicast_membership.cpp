@@ -0,0 +1,233 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "board_backend.h"
+#include "multicast_membership.h"
+#include "tools.h"
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Ip_Board.h"
+#else
+#include "VideoMasterHD_Ip_Board.h"
+#endif
+
+namespace
+{
+   const std::chrono::milliseconds datagram_sampling_period(1);
+   const std::chrono::seconds first_datagram_timeout(5);
+}
+
+MulticastMembership::MulticastMembership()
+{
+   m_thread = std::thread([this] { run(); });
+}
+
+MulticastMembership::~MulticastMembership()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+   }
+   m_condition.notify_all();
+   m_thread.join();
+}
+
+void MulticastMembership::set_leave_delay(std::chrono::milliseconds leave_delay)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_leave_delay = leave_delay;
+}
+
+VHD_ERRORCODE MulticastMembership::join(HANDLE board_handle, const Ipv4Address& group, HANDLE stream_handle)
+{
+   if (!group.is_multicast())
+      return VHDERR_BADARG;
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_statistics.nb_references++;
+   auto found = m_memberships.find({board_handle, group.value()});
+   if (found != m_memberships.end())
+   {
+      Membership& membership = found->second;
+      if (membership.leave_pending)
+         m_statistics.nb_cancelled_leaves++;
+      membership.leave_pending = false;
+      membership.nb_references++;
+      m_statistics.nb_shared_references++;
+      return VHDERR_NOERROR;
+   }
+
+   const VHD_ERRORCODE result =
+       board_backend().join_multicast_group(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, group.value());
+   if (result != VHDERR_NOERROR)
+   {
+      std::cout << "Error joining multicast group: " << to_string(result) << std::endl;
+      return result;
+   }
+
+   Membership& membership = m_memberships[{board_handle, group.value()}];
+   membership.nb_references = 1;
+   membership.join_time = std::chrono::steady_clock::now();
+   membership.stream_handle = stream_handle;
+   m_statistics.nb_joins++;
+   m_statistics.nb_groups = static_cast<uint32_t>(m_memberships.size());
+   if (stream_handle)
+      m_condition.notify_all();
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE MulticastMembership::leave(HANDLE board_handle, const Ipv4Address& group)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   const Key key = {board_handle, group.value()};
+   auto found = m_memberships.find(key);
+   if (found == m_memberships.end() || !found->second.nb_references)
+   {
+      std::cout << "Error leaving multicast group: not joined" << std::endl;
+      return VHDERR_BADARG;
+   }
+
+   Membership& membership = found->second;
+   if (--membership.nb_references)
+      return VHDERR_NOERROR;
+
+   // The stream may be closed once its reference is released
+   membership.stream_handle = nullptr;
+   if (m_leave_delay.count() <= 0)
+   {
+      const VHD_ERRORCODE result = leave_group(key);
+      m_memberships.erase(found);
+      m_statistics.nb_groups = static_cast<uint32_t>(m_memberships.size());
+      return result;
+   }
+
+   membership.leave_pending = true;
+   membership.leave_time = std::chrono::steady_clock::now() + m_leave_delay;
+   m_condition.notify_all();
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE MulticastMembership::flush(HANDLE board_handle)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   VHD_ERRORCODE result = VHDERR_NOERROR;
+   for (auto membership = m_memberships.begin(); membership != m_memberships.end();)
+   {
+      if (membership->first.first == board_handle && membership->second.leave_pending)
+      {
+         const VHD_ERRORCODE leave_result = leave_group(membership->first);
+         if (result == VHDERR_NOERROR)
+            result = leave_result;
+         membership = m_memberships.erase(membership);
+      }
+      else
+         ++membership;
+   }
+   m_statistics.nb_groups = static_cast<uint32_t>(m_memberships.size());
+   return result;
+}
+
+MulticastMembershipStatistics MulticastMembership::get_statistics() const
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return m_statistics;
+}
+
+void MulticastMembership::print_statistics() const
+{
+   const MulticastMembershipStatistics statistics = get_statistics();
+   if (!statistics.nb_references)
+      return;
+
+   std::cout << "Multicast: " << statistics.nb_joins << " joins - " << statistics.nb_leaves << " leaves - "
+             << statistics.nb_shared_references << "/" << statistics.nb_references
+             << " references served by a joined group (" << statistics.nb_cancelled_leaves
+             << " deferred leaves cancelled)";
+   if (statistics.nb_first_datagrams)
+      std::cout << " - join to first datagram: mean " << std::fixed << std::setprecision(1)
+                << statistics.mean_join_to_first_datagram_ms << " ms, max "
+                << statistics.max_join_to_first_datagram_ms << " ms" << std::defaultfloat;
+   std::cout << std::endl;
+}
+
+void MulticastMembership::run()
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   while (!m_stop)
+   {
+      const auto now = std::chrono::steady_clock::now();
+      auto wake_up_time = now + std::chrono::seconds(1);
+
+      for (auto entry = m_memberships.begin(); entry != m_memberships.end();)
+      {
+         Membership& membership = entry->second;
+         if (membership.leave_pending && membership.leave_time <= now)
+         {
+            leave_group(entry->first);
+            entry = m_memberships.erase(entry);
+            m_statistics.nb_groups = static_cast<uint32_t>(m_memberships.size());
+            continue;
+         }
+         if (membership.leave_pending)
+            wake_up_time = std::min(wake_up_time, membership.leave_time);
+
+         if (membership.stream_handle)
+         {
+            ULONG nb_datagrams = 0;
+            if (board_backend().get_stream_property(membership.stream_handle, VHD_IP_BRD_SP_DATAGRAM_COUNT,
+                                                    &nb_datagrams) == VHDERR_NOERROR &&
+                nb_datagrams)
+            {
+               const double join_to_first_datagram_ms =
+                   std::chrono::duration<double, std::milli>(now - membership.join_time).count();
+               m_statistics.nb_first_datagrams++;
+               m_join_to_first_datagram_sum_ms += join_to_first_datagram_ms;
+               m_statistics.mean_join_to_first_datagram_ms =
+                   m_join_to_first_datagram_sum_ms / m_statistics.nb_first_datagrams;
+               m_statistics.max_join_to_first_datagram_ms =
+                   std::max(m_statistics.max_join_to_first_datagram_ms, join_to_first_datagram_ms);
+               membership.stream_handle = nullptr;
+            }
+            else if (now - membership.join_time > first_datagram_timeout)
+               membership.stream_handle = nullptr;
+            else
+               wake_up_time = std::min(wake_up_time, now + datagram_sampling_period);
+         }
+         ++entry;
+      }
+
+      m_condition.wait_until(lock, wake_up_time);
+   }
+}
+
+VHD_ERRORCODE MulticastMembership::leave_group(const Key& key)
+{
+   const VHD_ERRORCODE result =
+       board_backend().leave_multicast_group(key.first, VHD_IP_BRD_ETHERNETPORT_ETH_0, key.second);
+   if (result != VHDERR_NOERROR)
+      std::cout << "Error when leaving the multicast group" << " [" << to_string(result) << "]" << std::endl;
+   m_statistics.nb_leaves++;
+   return result;
+}
+
+MulticastMembership& multicast_membership()
+{
+   static MulticastMembership membership;
+   return membership;
+}
@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file multicast_membership.h
+   @brief This file contains the table of the multicast groups joined by the boards, shared by their streams.
+
+   @detail Every stream receiving a multicast group takes a reference on the membership of its board. The group is
+   only joined by the first reference, and left once the last reference is released and leave_delay has elapsed
+   without a new reference. Reconfiguring a stream to the group it already receives, or sharing a group between
+   streams, then neither sends IGMP reports nor waits for the join again.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "ipv4.h"
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Core.h"
+#else
+#include "VideoMasterHD_Core.h"
+#endif
+
+struct MulticastMembershipStatistics
+{
+   uint64_t nb_joins = 0 /*! Groups joined on a board */;
+   uint64_t nb_leaves = 0 /*! Groups left on a board */;
+   uint64_t nb_references = 0 /*! References taken on a group */;
+   uint64_t nb_shared_references = 0 /*! References served by a group already joined */;
+   uint64_t nb_cancelled_leaves = 0 /*! Deferred leaves cancelled by a new reference */;
+   uint32_t nb_groups = 0 /*! Groups currently joined, including the ones waiting to be left */;
+   uint64_t nb_first_datagrams = 0 /*! Joins followed by a first datagram */;
+   double mean_join_to_first_datagram_ms = 0.0;
+   double max_join_to_first_datagram_ms = 0.0;
+};
+
+/*!
+   @brief Reference-counted multicast memberships of the boards, with deferred leaves
+
+   @detail A background thread leaves the groups whose deferred leave is due, and samples the datagram counter of
+   the stream given to join() every millisecond to measure the time from the join to the first datagram.
+*/
+class MulticastMembership
+{
+public:
+   MulticastMembership();
+   ~MulticastMembership();
+
+   MulticastMembership(const MulticastMembership&) = delete;
+   MulticastMembership& operator=(const MulticastMembership&) = delete;
+
+   /*!
+      @brief Set the time a group without reference stays joined, 0 to leave it right away
+   */
+   void set_leave_delay(std::chrono::milliseconds leave_delay /*!< [in] Delay before leaving a group*/);
+
+   /*!
+      @brief Take a reference on a group, joining it if the board is not a member yet
+
+      @detail When the group is joined, the datagram counter of stream_handle, if any, is sampled until the first
+      datagram. The stream must stay open until the reference is released.
+
+      @returns The function returns the status of its execution as VHD_ERRORCODE
+   */
+   VHD_ERRORCODE join(HANDLE board_handle /*!< [in] Board handle*/,
+                      const Ipv4Address& group /*!< [in] Multicast group*/,
+                      HANDLE stream_handle = nullptr /*!< [in] Stream receiving the group, for the first datagram*/);
+
+   /*!
+      @brief Release a reference on a group, the group is left once leave_delay has elapsed without reference
+
+      @returns The function returns the status of its execution as VHD_ERRORCODE
+   */
+   VHD_ERRORCODE leave(HANDLE board_handle /*!< [in] Board handle*/,
+                       const Ipv4Address& group /*!< [in] Multicast group*/);
+
+   /*!
+      @brief Leave right away the groups of a board without reference, to be called before closing the board
+
+      @returns The function returns the status of its execution as VHD_ERRORCODE
+   */
+   VHD_ERRORCODE flush(HANDLE board_handle /*!< [in] Board handle*/);
+
+   MulticastMembershipStatistics get_statistics() const;
+   void print_statistics() const;
+
+private:
+   using Key = std::pair<HANDLE, uint32_t>;
+
+   struct Membership
+   {
+      uint32_t nb_references = 0;
+      bool leave_pending = false;
+      std::chrono::steady_clock::time_point leave_time;
+      std::chrono::steady_clock::time_point join_time;
+      HANDLE stream_handle = nullptr /*! Stream sampled until its first datagram, nullptr once seen */;
+   };
+
+   void run();
+   VHD_ERRORCODE leave_group(const Key& key);
+
+   std::chrono::milliseconds m_leave_delay{2000};
+
+   mutable std::mutex m_mutex;
+   std::condition_variable m_condition;
+   std::thread m_thread;
+   bool m_stop = false;
+
+   std::map<Key, Membership> m_memberships;
+   MulticastMembershipStatistics m_statistics;
+   double m_join_to_first_datagram_sum_ms = 0.0;
+};
+
+/*!
+   @brief Multicast memberships of the boards of the process
+*/
+MulticastMembership& multicast_membership();
@@ -33,7 +33,14 @@
 #include "cpprest/host_utils.h"
 #include "cpprest/json_ops.h"
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+
 #include "tools.h"
+#include "board_backend.h"
+#include "video_constraints.h"
 
 #if defined(__APPLE__)
 #include "VideoMasterHD/VideoMasterHD_Ip_Board.h"
@@ -47,6 +54,46 @@
 #include "VideoMasterHD_String.h"
 #endif
 
+namespace
+{
+   nmos::chroma_subsampling get_chroma_subsampling(VHD_ST2110_20_SAMPLING sampling)
+   {
+      switch (sampling)
+      {
+      case VHD_ST2110_20_SAMPLING_YUV_444: return nmos::chroma_subsampling::YCbCr444;
+      case VHD_ST2110_20_SAMPLING_YUV_420: return nmos::chroma_subsampling::YCbCr420;
+      case VHD_ST2110_20_SAMPLING_RGB_444: return nmos::chroma_subsampling::RGB444;
+      default: return nmos::chroma_subsampling::YCbCr422;
+      }
+   }
+
+   web::json::value make_video_constraint_set(uint32_t frame_width, uint32_t frame_height, bool interlaced,
+                                              const GrainRate* grain_rates, uint32_t nb_grain_rates)
+   {
+      std::vector<nmos::rational> grain_rate_enum;
+      for (uint32_t i = 0; i < nb_grain_rates; i++)
+         grain_rate_enum.push_back(nmos::rational(grain_rates[i].numerator, grain_rates[i].denominator));
+
+      web::json::value constraint = web::json::value::object();
+      constraint[nmos::caps::format::grain_rate] = nmos::make_caps_rational_constraint(grain_rate_enum);
+      constraint[nmos::caps::format::frame_width] = nmos::make_caps_integer_constraint({frame_width});
+      constraint[nmos::caps::format::frame_height] = nmos::make_caps_integer_constraint({frame_height});
+      constraint[nmos::caps::format::interlace_mode] = nmos::make_caps_string_constraint(
+          {interlaced ? nmos::interlace_modes::interlaced_bff.name : nmos::interlace_modes::progressive.name});
+      // the board converts every ST 2110-20 sampling and depth to the YUV 4:2:2 10-bit slots
+      std::vector<int64_t> component_depth_enum;
+      for (VHD_ST2110_20_DEPTH depth : video_depths)
+         component_depth_enum.push_back(get_component_depth(depth));
+      std::vector<utility::string_t> color_sampling_enum;
+      for (VHD_ST2110_20_SAMPLING sampling : video_samplings)
+         color_sampling_enum.push_back(utility::conversions::to_string_t(get_sampling_name(sampling)));
+      constraint[nmos::caps::format::component_depth] = nmos::make_caps_integer_constraint(component_depth_enum);
+      constraint[nmos::caps::format::color_sampling] = nmos::make_caps_string_constraint(color_sampling_enum);
+      constraint[nmos::caps::format::transfer_characteristic] = nmos::make_caps_string_constraint({U("SDR")});
+      return constraint;
+   }
+}
+
 nmos_tools::NodeServer::NodeServer(nmos::node_model& node_model,
                                    nmos::experimental::node_implementation node_implementation,
                                    nmos::experimental::log_model& log_model, slog::base_gate& gate,
@@ -70,6 +117,21 @@ bool nmos_tools::NodeServer::get_ptp_system_parameters(NmosPtpSystemParameters &
       return false;
 }
 
+void nmos_tools::NodeServer::set_media_nic_mac_address(const std::string& media_nic_mac_address)
+{
+   this->media_nic_mac_address = media_nic_mac_address;
+}
+
+void nmos_tools::NodeServer::set_latency_recorder(LatencyRecorder* latency_recorder)
+{
+   this->latency_recorder = latency_recorder;
+}
+
+LatencyRecorder::Measurement nmos_tools::NodeServer::measure(const char* name)
+{
+   return LatencyRecorder::Measurement(latency_recorder, name);
+}
+
 void nmos_tools::NodeServer::start()
 {
    node_server.open();
@@ -80,11 +142,33 @@ void nmos_tools::NodeServer::stop()
    node_server.close().wait();
 }
 
+nmos_tools::RegistrationStatistics nmos_tools::NodeServer::get_registration_statistics()
+{
+   std::lock_guard lock(m_registration_statistics_mutex);
+   return m_registration_statistics;
+}
+
+void nmos_tools::NodeServer::print_registration_statistics()
+{
+   const RegistrationStatistics statistics = get_registration_statistics();
+   std::cout << "NMOS: " << statistics.nb_resources << " resources inserted in " << statistics.nb_batches
+             << " batch(es) - " << statistics.nb_notifications << " registration pass(es) - "
+             << statistics.insertion_ms << " ms under the model write lock" << std::endl;
+}
+
 bool nmos_tools::NodeServer::node_implementation_init()
 {
-   const unsigned int delay_millis{ 0 };
+   ResourceBatch batch;
+   add_node_resources(batch);
+   if (!insert_resources(batch))
+      throw node_implementation_init_exception("Failed to insert node resources");
 
-   nmos::write_lock lock = node_model.write_lock();
+   return true;
+}
+
+void nmos_tools::NodeServer::add_node_resources(ResourceBatch& batch)
+{
+   auto lock = node_model.read_lock(); // the settings are read while the resources are built
 
    const auto seed_id = nmos::experimental::fields::seed_id(node_model.settings);
 
@@ -101,9 +185,7 @@ bool nmos_tools::NodeServer::node_implementation_init()
 
    node_id = nmos::make_repeatable_id(seed_id, nmos::fields::label(node_model.settings));
 
-   auto node = nmos::make_node(node_id, clocks, interfaces, node_model.settings);
-   if (!insert_resource_after(node_model,lock,delay_millis, node_model.node_resources, std::move(node), gate))
-      throw node_implementation_init_exception("Failed to insert node resource");
+   batch.add(node_model.node_resources, nmos::make_node(node_id, clocks, interfaces, node_model.settings));
 
    //Add one device
    device_id = nmos::make_repeatable_id(seed_id, utility::conversions::to_string_t(device_name));
@@ -112,12 +194,7 @@ bool nmos_tools::NodeServer::node_implementation_init()
    settings[nmos::fields::label] = web::json::value::string(utility::conversions::to_string_t(device_name));
    settings[nmos::fields::description] = web::json::value::string(utility::conversions::to_string_t(device_description));
 
-   auto device = nmos::make_device(device_id, node_id,{},{}, settings);
-   const std::pair<nmos::id, nmos::type> id_type{ device_id, device.type };
-   if (!insert_resource(node_model.node_resources, std::move(device)).second)
-      throw node_implementation_init_exception("Failed to insert device resource");
-
-   return true;
+   batch.add(node_model.node_resources, nmos::make_device(device_id, node_id,{},{}, settings));
 }
 
 void nmos_tools::NodeServer::system_params_handler(const web::uri &system_uri, const web::json::value &system_global)
@@ -140,15 +217,15 @@ void nmos_tools::NodeServer::system_params_handler(const web::uri &system_uri, c
 
 bool nmos_tools::NodeServerReceiver::node_implementation_init()
 {
-   const unsigned int delay_millis{ 0 };
-
    try
    {
-      NodeServer::node_implementation_init();
+      // the node, its device and the receiver are registered together
+      ResourceBatch batch;
+      add_node_resources(batch);
 
-      const auto seed_id = nmos::experimental::fields::seed_id(node_model.settings);
+      auto lock = node_model.read_lock(); // the settings are read while the resources are built
 
-      auto lock = node_model.write_lock(); // in order to update the resources
+      const auto seed_id = nmos::experimental::fields::seed_id(node_model.settings);
 
       // start of receiver specific part
       const auto label = U("VHD Video Receiver");
@@ -167,13 +244,14 @@ bool nmos_tools::NodeServerReceiver::node_implementation_init()
           .as_array()[0]
           .as_object()[nmos::fields::interface_ip] = web::json::value_of(
           {{nmos::fields::constraint_enum,
-            web::json::value_of({web::json::value(ipv4_to_string(m_active_transport_params.ip_interface))})}});
+            web::json::value_of({web::json::value(ipv4_to_string(m_active_transport_params.interface_ip))})}});
+
+      lock.unlock();
 
-      if (!insert_resource_after(node_model, lock, delay_millis, node_model.node_resources, std::move(receiver), gate))
-         throw node_implementation_init_exception("Failed to insert receiver resource");
-      if (!insert_resource_after(
-              node_model, lock, delay_millis, node_model.connection_resources, std::move(connection_receiver), gate))
-         throw node_implementation_init_exception("Failed to insert connection receiver resource");
+      batch.add(node_model.node_resources, std::move(receiver));
+      batch.add(node_model.connection_resources, std::move(connection_receiver));
+      if (!insert_resources(batch))
+         throw node_implementation_init_exception("Failed to insert receiver resources");
    }
    catch (const node_implementation_init_exception& e)
    {
@@ -216,29 +294,56 @@ std::string nmos_tools::NodeServerReceiver::get_sdp()
    return sdp;
 }
 
-bool nmos_tools::NodeServer::insert_resource_after(nmos::node_model& model, nmos::write_lock& lock,
-                                                   unsigned int milliseconds, nmos::resources& resources,
-                                                   nmos::resource&& resource, slog::base_gate& log_gate)
+bool nmos_tools::NodeServer::insert_resources(ResourceBatch& batch)
 {
-   if (nmos::details::wait_for(model.shutdown_condition,
-                               lock,
-                               std::chrono::milliseconds(milliseconds),
-                               [&] { return this->node_model.shutdown; }))
+   nmos::write_lock lock = node_model.write_lock();
+   if (node_model.shutdown)
       return false;
 
-   const std::pair<nmos::id, nmos::type> id_type{resource.id, resource.type};
-   const bool success = insert_resource(resources, std::move(resource)).second;
+   const auto begin = std::chrono::steady_clock::now();
 
-   if (success)
-      slog::log<slog::severities::info>(log_gate, SLOG_FLF) << "Updated model with " << id_type;
-   else
-      slog::log<slog::severities::severe>(log_gate, SLOG_FLF) << "Model update error: " << id_type;
+   // the whole batch is checked before the first insertion, so that it is inserted entirely or not at all
+   for (auto resource = batch.resources.begin(); resource != batch.resources.end(); ++resource)
+   {
+      const std::pair<nmos::id, nmos::type> id_type{resource->second.id, resource->second.type};
+      const bool is_duplicate =
+          std::any_of(batch.resources.begin(), resource, [&](const std::pair<nmos::resources*, nmos::resource>& other) {
+             return other.first == resource->first && other.second.id == resource->second.id;
+          });
+      if (is_duplicate || nmos::find_resource(*resource->first, id_type) != resource->first->end())
+      {
+         slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Model update error: " << id_type;
+         return false;
+      }
+   }
 
-   slog::log<slog::severities::more_info>(log_gate, SLOG_FLF)
-       << "Notifying node behaviour thread"; // and anyone else who cares...
-   model.notify();
+   std::vector<std::pair<nmos::resources*, nmos::id>> inserted;
+   for (auto& resource : batch.resources)
+   {
+      const std::pair<nmos::id, nmos::type> id_type{resource.second.id, resource.second.type};
+      if (!insert_resource(*resource.first, std::move(resource.second)).second)
+      {
+         slog::log<slog::severities::severe>(gate, SLOG_FLF) << "Model update error: " << id_type;
+         for (const auto& inserted_resource : inserted)
+            nmos::erase_resource(*inserted_resource.first, inserted_resource.second);
+         return false;
+      }
+      inserted.emplace_back(resource.first, id_type.first);
+      slog::log<slog::severities::info>(gate, SLOG_FLF) << "Updated model with " << id_type;
+   }
+   batch.resources.clear();
 
-   return success;
+   slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+       << "Notifying node behaviour thread"; // and anyone else who cares...
+   node_model.notify();
+
+   std::lock_guard statistics_lock(m_registration_statistics_mutex);
+   m_registration_statistics.nb_resources += inserted.size();
+   m_registration_statistics.nb_batches++;
+   m_registration_statistics.nb_notifications++;
+   m_registration_statistics.insertion_ms +=
+       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+   return true;
 }
 
 bool nmos_tools::NodeServer::is_field_auto(const web::json::value& object,
@@ -287,52 +392,65 @@ void nmos_tools::NodeServerReceiver::resolve_auto(const nmos::resource& resource
                                                   const nmos::resource& connection_resource,
                                                   web::json::value& transport_params)
 {
+   const auto callback_measurement = measure("resolve_auto");
+
    // debug log the json objects
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: resource: " << std::endl
-                                                          << resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: connection_resource: " << std::endl
-                                                          << connection_resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: transport_params: " << std::endl
-                                                          << transport_params.serialize();
+   {
+      const auto serialization_measurement = measure("json_serialization");
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: resource: " << std::endl
+                                                             << serialized(resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "resolve_auto_sender: connection_resource: " << std::endl
+          << serialized(connection_resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: transport_params: " << std::endl
+                                                             << serialized(transport_params);
+   }
 
    for (auto& transport_param : transport_params.as_array())
    {
       if (is_field_auto(transport_param, nmos::fields::interface_ip))
       {
          transport_param[nmos::fields::interface_ip] =
-             web::json::value::string(ipv4_to_string(m_resolve_auto_transport_params.ip_interface));
+             web::json::value::string(ipv4_to_string(m_resolve_auto_transport_params.interface_ip));
       }
       if (is_field_auto(transport_param, nmos::fields::destination_port))
       {
          transport_param[nmos::fields::destination_port] =
-             web::json::value::number(m_resolve_auto_transport_params.port_dst);
+             web::json::value::number(m_resolve_auto_transport_params.destination.port);
       }
       if (is_field_auto(transport_param, nmos::fields::multicast_ip))
       {
          transport_param[nmos::fields::multicast_ip] =
-             web::json::value::string(ipv4_to_string(m_resolve_auto_transport_params.ip_multicast));
+             web::json::value::string(ipv4_to_string(m_resolve_auto_transport_params.destination.address));
       }
       if (is_field_auto(transport_param, nmos::fields::source_ip))
       {
          transport_param[nmos::fields::source_ip] =
-             web::json::value::string(ipv4_to_string(m_resolve_auto_transport_params.ip_src));
+             web::json::value::string(ipv4_to_string(m_resolve_auto_transport_params.source_ip));
       }
    }
 
+   const auto serialization_measurement = measure("json_serialization");
    slog::log<slog::severities::more_info>(gate, SLOG_FLF)
        << "resolve_auto_sender: resolved_transport_params: " << std::endl
-       << transport_params.serialize();
+       << serialized(transport_params);
 }
 
 void nmos_tools::NodeServerReceiver::connection_activation(const nmos::resource& resource,
                                                            const nmos::resource& connection_resource)
 {
+   const auto callback_measurement = measure("connection_activation");
+
    // debug log the json objects
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "connection_activation_receiver: resource: " << std::endl
-                                                          << resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF)
-       << "connection_activation_receiver: connection_resource: " << std::endl
-       << connection_resource.data.serialize();
+   {
+      const auto serialization_measurement = measure("json_serialization");
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "connection_activation_receiver: resource: " << std::endl
+          << serialized(resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "connection_activation_receiver: connection_resource: " << std::endl
+          << serialized(connection_resource.data);
+   }
 
    // parameters have been activated, communicate those modifications to the sample in order to reflect the model
    // changes
@@ -345,23 +463,24 @@ void nmos_tools::NodeServerReceiver::connection_activation(const nmos::resource&
 
    if (active_transport_params_object.find(nmos::fields::interface_ip) != active_transport_params_object.end() &&
        active_transport_params_object.at(nmos::fields::interface_ip).is_string())
-      m_active_transport_params.ip_interface =
+      m_active_transport_params.interface_ip =
           string_to_ipv4(active_transport_params_object.at(nmos::fields::interface_ip).as_string());
    else
-      m_active_transport_params.ip_interface = 0;
+      m_active_transport_params.interface_ip = Ipv4Address();
    if (active_transport_params_object.find(nmos::fields::multicast_ip) != active_transport_params_object.end() &&
        active_transport_params_object.at(nmos::fields::multicast_ip).is_string())
-      m_active_transport_params.ip_multicast =
+      m_active_transport_params.destination.address =
           string_to_ipv4(active_transport_params_object.at(nmos::fields::multicast_ip).as_string());
    else
-      m_active_transport_params.ip_multicast = 0;
+      m_active_transport_params.destination.address = Ipv4Address();
    if (active_transport_params_object.find(nmos::fields::source_ip) != active_transport_params_object.end() &&
        active_transport_params_object.at(nmos::fields::source_ip).is_string())
-      m_active_transport_params.ip_src =
+      m_active_transport_params.source_ip =
           string_to_ipv4(active_transport_params_object.at(nmos::fields::source_ip).as_string());
    else
-      m_active_transport_params.ip_src = 0;
-   m_active_transport_params.port_dst = active_transport_params_object.at(nmos::fields::destination_port).as_integer();
+      m_active_transport_params.source_ip = Ipv4Address();
+   m_active_transport_params.destination.port =
+       static_cast<uint16_t>(active_transport_params_object.at(nmos::fields::destination_port).as_integer());
 
    const web::json::object& transport_file =
        connection_resource.data.at(nmos::fields::active).at(nmos::fields::transport_file).as_object();
@@ -377,59 +496,61 @@ web::json::value nmos_tools::NodeServerReceiver::transportfile_parser(const nmos
                                                                       const utility::string_t& transportfile_type,
                                                                       const utility::string_t& transportfile_data)
 {
+   const auto callback_measurement = measure("transportfile_parser");
+
    // debug log the json objects
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF)
-       << "transportfile_parser: resource: " << resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF)
-       << "transportfile_parser: connection_resource: " << connection_resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF)
-       << "transportfile_parser: transportfile_type: " << transportfile_type;
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF)
-       << "transportfile_parser: transportfile_data: " << transportfile_data;
+   {
+      const auto serialization_measurement = measure("json_serialization");
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "transportfile_parser: resource: " << serialized(resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "transportfile_parser: connection_resource: " << serialized(connection_resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "transportfile_parser: transportfile_type: " << transportfile_type;
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "transportfile_parser: transportfile_data: " << transportfile_data;
+   }
 
    web::json::value res =
        nmos::parse_rtp_transport_file(resource, connection_resource, transportfile_type, transportfile_data, gate);
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "transportfile_parser: result: " << res.serialize();
+
+   const auto serialization_measurement = measure("json_serialization");
+   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "transportfile_parser: result: " << serialized(res);
    return res;
 }
 
-web::json::value nmos_tools::NodeServerReceiver::generate_constraints()
+web::json::value nmos_tools::make_video_constraint_sets()
 {
-   uint32_t frame_heigth;
-   uint32_t frame_width;
-   uint32_t frame_rate;
-   nmos::rational frame_rate_rational;
-   bool interlaced;
-   bool is_us;
-
+   // one constraint set per frame geometry, enumerating the grain rates of the matching video standards
    web::json::value constraints = web::json::value::array();
-   for (uint32_t i = 0; i < NB_VHD_ST2110_20_VIDEO_STANDARD; i++)
+   for (uint32_t i = 0; i < compacted_video_formats.nb_formats; i++)
    {
-      const VHD_ERRORCODE result = get_video_standard_info(
-          static_cast<VHD_ST2110_20_VIDEO_STANDARD>(i), frame_width, frame_heigth, frame_rate, interlaced, is_us);
-      if (result != VHDERR_NOERROR)
-         throw node_implementation_init_exception("Error while getting video standard info");
-
-      if (interlaced)
-         frame_rate /= 2; // frame rate *is* divisible by 2
-
-      if (is_us)
-         frame_rate_rational = nmos::parse_rational(nmos::make_rational(frame_rate * 1000, 1001));
-      else
-         frame_rate_rational = frame_rate;
+      const CompactedVideoFormat& format = compacted_video_formats.formats[i];
+      constraints.as_array()[i] = make_video_constraint_set(
+          format.frame_width, format.frame_height, format.interlaced, format.grain_rates, format.nb_grain_rates);
+   }
+   return constraints;
+}
 
-      web::json::value constraint = web::json::value::object();
-      constraint[nmos::caps::format::grain_rate] = nmos::make_caps_rational_constraint({frame_rate_rational});
-      constraint[nmos::caps::format::frame_width] = nmos::make_caps_integer_constraint({frame_width});
-      constraint[nmos::caps::format::frame_height] = nmos::make_caps_integer_constraint({frame_heigth});
-      constraint[nmos::caps::format::interlace_mode] = nmos::make_caps_string_constraint(
-          {interlaced ? nmos::interlace_modes::interlaced_bff.name : nmos::interlace_modes::progressive.name});
-      constraint[nmos::caps::format::component_depth] = nmos::make_caps_integer_constraint({10});
-      constraint[nmos::caps::format::color_sampling] = nmos::make_caps_string_constraint({U("YCbCr-4:2:2")});
-      constraint[nmos::caps::format::transfer_characteristic] = nmos::make_caps_string_constraint({U("SDR")});
+web::json::value nmos_tools::NodeServerReceiver::generate_constraints()
+{
+   web::json::value constraints = make_video_constraint_sets();
 
-      constraints.as_array()[i] = constraint;
-   }
+   // report once what the compaction saves on the receiver resource, against one constraint set per video standard
+   static std::once_flag size_reported;
+   std::call_once(size_reported, [&constraints] {
+      web::json::value per_standard_constraints = web::json::value::array();
+      for (uint32_t i = 0; i < nb_video_standard_infos; i++)
+      {
+         const VideoStandardInfo& info = video_standard_infos[i];
+         const GrainRate grain_rate = get_grain_rate(info);
+         per_standard_constraints.as_array()[i] =
+             make_video_constraint_set(info.frame_width, info.frame_height, info.interlaced, &grain_rate, 1);
+      }
+      std::cout << "Receiver caps: " << compacted_video_formats.nb_formats << " constraint sets ("
+                << constraints.serialize().size() << " bytes) instead of " << nb_video_standard_infos << " ("
+                << per_standard_constraints.serialize().size() << " bytes)" << std::endl;
+   });
 
    return constraints;
 }
@@ -437,7 +558,7 @@ web::json::value nmos_tools::NodeServerReceiver::generate_constraints()
 nmos_tools::NodeServerSender::NodeServerSender(nmos::node_model& node_model, nmos::experimental::log_model& log_model,
                                                slog::base_gate& gate, const std::string device_name,
                                                const std::string device_description,
-                                               void *board_handle, void *stream_handle,
+                                               void *&board_handle, void *&stream_handle,
                                                TransportParams& resolve_auto_transport_params,
                                                TransportParams& active_transport_params, std::string media_nic_name,
                                                std::string media_mac_address, std::string sdp)
@@ -450,6 +571,21 @@ nmos_tools::NodeServerSender::NodeServerSender(nmos::node_model& node_model, nmo
    this->sdp = sdp;
 }
 
+void nmos_tools::NodeServerSender::set_sdp(const std::string& sdp)
+{
+   this->sdp = sdp;
+}
+
+void nmos_tools::NodeServerSender::set_video_format(const VideoFormat& video_format)
+{
+   this->video_format = video_format;
+}
+
+void nmos_tools::NodeServerSender::set_stream_hooks(const StreamHooks& stream_hooks)
+{
+   this->stream_hooks = stream_hooks;
+}
+
 nmos::experimental::node_implementation nmos_tools::NodeServerSender::make_node_implementation()
 {
    auto node_implementation = nmos::experimental::node_implementation();
@@ -469,24 +605,27 @@ nmos::experimental::node_implementation nmos_tools::NodeServerSender::make_node_
    return node_implementation;
 }
 
-bool nmos_tools::NodeServerSender::update_connection_parameters(uint32_t ip_dst, uint16_t port_dst)
+bool nmos_tools::NodeServerSender::update_connection_parameters(const Ipv4Endpoint& destination)
 {
+   if (stream_hooks.set_destination)
+      return stream_hooks.set_destination(destination);
+
    VHD_ERRORCODE result;
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_IP_BRD_SP_IP_DST, static_cast<ULONG>(ip_dst)));
+   result = board_backend(
+       ).set_stream_property(stream_handle, VHD_IP_BRD_SP_IP_DST, static_cast<ULONG>(destination.address.value()));
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting destination IP: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_IP_BRD_SP_UDP_PORT_DST, static_cast<ULONG>(port_dst)));
+   result = board_backend(
+       ).set_stream_property(stream_handle, VHD_IP_BRD_SP_UDP_PORT_DST, static_cast<ULONG>(destination.port));
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting destination UDP port: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
    return result == VHDERR_NOERROR;
@@ -494,7 +633,6 @@ bool nmos_tools::NodeServerSender::update_connection_parameters(uint32_t ip_dst,
 
 bool nmos_tools::NodeServerSender::node_implementation_init()
 {
-   const unsigned int delay_millis{ 0 };
    uint32_t frame_heigth;
    uint32_t frame_width;
    uint32_t frame_rate;
@@ -504,13 +642,25 @@ bool nmos_tools::NodeServerSender::node_implementation_init()
 
    try
    {
-      NodeServer::node_implementation_init();
+      // the node, its device, the source, the flow and the sender are registered together
+      ResourceBatch batch;
+      add_node_resources(batch);
 
       ULONG video_standard_ul;
-      VHD_ERRORCODE result = static_cast<VHD_ERRORCODE>(
-          VHD_GetStreamProperty(stream_handle, VHD_ST2110_20_SP_VIDEO_STANDARD, &video_standard_ul));
-      if (result != VHDERR_NOERROR)
-         throw node_implementation_init_exception("Error while getting video standard");
+      if (stream_hooks.get_video_standard)
+      {
+         uint32_t video_standard_value;
+         if (!stream_hooks.get_video_standard(video_standard_value))
+            throw node_implementation_init_exception("Error while getting video standard");
+         video_standard_ul = video_standard_value;
+      }
+      else
+      {
+         VHD_ERRORCODE result = board_backend(
+             ).get_stream_property(stream_handle, VHD_ST2110_20_SP_VIDEO_STANDARD, &video_standard_ul);
+         if (result != VHDERR_NOERROR)
+            throw node_implementation_init_exception("Error while getting video standard");
+      }
 
       const auto video_standard = static_cast<VHD_ST2110_20_VIDEO_STANDARD>(video_standard_ul);
       if (get_video_standard_info(video_standard, frame_width, frame_heigth, frame_rate, interlaced, is_us) !=
@@ -524,7 +674,7 @@ bool nmos_tools::NodeServerSender::node_implementation_init()
 
       const auto seed_id = nmos::experimental::fields::seed_id(node_model.settings);
 
-      nmos::write_lock lock = node_model.write_lock(); // in order to update the resources
+      auto lock = node_model.read_lock(); // the settings are read while the resources are built
 
       //Start of sender specific part
       //Add one source
@@ -547,17 +697,15 @@ bool nmos_tools::NodeServerSender::node_implementation_init()
                                                                  : nmos::interlace_modes::progressive,
                                                       nmos::colorspaces::BT709,
                                                       nmos::transfer_characteristics::SDR,
-                                                      nmos::chroma_subsampling::YCbCr422,
-                                                      10,
+                                                      get_chroma_subsampling(video_format.sampling),
+                                                      get_component_depth(video_format.depth),
                                                       node_model.settings);
 
       flow.data[nmos::fields::label] = web::json::value::string(U("IPVC Video Flow"));
       flow.data[nmos::fields::description] = web::json::value::string(U("IP Virtual Card Video Flow"));
 
-      if (!insert_resource_after(node_model, lock, delay_millis, node_model.node_resources, std::move(source), gate))
-         throw node_implementation_init_exception("Failed to insert source resource");
-      if (!insert_resource_after(node_model, lock, delay_millis, node_model.node_resources, std::move(flow), gate))
-         throw node_implementation_init_exception("Failed to insert flow resource");
+      batch.add(node_model.node_resources, std::move(source));
+      batch.add(node_model.node_resources, std::move(flow));
 
       const auto manifest_href = nmos::experimental::make_manifest_api_manifest(sender_id, node_model.settings);
       auto sender = nmos::make_sender(sender_id,
@@ -576,17 +724,18 @@ bool nmos_tools::NodeServerSender::node_implementation_init()
       connection_sender.data[nmos::fields::endpoint_constraints][0][nmos::fields::source_ip]
          = web::json::value_of({
                { nmos::fields::constraint_enum,
-               web::json::value_of({nmos_tools::ipv4_to_string(active_transport_params.ip_src)})},
+               web::json::value_of({nmos_tools::ipv4_to_string(active_transport_params.source.address)})},
                               });
       connection_sender.data[nmos::fields::endpoint_constraints][0][nmos::fields::source_port] = web::json::value_of({
-          {nmos::fields::constraint_enum, web::json::value_of({active_transport_params.port_src})},
+          {nmos::fields::constraint_enum, web::json::value_of({active_transport_params.source.port})},
       });
 
-      if (!insert_resource_after(node_model, lock, delay_millis, node_model.node_resources, std::move(sender), gate))
-         throw node_implementation_init_exception("Failed to insert sender resource");
-      if (!insert_resource_after(
-              node_model, lock, delay_millis, node_model.connection_resources, std::move(connection_sender), gate))
-         throw node_implementation_init_exception("Failed to insert connection sender resource");
+      lock.unlock();
+
+      batch.add(node_model.node_resources, std::move(sender));
+      batch.add(node_model.connection_resources, std::move(connection_sender));
+      if (!insert_resources(batch))
+         throw node_implementation_init_exception("Failed to insert sender resources");
    }
    catch (const node_implementation_init_exception& e)
    {
@@ -628,26 +777,36 @@ void nmos_tools::NodeServerSender::patch_validator(const nmos::resource& resourc
                                                    const nmos::resource& connection_resource,
                                                    const web::json::value& endpoint_staged)
 {
+   const auto callback_measurement = measure("patch_validator");
+
    // debug log the json objects
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: resource: " << std::endl
-                                                          << resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: connection_resource: " << std::endl
-                                                          << connection_resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: endpoint_staged: " << std::endl
-                                                          << endpoint_staged.serialize();
+   {
+      const auto serialization_measurement = measure("json_serialization");
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: resource: " << std::endl
+                                                             << serialized(resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: connection_resource: " << std::endl
+                                                             << serialized(connection_resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: endpoint_staged: " << std::endl
+                                                             << serialized(endpoint_staged);
+   }
 }
 
 void nmos_tools::NodeServerReceiver::patch_validator(const nmos::resource& resource,
                                                      const nmos::resource& connection_resource,
                                                      const web::json::value& endpoint_staged)
 {
+   const auto callback_measurement = measure("patch_validator");
+
    // debug log the json objects
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: resource: " << std::endl
-                                                          << resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: connection_resource: " << std::endl
-                                                          << connection_resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: endpoint_staged: " << std::endl
-                                                          << endpoint_staged.serialize();
+   {
+      const auto serialization_measurement = measure("json_serialization");
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: resource: " << std::endl
+                                                             << serialized(resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: connection_resource: " << std::endl
+                                                             << serialized(connection_resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "patch_validator: endpoint_staged: " << std::endl
+                                                             << serialized(endpoint_staged);
+   }
 
    // check if the sdp is not null
    if (endpoint_staged.at(nmos::fields::transport_file).at(nmos::fields::data).is_null())
@@ -658,51 +817,63 @@ void nmos_tools::NodeServerSender::resolve_auto(const nmos::resource& resource,
                                                 const nmos::resource& connection_resource,
                                                 web::json::value& transport_params)
 {
+   const auto callback_measurement = measure("resolve_auto");
+
    // debug log the json objects
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: resource: " << std::endl
-                                                          << resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: connection_resource: " << std::endl
-                                                          << connection_resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: transport_params: " << std::endl
-                                                          << transport_params.serialize();
+   {
+      const auto serialization_measurement = measure("json_serialization");
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: resource: " << std::endl
+                                                             << serialized(resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "resolve_auto_sender: connection_resource: " << std::endl
+          << serialized(connection_resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "resolve_auto_sender: transport_params: " << std::endl
+                                                             << serialized(transport_params);
+   }
 
    for (auto& transport_param : transport_params.as_array())
    {
       if (is_field_auto(transport_param, nmos::fields::destination_ip))
       {
          transport_param[nmos::fields::destination_ip] =
-             web::json::value::string(ipv4_to_string(resolve_auto_transport_params.ip_dst));
+             web::json::value::string(ipv4_to_string(resolve_auto_transport_params.destination.address));
       }
       if (is_field_auto(transport_param, nmos::fields::destination_port))
       {
          transport_param[nmos::fields::destination_port] =
-             web::json::value::number(resolve_auto_transport_params.port_dst);
+             web::json::value::number(resolve_auto_transport_params.destination.port);
       }
       if (is_field_auto(transport_param, nmos::fields::source_ip))
       {
          transport_param[nmos::fields::source_ip] =
-             web::json::value::string(ipv4_to_string(resolve_auto_transport_params.ip_src));
+             web::json::value::string(ipv4_to_string(resolve_auto_transport_params.source.address));
       }
       if (is_field_auto(transport_param, nmos::fields::source_port))
       {
-         transport_param[nmos::fields::source_port] = web::json::value::number(resolve_auto_transport_params.port_src);
+         transport_param[nmos::fields::source_port] = web::json::value::number(resolve_auto_transport_params.source.port);
       }
    }
 
+   const auto serialization_measurement = measure("json_serialization");
    slog::log<slog::severities::more_info>(gate, SLOG_FLF)
        << "resolve_auto_sender: resolved_transport_params: " << std::endl
-       << transport_params.serialize();
+       << serialized(transport_params);
 }
 
 void nmos_tools::NodeServerSender::connection_activation(const nmos::resource& resource,
                                                          const nmos::resource& connection_resource)
 {
+   const auto callback_measurement = measure("connection_activation");
+
    // debug log the json objects
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "connection_activation_sender: resource: " << std::endl
-                                                          << resource.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF)
-       << "connection_activation_sender: connection_resource: " << std::endl
-       << connection_resource.data.serialize();
+   {
+      const auto serialization_measurement = measure("json_serialization");
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "connection_activation_sender: resource: " << std::endl
+                                                             << serialized(resource.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "connection_activation_sender: connection_resource: " << std::endl
+          << serialized(connection_resource.data);
+   }
 
    // parameters have been activated, communicate those modifications to the sample in order to reflect the model
    // changes
@@ -713,44 +884,58 @@ void nmos_tools::NodeServerSender::connection_activation(const nmos::resource& r
        connection_resource.data.at(nmos::fields::active).at(nmos::fields::transport_params).as_array();
    const web::json::object& active_transport_params_object = active_transport_params_array.at(0).as_object();
 
-   active_transport_params.ip_dst =
+   active_transport_params.destination.address =
        string_to_ipv4(active_transport_params_object.at(nmos::fields::destination_ip).as_string());
-   active_transport_params.port_dst = active_transport_params_object.at(nmos::fields::destination_port).as_integer();
-   active_transport_params.ip_src =
+   active_transport_params.destination.port =
+       static_cast<uint16_t>(active_transport_params_object.at(nmos::fields::destination_port).as_integer());
+   active_transport_params.source.address =
        string_to_ipv4(active_transport_params_object.at(nmos::fields::source_ip).as_string());
-   active_transport_params.port_src = active_transport_params_object.at(nmos::fields::source_port).as_integer();
+   active_transport_params.source.port =
+       static_cast<uint16_t>(active_transport_params_object.at(nmos::fields::source_port).as_integer());
 }
 
 void nmos_tools::NodeServerSender::transportfile_setter(const nmos::resource& sender,
                                                         const nmos::resource& connection_sender,
                                                         web::json::value& endpoint_transportfile)
 {
+   const auto callback_measurement = measure("transportfile_setter");
+
    // debug log the json objects
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "transportfile_setter: sender: " << std::endl
-                                                          << sender.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "transportfile_setter: connection_sender: " << std::endl
-                                                          << connection_sender.data.serialize();
-   slog::log<slog::severities::more_info>(gate, SLOG_FLF)
-       << "transportfile_setter: endpoint_transportfile: " << std::endl
-       << endpoint_transportfile.serialize();
+   {
+      const auto serialization_measurement = measure("json_serialization");
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "transportfile_setter: sender: " << std::endl
+                                                             << serialized(sender.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF) << "transportfile_setter: connection_sender: " << std::endl
+                                                             << serialized(connection_sender.data);
+      slog::log<slog::severities::more_info>(gate, SLOG_FLF)
+          << "transportfile_setter: endpoint_transportfile: " << std::endl
+          << serialized(endpoint_transportfile);
+   }
 
    // update sdp to reflect changes in transport_params
    const web::json::array& active_transport_params =
        connection_sender.data.at(U("active")).at(U("transport_params")).as_array();
 
    // Update the sender with destination IP and port
-   bool update_success =
-       update_connection_parameters(string_to_ipv4(active_transport_params.at(0).at(U("destination_ip")).as_string()),
-                                    active_transport_params.at(0).at(U("destination_port")).as_integer());
-   if (!update_success)
+   const Ipv4Endpoint destination = {
+       string_to_ipv4(active_transport_params.at(0).at(U("destination_ip")).as_string()),
+       static_cast<uint16_t>(active_transport_params.at(0).at(U("destination_port")).as_integer())};
+   std::string sdp;
+   VHD_ERRORCODE result = VHDERR_NOERROR;
    {
-      throw web::json::json_exception("Error while updating connection parameters");
-   }
+      const auto stream_measurement = measure("vhd_calls");
+      bool update_success = update_connection_parameters(destination);
+      if (!update_success)
+      {
+         throw web::json::json_exception("Error while updating connection parameters");
+      }
 
-   // sdp must be set before the stream restart, so we have to call generate sdp here
-   std::string sdp;
-   VHD_ERRORCODE result =
-       generate_sdp(board_handle, stream_handle, sdp);
+      // sdp must be set before the stream restart, so we have to call generate sdp here
+      if (stream_hooks.generate_sdp)
+         result = stream_hooks.generate_sdp(destination, sdp) ? VHDERR_NOERROR : VHDERR_FATALERROR;
+      else
+         result = generate_sdp(board_handle, stream_handle, sdp);
+   }
 
    if (result == VHDERR_NOERROR)
    {
@@ -763,41 +948,32 @@ void nmos_tools::NodeServerSender::transportfile_setter(const nmos::resource& se
    }
 }
 
-utility::string_t nmos_tools::ipv4_to_string(uint32_t ipv4_network_byte_order)
+utility::string_t nmos_tools::ipv4_to_string(Ipv4Address ipv4_address)
 {
-   std::stringstream ss;
-   ss << ((ipv4_network_byte_order >> 24) & 0xFF) << "."
-      << ((ipv4_network_byte_order >> 16) & 0xFF) << "."
-      << ((ipv4_network_byte_order >> 8) & 0xFF) << "."
-      << (ipv4_network_byte_order & 0xFF);
-   return utility::conversions::to_string_t(ss.str());
+   const auto ipv4_chars = to_chars(ipv4_address);
+   return utility::string_t(ipv4_chars.view().begin(), ipv4_chars.view().end());
 }
 
-uint32_t nmos_tools::string_to_ipv4(const utility::string_t& ipv4_string)
+Ipv4Address nmos_tools::string_to_ipv4(const utility::string_t& ipv4_string)
 {
-   std::string utf8_str = utility::conversions::to_utf8string(ipv4_string);
-   uint32_t ipv4_network_byte_order = 0;
-   std::istringstream iss(utf8_str);
-   std::vector<uint32_t> octets;
-   std::string octet;
+   // utility::string_t may be a wide string, narrow it into a fixed-size buffer before parsing
+   char ipv4_chars[Ipv4Address::max_string_size];
+   if (ipv4_string.size() > sizeof(ipv4_chars))
+      return Ipv4Address();
 
-   while (std::getline(iss, octet, '.')) {
-       if (octets.size() >= 4) break;
-       try {
-           uint32_t value = std::stoul(octet);
-           if (value > 255) return 0;
-           octets.push_back(value);
-       } catch (...) {
-           return 0;
-       }
+   for (size_t i = 0; i < ipv4_string.size(); i++)
+   {
+      if (static_cast<unsigned int>(ipv4_string[i]) > 127)
+         return Ipv4Address();
+      ipv4_chars[i] = static_cast<char>(ipv4_string[i]);
    }
 
-   if (octets.size() == 4) {
-       ipv4_network_byte_order = (octets[0] << 24) |
-                                 (octets[1] << 16) |
-                                 (octets[2] << 8) |
-                                 octets[3];
-   }
+   Ipv4Address ipv4_address;
+   Ipv4Address::parse(std::string_view(ipv4_chars, ipv4_string.size()), ipv4_address);
+   return ipv4_address;
+}
 
-   return ipv4_network_byte_order;
+std::ostream& nmos_tools::operator<<(std::ostream& stream, const Serialized& serialized)
+{
+   return stream << utility::conversions::to_utf8string(serialized.value.serialize());
 }
@@ -19,6 +19,14 @@
 #include "nmos/server.h"
 #include "nmos/mutex.h"
 
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "ipv4.h"
+#include "latency_recorder.h"
+#include "video_format.h"
+
 namespace nmos_tools
 {
    struct NmosPtpSystemParameters{
@@ -35,6 +43,13 @@ namespace nmos_tools
       }
    }; /*! PTP parameters as defined in PTP standard IEEE 1588-2008 */;
 
+   struct RegistrationStatistics{
+      uint64_t nb_resources     /*! Resources inserted into the node model */ = 0;
+      uint64_t nb_batches       /*! Batches the resources were inserted in */ = 0;
+      uint64_t nb_notifications /*! Notifications of the node behaviour thread, which registers the changes */ = 0;
+      double insertion_ms       /*! Time the node model write lock was held to insert the resources */ = 0.0;
+   }; /*! Insertions of the node resources, each notification starts a registration pass */
+
    class NodeServer
    {
    public:
@@ -47,6 +62,15 @@ namespace nmos_tools
 
       bool get_ptp_system_parameters(NmosPtpSystemParameters& ptp_system_parameters);
 
+      // the MAC address may be set after construction, as long as it is before node_implementation_init()
+      void set_media_nic_mac_address(const std::string& media_nic_mac_address);
+
+      // the callbacks record their latency in the recorder, if any; it must outlive the node server
+      void set_latency_recorder(LatencyRecorder* latency_recorder);
+
+      RegistrationStatistics get_registration_statistics();
+      void print_registration_statistics();
+
       void start();
       void stop();
 
@@ -65,9 +89,23 @@ namespace nmos_tools
       nmos::server node_server;
       nmos::id node_id;
       nmos::id device_id;
+      LatencyRecorder* latency_recorder = nullptr;
+
+      // resources to insert into the node model together, see insert_resources()
+      struct ResourceBatch{
+         std::vector<std::pair<nmos::resources*, nmos::resource>> resources;
+
+         void add(nmos::resources& resources, nmos::resource&& resource)
+         {
+            this->resources.emplace_back(&resources, std::move(resource));
+         }
+      };
 
       virtual bool node_implementation_init();
 
+      // add the node and device resources to the batch
+      void add_node_resources(ResourceBatch& batch);
+
       // callbacks
       void system_params_handler(const web::uri& system_uri, const web::json::value& system_global);
       virtual void resolve_auto(const nmos::resource& resource, const nmos::resource& connection_resource,
@@ -77,9 +115,11 @@ namespace nmos_tools
       virtual void connection_activation(const nmos::resource& resource, const nmos::resource& connection_resource) = 0;
 
       // helpers
-      bool insert_resource_after(nmos::node_model& node_model, nmos::write_lock& lock, unsigned int milliseconds,
-                                 nmos::resources& resources, nmos::resource&& resource, slog::base_gate& gate);
+      // insert every resource of the batch under one write lock and notify the node behaviour thread once, so that
+      // the resources of a stream are registered in a single pass; no resource is inserted if one of them cannot be
+      bool insert_resources(ResourceBatch& batch);
       bool is_field_auto(const web::json::value& object, const web::json::field_as_value_or& field_name);
+      LatencyRecorder::Measurement measure(const char* name);
 
       class node_implementation_init_exception : public std::exception
       {
@@ -99,6 +139,9 @@ namespace nmos_tools
       NmosPtpSystemParameters m_ptp_system_parameters;
       std::mutex m_ptp_system_parameters_mutex;
       bool m_are_system_parameters_valid = false;
+
+      RegistrationStatistics m_registration_statistics;
+      std::mutex m_registration_statistics_mutex;
    };
 
    class NodeServerReceiver : public nmos_tools::NodeServer
@@ -106,14 +149,13 @@ namespace nmos_tools
    public:
 
       struct TransportParams{
-         uint32_t ip_interface /*! Receiver interface ip. */ = 0u;
-         uint32_t ip_multicast /*! Multicast destination ip : can be equal to 0 if unicast used. */ = 0u;
-         uint32_t ip_src /*! Source ip : filtering, if equals to 0 disable filtering. */ = 0u;
-         uint16_t port_dst /*! Destination port. */ = 0u;
+         Ipv4Address interface_ip /*! Receiver interface ip. */;
+         Ipv4Endpoint destination /*! Multicast destination ip (unspecified if unicast used) and destination port. */;
+         Ipv4Address source_ip /*! Source ip : filtering, if unspecified disable filtering. */;
 
          bool operator==(const TransportParams& other) const {
-            return std::tie(ip_interface, ip_multicast, ip_src, port_dst) ==
-                   std::tie(other.ip_interface, other.ip_multicast, other.ip_src, other.port_dst);
+            return std::tie(interface_ip, destination, source_ip) ==
+                   std::tie(other.interface_ip, other.destination, other.source_ip);
          }
 
          bool operator!=(const TransportParams& other) const {
@@ -155,14 +197,11 @@ namespace nmos_tools
    public:
 
       struct TransportParams{
-         uint32_t ip_src   /*! Source IP address. */;
-         uint16_t port_src /*! Source port. */;
-         uint32_t ip_dst   /*! Destination IP address. */;
-         uint16_t port_dst /*! Destination port. */;
-         
+         Ipv4Endpoint source      /*! Source IP address and port. */;
+         Ipv4Endpoint destination /*! Destination IP address and port. */;
+
          bool operator==(const TransportParams& other) const {
-            return std::tie(ip_src, port_src, ip_dst, port_dst) ==
-                   std::tie(other.ip_src, other.port_src, other.ip_dst, other.port_dst);
+            return std::tie(source, destination) == std::tie(other.source, other.destination);
          }
          bool operator!=(const TransportParams& other) const {
             return !(*this == other);
@@ -173,22 +212,41 @@ namespace nmos_tools
 
       NodeServerSender(nmos::node_model& node_model, nmos::experimental::log_model& log_model, slog::base_gate& gate,
                        const std::string device_name, const std::string device_description,
-                       void *board_handle, void *stream_handle,
+                       void *&board_handle, void *&stream_handle,
                        TransportParams& resolve_auto_transport_params, TransportParams& active_transport_params,
                        std::string media_nic_name, std::string media_nic_mac_address, std::string sdp = "");
 
       bool node_implementation_init() override;
 
+      // the SDP may be set after construction, as long as it is before node_implementation_init()
+      void set_sdp(const std::string& sdp);
+
+      // the sampling and depth of the flow, YCbCr-4:2:2 10-bit by default, must be set before node_implementation_init()
+      void set_video_format(const VideoFormat& video_format);
+
+      // replacement of the VideoMaster stream calls, for a sender whose frames are not sent by a board
+      struct StreamHooks{
+         std::function<bool(uint32_t& video_standard)> get_video_standard; // VHD_ST2110_20_VIDEO_STANDARD of the flow
+         std::function<bool(const Ipv4Endpoint& destination)> set_destination;
+         std::function<bool(const Ipv4Endpoint& destination, std::string& sdp)> generate_sdp;
+      };
+
+      // the hooks must be set before node_implementation_init()
+      void set_stream_hooks(const StreamHooks& stream_hooks);
+
    private:
 
-      void *board_handle;
-      void *stream_handle;
+      // references, so that the node server follows the stream when the sample reopens it
+      void *&board_handle;
+      void *&stream_handle;
+      StreamHooks stream_hooks;
+      VideoFormat video_format = default_video_format;
 
       TransportParams& resolve_auto_transport_params;
 
       nmos::experimental::node_implementation make_node_implementation();
 
-      bool update_connection_parameters(uint32_t ip_dst, uint16_t port_dst);
+      bool update_connection_parameters(const Ipv4Endpoint& destination);
 
       void resolve_auto(const nmos::resource& resource, const nmos::resource& connection_resource,
                         web::json::value& transport_params) override;
@@ -200,9 +258,28 @@ namespace nmos_tools
                                 web::json::value& endpoint_transportfile);
    };
 
-   // convert the given ipv4 address in network byte order to a string representation of the form "a.b.c.d"
-   utility::string_t ipv4_to_string(uint32_t ipv4_network_byte_order);
+   // constraint sets of the receiver caps, one per frame geometry of the supported video standards enumerating their
+   // grain rates (see video_constraints.h)
+   web::json::value make_video_constraint_sets();
+
+   // convert the given ipv4 address to a string representation of the form "a.b.c.d"
+   utility::string_t ipv4_to_string(Ipv4Address ipv4_address);
+
+   // convert the given string representation of an ipv4 address of the form "a.b.c.d" to an ipv4 address,
+   // the unspecified address (0.0.0.0) is returned if the string is not a valid ipv4 address
+   Ipv4Address string_to_ipv4(const utility::string_t& ipv4_string);
+
+   // a json value serialized only when it is streamed, so that a log statement which is not pertinent does not
+   // serialize it, e.g. slog::log<slog::severities::more_info>(gate, SLOG_FLF) << serialized(resource.data)
+   struct Serialized
+   {
+      const web::json::value& value;
+   };
+
+   inline Serialized serialized(const web::json::value& value)
+   {
+      return {value};
+   }
 
-   // convert the given string representation of an ipv4 address of the form "a.b.c.d" to an ipv4 address in network byte order
-   uint32_t string_to_ipv4(const utility::string_t& ipv4_string);
+   std::ostream& operator<<(std::ostream& stream, const Serialized& serialized);
 }
@@ -0,0 +1,364 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "numa.h"
+#include "tools.h"
+#include "board_backend.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+namespace
+{
+   // Memory policies of set_mempolicy(2) and mbind(2), see <numaif.h>
+   const int mpol_preferred = 1;
+   const int mpol_bind = 2;
+   const unsigned long max_numa_nodes = 8 * sizeof(unsigned long);
+
+   bool read_numa_node_cpus(int numa_node, cpu_set_t& cpus)
+   {
+      std::ifstream cpulist_file("/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist");
+      std::string cpulist;
+      if (!std::getline(cpulist_file, cpulist))
+         return false;
+
+      // cpulist is of the form "0-7,16-23"
+      CPU_ZERO(&cpus);
+      std::istringstream iss(cpulist);
+      std::string range;
+      while (std::getline(iss, range, ','))
+      {
+         unsigned int first = 0, last = 0;
+         if (std::sscanf(range.c_str(), "%u-%u", &first, &last) == 1)
+            last = first;
+         for (unsigned int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &cpus);
+      }
+      return CPU_COUNT(&cpus) > 0;
+   }
+
+   // The node ids may have holes, online is a list of the form "0-1,3"
+   bool read_online_numa_nodes(std::vector<int>& numa_nodes)
+   {
+      std::ifstream online_file("/sys/devices/system/node/online");
+      std::string online;
+      numa_nodes.clear();
+      if (!std::getline(online_file, online))
+         return false;
+
+      std::istringstream iss(online);
+      std::string range;
+      while (std::getline(iss, range, ','))
+      {
+         int first = 0, last = 0;
+         const int nb_fields = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+         if (nb_fields < 1)
+            return false;
+         if (nb_fields == 1)
+            last = first;
+         for (int numa_node = first; numa_node <= last; numa_node++)
+            numa_nodes.push_back(numa_node);
+      }
+      return !numa_nodes.empty();
+   }
+
+   bool read_numa_node_distances(int numa_node, std::vector<int>& distances)
+   {
+      // distance holds the ACPI SLIT row of the node, one relative distance per node, e.g. "10 21 31 21"
+      std::ifstream distance_file("/sys/devices/system/node/node" + std::to_string(numa_node) + "/distance");
+      distances.clear();
+      int distance = 0;
+      while (distance_file >> distance)
+         distances.push_back(distance);
+      return !distances.empty();
+   }
+}
+#endif
+
+bool bind_memory_to_numa_node(void* data, size_t size, int numa_node)
+{
+#if defined(__linux__)
+   if (numa_node < 0 || static_cast<unsigned long>(numa_node) >= max_numa_nodes)
+      return false;
+   unsigned long node_mask = 1ul << numa_node;
+   return syscall(SYS_mbind, data, size, mpol_bind, &node_mask, max_numa_nodes, 0) == 0;
+#else
+   return false;
+#endif
+}
+
+NumaBuffer::NumaBuffer(size_t size, int numa_node) : m_size(size), m_numa_node(numa_node)
+{
+#if defined(__linux__)
+   void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (data == MAP_FAILED)
+   {
+      std::cout << "Error when allocating a " << size << " bytes buffer" << std::endl;
+      m_size = 0;
+      return;
+   }
+   m_data = static_cast<uint8_t*>(data);
+
+   if (numa_node >= 0 && !bind_memory_to_numa_node(m_data, m_size, numa_node))
+      m_numa_node = -1;
+
+   // Fault the pages in now so that the first frame does not pay for it
+   std::memset(m_data, 0, m_size);
+#else
+   m_data = new uint8_t[size]();
+   m_numa_node = -1;
+#endif
+}
+
+NumaBuffer::~NumaBuffer()
+{
+   release();
+}
+
+NumaBuffer::NumaBuffer(NumaBuffer&& other) noexcept
+    : m_data(other.m_data), m_size(other.m_size), m_numa_node(other.m_numa_node)
+{
+   other.m_data = nullptr;
+   other.m_size = 0;
+}
+
+NumaBuffer& NumaBuffer::operator=(NumaBuffer&& other) noexcept
+{
+   if (this != &other)
+   {
+      release();
+      m_data = other.m_data;
+      m_size = other.m_size;
+      m_numa_node = other.m_numa_node;
+      other.m_data = nullptr;
+      other.m_size = 0;
+   }
+   return *this;
+}
+
+void NumaBuffer::release()
+{
+   if (!m_data)
+      return;
+#if defined(__linux__)
+   munmap(m_data, m_size);
+#else
+   delete[] m_data;
+#endif
+   m_data = nullptr;
+   m_size = 0;
+}
+
+VHD_ERRORCODE open_all_boards(std::vector<BoardContext>& boards, uint32_t streaming_board_id)
+{
+   VHD_ERRORCODE result;
+   ULONG dll_version = 0, nb_boards = 0;
+
+   boards.clear();
+
+   result = board_backend().get_api_info(&dll_version, &nb_boards);
+   if (result != VHDERR_NOERROR)
+   {
+      std::cout << "Error when getting the API info" << " [" << to_string(result) << "]" << std::endl;
+      return result;
+   }
+
+   for (uint32_t board_id = 0; board_id < nb_boards; board_id++)
+   {
+      BoardContext board;
+      board.board_id = board_id;
+      board.nic_name = "delta" + std::to_string(board_id);
+      board.numa_node = get_nic_numa_node(board.nic_name);
+
+      result = board_backend().open_board_handle(board_id, &board.handle, nullptr, 0ul);
+      if (result != VHDERR_NOERROR)
+      {
+         std::cout << "Error when opening the board handle " << board_id << " [" << to_string(result) << "]"
+                   << std::endl;
+         if (board_id == streaming_board_id)
+         {
+            close_all_boards(boards);
+            return result;
+         }
+         // A board the sample does not stream on is only reported, it is kept unopened
+         board.handle = nullptr;
+      }
+
+      boards.push_back(board);
+   }
+
+   return VHDERR_NOERROR;
+}
+
+void close_all_boards(std::vector<BoardContext>& boards)
+{
+   for (auto& board : boards)
+   {
+      if (!board.handle)
+         continue;
+
+      VHD_ERRORCODE result = board_backend().close_board_handle(board.handle);
+      if (result != VHDERR_NOERROR)
+         std::cout << "Error when closing the board handle " << board.board_id << " [" << to_string(result) << "]"
+                   << std::endl;
+      board.handle = nullptr;
+   }
+   boards.clear();
+}
+
+int get_nic_numa_node(const std::string& nic_name)
+{
+#if defined(__linux__)
+   std::ifstream numa_node_file("/sys/class/net/" + nic_name + "/device/numa_node");
+   int numa_node = -1;
+   if (numa_node_file >> numa_node)
+      return numa_node;
+#endif
+   return -1;
+}
+
+int get_numa_node_count()
+{
+#if defined(__linux__)
+   std::vector<int> numa_nodes;
+   read_online_numa_nodes(numa_nodes);
+   return numa_nodes.empty() ? 1 : static_cast<int>(numa_nodes.size());
+#else
+   return 1;
+#endif
+}
+
+int get_farthest_numa_node(int numa_node)
+{
+#if defined(__linux__)
+   // The distances are given to every online node, in the order of their ids
+   std::vector<int> distances, numa_nodes;
+   if (numa_node < 0 || !read_numa_node_distances(numa_node, distances) || !read_online_numa_nodes(numa_nodes) ||
+       numa_nodes.size() != distances.size())
+      return -1;
+
+   int farthest_node = -1, farthest_distance = 0;
+   for (size_t i = 0; i < distances.size(); i++)
+   {
+      if (numa_nodes[i] != numa_node && (farthest_node < 0 || distances[i] > farthest_distance))
+      {
+         farthest_node = numa_nodes[i];
+         farthest_distance = distances[i];
+      }
+   }
+   return farthest_node;
+#else
+   return -1;
+#endif
+}
+
+int get_current_numa_node()
+{
+#if defined(__linux__)
+   unsigned int cpu = 0, numa_node = 0;
+   if (syscall(SYS_getcpu, &cpu, &numa_node, nullptr) == 0)
+      return static_cast<int>(numa_node);
+#endif
+   return -1;
+}
+
+bool bind_current_thread_to_numa_node(int numa_node)
+{
+#if defined(__linux__)
+   if (numa_node < 0 || static_cast<unsigned long>(numa_node) >= max_numa_nodes)
+      return false;
+
+   cpu_set_t cpus;
+   if (!read_numa_node_cpus(numa_node, cpus))
+      return false;
+
+   if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+      return false;
+
+   // Buffers first touched by this thread will then be allocated on the same node
+   unsigned long node_mask = 1ul << numa_node;
+   return syscall(SYS_set_mempolicy, mpol_preferred, &node_mask, max_numa_nodes) == 0;
+#else
+   return false;
+#endif
+}
+
+double measure_numa_copy_bandwidth(size_t size, int source_node, int destination_node)
+{
+   const int nb_copies = 16;
+
+   NumaBuffer source(size, source_node);
+   NumaBuffer destination(size, destination_node);
+   if (!source.data() || !destination.data())
+      return 0.0;
+
+   const auto start = std::chrono::steady_clock::now();
+   for (int i = 0; i < nb_copies; i++)
+      std::memcpy(destination.data(), source.data(), size);
+   const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+   return elapsed.count() > 0.0 ? (static_cast<double>(size) * nb_copies) / elapsed.count() : 0.0;
+}
+
+void print_numa_placement_report(const std::vector<BoardContext>& boards, size_t frame_size)
+{
+   const int nb_numa_nodes = get_numa_node_count();
+
+   std::cout << "NUMA: " << nb_numa_nodes << " node(s), " << boards.size() << " board(s)" << std::endl;
+   for (const auto& board : boards)
+   {
+      std::cout << "\tBoard " << board.board_id << " (" << board.nic_name << "): NUMA node ";
+      if (board.numa_node >= 0)
+         std::cout << board.numa_node;
+      else
+         std::cout << "unknown";
+      std::cout << (board.handle ? "" : " (not opened)") << std::endl;
+   }
+
+   if (nb_numa_nodes < 2)
+      return;
+
+   // Compare, for each board, a frame copy landing on its local node with one coming from the farthest node
+   for (const auto& board : boards)
+   {
+      if (board.numa_node < 0)
+         continue;
+
+      const int remote_node = get_farthest_numa_node(board.numa_node);
+      if (remote_node < 0)
+         continue;
+      const double local_bandwidth = measure_numa_copy_bandwidth(frame_size, board.numa_node, board.numa_node);
+      const double remote_bandwidth = measure_numa_copy_bandwidth(frame_size, remote_node, board.numa_node);
+
+      std::cout << "\tBoard " << board.board_id << " frame copy: local " << local_bandwidth / 1e9
+                << " GB/s - cross-node (from node " << remote_node << ") " << remote_bandwidth / 1e9 << " GB/s";
+      if (remote_bandwidth > 0.0)
+         std::cout << " - x" << local_bandwidth / remote_bandwidth;
+      std::cout << std::endl;
+   }
+}
@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file numa.h
+   @brief This file contains the helpers used to open every board of the host and to place the slot loops and
+   their frame buffers on the NUMA node local to each board.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Core.h"
+#else
+#include "VideoMasterHD_Core.h"
+#endif
+
+/*!
+   @brief Board opened by open_all_boards() and its placement on the host
+*/
+struct BoardContext
+{
+   uint32_t board_id /*! Board index as given to VHD_OpenBoardHandle */ = 0;
+   HANDLE handle /*! Board handle */ = nullptr;
+   std::string nic_name /*! Name of the media network interface of the board */;
+   int numa_node /*! NUMA node the board is attached to, -1 if unknown */ = -1;
+};
+
+/*!
+   @brief Buffer whose pages are bound to a given NUMA node
+
+   @detail When the node is unknown or the platform does not support NUMA placement, the buffer is a plain
+   anonymous allocation.
+*/
+class NumaBuffer
+{
+public:
+   NumaBuffer() = default;
+   NumaBuffer(size_t size /*!< [in] Size of the buffer in bytes*/, int numa_node /*!< [in] NUMA node, -1 for any*/);
+   ~NumaBuffer();
+
+   NumaBuffer(const NumaBuffer&) = delete;
+   NumaBuffer& operator=(const NumaBuffer&) = delete;
+   NumaBuffer(NumaBuffer&& other) noexcept;
+   NumaBuffer& operator=(NumaBuffer&& other) noexcept;
+
+   uint8_t* data() const { return m_data; }
+   size_t size() const { return m_size; }
+   int numa_node() const { return m_numa_node; }
+
+private:
+   void release();
+
+   uint8_t* m_data = nullptr;
+   size_t m_size = 0;
+   int m_numa_node = -1;
+};
+
+/*!
+   @brief Bind the pages of a memory range to a NUMA node, before they are faulted in
+
+   @returns True if the range has been bound
+*/
+bool bind_memory_to_numa_node(void* data /*!< [in] Start of the range, page aligned*/,
+                              size_t size /*!< [in] Size of the range in bytes*/,
+                              int numa_node /*!< [in] NUMA node to bind to*/);
+
+/*!
+   @brief Open every board detected by the VideoMaster API and resolve the NUMA node of each one
+
+   @detail A board that fails to open is kept in boards with a null handle, unless it is the streaming board.
+
+   @returns VHDERR_NOERROR if the streaming board was opened. On error, the boards already opened are closed.
+*/
+VHD_ERRORCODE open_all_boards(std::vector<BoardContext>& boards /*!< [out] Boards, indexed by board ID*/,
+                              uint32_t streaming_board_id /*!< [in] Board the sample streams on, it must open*/);
+
+/*!
+   @brief Close the boards opened by open_all_boards()
+*/
+void close_all_boards(std::vector<BoardContext>& boards /*!< [inout] Boards to close*/);
+
+/*!
+   @brief Get the NUMA node a network interface is attached to
+
+   @returns The NUMA node, -1 if unknown
+*/
+int get_nic_numa_node(const std::string& nic_name /*!< [in] Name of the network interface*/);
+
+/*!
+   @brief Get the number of NUMA nodes of the host
+
+   @returns The number of NUMA nodes, 1 if the platform does not expose NUMA information
+*/
+int get_numa_node_count();
+
+/*!
+   @brief Get the NUMA node at the greatest distance from a node, from the distances reported by the kernel
+
+   @returns The farthest NUMA node, -1 if the distances are unknown or the host has a single node
+*/
+int get_farthest_numa_node(int numa_node /*!< [in] NUMA node to measure the distances from*/);
+
+/*!
+   @brief Get the NUMA node of the CPU the calling thread is currently running on
+
+   @returns The NUMA node, -1 if unknown
+*/
+int get_current_numa_node();
+
+/*!
+   @brief Restrict the calling thread to the CPUs of a NUMA node and make its allocations prefer that node
+
+   @returns True if the thread has been bound
+*/
+bool bind_current_thread_to_numa_node(int numa_node /*!< [in] NUMA node to bind to*/);
+
+/*!
+   @brief Measure the copy bandwidth from a buffer on a source node to a buffer on a destination node
+
+   @returns The bandwidth in bytes per second, 0 if the measurement failed
+*/
+double measure_numa_copy_bandwidth(size_t size /*!< [in] Size of one copy in bytes (typically a frame)*/,
+                                   int source_node /*!< [in] NUMA node of the source buffer*/,
+                                   int destination_node /*!< [in] NUMA node of the destination buffer*/);
+
+/*!
+   @brief Print the placement of the boards and, on multi-node hosts, compare a frame copy on the node local to
+   the board with a copy from the farthest node
+*/
+void print_numa_placement_report(const std::vector<BoardContext>& boards /*!< [in] Opened boards*/,
+                                 size_t frame_size /*!< [in] Size of a frame in bytes*/);
@@ -0,0 +1,155 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "packetizer.h"
+#include "pixel_conversion.h"
+
+namespace
+{
+   inline void write_be16(uint8_t* destination, uint32_t value)
+   {
+      destination[0] = static_cast<uint8_t>(value >> 8);
+      destination[1] = static_cast<uint8_t>(value);
+   }
+
+   inline void write_be32(uint8_t* destination, uint32_t value)
+   {
+      destination[0] = static_cast<uint8_t>(value >> 24);
+      destination[1] = static_cast<uint8_t>(value >> 16);
+      destination[2] = static_cast<uint8_t>(value >> 8);
+      destination[3] = static_cast<uint8_t>(value);
+   }
+}
+
+bool St2110_20Packetizer::is_supported(const VideoFormat& video_format)
+{
+   return video_format.sampling == VHD_ST2110_20_SAMPLING_YUV_422 && get_component_depth(video_format.depth);
+}
+
+St2110_20Packetizer::St2110_20Packetizer(const VideoStandardInfo& video_standard_info, uint32_t ssrc,
+                                         const VideoFormat& video_format, uint8_t payload_type,
+                                         uint32_t nb_pgroups_per_packet)
+    : m_video_standard_info(video_standard_info), m_video_format(video_format),
+      m_pgroup(get_pixel_group(video_format)), m_ssrc(ssrc), m_payload_type(payload_type),
+      m_period{video_standard_info.frame_rate * 1000ull, video_standard_info.is_us ? 1001ull : 1000ull}
+{
+   if (!nb_pgroups_per_packet)
+      nb_pgroups_per_packet = default_payload_size / m_pgroup.size;
+   const uint32_t nb_rows =
+       video_standard_info.interlaced ? video_standard_info.frame_height / 2 : video_standard_info.frame_height;
+   const uint32_t nb_pgroups_per_line = video_standard_info.frame_width / m_pgroup.nb_pixels;
+
+   uint32_t row = 0, pgroup_offset = 0;
+   while (row < nb_rows)
+   {
+      PacketLayout packet_layout = {};
+      uint32_t nb_remaining_pgroups = nb_pgroups_per_packet;
+      while (nb_remaining_pgroups > 0 && row < nb_rows && packet_layout.nb_segments < max_nb_segments)
+      {
+         const uint32_t nb_pgroups = std::min(nb_remaining_pgroups, nb_pgroups_per_line - pgroup_offset);
+         packet_layout.segments[packet_layout.nb_segments++] = {static_cast<uint16_t>(row),
+                                                                static_cast<uint16_t>(pgroup_offset * m_pgroup.nb_pixels),
+                                                                static_cast<uint16_t>(nb_pgroups)};
+         nb_remaining_pgroups -= nb_pgroups;
+         pgroup_offset += nb_pgroups;
+         if (pgroup_offset == nb_pgroups_per_line)
+         {
+            row++;
+            pgroup_offset = 0;
+         }
+      }
+      packet_layout.marker = (row == nb_rows);
+
+      uint32_t packet_size = header_size + packet_layout.nb_segments * segment_header_size;
+      for (uint32_t i = 0; i < packet_layout.nb_segments; i++)
+         packet_size += packet_layout.segments[i].nb_pgroups * m_pgroup.size;
+      m_max_packet_size = std::max(m_max_packet_size, packet_size);
+
+      m_packet_layouts.push_back(packet_layout);
+   }
+}
+
+uint32_t St2110_20Packetizer::build_packet(const uint8_t* frame, uint32_t field, uint32_t packet_index,
+                                           uint32_t rtp_timestamp, uint8_t* packet)
+{
+   const PacketLayout& packet_layout = m_packet_layouts[packet_index];
+   const uint32_t sequence_number = m_sequence_number++;
+
+   packet[0] = 0x80; // RTP version 2
+   packet[1] = static_cast<uint8_t>((packet_layout.marker ? 0x80 : 0x00) | m_payload_type);
+   write_be16(packet + 2, sequence_number & 0xffff);
+   write_be32(packet + 4, rtp_timestamp);
+   write_be32(packet + 8, m_ssrc);
+   write_be16(packet + 12, sequence_number >> 16);
+
+   uint8_t* segment_header = packet + header_size;
+   uint8_t* data = segment_header + packet_layout.nb_segments * segment_header_size;
+   const uint32_t line_size = m_video_standard_info.frame_width * yuv422_8_bytes_per_pixel;
+   // The fields are stored one after the other in the sender buffers
+   const uint32_t first_line = field ? (m_video_standard_info.frame_height + 1) / 2 : 0;
+
+   for (uint32_t i = 0; i < packet_layout.nb_segments; i++)
+   {
+      const Segment& segment = packet_layout.segments[i];
+      const bool continuation = (i + 1 < packet_layout.nb_segments);
+      write_be16(segment_header, segment.nb_pgroups * m_pgroup.size);
+      write_be16(segment_header + 2, (field ? 0x8000 : 0) | segment.row);
+      write_be16(segment_header + 4, (continuation ? 0x8000 : 0) | segment.offset);
+      segment_header += segment_header_size;
+
+      pack_pgroups(m_video_format,
+                   frame + static_cast<uint64_t>(first_line + segment.row) * line_size +
+                       segment.offset * yuv422_8_bytes_per_pixel,
+                   HostComponent::byte, line_size, data, segment.nb_pgroups);
+      data += segment.nb_pgroups * m_pgroup.size;
+   }
+
+   return static_cast<uint32_t>(data - packet);
+}
+
+std::string St2110_20Packetizer::generate_sdp(const Ipv4Endpoint& source, const Ipv4Endpoint& destination) const
+{
+   const int payload_type = m_payload_type;
+   // exactframerate is a frame rate, the table holds the field rate of interlaced standards
+   const uint32_t frame_rate =
+       m_video_standard_info.interlaced ? m_video_standard_info.frame_rate / 2 : m_video_standard_info.frame_rate;
+
+   std::stringstream sdp;
+   sdp << "v=0\r\n";
+   sdp << "o=- " << m_ssrc << " 0 IN IP4 " << to_chars(source.address).c_str() << "\r\n";
+   sdp << "s=Software ST 2110-20 sender\r\n";
+   sdp << "t=0 0\r\n";
+   sdp << "m=video " << destination.port << " RTP/AVP " << payload_type << "\r\n";
+   sdp << "c=IN IP4 " << to_chars(destination.address).c_str() << (destination.address.is_multicast() ? "/64" : "")
+       << "\r\n";
+   if (destination.address.is_multicast())
+      sdp << "a=source-filter: incl IN IP4 " << to_chars(destination.address).c_str() << " "
+          << to_chars(source.address).c_str() << "\r\n";
+   sdp << "a=rtpmap:" << payload_type << " raw/90000\r\n";
+   sdp << "a=fmtp:" << payload_type << " sampling=" << get_sampling_name(m_video_format.sampling) << "; width=" << m_video_standard_info.frame_width
+       << "; height=" << m_video_standard_info.frame_height << "; exactframerate=";
+   if (m_video_standard_info.is_us)
+      sdp << frame_rate * 1000 << "/1001";
+   else
+      sdp << frame_rate;
+   sdp << "; depth=" << get_component_depth(m_video_format.depth) << "; TCS=SDR; colorimetry=BT709; PM=2110GPM; SSN=ST2110-20:2017; TP=2110TPN; "
+       << (m_video_standard_info.interlaced ? "interlace; " : "") << "\r\n";
+   sdp << "a=mediaclk:direct=0\r\n";
+   sdp << "a=ts-refclk:ptp=IEEE1588-2008:traceable\r\n";
+   return sdp.str();
+}
@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file packetizer.h
+   @brief This file contains a software ST 2110-20 packetizer.
+
+   @detail The frames are taken in the VHD_BUFPACK_VIDEO_YUV422_8 layout the sender fills its slots with (Cb Y0 Cr
+   Y1 bytes, fields one after the other for interlaced video) and packetized as RFC 4175 YCbCr-4:2:2 pixel groups of
+   8, 10 or 12 bits per component, with a fixed number of pixel groups per packet wrapping from one line to the next.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "ipv4.h"
+#include "st2110_timing.h"
+#include "tools.h"
+#include "video_format.h"
+
+class St2110_20Packetizer
+{
+public:
+   static const uint32_t default_payload_size = 1200 /*! Bytes of video per packet, 4 packets per 1080p 10-bit line */;
+   static const uint32_t max_nb_segments = 4;
+   static const uint32_t header_size = 12 + 2 /*! RTP header and extended sequence number */;
+   static const uint32_t segment_header_size = 6;
+
+   St2110_20Packetizer(const VideoStandardInfo& video_standard_info /*!< [in] Video standard to packetize*/,
+                       uint32_t ssrc /*!< [in] RTP synchronization source*/,
+                       const VideoFormat& video_format = default_video_format /*!< [in] Format of the pixel groups, see is_supported()*/,
+                       uint8_t payload_type = 96 /*!< [in] RTP payload type*/,
+                       uint32_t nb_pgroups_per_packet = 0 /*!< [in] Pixel groups per packet, 0 for default_payload_size bytes*/);
+
+   /*!
+      @brief Whether the frames can be packetized in a video format: YCbCr-4:2:2, the sampling of the sender buffers
+   */
+   static bool is_supported(const VideoFormat& video_format /*!< [in] Format of the pixel groups*/);
+
+   const VideoStandardInfo& get_video_standard_info() const { return m_video_standard_info; }
+   const VideoFormat& get_video_format() const { return m_video_format; }
+
+   /*!
+      @brief Period of one RTP timestamp: a frame for progressive video, a field for interlaced video
+   */
+   const FramePeriod& get_period() const { return m_period; }
+
+   /*!
+      @brief Number of packets of a frame, of a field for interlaced video
+   */
+   uint32_t get_nb_packets_per_period() const { return static_cast<uint32_t>(m_packet_layouts.size()); }
+
+   /*!
+      @brief Largest packet built by build_packet()
+   */
+   uint32_t get_max_packet_size() const { return m_max_packet_size; }
+
+   /*!
+      @brief Build a packet of a frame
+
+      @returns The size of the packet
+   */
+   uint32_t build_packet(const uint8_t* frame /*!< [in] Frame in the VHD_BUFPACK_VIDEO_YUV422_8 layout*/,
+                         uint32_t field /*!< [in] Field to packetize, 0 for progressive video*/,
+                         uint32_t packet_index /*!< [in] Index of the packet in the frame or field*/,
+                         uint32_t rtp_timestamp /*!< [in] RTP timestamp of the frame or field*/,
+                         uint8_t* packet /*!< [out] Packet, at least get_max_packet_size() bytes*/);
+
+   /*!
+      @brief Generate the SDP describing the packetized flow
+   */
+   std::string generate_sdp(const Ipv4Endpoint& source /*!< [in] Source of the flow*/,
+                            const Ipv4Endpoint& destination /*!< [in] Destination of the flow*/) const;
+
+private:
+   struct Segment
+   {
+      uint16_t row /*! Row in the field for interlaced video */;
+      uint16_t offset /*! First pixel of the segment */;
+      uint16_t nb_pgroups;
+   };
+
+   struct PacketLayout
+   {
+      uint32_t nb_segments;
+      Segment segments[max_nb_segments];
+      bool marker;
+   };
+
+   const VideoStandardInfo m_video_standard_info;
+   const VideoFormat m_video_format;
+   const PixelGroup m_pgroup;
+   const uint32_t m_ssrc;
+   const uint8_t m_payload_type;
+   const FramePeriod m_period;
+   std::vector<PacketLayout> m_packet_layouts /*! Layout of the packets of a frame, of a field for interlaced video */;
+   uint32_t m_max_packet_size = 0;
+   uint32_t m_sequence_number = 0;
+};
@@ -0,0 +1,388 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "pcap_reader.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+   const uint32_t pcap_magic_microseconds = 0xa1b2c3d4;
+   const uint32_t pcap_magic_nanoseconds = 0xa1b23c4d;
+   const uint32_t pcap_header_size = 24;
+   const uint32_t pcap_record_header_size = 16;
+
+   const uint32_t pcapng_section_header_block = 0x0a0d0d0a;
+   const uint32_t pcapng_interface_description_block = 0x00000001;
+   const uint32_t pcapng_enhanced_packet_block = 0x00000006;
+   const uint32_t pcapng_byte_order_magic = 0x1a2b3c4d;
+   const uint16_t pcapng_option_if_tsresol = 9;
+
+   const uint16_t linktype_ethernet = 1;
+   const uint16_t linktype_linux_sll = 113;
+
+   const uint16_t ethertype_ipv4 = 0x0800;
+   const uint16_t ethertype_vlan = 0x8100;
+   const uint16_t ethertype_qinq = 0x88a8;
+   const uint8_t ip_protocol_udp = 17;
+
+   uint32_t swap32(uint32_t value)
+   {
+      return ((value & 0xff) << 24) | ((value & 0xff00) << 8) | ((value >> 8) & 0xff00) | (value >> 24);
+   }
+
+   uint16_t read_be16(const uint8_t* data)
+   {
+      return static_cast<uint16_t>((data[0] << 8) | data[1]);
+   }
+
+   uint32_t read_be32(const uint8_t* data)
+   {
+      return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+             (static_cast<uint32_t>(data[2]) << 8) | data[3];
+   }
+}
+
+PcapReader::~PcapReader()
+{
+   close();
+}
+
+bool PcapReader::open(const std::string& path)
+{
+   close();
+
+#if defined(_WIN32)
+   m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+   if (m_file == INVALID_HANDLE_VALUE)
+   {
+      m_file = nullptr;
+      std::cout << "Error when opening " << path << std::endl;
+      return false;
+   }
+   LARGE_INTEGER size;
+   GetFileSizeEx(m_file, &size);
+   m_size = static_cast<size_t>(size.QuadPart);
+   if (m_size > 0)
+   {
+      m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (m_mapping)
+         m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+   }
+#else
+   m_file = ::open(path.c_str(), O_RDONLY);
+   if (m_file < 0)
+   {
+      std::cout << "Error when opening " << path << " [" << std::strerror(errno) << "]" << std::endl;
+      return false;
+   }
+   struct stat file_stat;
+   if (fstat(m_file, &file_stat) == 0)
+      m_size = static_cast<size_t>(file_stat.st_size);
+   if (m_size > 0)
+   {
+      void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+      if (data != MAP_FAILED)
+      {
+         // The capture is walked once from the beginning to the end
+         madvise(data, m_size, MADV_SEQUENTIAL);
+         m_data = static_cast<const uint8_t*>(data);
+      }
+   }
+#endif
+   if (!m_data)
+   {
+      std::cout << "Error when mapping " << path << std::endl;
+      close();
+      return false;
+   }
+
+   if (m_size >= 4 && read32(m_data) == pcapng_section_header_block)
+   {
+      m_format = Format::pcapng;
+      if (!read_pcapng_section_header(0))
+      {
+         std::cout << "Error when reading the pcapng section header of " << path << std::endl;
+         close();
+         return false;
+      }
+      m_first_packet_position = 0;
+   }
+   else if (m_size >= pcap_header_size)
+   {
+      uint32_t magic;
+      std::memcpy(&magic, m_data, sizeof(magic));
+      m_swapped = (magic == swap32(pcap_magic_microseconds) || magic == swap32(pcap_magic_nanoseconds));
+      magic = m_swapped ? swap32(magic) : magic;
+      if (magic != pcap_magic_microseconds && magic != pcap_magic_nanoseconds)
+      {
+         std::cout << path << " is not a pcap or pcapng capture" << std::endl;
+         close();
+         return false;
+      }
+      m_format = Format::pcap;
+      m_nanosecond_timestamps = (magic == pcap_magic_nanoseconds);
+      m_link_type = static_cast<uint16_t>(read32(m_data + 20));
+      m_first_packet_position = pcap_header_size;
+   }
+   else
+   {
+      std::cout << path << " is not a pcap or pcapng capture" << std::endl;
+      close();
+      return false;
+   }
+
+   m_position = m_first_packet_position;
+   return true;
+}
+
+void PcapReader::close()
+{
+#if defined(_WIN32)
+   if (m_data)
+      UnmapViewOfFile(m_data);
+   if (m_mapping)
+      CloseHandle(m_mapping);
+   if (m_file)
+      CloseHandle(m_file);
+   m_mapping = nullptr;
+   m_file = nullptr;
+#else
+   if (m_data)
+      munmap(const_cast<uint8_t*>(m_data), m_size);
+   if (m_file >= 0)
+      ::close(m_file);
+   m_file = -1;
+#endif
+   m_data = nullptr;
+   m_size = 0;
+   m_position = 0;
+   m_interfaces.clear();
+}
+
+void PcapReader::rewind()
+{
+   m_position = m_first_packet_position;
+   if (m_format == Format::pcapng)
+      m_interfaces.clear();
+}
+
+bool PcapReader::next(PcapPacket& packet)
+{
+   if (!m_data)
+      return false;
+   return (m_format == Format::pcap) ? next_pcap(packet) : next_pcapng(packet);
+}
+
+bool PcapReader::next_pcap(PcapPacket& packet)
+{
+   if (m_size - m_position < pcap_record_header_size)
+      return false;
+
+   const uint8_t* record = m_data + m_position;
+   const uint32_t seconds = read32(record);
+   const uint32_t fraction = read32(record + 4);
+   packet.captured_size = read32(record + 8);
+   packet.original_size = read32(record + 12);
+   if (m_size - m_position - pcap_record_header_size < packet.captured_size)
+      return false;
+
+   packet.timestamp_ns = static_cast<uint64_t>(seconds) * 1000000000 +
+                         (m_nanosecond_timestamps ? fraction : static_cast<uint64_t>(fraction) * 1000);
+   packet.data = record + pcap_record_header_size;
+   packet.link_type = m_link_type;
+   m_position += pcap_record_header_size + packet.captured_size;
+   return true;
+}
+
+bool PcapReader::next_pcapng(PcapPacket& packet)
+{
+   while (m_size - m_position >= 12)
+   {
+      const uint8_t* block = m_data + m_position;
+      const uint32_t block_type = read32(block);
+      if (block_type == pcapng_section_header_block)
+      {
+         // A new section may use the other byte order and has its own interfaces
+         if (!read_pcapng_section_header(m_position))
+            return false;
+         block = m_data + m_position;
+      }
+
+      const uint32_t block_size = read32(block + 4);
+      if (block_size < 12 || block_size % 4 != 0 || block_size > m_size - m_position)
+         return false;
+      const uint8_t* body = block + 8;
+      const size_t body_size = block_size - 12;
+      m_position += block_size;
+
+      if (block_type == pcapng_interface_description_block)
+      {
+         read_pcapng_interface_description(body, body_size);
+      }
+      else if (block_type == pcapng_enhanced_packet_block && body_size >= 20)
+      {
+         const uint32_t interface_id = read32(body);
+         if (interface_id >= m_interfaces.size())
+            return false;
+         const uint64_t timestamp = (static_cast<uint64_t>(read32(body + 4)) << 32) | read32(body + 8);
+         packet.captured_size = read32(body + 12);
+         packet.original_size = read32(body + 16);
+         if (packet.captured_size > body_size - 20)
+            return false;
+
+         const Interface& interface = m_interfaces[interface_id];
+         if (interface.timestamp_units_per_second == 1000000000)
+            packet.timestamp_ns = timestamp;
+         else
+            packet.timestamp_ns = (timestamp / interface.timestamp_units_per_second) * 1000000000 +
+                                  (timestamp % interface.timestamp_units_per_second) * 1000000000 /
+                                      interface.timestamp_units_per_second;
+         packet.data = body + 20;
+         packet.link_type = interface.link_type;
+         return true;
+      }
+   }
+   return false;
+}
+
+bool PcapReader::read_pcapng_section_header(size_t position)
+{
+   if (m_size - position < 28)
+      return false;
+   uint32_t byte_order_magic;
+   std::memcpy(&byte_order_magic, m_data + position + 8, sizeof(byte_order_magic));
+   if (byte_order_magic == pcapng_byte_order_magic)
+      m_swapped = false;
+   else if (byte_order_magic == swap32(pcapng_byte_order_magic))
+      m_swapped = true;
+   else
+      return false;
+   m_interfaces.clear();
+   return true;
+}
+
+void PcapReader::read_pcapng_interface_description(const uint8_t* body, size_t body_size)
+{
+   if (body_size < 8)
+      return;
+
+   Interface interface = {read16(body), 1000000};
+   size_t position = 8;
+   while (body_size - position >= 4)
+   {
+      const uint16_t option_code = read16(body + position);
+      const uint16_t option_size = read16(body + position + 2);
+      position += 4;
+      if (option_code == 0 || option_size > body_size - position)
+         break;
+      if (option_code == pcapng_option_if_tsresol && option_size >= 1)
+      {
+         // Most significant bit set: negative power of two, otherwise negative power of ten
+         const uint8_t resolution = body[position];
+         const uint32_t exponent = resolution & 0x7f;
+         uint64_t units = 1;
+         for (uint32_t i = 0; i < exponent && units < 1000000000000ull; i++)
+            units *= (resolution & 0x80) ? 2 : 10;
+         interface.timestamp_units_per_second = units;
+      }
+      position += (option_size + 3) & ~3u;
+   }
+   m_interfaces.push_back(interface);
+}
+
+uint16_t PcapReader::read16(const uint8_t* data) const
+{
+   uint16_t value;
+   std::memcpy(&value, data, sizeof(value));
+   return m_swapped ? static_cast<uint16_t>((value << 8) | (value >> 8)) : value;
+}
+
+uint32_t PcapReader::read32(const uint8_t* data) const
+{
+   uint32_t value;
+   std::memcpy(&value, data, sizeof(value));
+   return m_swapped ? swap32(value) : value;
+}
+
+bool parse_udp_datagram(const PcapPacket& packet, UdpDatagram& datagram)
+{
+   const uint8_t* data = packet.data;
+   uint32_t size = packet.captured_size;
+   uint16_t ethertype;
+
+   if (packet.link_type == linktype_ethernet)
+   {
+      if (size < 14)
+         return false;
+      ethertype = read_be16(data + 12);
+      data += 14;
+      size -= 14;
+   }
+   else if (packet.link_type == linktype_linux_sll)
+   {
+      if (size < 16)
+         return false;
+      ethertype = read_be16(data + 14);
+      data += 16;
+      size -= 16;
+   }
+   else
+   {
+      return false;
+   }
+
+   while ((ethertype == ethertype_vlan || ethertype == ethertype_qinq) && size >= 4)
+   {
+      ethertype = read_be16(data + 2);
+      data += 4;
+      size -= 4;
+   }
+   if (ethertype != ethertype_ipv4 || size < 20 || (data[0] >> 4) != 4)
+      return false;
+
+   const uint32_t ip_header_size = (data[0] & 0x0f) * 4u;
+   const uint32_t ip_total_size = read_be16(data + 2);
+   const bool fragmented = (read_be16(data + 6) & 0x3fff) != 0; // MF flag or fragment offset
+   if (ip_header_size < 20 || ip_total_size < ip_header_size + 8 || size < ip_header_size + 8 || fragmented ||
+       data[9] != ip_protocol_udp)
+      return false;
+
+   const uint8_t* udp = data + ip_header_size;
+   datagram.source = {Ipv4Address(read_be32(data + 12)), read_be16(udp)};
+   datagram.destination = {Ipv4Address(read_be32(data + 16)), read_be16(udp + 2)};
+
+   // Do not trust the UDP length beyond what has actually been captured
+   uint32_t udp_size = read_be16(udp + 4);
+   if (udp_size < 8)
+      return false;
+   udp_size = std::min(udp_size, std::min(ip_total_size, size) - ip_header_size);
+   datagram.payload = udp + 8;
+   datagram.payload_size = udp_size - 8;
+   return true;
+}
@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file pcap_reader.h
+   @brief This file contains a memory-mapped reader for pcap and pcapng captures and the decoding of the
+   Ethernet/IPv4/UDP headers of the captured packets.
+
+   @detail The capture file is mapped in memory and the packets point into the mapping, so that multi-GB captures
+   are walked without copying them.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "ipv4.h"
+
+/*!
+   @brief Captured packet, pointing into the mapped capture file
+*/
+struct PcapPacket
+{
+   uint64_t timestamp_ns /*! Capture timestamp in nanoseconds since the epoch of the capture clock */;
+   const uint8_t* data /*! Link-layer frame */;
+   uint32_t captured_size /*! Number of bytes of the frame present in the capture */;
+   uint32_t original_size /*! Size of the frame on the wire */;
+   uint16_t link_type /*! LINKTYPE_* of the interface the packet was captured on */;
+};
+
+/*!
+   @brief UDP datagram decoded from a captured packet
+*/
+struct UdpDatagram
+{
+   Ipv4Endpoint source;
+   Ipv4Endpoint destination;
+   const uint8_t* payload;
+   uint32_t payload_size;
+};
+
+/*!
+   @brief Sequential reader of a pcap or pcapng capture file
+*/
+class PcapReader
+{
+public:
+   PcapReader() = default;
+   ~PcapReader();
+
+   PcapReader(const PcapReader&) = delete;
+   PcapReader& operator=(const PcapReader&) = delete;
+
+   /*!
+      @brief Map a capture file and check its header
+
+      @returns True if the file is a supported pcap or pcapng capture
+   */
+   bool open(const std::string& path /*!< [in] Path of the capture file*/);
+   void close();
+
+   /*!
+      @brief Read the next packet of the capture
+
+      @returns False at the end of the capture or if the capture is truncated or corrupted
+   */
+   bool next(PcapPacket& packet /*!< [out] Next packet, valid as long as the reader is open*/);
+
+   /*!
+      @brief Restart reading from the first packet
+   */
+   void rewind();
+
+   size_t file_size() const { return m_size; }
+   size_t position() const { return m_position; }
+
+private:
+   enum class Format
+   {
+      pcap,
+      pcapng
+   };
+
+   struct Interface
+   {
+      uint16_t link_type;
+      uint64_t timestamp_units_per_second;
+   };
+
+   bool next_pcap(PcapPacket& packet);
+   bool next_pcapng(PcapPacket& packet);
+   bool read_pcapng_section_header(size_t position);
+   void read_pcapng_interface_description(const uint8_t* body, size_t body_size);
+   uint16_t read16(const uint8_t* data) const;
+   uint32_t read32(const uint8_t* data) const;
+
+   const uint8_t* m_data = nullptr;
+   size_t m_size = 0;
+   size_t m_position = 0;
+   size_t m_first_packet_position = 0;
+#if defined(_WIN32)
+   void* m_file = nullptr;
+   void* m_mapping = nullptr;
+#else
+   int m_file = -1;
+#endif
+
+   Format m_format = Format::pcap;
+   bool m_swapped = false /*! File written with the other byte order */;
+   bool m_nanosecond_timestamps = false /*! pcap only */;
+   uint16_t m_link_type = 0 /*! pcap only */;
+   std::vector<Interface> m_interfaces /*! pcapng only, interfaces of the current section */;
+};
+
+/*!
+   @brief Decode the Ethernet (optionally VLAN tagged) or Linux cooked capture, IPv4 and UDP headers of a packet
+
+   @returns False if the packet is not an unfragmented IPv4 UDP datagram
+*/
+bool parse_udp_datagram(const PcapPacket& packet /*!< [in] Captured packet*/,
+                        UdpDatagram& datagram /*!< [out] Decoded datagram, pointing into the packet*/);
@@ -0,0 +1,441 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file pixel_conversion.h
+   @brief This file contains the conversions between the slot buffer layouts of the VideoMaster API and the
+   ST 2110-20 (RFC 4175) pixel groups of every video format (video_format.h).
+
+   @detail The pixel groups hold their components as a big-endian bit stream of 8, 10 or 12 bits per component.
+   The host layouts hold the same components in the same order, on one byte per component (e.g.
+   VHD_BUFPACK_VIDEO_YUV422_8: Cb Y0 Cr Y1) or on one 16-bit little-endian word per component, MSB aligned (e.g.
+   VHD_BUFPACK_VIDEO_YUV422_10). The host layout of YCbCr-4:2:0 is YCbCr-4:2:2 on both lines of the pixel groups:
+   the chroma of the two lines is averaged when packing, and repeated on both lines when unpacking. Components
+   narrower on the host than on the wire are shifted left, wider ones are truncated.
+
+   The components are converted several at a time with 64-bit loads and stores (SWAR): 8 components per step when
+   packing, 4 when unpacking, whose 64-bit loads overlap but whose stores do not. The last components are converted
+   one at a time, since the 64-bit accesses would run past the end of the buffers.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "video_format.h"
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The pixel conversions expect a little-endian host"
+#endif
+
+inline constexpr uint32_t pgroup_size = 5 /*! Bytes of a YCbCr-4:2:2 10-bit pixel group */;
+inline constexpr uint32_t pgroup_pixels = 2 /*! Pixels of a YCbCr-4:2:2 pixel group */;
+inline constexpr uint32_t yuv422_8_bytes_per_pixel = 2;
+inline constexpr uint32_t yuv422_10_bytes_per_pixel = 4;
+
+/*!
+   @brief Storage of a component in a host layout
+*/
+enum class HostComponent
+{
+   byte /*! One byte per component */,
+   word /*! One 16-bit little-endian word per component, MSB aligned */,
+};
+
+constexpr uint32_t get_host_component_size(HostComponent host)
+{
+   return host == HostComponent::byte ? 1 : 2;
+}
+
+/*!
+   @brief Bytes of a pixel in the host layout of a sampling
+*/
+constexpr uint32_t get_host_bytes_per_pixel(VHD_ST2110_20_SAMPLING sampling, HostComponent host)
+{
+   const bool is_444 = sampling == VHD_ST2110_20_SAMPLING_YUV_444 || sampling == VHD_ST2110_20_SAMPLING_RGB_444;
+   return (is_444 ? 3 : 2) * get_host_component_size(host);
+}
+
+inline uint64_t load_be64(const uint8_t* source)
+{
+   uint64_t value;
+   std::memcpy(&value, source, sizeof(value));
+#if defined(_MSC_VER)
+   return _byteswap_uint64(value);
+#else
+   return __builtin_bswap64(value);
+#endif
+}
+
+inline void store_be64(uint8_t* destination, uint64_t value)
+{
+#if defined(_MSC_VER)
+   value = _byteswap_uint64(value);
+#else
+   value = __builtin_bswap64(value);
+#endif
+   std::memcpy(destination, &value, sizeof(value));
+}
+
+/*!
+   @brief Read a host component, as a 16-bit MSB aligned value
+*/
+template <HostComponent host>
+inline uint32_t read_host_component(const uint8_t* source, uint32_t index)
+{
+   if constexpr (host == HostComponent::byte)
+      return static_cast<uint32_t>(source[index]) << 8;
+   else
+      return source[2 * index] | (static_cast<uint32_t>(source[2 * index + 1]) << 8);
+}
+
+/*!
+   @brief Write a host component from a 16-bit MSB aligned value
+*/
+template <HostComponent host>
+inline void write_host_component(uint8_t* destination, uint32_t index, uint32_t value)
+{
+   if constexpr (host == HostComponent::byte)
+      destination[index] = static_cast<uint8_t>(value >> 8);
+   else
+   {
+      destination[2 * index] = static_cast<uint8_t>(value);
+      destination[2 * index + 1] = static_cast<uint8_t>(value >> 8);
+   }
+}
+
+/*!
+   @brief Pack host components into a bit stream of depth-bit components
+*/
+template <uint32_t depth, HostComponent host>
+inline void pack_components(const uint8_t* source /*!< [in] Host components*/,
+                            uint8_t* destination /*!< [out] Bit stream*/,
+                            uint32_t nb_components /*!< [in] Components to pack, whole bytes of the stream*/)
+{
+   static_assert(depth >= 8 && depth <= 12, "8 components are packed into 64 bits and at most 32 more");
+   constexpr uint32_t step_components = 8, step_size = depth /*! 8 components of depth bits */;
+   constexpr uint32_t host_step_size = step_components * get_host_component_size(host);
+
+   // Groups of 4 components from 64-bit loads, written out so that the shifts are constants
+   auto get_component = [](uint64_t components, uint32_t k) -> uint64_t {
+      return host == HostComponent::byte ? ((components >> (8 * k)) & 0xff) << (depth - 8)
+                                         : ((components >> (16 * k)) & 0xffff) >> (16 - depth);
+   };
+   auto pack_group = [&](uint64_t components) {
+      return (get_component(components, 0) << (3 * depth)) | (get_component(components, 1) << (2 * depth)) |
+             (get_component(components, 2) << depth) | get_component(components, 3);
+   };
+
+   // Every step stores exactly its bytes: overlapping stores would stall on the previous ones
+   const uint32_t nb_steps = nb_components / step_components;
+   for (uint32_t i = 0; i < nb_steps; i++, source += host_step_size, destination += step_size)
+   {
+      uint64_t first_group, second_group;
+      if constexpr (host == HostComponent::byte)
+      {
+         uint64_t components;
+         std::memcpy(&components, source, sizeof(components));
+         first_group = pack_group(components);
+         second_group = pack_group(components >> 32);
+      }
+      else
+      {
+         uint64_t components[2];
+         std::memcpy(components, source, sizeof(components));
+         first_group = pack_group(components[0]);
+         second_group = pack_group(components[1]);
+      }
+      store_be64(destination, (first_group << (64 - 4 * depth)) | (second_group >> (8 * depth - 64)));
+      for (uint32_t k = 8; k < step_size; k++)
+         destination[k] = static_cast<uint8_t>(second_group >> (8 * (step_size - 1 - k)));
+   }
+
+   uint32_t bits = 0, nb_bits = 0;
+   for (uint32_t k = 0; k < nb_components - nb_steps * step_components; k++)
+   {
+      bits = (bits << depth) | (read_host_component<host>(source, k) >> (16 - depth));
+      for (nb_bits += depth; nb_bits >= 8; nb_bits -= 8)
+         *destination++ = static_cast<uint8_t>(bits >> (nb_bits - 8));
+   }
+}
+
+/*!
+   @brief Unpack a bit stream of depth-bit components into host components
+*/
+template <uint32_t depth, HostComponent host>
+inline void unpack_components(const uint8_t* source /*!< [in] Bit stream*/,
+                              uint8_t* destination /*!< [out] Host components*/,
+                              uint32_t nb_components /*!< [in] Components to unpack, whole bytes of the stream*/)
+{
+   static_assert(depth >= 8 && depth <= 16, "the components are unpacked to 16-bit values");
+   constexpr uint32_t group_components = 4, group_size = group_components * depth / 8;
+   constexpr uint32_t host_group_size = group_components * get_host_component_size(host);
+   constexpr uint64_t component_mask = (1u << depth) - 1;
+
+   // Host component k of the group from its depth-bit component, written out so that the shifts are constants
+   auto get_host_components = [](uint64_t component, uint32_t k) -> uint64_t {
+      component &= component_mask;
+      return host == HostComponent::byte ? (component >> (depth - 8)) << (8 * k)
+                                         : (component << (16 - depth)) << (16 * k);
+   };
+
+   // 8 bytes are loaded per group of 4 components, the last group is left to the component loop
+   const uint32_t nb_groups = nb_components / group_components;
+   uint32_t i = 0;
+   for (; i + 1 < nb_groups; i++, source += group_size, destination += host_group_size)
+   {
+      const uint64_t group = load_be64(source) >> (64 - group_components * depth);
+      const uint64_t components = get_host_components(group >> (3 * depth), 0) |
+                                  get_host_components(group >> (2 * depth), 1) |
+                                  get_host_components(group >> depth, 2) | get_host_components(group, 3);
+      if constexpr (host == HostComponent::byte)
+      {
+         const uint32_t bytes = static_cast<uint32_t>(components);
+         std::memcpy(destination, &bytes, sizeof(bytes));
+      }
+      else
+         std::memcpy(destination, &components, sizeof(components));
+   }
+
+   uint32_t bits = 0, nb_bits = 0;
+   for (uint32_t k = 0; k < nb_components - i * group_components; k++)
+   {
+      for (; nb_bits < depth; nb_bits += 8)
+         bits = (bits << 8) | *source++;
+      nb_bits -= depth;
+      write_host_component<host>(destination, k, ((bits >> nb_bits) & component_mask) << (16 - depth));
+   }
+}
+
+/*!
+   @brief Pack host components into a bit stream of components of any supported depth
+*/
+inline void pack_components(const uint8_t* source /*!< [in] Host components*/,
+                            HostComponent host /*!< [in] Storage of the host components*/,
+                            uint8_t* destination /*!< [out] Bit stream*/,
+                            VHD_ST2110_20_DEPTH depth /*!< [in] Depth of the stream*/,
+                            uint32_t nb_components /*!< [in] Components to pack*/)
+{
+   const bool is_byte = host == HostComponent::byte;
+   switch (depth)
+   {
+   case VHD_ST2110_20_DEPTH_8BIT:
+      if (is_byte)
+         std::memcpy(destination, source, nb_components);
+      else
+         pack_components<8, HostComponent::word>(source, destination, nb_components);
+      break;
+   case VHD_ST2110_20_DEPTH_10BIT:
+      is_byte ? pack_components<10, HostComponent::byte>(source, destination, nb_components)
+              : pack_components<10, HostComponent::word>(source, destination, nb_components);
+      break;
+   case VHD_ST2110_20_DEPTH_12BIT:
+      is_byte ? pack_components<12, HostComponent::byte>(source, destination, nb_components)
+              : pack_components<12, HostComponent::word>(source, destination, nb_components);
+      break;
+   default: break;
+   }
+}
+
+/*!
+   @brief Unpack a bit stream of components of any supported depth into host components
+*/
+inline void unpack_components(const uint8_t* source /*!< [in] Bit stream*/,
+                              VHD_ST2110_20_DEPTH depth /*!< [in] Depth of the stream*/,
+                              uint8_t* destination /*!< [out] Host components*/,
+                              HostComponent host /*!< [in] Storage of the host components*/,
+                              uint32_t nb_components /*!< [in] Components to unpack*/)
+{
+   const bool is_byte = host == HostComponent::byte;
+   switch (depth)
+   {
+   case VHD_ST2110_20_DEPTH_8BIT:
+      if (is_byte)
+         std::memcpy(destination, source, nb_components);
+      else
+         unpack_components<8, HostComponent::word>(source, destination, nb_components);
+      break;
+   case VHD_ST2110_20_DEPTH_10BIT:
+      is_byte ? unpack_components<10, HostComponent::byte>(source, destination, nb_components)
+              : unpack_components<10, HostComponent::word>(source, destination, nb_components);
+      break;
+   case VHD_ST2110_20_DEPTH_12BIT:
+      is_byte ? unpack_components<12, HostComponent::byte>(source, destination, nb_components)
+              : unpack_components<12, HostComponent::word>(source, destination, nb_components);
+      break;
+   default: break;
+   }
+}
+
+/*!
+   @brief Pack YCbCr-4:2:0 pixel groups from two YCbCr-4:2:2 host lines, the chroma of the lines being averaged
+*/
+template <HostComponent host>
+inline void pack_yuv420_pgroups(const uint8_t* first_line /*!< [in] First line of the pixel groups*/,
+                                const uint8_t* second_line /*!< [in] Second line of the pixel groups*/,
+                                VHD_ST2110_20_DEPTH depth /*!< [in] Depth of the pixel groups*/,
+                                uint8_t* destination /*!< [out] Pixel groups*/,
+                                uint32_t nb_blocks /*!< [in] Blocks of 2x2 pixels to pack*/)
+{
+   // The blocks are reordered by chunks, a chunk of components fills whole bytes at every depth
+   constexpr uint32_t chunk_blocks = 32, block_components = 6;
+   using Value = std::conditional_t<host == HostComponent::byte, uint8_t, uint16_t>;
+   uint8_t chunk[chunk_blocks * block_components * 2];
+   for (uint32_t first_block = 0; first_block < nb_blocks; first_block += chunk_blocks)
+   {
+      const uint32_t nb_chunk_blocks = std::min(chunk_blocks, nb_blocks - first_block);
+      for (uint32_t b = 0; b < nb_chunk_blocks; b++)
+      {
+         // Cb Y0 Cr Y1 on each line, to Y00 Y01 Y10 Y11 Cb Cr
+         Value first[4], second[4];
+         std::memcpy(first, first_line + (first_block + b) * sizeof(first), sizeof(first));
+         std::memcpy(second, second_line + (first_block + b) * sizeof(second), sizeof(second));
+         const Value block[block_components] = {first[1],
+                                                first[3],
+                                                second[1],
+                                                second[3],
+                                                static_cast<Value>((first[0] + second[0] + 1) / 2),
+                                                static_cast<Value>((first[2] + second[2] + 1) / 2)};
+         std::memcpy(chunk + b * sizeof(block), block, sizeof(block));
+      }
+      const uint32_t nb_components = nb_chunk_blocks * block_components;
+      pack_components(chunk, host, destination, depth, nb_components);
+      destination += nb_components * get_component_depth(depth) / 8;
+   }
+}
+
+/*!
+   @brief Unpack YCbCr-4:2:0 pixel groups to two YCbCr-4:2:2 host lines, the chroma being repeated on both lines
+*/
+template <HostComponent host>
+inline void unpack_yuv420_pgroups(const uint8_t* source /*!< [in] Pixel groups*/,
+                                  VHD_ST2110_20_DEPTH depth /*!< [in] Depth of the pixel groups*/,
+                                  uint8_t* first_line /*!< [out] First line of the pixel groups*/,
+                                  uint8_t* second_line /*!< [out] Second line of the pixel groups*/,
+                                  uint32_t nb_blocks /*!< [in] Blocks of 2x2 pixels to unpack*/)
+{
+   constexpr uint32_t chunk_blocks = 32, block_components = 6;
+   using Value = std::conditional_t<host == HostComponent::byte, uint8_t, uint16_t>;
+   uint8_t chunk[chunk_blocks * block_components * 2];
+   for (uint32_t first_block = 0; first_block < nb_blocks; first_block += chunk_blocks)
+   {
+      const uint32_t nb_chunk_blocks = std::min(chunk_blocks, nb_blocks - first_block);
+      const uint32_t nb_components = nb_chunk_blocks * block_components;
+      unpack_components(source, depth, chunk, host, nb_components);
+      source += nb_components * get_component_depth(depth) / 8;
+      for (uint32_t b = 0; b < nb_chunk_blocks; b++)
+      {
+         Value block[block_components];
+         std::memcpy(block, chunk + b * sizeof(block), sizeof(block));
+         const Value first[4] = {block[4], block[0], block[5], block[1]};
+         const Value second[4] = {block[4], block[2], block[5], block[3]};
+         std::memcpy(first_line + (first_block + b) * sizeof(first), first, sizeof(first));
+         std::memcpy(second_line + (first_block + b) * sizeof(second), second, sizeof(second));
+      }
+   }
+}
+
+/*!
+   @brief Pack the pixel groups of a video format from its host layout
+
+   @detail For YCbCr-4:2:0, the second line of the pixel groups is host_line_stride bytes after the first one.
+*/
+inline void pack_pgroups(const VideoFormat& format /*!< [in] Format of the pixel groups*/,
+                         const uint8_t* source /*!< [in] Pixels in the host layout*/,
+                         HostComponent host /*!< [in] Storage of the host components*/,
+                         uint64_t host_line_stride /*!< [in] Bytes between two host lines, for YCbCr-4:2:0*/,
+                         uint8_t* destination /*!< [out] Pixel groups*/,
+                         uint32_t nb_pgroups /*!< [in] Pixel groups to pack*/)
+{
+   const PixelGroup pgroup = get_pixel_group(format);
+   const uint32_t nb_components = nb_pgroups * pgroup.nb_components;
+   if (format.sampling != VHD_ST2110_20_SAMPLING_YUV_420)
+      pack_components(source, host, destination, format.depth, nb_components);
+   else if (host == HostComponent::byte)
+      pack_yuv420_pgroups<HostComponent::byte>(source, source + host_line_stride, format.depth, destination,
+                                               nb_components / 6);
+   else
+      pack_yuv420_pgroups<HostComponent::word>(source, source + host_line_stride, format.depth, destination,
+                                               nb_components / 6);
+}
+
+/*!
+   @brief Unpack the pixel groups of a video format to its host layout
+
+   @detail For YCbCr-4:2:0, the second line of the pixel groups is host_line_stride bytes after the first one.
+*/
+inline void unpack_pgroups(const VideoFormat& format /*!< [in] Format of the pixel groups*/,
+                           const uint8_t* source /*!< [in] Pixel groups*/,
+                           uint8_t* destination /*!< [out] Pixels in the host layout*/,
+                           HostComponent host /*!< [in] Storage of the host components*/,
+                           uint64_t host_line_stride /*!< [in] Bytes between two host lines, for YCbCr-4:2:0*/,
+                           uint32_t nb_pgroups /*!< [in] Pixel groups to unpack*/)
+{
+   const PixelGroup pgroup = get_pixel_group(format);
+   const uint32_t nb_components = nb_pgroups * pgroup.nb_components;
+   if (format.sampling != VHD_ST2110_20_SAMPLING_YUV_420)
+      unpack_components(source, format.depth, destination, host, nb_components);
+   else if (host == HostComponent::byte)
+      unpack_yuv420_pgroups<HostComponent::byte>(source, format.depth, destination, destination + host_line_stride,
+                                                 nb_components / 6);
+   else
+      unpack_yuv420_pgroups<HostComponent::word>(source, format.depth, destination, destination + host_line_stride,
+                                                 nb_components / 6);
+}
+
+/*!
+   @brief Convert VHD_BUFPACK_VIDEO_YUV422_8 pixels to 10-bit pixel groups, the components being shifted left by 2
+*/
+inline void pack_yuv422_8_to_pgroups(const uint8_t* source /*!< [in] Pixels, 2 per pixel group*/,
+                                     uint8_t* destination /*!< [out] Pixel groups*/,
+                                     uint32_t nb_pgroups /*!< [in] Number of pixel groups to convert*/)
+{
+   pack_components<10, HostComponent::byte>(source, destination, nb_pgroups * 4);
+}
+
+/*!
+   @brief Convert 10-bit pixel groups to VHD_BUFPACK_VIDEO_YUV422_10 pixels
+*/
+inline void unpack_pgroups_to_yuv422_10(const uint8_t* source /*!< [in] Pixel groups*/,
+                                        uint8_t* destination /*!< [out] Pixels, 2 per pixel group*/,
+                                        uint32_t nb_pgroups /*!< [in] Number of pixel groups to convert*/)
+{
+   unpack_components<10, HostComponent::word>(source, destination, nb_pgroups * 4);
+}
+
+/*!
+   @brief Convert VHD_BUFPACK_VIDEO_YUV422_10 pixels to VHD_BUFPACK_VIDEO_YUV422_8 pixels, the components being
+   rounded to 8 bits
+*/
+inline void convert_yuv422_10_to_yuv422_8(const uint8_t* source /*!< [in] Pixels, 16 bits per component*/,
+                                          uint8_t* destination /*!< [out] Pixels, 8 bits per component*/,
+                                          uint32_t nb_pixels /*!< [in] Number of pixels to convert*/)
+{
+   for (uint32_t i = 0; i < nb_pixels * 2; i++, source += 2)
+   {
+      const uint32_t component = ((static_cast<uint32_t>(source[1]) << 8) | source[0]) >> 6;
+      destination[i] = static_cast<uint8_t>(component >= 0x3fe ? 0xff : (component + 2) >> 2);
+   }
+}
@@ -0,0 +1,208 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "ptp_monitor.h"
+#include "tools.h"
+#include "board_backend.h"
+
+PtpMonitor::PtpMonitor(HANDLE board_handle, int64_t lock_threshold_ns, std::chrono::milliseconds sampling_period,
+                       uint32_t history_size)
+    : m_board_handle(board_handle), m_lock_threshold_ns(lock_threshold_ns), m_sampling_period(sampling_period),
+      m_samples(std::max(history_size, 1u)), m_lock_detection_start(std::chrono::steady_clock::now())
+{
+}
+
+PtpMonitor::~PtpMonitor()
+{
+   stop();
+}
+
+void PtpMonitor::start(const std::function<void()>& thread_setup)
+{
+   std::lock_guard lock(m_mutex);
+   if (m_thread.joinable())
+      return;
+   m_stop = false;
+   m_lock_detection_start = std::chrono::steady_clock::now();
+   m_thread_setup = thread_setup;
+   m_thread = std::thread([this, thread_setup] {
+      if (thread_setup)
+         thread_setup();
+      run();
+   });
+}
+
+void PtpMonitor::stop()
+{
+   {
+      std::lock_guard lock(m_mutex);
+      m_stop = true;
+      m_suspended = false;
+   }
+   m_condition.notify_all();
+   if (m_thread.joinable())
+      m_thread.join();
+}
+
+void PtpMonitor::restart_lock_detection()
+{
+   std::lock_guard lock(m_mutex);
+   m_nb_consecutive_locked_samples = 0;
+   m_locked_within_threshold = false;
+   m_status_locked_within_threshold.store(false, std::memory_order_relaxed);
+   m_time_to_lock_s = -1.0;
+   m_lock_detection_start = std::chrono::steady_clock::now();
+}
+
+void PtpMonitor::set_board_handle(HANDLE board_handle)
+{
+   // The sampling thread reads the handle without the lock, it is stopped while the handle changes and until the
+   // handle is valid again
+   const bool is_running = m_thread.joinable() || m_suspended;
+   stop();
+   m_board_handle = board_handle;
+   restart_lock_detection();
+   m_suspended = is_running && board_handle == nullptr;
+   if (is_running && board_handle != nullptr)
+      start(m_thread_setup);
+}
+
+bool PtpMonitor::is_locked_within_threshold() const
+{
+   std::lock_guard lock(m_mutex);
+   return m_locked_within_threshold;
+}
+
+bool PtpMonitor::wait_for_lock(std::chrono::milliseconds timeout)
+{
+   std::unique_lock lock(m_mutex);
+   return m_condition.wait_for(lock, timeout, [this] { return m_locked_within_threshold || m_stop; }) &&
+          m_locked_within_threshold;
+}
+
+PtpStatistics PtpMonitor::get_statistics() const
+{
+   std::lock_guard lock(m_mutex);
+
+   PtpStatistics statistics;
+   statistics.locked_within_threshold = m_locked_within_threshold;
+   statistics.time_to_lock_s = m_time_to_lock_s;
+   if (m_nb_samples == 0)
+      return statistics;
+
+   const uint32_t history_size = static_cast<uint32_t>(m_samples.size());
+   const PtpSample& last_sample = m_samples[(m_next_sample + history_size - 1) % history_size];
+   statistics.state = last_sample.state;
+   statistics.offset_ns = last_sample.offset_ns;
+
+   // The offsets before the lock would hide the locked ones, Welford's update keeps the variance accurate
+   statistics.nb_samples =
+       m_locked_within_threshold ? std::min(m_nb_consecutive_locked_samples, m_nb_samples) : m_nb_samples;
+   double mean = 0.0, sum_of_squared_deviations = 0.0;
+   for (uint32_t i = 0; i < statistics.nb_samples; i++)
+   {
+      const int64_t offset_ns = m_samples[(m_next_sample + history_size - statistics.nb_samples + i) % history_size]
+                                    .offset_ns;
+      const double delta = static_cast<double>(offset_ns) - mean;
+      mean += delta / (i + 1);
+      sum_of_squared_deviations += delta * (static_cast<double>(offset_ns) - mean);
+      statistics.max_abs_offset_ns = std::max(statistics.max_abs_offset_ns, offset_ns < 0 ? -offset_ns : offset_ns);
+   }
+   statistics.mean_offset_ns = mean;
+   statistics.stddev_offset_ns = std::sqrt(sum_of_squared_deviations / statistics.nb_samples);
+
+   return statistics;
+}
+
+std::vector<PtpSample> PtpMonitor::get_samples() const
+{
+   std::lock_guard lock(m_mutex);
+
+   std::vector<PtpSample> samples;
+   samples.reserve(m_nb_samples);
+   const uint32_t history_size = static_cast<uint32_t>(m_samples.size());
+   const uint32_t oldest = (m_nb_samples < history_size) ? 0 : m_next_sample;
+   for (uint32_t i = 0; i < m_nb_samples; i++)
+      samples.push_back(m_samples[(oldest + i) % history_size]);
+   return samples;
+}
+
+void PtpMonitor::print_status(uint8_t domain_number, uint8_t announce_receipt_timeout) const
+{
+   const PtpStatistics statistics = get_statistics();
+
+   std::cout << "PTP : Domain Number = " << static_cast<int>(domain_number)
+             << " Announce Receipt Timeout = " << static_cast<int>(announce_receipt_timeout)
+             << " State = " << to_string(statistics.state) << " (Offset : " << statistics.offset_ns
+             << " ns, mean " << static_cast<int64_t>(statistics.mean_offset_ns) << " ns, stddev "
+             << static_cast<int64_t>(statistics.stddev_offset_ns) << " ns, max " << statistics.max_abs_offset_ns
+             << " ns)";
+   if (statistics.locked_within_threshold)
+      std::cout << " locked in " << statistics.time_to_lock_s << " s";
+   std::cout << "                 \r" << std::flush;
+}
+
+void PtpMonitor::run()
+{
+   std::unique_lock lock(m_mutex);
+   while (!m_stop)
+   {
+      lock.unlock();
+
+      PtpSample sample = {std::chrono::steady_clock::now(), VHD_PTP_PORT_STATE_INITIALIZING, false, 0};
+      BOOL32 locked = false;
+      LONG offset_sec = 0, offset_nsec = 0;
+      VHD_ERRORCODE result =
+          board_backend().get_ptp_port_state(m_board_handle, &sample.state, &locked);
+      if (result == VHDERR_NOERROR)
+         result = board_backend().get_ptp_offset(m_board_handle, &offset_sec, &offset_nsec);
+      sample.locked = locked != 0;
+      sample.offset_ns = static_cast<int64_t>(offset_sec) * 1000000000 + offset_nsec;
+
+      lock.lock();
+      if (result == VHDERR_NOERROR)
+         add_sample(sample);
+      m_condition.wait_for(lock, m_sampling_period, [this] { return m_stop; });
+   }
+}
+
+void PtpMonitor::add_sample(const PtpSample& sample)
+{
+   m_samples[m_next_sample] = sample;
+   m_next_sample = (m_next_sample + 1) % static_cast<uint32_t>(m_samples.size());
+   m_nb_samples = std::min(m_nb_samples + 1, static_cast<uint32_t>(m_samples.size()));
+
+   const int64_t abs_offset_ns = sample.offset_ns < 0 ? -sample.offset_ns : sample.offset_ns;
+   if (sample.locked && abs_offset_ns <= m_lock_threshold_ns)
+      m_nb_consecutive_locked_samples++;
+   else
+      m_nb_consecutive_locked_samples = 0;
+
+   const bool locked_within_threshold = m_nb_consecutive_locked_samples >= lock_confirmation_samples;
+   if (locked_within_threshold && m_time_to_lock_s < 0.0)
+      m_time_to_lock_s = std::chrono::duration<double>(sample.time - m_lock_detection_start).count();
+   m_locked_within_threshold = locked_within_threshold;
+
+   m_status_state.store(static_cast<uint32_t>(sample.state), std::memory_order_relaxed);
+   m_status_locked_within_threshold.store(locked_within_threshold, std::memory_order_relaxed);
+   m_status_offset_ns.store(sample.offset_ns, std::memory_order_relaxed);
+
+   if (m_locked_within_threshold)
+      m_condition.notify_all();
+}
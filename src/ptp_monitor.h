@@ -0,0 +1,181 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file ptp_monitor.h
+   @brief This file contains the background PTP monitoring service.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Core.h"
+#include "VideoMasterHD/VideoMasterHD_PTP.h"
+#else
+#include "VideoMasterHD_Core.h"
+#include "VideoMasterHD_PTP.h"
+#endif
+
+/*!
+   @brief One sample of the PTP port state
+*/
+struct PtpSample
+{
+   std::chrono::steady_clock::time_point time;
+   VHD_PTP_PORT_STATE state;
+   bool locked /*! Lock flag reported by the board */;
+   int64_t offset_ns /*! Offset from the master in nanoseconds */;
+};
+
+/*!
+   @brief Statistics of the PTP offset over the samples of the history taken since the lock, or over the whole
+   history while not locked
+*/
+struct PtpStatistics
+{
+   uint32_t nb_samples = 0 /*! Samples the mean, standard deviation and maximum are computed over */;
+   VHD_PTP_PORT_STATE state = VHD_PTP_PORT_STATE_INITIALIZING /*! Last sampled state */;
+   int64_t offset_ns = 0 /*! Last sampled offset */;
+   double mean_offset_ns = 0.0;
+   double stddev_offset_ns = 0.0;
+   int64_t max_abs_offset_ns = 0;
+   bool locked_within_threshold = false;
+   double time_to_lock_s = -1.0 /*! Time between the (re)start of the lock detection and the lock, -1 if not locked yet */;
+};
+
+/*!
+   @brief Last PTP state published by the monitor
+*/
+struct PtpStatus
+{
+   VHD_PTP_PORT_STATE state;
+   bool locked_within_threshold;
+   int64_t offset_ns;
+};
+
+/*!
+   @brief Samples the PTP state of a board in a background thread
+
+   @detail The PTP is considered locked within threshold once the board reports a lock and the absolute offset
+   stays below the threshold for lock_confirmation_samples consecutive samples. The transmission and reception
+   start paths wait on that condition instead of polling the board.
+*/
+class PtpMonitor
+{
+public:
+   PtpMonitor(HANDLE board_handle /*!< [in] Board handle*/,
+              int64_t lock_threshold_ns = 1000 /*!< [in] Maximum absolute offset to be considered locked*/,
+              std::chrono::milliseconds sampling_period = std::chrono::milliseconds(100) /*!< [in] Sampling period*/,
+              uint32_t history_size = 600 /*!< [in] Number of samples kept for the statistics*/);
+   ~PtpMonitor();
+
+   PtpMonitor(const PtpMonitor&) = delete;
+   PtpMonitor& operator=(const PtpMonitor&) = delete;
+
+   /*!
+      @brief Start the sampling thread, thread_setup is called first on it (e.g. to set its scheduling)
+   */
+   void start(const std::function<void()>& thread_setup = {} /*!< [in] Setup of the sampling thread*/);
+   void stop();
+
+   /*!
+      @brief Restart the lock detection, to be called when the PTP configuration is changed
+   */
+   void restart_lock_detection();
+
+   /*!
+      @brief Sample another handle of the board, e.g. once it is reopened, and restart the lock detection
+
+      @detail A null handle suspends the sampling until a valid handle is set, to be set before the handle is
+      closed.
+   */
+   void set_board_handle(HANDLE board_handle /*!< [in] New board handle*/);
+
+   bool is_locked_within_threshold() const;
+
+   /*!
+      @brief Wait until the PTP is locked within threshold
+
+      @returns True if locked, false on timeout
+   */
+   bool wait_for_lock(std::chrono::milliseconds timeout /*!< [in] Maximum time to wait*/);
+
+   PtpStatistics get_statistics() const;
+
+   /*!
+      @brief Last sampled state and offset and the lock within threshold, read without the lock nor any computation
+      so that it can be called on every slot (the three values may come from consecutive samples)
+   */
+   PtpStatus get_status() const
+   {
+      return {static_cast<VHD_PTP_PORT_STATE>(m_status_state.load(std::memory_order_relaxed)),
+              m_status_locked_within_threshold.load(std::memory_order_relaxed),
+              m_status_offset_ns.load(std::memory_order_relaxed)};
+   }
+
+   /*!
+      @brief Copy of the sampling history, oldest sample first
+   */
+   std::vector<PtpSample> get_samples() const;
+
+   /*!
+      @brief Print the PTP status and the offset statistics on a single console line
+   */
+   void print_status(uint8_t domain_number /*!< [in] Domain number of the PTP service*/,
+                     uint8_t announce_receipt_timeout /*!< [in] Announce receipt timeout in seconds*/) const;
+
+private:
+   static const uint32_t lock_confirmation_samples = 3;
+
+   void run();
+   void add_sample(const PtpSample& sample);
+
+   HANDLE m_board_handle;
+   const int64_t m_lock_threshold_ns;
+   const std::chrono::milliseconds m_sampling_period;
+
+   mutable std::mutex m_mutex;
+   std::condition_variable m_condition;
+   std::thread m_thread;
+   std::function<void()> m_thread_setup;
+   bool m_stop = false;
+   bool m_suspended = false /*! Sampling stopped by a null board handle, restarted by the next valid one */;
+
+   std::vector<PtpSample> m_samples; // ring buffer
+   uint32_t m_next_sample = 0;
+   uint32_t m_nb_samples = 0;
+   uint32_t m_nb_consecutive_locked_samples = 0;
+   bool m_locked_within_threshold = false;
+   std::chrono::steady_clock::time_point m_lock_detection_start;
+   double m_time_to_lock_s = -1.0;
+
+   // Published by the sampling thread for get_status()
+   std::atomic<uint32_t> m_status_state{VHD_PTP_PORT_STATE_INITIALIZING};
+   std::atomic<bool> m_status_locked_within_threshold{false};
+   std::atomic<int64_t> m_status_offset_ns{0};
+};
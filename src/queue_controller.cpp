@@ -0,0 +1,246 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "board_backend.h"
+#include "queue_controller.h"
+
+QueueController::QueueController(const QueueTuningConfig& config, bool transmission)
+    : m_config(config)
+    , m_transmission(transmission)
+    , m_depth(std::max<uint32_t>(1, std::min(std::max(config.initial_depth, config.min_depth), config.max_depth)))
+    , m_next_depth(m_depth)
+{
+}
+
+VHD_ERRORCODE QueueController::apply(HANDLE stream_handle, const VideoStandardInfo& video_standard_info)
+{
+   if (!m_config.adaptive)
+      return VHDERR_NOERROR;
+
+   // A slot holds a frame, frame_rate is the field rate for interlaced standards
+   m_frame_period = std::chrono::nanoseconds(static_cast<int64_t>(
+       1e9 * (video_standard_info.is_us ? 1.001 : 1.0) * (video_standard_info.interlaced ? 2 : 1) /
+       video_standard_info.frame_rate));
+   if (!m_io_timeout_ms)
+      m_io_timeout_ms = get_io_timeout_ms(std::chrono::nanoseconds(0));
+
+   return apply_tuning(stream_handle);
+}
+
+VHD_ERRORCODE QueueController::restart_stream(HANDLE stream_handle)
+{
+   VHD_ERRORCODE result = board_backend().stop_stream(stream_handle);
+   if (result != VHDERR_NOERROR)
+   {
+      std::cout << "Error stopping the stream: " << to_string(result) << std::endl;
+      return result;
+   }
+
+   result = apply_tuning(stream_handle);
+   if (result != VHDERR_NOERROR)
+      return result;
+
+   result = board_backend().start_stream(stream_handle);
+   if (result != VHDERR_NOERROR)
+      std::cout << "Error starting the stream: " << to_string(result) << std::endl;
+   return result;
+}
+
+QueueAction QueueController::on_slot_locked(HANDLE stream_handle, std::chrono::nanoseconds lock_wait)
+{
+   if (!m_config.adaptive)
+      return QueueAction::none;
+
+   ULONG filling = 0;
+   if (board_backend().get_stream_property(stream_handle, VHD_CORE_SP_BUFFERQUEUE_FILLING, &filling) !=
+       VHDERR_NOERROR)
+      filling = m_transmission ? m_depth - 1 : 0; // unknown filling, only the drops are followed
+   filling = std::min<ULONG>(filling, m_depth - 1);
+
+   m_window_min_margin = std::min(m_window_min_margin, get_margin(filling));
+   m_window_filling_sum += filling;
+   m_window_max_lock_wait = std::max(m_window_max_lock_wait, lock_wait);
+
+   if (++m_nb_window_slots < m_config.evaluation_slots)
+      return QueueAction::none;
+   return evaluate(stream_handle);
+}
+
+void QueueController::on_timeout(HANDLE stream_handle)
+{
+   if (!m_config.adaptive)
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_statistics.nb_timeouts++;
+   }
+   const uint32_t io_timeout_ms =
+       std::min(m_config.max_io_timeout_ms, std::max(m_config.min_io_timeout_ms, 2 * m_io_timeout_ms));
+   if (io_timeout_ms != m_io_timeout_ms)
+      set_io_timeout(stream_handle, io_timeout_ms);
+}
+
+QueueControllerStatistics QueueController::get_statistics() const
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return m_statistics;
+}
+
+void QueueController::print_status() const
+{
+   if (!m_config.adaptive)
+      return;
+
+   const QueueControllerStatistics statistics = get_statistics();
+   std::cout << " - Queue: " << statistics.depth;
+   if (statistics.next_depth != statistics.depth)
+      std::cout << "->" << statistics.next_depth;
+   std::cout << " (" << std::fixed << std::setprecision(1)
+             << statistics.latency_frames << std::defaultfloat << " frames) - IOTimeout: " << statistics.io_timeout_ms
+             << " ms";
+}
+
+void QueueController::print_statistics() const
+{
+   if (!m_config.adaptive)
+      return;
+
+   const QueueControllerStatistics statistics = get_statistics();
+   std::cout << "Slot queue: depth " << statistics.depth << " [" << m_config.min_depth << ", " << m_config.max_depth
+             << "] - latency " << std::fixed << std::setprecision(2) << statistics.latency_frames << std::defaultfloat
+             << " frames - IO timeout " << statistics.io_timeout_ms << " ms - windows: " << statistics.nb_windows
+             << " - grows: " << statistics.nb_grows << " - shrinks: " << statistics.nb_shrinks
+             << " - timeouts: " << statistics.nb_timeouts << " - dropped: " << statistics.nb_dropped_slots
+             << std::endl;
+}
+
+VHD_ERRORCODE QueueController::apply_tuning(HANDLE stream_handle)
+{
+   VHD_ERRORCODE result =
+       board_backend().set_stream_property(stream_handle, VHD_CORE_SP_BUFFERQUEUE_DEPTH, m_next_depth);
+   if (result != VHDERR_NOERROR)
+   {
+      std::cout << "Error setting buffer queue depth: " << to_string(result) << std::endl;
+      return result;
+   }
+   const uint32_t previous_depth = m_depth;
+   m_depth = m_next_depth;
+
+   result = set_io_timeout(stream_handle, m_io_timeout_ms);
+   if (result != VHDERR_NOERROR)
+      return result;
+
+   // The slot counters of the stream restart from 0 with the stream
+   m_previous_slots_dropped = 0;
+   reset_window();
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_statistics.depth = m_depth;
+   m_statistics.next_depth = m_next_depth;
+   if (m_depth > previous_depth)
+      m_statistics.nb_grows++;
+   else if (m_depth < previous_depth)
+      m_statistics.nb_shrinks++;
+   return VHDERR_NOERROR;
+}
+
+uint32_t QueueController::get_margin(ULONG filling) const
+{
+   // Slots that can still pile up before a drop in reception, slots queued ahead of the board in transmission
+   return m_transmission ? filling : m_depth - 1 - filling;
+}
+
+uint32_t QueueController::get_io_timeout_ms(std::chrono::nanoseconds longest_lock_wait) const
+{
+   const auto io_timeout = std::max(m_frame_period * m_config.io_timeout_periods, 2 * longest_lock_wait);
+   const auto io_timeout_ms = std::chrono::ceil<std::chrono::milliseconds>(io_timeout).count();
+   return static_cast<uint32_t>(std::min<int64_t>(
+       m_config.max_io_timeout_ms, std::max<int64_t>(m_config.min_io_timeout_ms, io_timeout_ms)));
+}
+
+VHD_ERRORCODE QueueController::set_io_timeout(HANDLE stream_handle, uint32_t io_timeout_ms)
+{
+   const VHD_ERRORCODE result =
+       board_backend().set_stream_property(stream_handle, VHD_CORE_SP_IO_TIMEOUT, io_timeout_ms);
+   if (result != VHDERR_NOERROR)
+   {
+      std::cout << "Error setting IO timeout: " << to_string(result) << std::endl;
+      return result;
+   }
+
+   m_io_timeout_ms = io_timeout_ms;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_statistics.io_timeout_ms = io_timeout_ms;
+   return VHDERR_NOERROR;
+}
+
+QueueAction QueueController::evaluate(HANDLE stream_handle)
+{
+   ULONG slots_dropped = m_previous_slots_dropped;
+   board_backend().get_stream_property(stream_handle, VHD_CORE_SP_SLOTS_DROPPED, &slots_dropped);
+   const ULONG nb_dropped_slots = slots_dropped >= m_previous_slots_dropped ? slots_dropped - m_previous_slots_dropped
+                                                                             : 0;
+   m_previous_slots_dropped = slots_dropped;
+
+   // A grow restarts the stream right away, a shrink is pending until the next start of the stream and is
+   // cancelled by a window without spare margin
+   bool is_growing = false;
+   if (nb_dropped_slots || !m_window_min_margin)
+   {
+      m_nb_stable_windows = 0;
+      m_next_depth = m_depth < m_config.max_depth ? m_depth + 1 : m_depth;
+      is_growing = m_next_depth != m_depth;
+   }
+   else if (m_window_min_margin >= 2)
+   {
+      if (++m_nb_stable_windows >= m_config.shrink_after_windows && m_depth > m_config.min_depth)
+         m_next_depth = m_depth - 1;
+   }
+   else
+   {
+      m_nb_stable_windows = 0;
+      m_next_depth = m_depth;
+   }
+
+   // The timeout follows the slowest lock right away, and comes back down once the queue has spare margin
+   const uint32_t io_timeout_ms = get_io_timeout_ms(m_window_max_lock_wait);
+   if (io_timeout_ms > m_io_timeout_ms || (io_timeout_ms < m_io_timeout_ms && m_nb_stable_windows))
+      set_io_timeout(stream_handle, io_timeout_ms);
+
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_statistics.latency_frames = 1.0 + static_cast<double>(m_window_filling_sum) / m_nb_window_slots;
+      m_statistics.min_margin = m_window_min_margin;
+      m_statistics.nb_windows++;
+      m_statistics.nb_dropped_slots += nb_dropped_slots;
+      m_statistics.next_depth = m_next_depth;
+   }
+
+   reset_window();
+   return is_growing ? QueueAction::restart_stream : QueueAction::none;
+}
+
+void QueueController::reset_window()
+{
+   m_nb_window_slots = 0;
+   m_window_min_margin = m_depth - 1;
+   m_window_filling_sum = 0;
+   m_window_max_lock_wait = std::chrono::nanoseconds(0);
+}
@@ -0,0 +1,160 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file queue_controller.h
+   @brief This file contains the adaptive tuning of the slot queue depth and of the IO timeout of a stream.
+
+   @detail The controller follows, slot after slot, the margin left in the buffer queue of the board: the slots
+   that can still pile up before the next one is dropped in reception, the slots queued ahead of the transmission
+   in transmission. Every evaluation window, it grows the queue by one slot when a slot was dropped or the margin
+   was exhausted, and shrinks it by one slot after several windows without drop and with spare margin, within the
+   configured depth bounds. As the depth of the queue can only be set on a stopped stream, a grow is applied by
+   restarting the stream from the slot loop, which drops the slots of the restart on air. A healthy stream is never
+   restarted to shrink its queue: a shrink waits for the next start of the stream. The IO timeout is applied right
+   away.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <chrono>
+#include <mutex>
+
+#include "tools.h"
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Core.h"
+#else
+#include "VideoMasterHD_Core.h"
+#endif
+
+struct QueueTuningConfig
+{
+   bool adaptive = false /*! Tune the queue of the stream, else keep the driver defaults. Each grow restarts the
+                             stream, a glitch on air, shrinks wait for the next start of the stream */;
+   uint32_t initial_depth = 4 /*! Queue depth in slots when the stream first starts */;
+   uint32_t min_depth = 2 /*! Smallest queue depth */;
+   uint32_t max_depth = 8 /*! Largest queue depth, bounds the latency added by the queue */;
+   uint32_t evaluation_slots = 250 /*! Slots of an evaluation window */;
+   uint32_t shrink_after_windows = 8 /*! Consecutive windows without drop and with spare margin before the queue
+                                         shrinks at the next start of the stream */;
+   uint32_t io_timeout_periods = 3 /*! IO timeout in frame periods, and at least twice the longest slot lock */;
+   uint32_t min_io_timeout_ms = 20;
+   uint32_t max_io_timeout_ms = 200;
+};
+
+/*!
+   @brief Outcome of a slot for the slot loop
+*/
+enum class QueueAction
+{
+   none,
+   restart_stream /*! The queue grew, the stream is to be stopped and started again */
+};
+
+struct QueueControllerStatistics
+{
+   uint32_t depth = 0 /*! Current queue depth, 0 if the driver default is kept */;
+   uint32_t next_depth = 0 /*! Queue depth of the next start of the stream, below depth for a pending shrink */;
+   uint32_t io_timeout_ms = 0 /*! Current IO timeout, 0 if the driver default is kept */;
+   double latency_frames = 0.0 /*! Mean latency added by the queue over the last window, in frames */;
+   uint32_t min_margin = 0 /*! Smallest margin of the last window, in slots */;
+   uint64_t nb_windows = 0;
+   uint64_t nb_grows = 0;
+   uint64_t nb_shrinks = 0;
+   uint64_t nb_timeouts = 0;
+   uint64_t nb_dropped_slots = 0 /*! Slots dropped since the controller was created */;
+};
+
+/*!
+   @brief Adaptive tuning of the slot queue of one stream, driven from its slot loop
+*/
+class QueueController
+{
+public:
+   QueueController(const QueueTuningConfig& config /*!< [in] Tuning bounds*/,
+                   bool transmission /*!< [in] True for a TX stream, false for a RX stream*/);
+
+   QueueController(const QueueController&) = delete;
+   QueueController& operator=(const QueueController&) = delete;
+
+   /*!
+      @brief Set the current queue depth and IO timeout on a stream that is not started, to be called before every
+      start of the stream
+
+      @returns The function returns the status of its execution as VHD_ERRORCODE
+   */
+   VHD_ERRORCODE apply(HANDLE stream_handle /*!< [in] Stopped stream*/,
+                       const VideoStandardInfo& video_standard_info /*!< [in] Video standard of the stream*/);
+
+   /*!
+      @brief Stop the stream, set the new queue depth and start the stream again, on QueueAction::restart_stream
+
+      @returns The function returns the status of its execution as VHD_ERRORCODE
+   */
+   VHD_ERRORCODE restart_stream(HANDLE stream_handle /*!< [in] Started stream*/);
+
+   /*!
+      @brief Account for a locked slot, to be called by the slot loop right after each slot lock
+
+      @returns QueueAction::restart_stream when the stream is to be restarted with a new queue depth
+   */
+   QueueAction on_slot_locked(HANDLE stream_handle /*!< [in] Started stream*/,
+                              std::chrono::nanoseconds lock_wait /*!< [in] Time spent in the slot lock*/);
+
+   /*!
+      @brief Account for a slot lock that timed out, the IO timeout is doubled within its bounds
+   */
+   void on_timeout(HANDLE stream_handle /*!< [in] Started stream*/);
+
+   QueueControllerStatistics get_statistics() const;
+
+   /*!
+      @brief Print the queue depth, latency and IO timeout, without end of line, for the monitoring lines
+   */
+   void print_status() const;
+
+   void print_statistics() const;
+
+private:
+   VHD_ERRORCODE apply_tuning(HANDLE stream_handle);
+   uint32_t get_margin(ULONG filling) const;
+   uint32_t get_io_timeout_ms(std::chrono::nanoseconds duration) const;
+   VHD_ERRORCODE set_io_timeout(HANDLE stream_handle, uint32_t io_timeout_ms);
+   QueueAction evaluate(HANDLE stream_handle);
+   void reset_window();
+
+   const QueueTuningConfig m_config;
+   const bool m_transmission;
+   std::chrono::nanoseconds m_frame_period{0};
+
+   // Only used by the slot loop
+   uint32_t m_depth;
+   uint32_t m_next_depth /*! Depth set at the next start of the stream */;
+   uint32_t m_io_timeout_ms = 0;
+   uint32_t m_nb_window_slots = 0;
+   uint32_t m_window_min_margin = 0;
+   uint64_t m_window_filling_sum = 0;
+   std::chrono::nanoseconds m_window_max_lock_wait{0};
+   uint32_t m_nb_stable_windows = 0;
+   ULONG m_previous_slots_dropped = 0;
+
+   mutable std::mutex m_mutex;
+   QueueControllerStatistics m_statistics;
+};
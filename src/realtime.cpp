@@ -0,0 +1,187 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "realtime.h"
+
+#if defined(__linux__)
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+#if defined(__linux__)
+   // cpulist is of the form "0-7,16-23", as in /sys/devices/system/node/node*/cpulist
+   bool parse_cpulist(const std::string& cpulist, cpu_set_t& cpus)
+   {
+      CPU_ZERO(&cpus);
+      std::istringstream iss(cpulist);
+      std::string range;
+      while (std::getline(iss, range, ','))
+      {
+         unsigned int first = 0, last = 0;
+         const int nb_fields = std::sscanf(range.c_str(), "%u-%u", &first, &last);
+         if (nb_fields < 1)
+            return false;
+         if (nb_fields == 1)
+            last = first;
+         for (unsigned int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &cpus);
+      }
+      return CPU_COUNT(&cpus) > 0;
+   }
+
+   int to_native_policy(SchedulingPolicy policy)
+   {
+      switch (policy)
+      {
+      case SchedulingPolicy::fifo: return SCHED_FIFO;
+      case SchedulingPolicy::round_robin: return SCHED_RR;
+      default: return SCHED_OTHER;
+      }
+   }
+
+   // CPUs of the calling thread the first time a scheduling is applied, given to the roles without CPU list
+   const cpu_set_t& get_default_cpus()
+   {
+      static const cpu_set_t default_cpus = [] {
+         cpu_set_t cpus;
+         CPU_ZERO(&cpus);
+         if (pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+            CPU_ZERO(&cpus);
+         return cpus;
+      }();
+      return default_cpus;
+   }
+
+   void prefault_stack(size_t size)
+   {
+      volatile char* stack = static_cast<volatile char*>(alloca(size));
+      for (size_t offset = 0; offset < size; offset += 4096)
+         stack[offset] = 0;
+   }
+#endif
+}
+
+const char* to_string(ThreadRole role)
+{
+   switch (role)
+   {
+   case ThreadRole::slot_loop: return "slot loop";
+   case ThreadRole::producer: return "producer";
+   case ThreadRole::monitor: return "monitor";
+   case ThreadRole::control_plane: return "control plane";
+   default: return "unknown";
+   }
+}
+
+const char* to_string(SchedulingPolicy policy)
+{
+   switch (policy)
+   {
+   case SchedulingPolicy::other: return "SCHED_OTHER";
+   case SchedulingPolicy::fifo: return "SCHED_FIFO";
+   case SchedulingPolicy::round_robin: return "SCHED_RR";
+   default: return "unknown";
+   }
+}
+
+const ThreadScheduling& RealtimeConfig::get(ThreadRole role) const
+{
+   switch (role)
+   {
+   case ThreadRole::slot_loop: return slot_loop;
+   case ThreadRole::producer: return producer;
+   case ThreadRole::monitor: return monitor;
+   default: return control_plane;
+   }
+}
+
+bool apply_thread_scheduling(ThreadRole role, const RealtimeConfig& config, std::ostream& log)
+{
+   const ThreadScheduling& scheduling = config.get(role);
+
+#if defined(__linux__)
+   // The scheduling is always applied, so that a thread never keeps the one inherited from a thread of another role
+   bool applied = true;
+   cpu_set_t cpus = get_default_cpus();
+   if (!scheduling.cpus.empty() && !parse_cpulist(scheduling.cpus, cpus))
+   {
+      log << "Invalid CPU list \"" << scheduling.cpus << "\" for the " << to_string(role) << " threads"
+          << std::endl;
+      applied = false;
+   }
+   else if (CPU_COUNT(&cpus) > 0)
+   {
+      if (const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+      {
+         log << "Could not restrict the " << to_string(role) << " threads to CPUs " << scheduling.cpus << ": "
+             << std::strerror(error) << std::endl;
+         applied = false;
+      }
+   }
+
+   sched_param parameters = {};
+   parameters.sched_priority = scheduling.policy == SchedulingPolicy::other ? 0 : scheduling.priority;
+   if (const int error = pthread_setschedparam(pthread_self(), to_native_policy(scheduling.policy), &parameters))
+   {
+      log << "Could not set " << to_string(scheduling.policy) << " priority " << parameters.sched_priority
+          << " on the " << to_string(role) << " threads: " << std::strerror(error)
+          << (error == EPERM ? " (CAP_SYS_NICE or RLIMIT_RTPRIO needed)" : "") << std::endl;
+      applied = false;
+   }
+
+   if (applied && (scheduling.policy != SchedulingPolicy::other || !scheduling.cpus.empty()))
+      log << "Scheduling of the " << to_string(role) << " threads: " << to_string(scheduling.policy)
+          << (scheduling.policy == SchedulingPolicy::other ? "" : " " + std::to_string(scheduling.priority))
+          << (scheduling.cpus.empty() ? "" : " on CPUs " + scheduling.cpus) << std::endl;
+   return applied;
+#else
+   if (scheduling.policy == SchedulingPolicy::other && scheduling.cpus.empty())
+      return true;
+   log << "Thread scheduling options are only available on Linux" << std::endl;
+   return false;
+#endif
+}
+
+bool lock_process_memory(const RealtimeConfig& config)
+{
+   if (!config.lock_memory)
+      return true;
+
+#if defined(__linux__)
+   if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+   {
+      std::cout << "Could not lock the process memory: " << std::strerror(errno)
+                << (errno == ENOMEM || errno == EPERM ? " (RLIMIT_MEMLOCK too low)" : "") << std::endl;
+      return false;
+   }
+
+   // With the pages locked, the stack touched now stays resident and the slot loop never faults on it
+   prefault_stack(config.prefault_stack_size);
+   return true;
+#else
+   std::cout << "Memory locking is only available on Linux" << std::endl;
+   return false;
+#endif
+}
@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file realtime.h
+   @brief This file contains the scheduling, CPU affinity and memory locking options of the sample threads.
+*/
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+/*!
+   @brief Role of a thread of the samples, each role has its own scheduling
+*/
+enum class ThreadRole
+{
+   slot_loop /*! Streaming loop locking and filling or reading the slots */,
+   producer /*! Workers producing the frames for the slot loop (e.g. unpacking of a replayed capture) */,
+   monitor /*! Stream and PTP monitoring */,
+   control_plane /*! NMOS node, HTTP server and every other thread */
+};
+
+const char* to_string(ThreadRole role);
+
+enum class SchedulingPolicy
+{
+   other /*! SCHED_OTHER, the default time-sharing policy */,
+   fifo /*! SCHED_FIFO real-time policy */,
+   round_robin /*! SCHED_RR real-time policy */
+};
+
+const char* to_string(SchedulingPolicy policy);
+
+struct ThreadScheduling
+{
+   SchedulingPolicy policy = SchedulingPolicy::other /*! Scheduling policy of the thread */;
+   int priority = 0 /*! Real-time priority, 1 (lowest) to 99, ignored for SchedulingPolicy::other */;
+   std::string cpus /*! CPUs the thread may run on, as a cpulist ("2", "4-7,12"), empty for the default ones */;
+};
+
+struct RealtimeConfig
+{
+   ThreadScheduling slot_loop;
+   ThreadScheduling producer;
+   ThreadScheduling monitor;
+   ThreadScheduling control_plane;
+   bool lock_memory = false /*! Lock all the current and future pages of the process in memory (mlockall) */;
+   size_t prefault_stack_size = 512 * 1024 /*! Stack of the calling thread faulted in when the memory is locked */;
+
+   const ThreadScheduling& get(ThreadRole role) const;
+};
+
+/*!
+   @brief Apply the scheduling of a role to the calling thread
+
+   @detail Threads created afterwards by the calling thread inherit its policy, priority and CPUs, so applying the
+   control plane scheduling on the main thread first places the threads of the NMOS node and of the HTTP server.
+   The default CPUs of the roles without CPU list are the ones of the thread on which a scheduling is first
+   applied. The real-time policies need CAP_SYS_NICE or an RLIMIT_RTPRIO limit.
+
+   @returns True if the scheduling has been applied
+*/
+bool apply_thread_scheduling(ThreadRole role /*!< [in] Role of the calling thread*/,
+                             const RealtimeConfig& config /*!< [in] Scheduling of every role*/,
+                             std::ostream& log = std::cout /*!< [in] Stream the applied scheduling is reported to*/);
+
+/*!
+   @brief Lock the pages of the process in memory and fault in the stack of the calling thread, if configured
+
+   @returns True if the memory has been locked or if locking is not configured
+*/
+bool lock_process_memory(const RealtimeConfig& config /*!< [in] Memory options*/);
@@ -13,9 +13,15 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iomanip>
 #include <thread>
 
 #if defined(__GNUC__) && !(defined(__APPLE__))
@@ -39,7 +45,22 @@
 #include "nmos/node_server.h"
 
 #include "../tools.h"
+#include "../async_log_gate.h"
+#include "../board_backend.h"
+#include "../board_reconciler.h"
 #include "../nmos_tools.h"
+#include "../depacketizer.h"
+#include "../flight_recorder.h"
+#include "../numa.h"
+#include "../multicast_membership.h"
+#include "../ptp_monitor.h"
+#include "../queue_controller.h"
+#include "../realtime.h"
+#include "../shm_frame_ring.h"
+#include "../simulated_board.h"
+#include "../slot_tracer.h"
+#include "../startup_profiler.h"
+#include "../stream_watchdog.h"
 
 #include "videoviewer/videoviewer.hpp"
 
@@ -62,10 +83,219 @@ static void render_video(Deltacast::VideoViewer& viewer,
 }
 #endif
 
+static void display_frame(Deltacast::VideoViewer& viewer, const uint8_t* buffer, uint64_t buffer_size)
+{
+   uint8_t* viewer_data = nullptr;
+   uint64_t viewer_data_size = 0;
+
+   viewer.lock_data(&viewer_data, &viewer_data_size);
+   if (viewer_data_size != buffer_size)
+   {
+      std::cout << "Buffer size (" << buffer_size << ") does not match with videoviewer data size ("
+                << viewer_data_size << ")" << std::endl;
+   }
+   else
+   {
+      std::memcpy(viewer_data, buffer, buffer_size);
+   }
+   viewer.unlock_data();
+}
+
+static void display_line_block(Deltacast::VideoViewer& viewer, const LineBlock& block)
+{
+   uint8_t* viewer_data = nullptr;
+   uint64_t viewer_data_size = 0;
+
+   // The viewer data has the layout of the frame buffer
+   viewer.lock_data(&viewer_data, &viewer_data_size);
+   const uint64_t block_offset = block.first_line * block.line_size;
+   const uint64_t block_end = block_offset + (block.nb_lines - 1) * block.line_stride + block.line_size;
+   if (viewer_data_size < block_end)
+   {
+      std::cout << "Line block (up to " << block_end << " bytes) does not fit in the videoviewer data ("
+                << viewer_data_size << ")" << std::endl;
+   }
+   else
+   {
+      for (uint32_t line = 0; line < block.nb_lines; line++)
+         std::memcpy(viewer_data + block_offset + line * block.line_stride, block.data + line * block.line_stride,
+                     block.line_size);
+   }
+   viewer.unlock_data();
+}
+
+/*!
+   @brief Write the lines of a block at their place in a raw recording of the frames
+*/
+static void record_line_block(std::ofstream& recording, uint64_t frame_offset, const LineBlock& block)
+{
+   for (uint32_t line = 0; line < block.nb_lines; line++)
+   {
+      recording.seekp(frame_offset + block.first_line * block.line_size + line * block.line_stride);
+      recording.write(reinterpret_cast<const char*>(block.data + line * block.line_stride), block.line_size);
+   }
+}
+
+/*!
+   @brief Rebuild the frames of a ST 2110-20 capture in software and display them at the pace of the capture, in
+   place of the board reception
+
+   @detail With line blocks, the blocks are displayed, checked for losses and recorded as soon as they land,
+   without waiting for the end of their frame.
+*/
+static int replay_capture(const std::string& capture_path,
+                          const Ipv4Endpoint& destination,
+                          VHD_ST2110_20_VIDEO_STANDARD video_standard,
+                          const VideoFormat& video_format,
+                          uint32_t nb_line_blocks,
+                          const std::string& record_path,
+                          Deltacast::VideoViewer& viewer,
+                          const std::string& window_title,
+                          const RealtimeConfig& realtime_config)
+{
+   const VideoStandardInfo* video_standard_info = find_video_standard_info(video_standard);
+   if (!video_standard_info)
+   {
+      std::cout << "Error when getting video standard info" << std::endl;
+      return -1;
+   }
+   if (!St2110_20Depacketizer::is_supported(video_format))
+   {
+      std::cout << "Error when replaying " << to_string(video_format) << ": only YCbCr-4:2:2 flows can be rebuilt"
+                << std::endl;
+      return -1;
+   }
+
+   PcapReader reader;
+   if (!reader.open(capture_path))
+      return -1;
+
+   std::ofstream recording;
+   if (!record_path.empty())
+   {
+      recording.open(record_path, std::ios::binary | std::ios::trunc);
+      if (!recording)
+      {
+         std::cout << "Error when opening the recording " << record_path << std::endl;
+         return -1;
+      }
+   }
+
+   if (!viewer.init(960,
+                    540,
+                    window_title.c_str(),
+                    video_standard_info->frame_width,
+                    video_standard_info->frame_height,
+                    Deltacast::VideoViewer::InputFormat::ycbcr_422_10_le_msb))
+   {
+      std::cout << "VideoViewer initialization failed" << std::endl;
+      return -1;
+   }
+   viewer.start();
+
+#ifndef __APPLE__
+   std::thread viewerthread([&] {
+      apply_thread_scheduling(ThreadRole::control_plane, realtime_config);
+      render_video(viewer, 100);
+   });
+#endif
+
+   std::cout << "Replaying " << capture_path << " (" << to_chars(destination).c_str()
+             << "), press any key to stop..." << std::endl;
+
+   St2110_20Depacketizer depacketizer(video_standard_info->frame_width, video_standard_info->frame_height,
+                                      video_standard_info->interlaced, video_format);
+   depacketizer.set_worker_setup([&] { apply_thread_scheduling(ThreadRole::producer, realtime_config); });
+   apply_thread_scheduling(ThreadRole::slot_loop, realtime_config);
+   lock_process_memory(realtime_config);
+   const auto replay_start = std::chrono::steady_clock::now();
+   const uint64_t frame_size = St2110_20Depacketizer::get_frame_size(video_standard_info->frame_width,
+                                                                     video_standard_info->frame_height);
+   uint64_t first_timestamp_ns = 0, nb_frames = 0;
+
+   // Replays the capture at its pace: a frame or a line block is handled when its last packet was captured
+   auto wait_for_capture_time = [&](uint64_t timestamp_ns) {
+      if (first_timestamp_ns == 0)
+         first_timestamp_ns = timestamp_ns;
+      if (timestamp_ns > first_timestamp_ns)
+         std::this_thread::sleep_until(replay_start + std::chrono::nanoseconds(timestamp_ns - first_timestamp_ns));
+   };
+
+   if (nb_line_blocks)
+   {
+      depacketizer.set_line_blocks(nb_line_blocks, [&](const LineBlock& block) {
+         wait_for_capture_time(block.completion_timestamp_ns);
+
+         if (block.nb_incomplete_lines)
+            std::cout << "Frame " << block.rtp_timestamp << " block " << block.index << ": "
+                      << block.nb_incomplete_lines << " incomplete lines" << std::endl;
+
+         display_line_block(viewer, block);
+         if (recording.is_open())
+            record_line_block(recording, nb_frames * frame_size, block);
+         return true;
+      });
+   }
+
+   nb_frames = depacketizer.run(reader, destination, [&](const DepacketizedFrame& frame) {
+      if (_kbhit())
+      {
+         _getch();
+         return false;
+      }
+      if (viewer.window_request_close())
+         return false;
+
+      if (nb_line_blocks)
+      {
+         if (frame.nb_lost_packets)
+            std::cout << "Frame " << frame.rtp_timestamp << ": " << frame.nb_lost_packets << " packets lost"
+                      << std::endl;
+         // Position of the next frame in the recording
+         nb_frames++;
+      }
+      else
+      {
+         wait_for_capture_time(frame.end_timestamp_ns);
+
+         if (frame.nb_lost_packets || frame.nb_incomplete_lines)
+            std::cout << "Frame " << frame.rtp_timestamp << ": " << frame.nb_lost_packets << " packets lost, "
+                      << frame.nb_incomplete_lines << " incomplete lines" << std::endl;
+
+         display_frame(viewer, frame.buffer.data(), frame.buffer.size());
+         if (recording.is_open())
+            recording.write(reinterpret_cast<const char*>(frame.buffer.data()), frame.buffer.size());
+      }
+
+      viewer.process_escape_key();
+      viewer.render_iteration();
+      return true;
+   });
+
+   std::cout << nb_frames << " frames replayed" << std::endl;
+   if (nb_line_blocks)
+   {
+      const LineBlockStatistics statistics = depacketizer.get_line_block_statistics();
+      std::cout << "Line blocks: " << statistics.nb_blocks << " blocks, available " << std::fixed
+                << std::setprecision(2) << statistics.mean_advance_ns / 1e6 << " ms before their whole frame on"
+                << " average (first block of a frame " << statistics.mean_first_block_advance_ns / 1e6 << " ms)"
+                << std::defaultfloat << std::endl;
+   }
+
+   viewer.stop();
+#ifndef __APPLE__
+   viewerthread.join();
+#endif
+   viewer.release();
+
+   return 0;
+}
+
 int main(int argc, char* argv[])
 {
    //VHD parameters
-   const uint32_t board_id = 0;
+   const uint32_t board_id = 0; // Board used for streaming, all the boards of the host are opened
+   const std::string board_state_directory = BoardReconciler::get_default_state_directory(); // Cost of the board settings kept across runs, one file per board, to log the time saved when they are already in place
 
    //Media NIC
    const std::string media_nic_name = "delta" + std::to_string(board_id);  //Streaming network interface controller
@@ -76,8 +306,66 @@ int main(int argc, char* argv[])
 
    //NMOS parameters
    const std::string management_nic_ip = "192.168.0.10"; //Management network interface controller
-   const uint32_t default_destination_address = 0xef0a0a01; //default IP destination address used for resolving "auto" nmos parameter
-   const uint16_t default_destination_udp_port = 1025; //default UDP destination port used for resolving "auto" nmos parameter IP address
+   const Ipv4Endpoint default_destination = {Ipv4Address(0xef0a0a01), 1025}; //default IP destination address and UDP port used for resolving "auto" nmos parameters
+
+   // PTP parameters
+   const bool wait_for_ptp_lock = false; // Opt-in: start the stream only once the PTP is locked within threshold, the PTP is monitored either way
+   const int64_t ptp_lock_threshold_ns = 1000; // Maximum absolute PTP offset to be considered locked
+
+   // Multicast parameters
+   const std::chrono::milliseconds multicast_leave_delay(2000); // A group no stream uses is left after this delay, unless joined again
+
+   // Capture replay parameters
+   const std::string replay_capture_path = ""; // If set, the frames are rebuilt from this pcap capture instead of a board
+   const Ipv4Endpoint replay_destination = default_destination; // IP destination address and UDP port of the flow to replay
+   const auto replay_video_standard = VHD_ST2110_20_VIDEOSTD_1920x1080p60; // Video standard of the flow to replay
+   const VideoFormat replay_video_format = default_video_format; // Sampling and depth of the flow to replay, YCbCr-4:2:2 at 8, 10 or 12 bits
+   const uint32_t replay_line_blocks = 0; // Hand the frames over in this many line blocks as they land (e.g. 8), 0 for whole frames
+   const std::string replay_record_path = ""; // If set, the replayed frames are written to this raw file (YUV 4:2:2 10-bit layout)
+
+   // Shared-memory output parameters
+   const std::string shm_output_name = ""; // If set (e.g. "/nmos_vhd_rx"), the received frames are published to this POSIX shared-memory ring
+   const uint32_t shm_output_slots = 4; // Frames kept in the ring, a consumer more than this many frames late loses frames
+
+   // Flight recorder parameters
+   const std::string flight_recorder_path = "receiver_flight_recorder.bin"; // If set, the stream status and events are kept in this memory-mapped ring file, read it with flight_decoder
+   const uint32_t flight_recorder_records = 36000; // Records of 64 bytes kept in the file, one per 100 ms status or event (about 1 hour)
+
+   // Simulated board parameters
+   const bool simulated_board = false; // Run the sample loops on a simulated board instead of a DELTACAST IP Card
+   const SimulatedBoardConfig simulated_board_config = {}; // Slot cadence, drops and PTP behaviour of the simulated board
+
+   // Real-time parameters, e.g. {SchedulingPolicy::fifo, 80, "2"} runs the slot loop on an isolated CPU 2
+   const RealtimeConfig realtime_config = {
+       {SchedulingPolicy::other, 0, ""}, // Slot loop (the main thread once the node is ready, or replaying)
+       {SchedulingPolicy::other, 0, ""}, // Producer workers (unpacking of the replayed capture)
+       {SchedulingPolicy::other, 0, ""}, // Stream and PTP monitoring threads
+       {SchedulingPolicy::other, 0, ""}, // Control plane: NMOS node, HTTP server, viewer and other threads
+       false};                           // Lock the process memory (mlockall) and prefault the stack
+
+   // Slot queue parameters
+   const QueueTuningConfig queue_tuning_config = {
+       false, // Tune the queue and IO timeout to the margin and drops, a grow restarts the stream (glitch on air)
+       4,     // Initial queue depth in slots
+       2,     // Minimum queue depth in slots
+       8};    // Maximum queue depth in slots, bounds the latency added by the queue
+
+   // Stall watchdog parameters
+   const StreamWatchdogConfig stream_watchdog_config = {
+       false,                            // Opt-in: recover the stream when no slot completes instead of waiting or stopping
+       10,                               // Frame periods without a completed slot before the stream is stalled
+       2,                                // Attempts of each stage: stream restart, stream re-open, board re-init
+       10,                               // Attempts before the stall is given up and the slot loop stops as without the watchdog
+       std::chrono::milliseconds(100),   // Delay between the first two attempts, doubled at every attempt
+       std::chrono::milliseconds(5000)}; // Maximum delay between two attempts
+
+   // Logging parameters
+   const uint32_t log_queue_capacity = 4096; // Log records waiting for the background writer, 0 to write them synchronously
+
+   // Slot tracing parameters
+   const bool slot_tracing = false; // Trace the phases of every slot, dumped on 't' and at the first slot drop
+   const std::string slot_trace_path = "receiver_slot_trace.json"; // Chrome trace-event JSON file of the dumps
+   const std::chrono::milliseconds slot_trace_window(5000); // Duration of the trace kept in a dump
 
    //Node parameters
    const std::string node_label = "VHD Rx Node";
@@ -89,7 +377,9 @@ int main(int argc, char* argv[])
    const int connection_api_port = 3215; //port used by the node to expose its connection API
 
 
+   std::vector<BoardContext> boards;
    HANDLE board = nullptr, stream = nullptr, slot = nullptr;
+   int numa_node = -1;
    VHD_STREAMTYPE stream_type = VHD_ST_RX0;
    VHD_ERRORCODE result = VHDERR_NOERROR;
 
@@ -98,6 +388,11 @@ int main(int argc, char* argv[])
    uint32_t frame_rate;
    bool     interlaced;
    bool     is_us;
+   const VideoStandardInfo* video_standard_info = nullptr;
+   QueueController queue_controller(queue_tuning_config, false);
+   ShmFrameRingWriter shm_output;
+   FlightRecorder flight_recorder;
+   StreamWatchdog stream_watchdog(stream_watchdog_config, &flight_recorder);
    Deltacast::VideoViewer viewer;
 
    std::string media_nic_mac_address;
@@ -105,7 +400,7 @@ int main(int argc, char* argv[])
    //Buffer that will be created and filled by the API
    uint8_t* buffer = nullptr;
    ULONG buffer_size = 0, index = 0;
-   uint32_t multicast_group = 0u;
+   Ipv4Address multicast_group;
 
    bool exit = false;
 
@@ -114,35 +409,55 @@ int main(int argc, char* argv[])
    std::cout << "DELTA-IP NMOS ST2110-20 RECEPTION SAMPLE APPLICATION\n(c) DELTACAST\n--------------------------------------------------------"
       << std::endl << std::endl;
 
+   if (!replay_capture_path.empty())
+   {
+      const int replay_result =
+          replay_capture(replay_capture_path, replay_destination, replay_video_standard, replay_video_format,
+                         replay_line_blocks, replay_record_path, viewer, node_label, realtime_config);
+      close_keyboard();
+      return replay_result;
+   }
+
    nmos_tools::NodeServerReceiver::TransportParams resolve_auto_transport_params;
 
-   result = static_cast<VHD_ERRORCODE>(VHD_OpenBoardHandle(board_id, &board, nullptr, 0ul));
-   if (result != VHDERR_NOERROR)
+   StartupProfiler startup_profiler;
+
+   resolve_auto_transport_params.interface_ip = Ipv4Address(media_nic_ip);
+   resolve_auto_transport_params.destination = default_destination;
+   resolve_auto_transport_params.source_ip = Ipv4Address(); //no filtering on source ip
+
+   SimulatedBoardBackend* simulated_backend = nullptr;
+   if (simulated_board)
    {
-      std::cout << "Error when opening the board handle" << " [" << to_string(result) << "]" << std::endl;
+      auto backend = std::make_unique<SimulatedBoardBackend>(simulated_board_config);
+      simulated_backend = backend.get();
+      select_board_backend(std::move(backend));
+      std::cout << "Running on a simulated board" << std::endl;
    }
 
-   if(result == VHDERR_NOERROR)
    {
-      result = configure_nic(board, media_nic_ip, media_nic_subnet_mask, media_nic_gateway, media_nic_dhcp);
-      if(result != VHDERR_NOERROR)
-      {
-         std::cout << "Error when configuring the NIC" << " [" << to_string(result) << "]" << std::endl;
-      }
-      resolve_auto_transport_params.ip_interface = media_nic_ip;
-      resolve_auto_transport_params.ip_multicast = default_destination_address;
-      resolve_auto_transport_params.ip_src = 0; //no filtering on source ip
-      resolve_auto_transport_params.port_dst = default_destination_udp_port;
+      auto phase = startup_profiler.phase("open boards");
+      result = open_all_boards(boards, board_id);
    }
+   if (result == VHDERR_NOERROR && board_id >= boards.size())
+   {
+      result = VHDERR_BADARG;
+      std::cout << "Board " << board_id << " not found (" << boards.size() << " board(s) detected)" << std::endl;
+   }
+
    if (result == VHDERR_NOERROR)
    {
-      result = get_nic_mac_address(board, media_nic_mac_address);
-      if(result != VHDERR_NOERROR)
-      {
-         std::cout << "Error when getting the MAC address" << " [" << to_string(result) << "]" << std::endl;
-      }
+      board = boards[board_id].handle;
+
+      // The reception loop and its frame buffers live on the NUMA node local to the board
+      numa_node = boards[board_id].numa_node;
    }
 
+   // The threads created from now on (NMOS node, HTTP server) inherit the control plane scheduling
+   apply_thread_scheduling(ThreadRole::control_plane, realtime_config);
+   lock_process_memory(realtime_config);
+   multicast_membership().set_leave_delay(multicast_leave_delay);
+
    nmos::node_model node_model;
    nmos::experimental::log_model log_model;
    nmos::experimental::node_implementation node_implementation;
@@ -152,7 +467,9 @@ int main(int argc, char* argv[])
    std::filebuf access_log_buf;
    std::ostream access_log(&access_log_buf);
 
-   nmos::experimental::log_gate gate(error_log, access_log, log_model);
+   nmos::experimental::log_gate log_gate(error_log, access_log, log_model);
+   // The HTTP server threads only queue their log records, a background thread writes them
+   AsyncLogGate gate(log_gate, log_queue_capacity);
 
    web::json::value hostAddresses = web::json::value::array();
    hostAddresses[0] = web::json::value::string(utility::conversions::to_string_t(management_nic_ip));
@@ -173,25 +490,116 @@ int main(int argc, char* argv[])
    log_model.settings = node_model.settings;
    log_model.level = nmos::fields::logging_level(log_model.settings);
 
+   // The MAC address is given to the node server once the NIC is configured
    nmos_tools::NodeServerReceiver::TransportParams active_transport_params = resolve_auto_transport_params;
    nmos_tools::NodeServerReceiver node_server(node_model, log_model, gate, device_name, device_description,
       resolve_auto_transport_params, active_transport_params, media_nic_name, media_nic_mac_address);
 
-   if(!node_server.node_implementation_init())
+   // The NMOS HTTP server does not depend on the board configuration: it is brought up while the NIC is being
+   // configured
+   std::future<void> nmos_server_phase;
+   if (result == VHDERR_NOERROR)
+   {
+      nmos_server_phase = std::async(std::launch::async, [&] {
+         auto phase = startup_profiler.phase("nmos http server");
+         node_server.start();
+      });
+   }
+
+   // Only the settings the board does not hold already are applied, a warm restart neither bounces the link nor
+   // resets the PTP servo
+   BoardReconciler board_reconciler(board, board_state_directory);
+   bool ptp_lock_pending = false, board_state_reported = false;
+
+   if(result == VHDERR_NOERROR)
    {
-      result = VHDERR_OPERATIONFAILED;
-      std::cout << "Error when initializing the node server" << " [" << to_string(result) << "]" << std::endl;
+      auto phase = startup_profiler.phase("nic");
+      result = board_reconciler.reconcile_nic({media_nic_ip, media_nic_subnet_mask, media_nic_gateway, media_nic_dhcp});
+      if(result != VHDERR_NOERROR)
+      {
+         std::cout << "Error when configuring the NIC" << " [" << to_string(result) << "]" << std::endl;
+      }
+      if (result == VHDERR_NOERROR)
+      {
+         result = get_nic_mac_address(board, media_nic_mac_address);
+         if(result != VHDERR_NOERROR)
+         {
+            std::cout << "Error when getting the MAC address" << " [" << to_string(result) << "]" << std::endl;
+         }
+      }
+   }
+
+   if (nmos_server_phase.valid())
+      nmos_server_phase.get();
+
+   if (result == VHDERR_NOERROR)
+   {
+      auto phase = startup_profiler.phase("nmos resources");
+      node_server.set_media_nic_mac_address(media_nic_mac_address);
+      if(!node_server.node_implementation_init())
+      {
+         result = VHDERR_OPERATIONFAILED;
+         std::cout << "Error when initializing the node server" << " [" << to_string(result) << "]" << std::endl;
+      }
    }
 
    if (result == VHDERR_NOERROR)
    {
-      node_server.start();
       std::cout << "NMOS: node ready for connections" << std::endl;
+      node_server.print_registration_statistics();
+      startup_profiler.mark("ready");
+      print_numa_placement_report(boards, 3840 * 2160 * 5 / 2); // Sized for a 2160p YCbCr 4:2:2 10-bit frame
    }
 
    nmos_tools::NodeServerReceiver::TransportParams previous_transport_params = resolve_auto_transport_params;
    std::string previous_sdp = "INVALID SDP";
 
+   PtpMonitor ptp_monitor(board, ptp_lock_threshold_ns);
+   if (result == VHDERR_NOERROR)
+      ptp_monitor.start([&] { apply_thread_scheduling(ThreadRole::monitor, realtime_config); });
+
+   if (result == VHDERR_NOERROR && slot_tracing)
+   {
+      slot_tracer().enable(slot_trace_path, slot_trace_window);
+      slot_tracer().set_thread_name("reception loop");
+   }
+
+   // The ring is sized for the largest video standard, so that it outlives the SDP changes
+   if (result == VHDERR_NOERROR && !shm_output_name.empty())
+   {
+      uint64_t max_frame_size = 0;
+      for (const VideoStandardInfo& info : video_standard_infos)
+         max_frame_size = std::max(max_frame_size, St2110_20Depacketizer::get_frame_size(info.frame_width,
+                                                                                           info.frame_height));
+      if (!shm_output.create(shm_output_name, shm_output_slots, max_frame_size))
+         std::cout << "The received frames are not published to shared memory" << std::endl;
+   }
+
+   if (result == VHDERR_NOERROR && !flight_recorder_path.empty())
+   {
+      flight_recorder.set_ptp_source(
+         [&] {
+            const PtpStatus status = ptp_monitor.get_status();
+            return FlightPtpStatus{static_cast<uint32_t>(status.state), status.locked_within_threshold,
+                                   status.offset_ns};
+         },
+         [](uint32_t state) { return to_string(static_cast<VHD_PTP_PORT_STATE>(state)); });
+      if (!flight_recorder.open(flight_recorder_path, flight_recorder_records, "receiver"))
+         std::cout << "The stream status is not recorded" << std::endl;
+   }
+
+   // The main thread runs the slot loop from now on. Only then is it bound to the NUMA node of the board, so that
+   // the threads created before (NMOS node, HTTP server) are not, and a CPU list of the slot loop prevails.
+   if (result == VHDERR_NOERROR)
+   {
+      apply_thread_scheduling(ThreadRole::slot_loop, realtime_config);
+      if (numa_node >= 0 && realtime_config.slot_loop.cpus.empty() && !bind_current_thread_to_numa_node(numa_node))
+      {
+         std::cout << "Could not bind the reception loop to NUMA node " << numa_node << std::endl;
+         numa_node = -1;
+      }
+   }
+
    //Get the system parameters and apply new PTP parameters
    nmos_tools::NmosPtpSystemParameters ptp_system_parameters;
    nmos_tools::NmosPtpSystemParameters previous_ptp_system_parameters;
@@ -219,19 +627,28 @@ int main(int argc, char* argv[])
          {
             if(ptp_system_parameters != previous_ptp_system_parameters)
             {
-               std::cout << "Applying new PTP parameters: domain=" << ptp_system_parameters.domain_number << std::endl;
-               //ptp_system_parameters were changed, we need to update the ptp configuration
-               result = apply_ptp_parameters(board, static_cast<uint8_t>(ptp_system_parameters.domain_number),
-                  static_cast<uint8_t>(ptp_system_parameters.announce_receipt_timeout));
+               //ptp_system_parameters were changed, the ptp configuration is only set if the board does not hold it already
+               bool ptp_applied = false;
+               result = board_reconciler.reconcile_ptp(static_cast<uint8_t>(ptp_system_parameters.domain_number),
+                  static_cast<uint8_t>(ptp_system_parameters.announce_receipt_timeout), ptp_applied);
                if(result != VHDERR_NOERROR)
                {
                   exit = true;
                   break;
                }
+               std::cout << "PTP parameters: domain=" << ptp_system_parameters.domain_number
+                         << (ptp_applied ? " applied" : " already in place") << std::endl;
 
+               if (ptp_applied)
+               {
+                  ptp_monitor.restart_lock_detection();
+                  ptp_lock_pending = true;
+                  flight_recorder.record_event(FlightRecordType::ptp_configured,
+                                               static_cast<uint32_t>(ptp_system_parameters.domain_number));
+               }
                previous_ptp_system_parameters = ptp_system_parameters;
             }
-            print_ptp_status(board, static_cast<uint8_t>(ptp_system_parameters.domain_number),
+            ptp_monitor.print_status(static_cast<uint8_t>(ptp_system_parameters.domain_number),
                static_cast<uint8_t>(ptp_system_parameters.announce_receipt_timeout));
          }
 
@@ -242,27 +659,71 @@ int main(int argc, char* argv[])
       if(exit)
          break;
 
+      //Wait for the PTP to be locked within threshold before starting the stream
+      if (wait_for_ptp_lock && !ptp_monitor.is_locked_within_threshold())
+      {
+         std::cout << std::endl << "Waiting for PTP lock (offset below " << ptp_lock_threshold_ns << " ns)..." << std::endl;
+         while (node_server.is_enabled && !ptp_monitor.wait_for_lock(std::chrono::milliseconds(100)))
+         {
+            if (_kbhit())
+            {
+               _getch();
+               exit = true;
+               break;
+            }
+            if (viewer.window_request_close())
+            {
+               exit = true;
+               break;
+            }
+            ptp_monitor.print_status(static_cast<uint8_t>(ptp_system_parameters.domain_number),
+               static_cast<uint8_t>(ptp_system_parameters.announce_receipt_timeout));
+         }
+         std::cout << std::endl;
+         if (exit)
+            break;
+         if (!node_server.is_enabled)
+            continue;
+         std::cout << "PTP locked in " << ptp_monitor.get_statistics().time_to_lock_s << " s" << std::endl;
+         flight_recorder.record_event(FlightRecordType::ptp_locked,
+                                      static_cast<uint32_t>(ptp_monitor.get_statistics().time_to_lock_s * 1000));
+         if (ptp_lock_pending)
+         {
+            board_reconciler.add_ptp_lock_time(std::chrono::microseconds(
+                static_cast<int64_t>(ptp_monitor.get_statistics().time_to_lock_s * 1e6)));
+            ptp_lock_pending = false;
+         }
+      }
+
+      if (!board_state_reported)
+      {
+         board_reconciler.print_summary();
+         board_state_reported = true;
+      }
+
       std::string sdp = node_server.get_sdp();
       if(previous_transport_params != active_transport_params || sdp != previous_sdp)
       {
          std::cout << "New transport parameters received or SDP changed" << std::endl;
 
          //active parameters were changed, we need to update the stream
+         // The group is released before its stream is closed, and stays joined if the new SDP still uses it
+         leave_multicast(board, multicast_group);
          if (stream != nullptr) {
-            result = static_cast<VHD_ERRORCODE>(VHD_CloseStreamHandle(stream));
+            result = board_backend().close_stream_handle(stream);
             if (result != VHDERR_NOERROR)
                std::cout << "Error when destroying the stream" << " [" << to_string(result) << "]" << std::endl;
          }
          if (result == VHDERR_NOERROR)
          {
-            result = static_cast<VHD_ERRORCODE>(VHD_OpenStreamHandle(board, stream_type, VHD_ST2110_STPROC_DISJOINED_VIDEO, nullptr, &stream, nullptr));
+            result = board_backend(
+                ).open_stream_handle(board, stream_type, VHD_ST2110_STPROC_DISJOINED_VIDEO, nullptr, &stream, nullptr);
             if (result != VHDERR_NOERROR)
                std::cout << "Error when creating stream" << " [" << to_string(result) << "]" << std::endl;
          }
-         leave_multicast(board, multicast_group);
          if(result == VHDERR_NOERROR)
          {
-            result = configure_stream_from_sdp(board, sdp, active_transport_params.ip_multicast, active_transport_params.port_dst, stream, multicast_group);
+            result = configure_stream_from_sdp(board, sdp, active_transport_params.destination, stream, multicast_group);
             previous_transport_params = active_transport_params;
             previous_sdp = sdp;
             if (result != VHDERR_NOERROR)
@@ -271,20 +732,31 @@ int main(int argc, char* argv[])
          if (result == VHDERR_NOERROR)
          {
             ULONG video_standard;
-            result = static_cast<VHD_ERRORCODE>(VHD_GetStreamProperty(stream, VHD_ST2110_20_SP_VIDEO_STANDARD, &video_standard));
+            result = board_backend().get_stream_property(stream, VHD_ST2110_20_SP_VIDEO_STANDARD, &video_standard);
             if (result == VHDERR_NOERROR)
             {
+               video_standard_info =
+                   find_video_standard_info(static_cast<VHD_ST2110_20_VIDEO_STANDARD>(video_standard));
                result = get_video_standard_info(static_cast<VHD_ST2110_20_VIDEO_STANDARD>(video_standard), frame_width, frame_height, frame_rate, interlaced, is_us);
                if (result != VHDERR_NOERROR)
                   std::cout << "Error when getting video standard info" << std::endl;
+               else if (video_standard_info)
+                  shm_output.set_format(make_shm_frame_format(*video_standard_info, sdp, ShmPixelLayout::yuv422_10));
             }
          }
 
       }
 
+      if (result == VHDERR_NOERROR && video_standard_info)
+      {
+         result = queue_controller.apply(stream, *video_standard_info);
+         if (result != VHDERR_NOERROR)
+            std::cout << "Error when tuning the slot queue" << " [" << to_string(result) << "]" << std::endl;
+      }
+
       if(result == VHDERR_NOERROR)
       {
-         result = static_cast<VHD_ERRORCODE>(VHD_StartStream(stream));
+         result = board_backend().start_stream(stream);
          if (result != VHDERR_NOERROR)
             std::cout << "Error when starting stream" << " [" << to_string(result) << "]" << std::endl;
       }
@@ -293,6 +765,10 @@ int main(int argc, char* argv[])
       {
          std::cout << std::endl << "Received Sdp : " << std::endl << sdp << std::endl;
          std::cout << std::endl << "Reception started, press any key to stop..." << std::endl;
+         flight_recorder.record_event(FlightRecordType::activation,
+                                      video_standard_info ? video_standard_info->video_standard : 0,
+                                      active_transport_params.destination.address.value(),
+                                      active_transport_params.destination.port);
 
          if (!viewer.init(960,
                           540,
@@ -307,24 +783,119 @@ int main(int argc, char* argv[])
          viewer.start();
 
 #ifndef __APPLE__
-         std::thread viewerthread(render_video, std::ref(viewer), 100);
+         std::thread viewerthread([&] {
+            apply_thread_scheduling(ThreadRole::control_plane, realtime_config);
+            render_video(viewer, 100);
+         });
 #endif
 
-         uint8_t* viewer_data = nullptr;
-         uint64_t viewer_data_size = 0;
-
          uint32_t slot_timeout = 0;
          bool stop_monitoring = false;
-         std::thread monitoring_thread(monitor_rx_stream_status, stream, &stop_monitoring, &slot_timeout);
+         std::thread monitoring_thread;
+         // The monitoring is restarted when a recovery replaces the stream handle
+         const auto start_monitoring = [&] {
+            stop_monitoring = false;
+            monitoring_thread = std::thread([&] {
+               apply_thread_scheduling(ThreadRole::monitor, realtime_config);
+               monitor_rx_stream_status(stream, &stop_monitoring, &slot_timeout, numa_node, &queue_controller,
+                                        &flight_recorder);
+            });
+         };
+         const auto stop_monitoring_thread = [&] {
+            stop_monitoring = true;
+            if (monitoring_thread.joinable())
+               monitoring_thread.join();
+         };
+         start_monitoring();
+
+         // A stalled stream is recovered inside the reception loop, the NMOS node keeps its resources and the
+         // controller sees no change of the receiver
+         const auto restart_stream = [&] {
+            VHD_ERRORCODE status = board_backend().stop_stream(stream);
+            if (status == VHDERR_NOERROR && video_standard_info)
+               status = queue_controller.apply(stream, *video_standard_info);
+            if (status == VHDERR_NOERROR)
+               status = board_backend().start_stream(stream);
+            return status;
+         };
+         const auto reopen_stream = [&] {
+            stop_monitoring_thread();
+            leave_multicast(board, multicast_group);
+            if (stream != nullptr)
+            {
+               board_backend().stop_stream(stream);
+               board_backend().close_stream_handle(stream);
+               stream = nullptr;
+            }
+            VHD_ERRORCODE status = board_backend().open_stream_handle(
+                board, stream_type, VHD_ST2110_STPROC_DISJOINED_VIDEO, nullptr, &stream, nullptr);
+            if (status != VHDERR_NOERROR)
+               stream = nullptr;
+            if (status == VHDERR_NOERROR)
+               status = configure_stream_from_sdp(board, previous_sdp, previous_transport_params.destination, stream,
+                                                  multicast_group);
+            if (status == VHDERR_NOERROR && video_standard_info)
+               status = queue_controller.apply(stream, *video_standard_info);
+            if (status == VHDERR_NOERROR)
+               status = board_backend().start_stream(stream);
+            if (status == VHDERR_NOERROR)
+               start_monitoring();
+            return status;
+         };
+         const auto reinit_board = [&] {
+            stop_monitoring_thread();
+            leave_multicast(board, multicast_group);
+            if (stream != nullptr)
+            {
+               board_backend().stop_stream(stream);
+               board_backend().close_stream_handle(stream);
+               stream = nullptr;
+            }
+            // The PTP monitor samples the handle from its thread, it is detached before the handle is closed
+            ptp_monitor.set_board_handle(nullptr);
+            if (board != nullptr)
+            {
+               multicast_membership().flush(board);
+               board_backend().close_board_handle(board);
+            }
+            VHD_ERRORCODE status = board_backend().open_board_handle(board_id, &board, nullptr, 0);
+            if (status != VHDERR_NOERROR)
+               board = nullptr;
+            boards[board_id].handle = board;
+            board_reconciler.set_board_handle(board);
+            if (status == VHDERR_NOERROR)
+               ptp_monitor.set_board_handle(board);
+
+            // The settings are reconciled, a board that kept them across the re-init is not reconfigured
+            bool ptp_applied = false;
+            if (status == VHDERR_NOERROR)
+               status = board_reconciler.reconcile_nic(
+                   {media_nic_ip, media_nic_subnet_mask, media_nic_gateway, media_nic_dhcp});
+            if (status == VHDERR_NOERROR)
+               status = board_reconciler.reconcile_ptp(
+                   static_cast<uint8_t>(previous_ptp_system_parameters.domain_number),
+                   static_cast<uint8_t>(previous_ptp_system_parameters.announce_receipt_timeout), ptp_applied);
+            if (status == VHDERR_NOERROR)
+               status = reopen_stream();
+            return status;
+         };
+         const StreamRecoveryActions recovery_actions = {restart_stream, reopen_stream, reinit_board};
+         if (video_standard_info)
+            stream_watchdog.arm(*video_standard_info);
 
          //Reception loop
          while (1)
          {
             if (_kbhit())
             {
-               _getch();
-               exit = true;
-               break;
+               // 't' dumps the slot trace, any other key stops the reception
+               if (_getch() == 't' && slot_tracer().is_enabled())
+                  slot_tracer().dump();
+               else
+               {
+                  exit = true;
+                  break;
+               }
             }
             if (viewer.window_request_close())
             {
@@ -350,48 +921,92 @@ int main(int argc, char* argv[])
             }
 
             //Try to lock the next slot.
-            result = static_cast<VHD_ERRORCODE>(VHD_LockSlotHandle(stream, &slot));
+            const auto lock_start = std::chrono::steady_clock::now();
+            {
+               auto trace = slot_tracer().trace("lock_slot", index);
+               result = board_backend().lock_slot_handle(stream, &slot);
+            }
             if (result != VHDERR_NOERROR)
             {
                if (result == VHDERR_TIMEOUT)
                {
                   slot_timeout++;
+                  queue_controller.on_timeout(stream);
+                  stream_watchdog.on_stall(recovery_actions, result);
                   result = VHDERR_NOERROR; //After the above print message, timeout error is considered as handled
                   continue;
                }
+               if (stream_watchdog.on_stall(recovery_actions, result))
+               {
+                  result = VHDERR_NOERROR; // The watchdog recovers the stream
+                  continue;
+               }
                std::cout << "Error when locking slot " << index << " [" << to_string(result) << "]" << std::endl;
                break;
             }
 
+            const QueueAction queue_action =
+                queue_controller.on_slot_locked(stream, std::chrono::steady_clock::now() - lock_start);
+
             //Get the video buffer associated to the slot.
-            result = static_cast<VHD_ERRORCODE>(VHD_GetSlotBuffer(slot, VHD_ST2110_BT_VIDEO, &buffer, &buffer_size));
+            {
+               auto trace = slot_tracer().trace("get_slot_buffer", index);
+               result = board_backend().get_slot_buffer(slot, VHD_ST2110_BT_VIDEO, &buffer, &buffer_size);
+            }
             if (result != VHDERR_NOERROR)
             {
                std::cout << "Error when getting slot buffer at slot " << index << " [" << to_string(result) << "]" << std::endl;
             }
 
-            viewer.lock_data(&viewer_data, &viewer_data_size);
-            if (viewer_data_size != buffer_size)
             {
-               std::cout << "Buffer size (" << buffer_size << ") does not match with videoviewer data size ("
-                         << viewer_data_size << ")" << std::endl;
+               auto trace = slot_tracer().trace("display_frame", index);
+               display_frame(viewer, buffer, buffer_size);
             }
-            else
+
+            // The consumers of the ring never hold the slot back, the frame is copied and published
+            if (shm_output.is_open() && result == VHDERR_NOERROR)
             {
-               std::memcpy(viewer_data, buffer, buffer_size);
+               auto trace = slot_tracer().trace("shm_publish", index);
+               shm_output.publish(buffer, buffer_size, index);
             }
-            viewer.unlock_data();
 
             //Unlock the slot. buffer wont be available anymore
-            result = static_cast<VHD_ERRORCODE>(VHD_UnlockSlotHandle(slot));
+            {
+               auto trace = slot_tracer().trace("unlock_slot", index);
+               result = board_backend().unlock_slot_handle(slot);
+            }
             if (result != VHDERR_NOERROR)
             {
+               if (stream_watchdog.on_stall(recovery_actions, result))
+               {
+                  result = VHDERR_NOERROR; // The watchdog recovers the stream
+                  continue;
+               }
                std::cout << "Error when unlocking slot at slot " << index << " [" << to_string(result) << "]" << std::endl;
                break;
             }
+            stream_watchdog.on_slot_completed();
+
+            if (queue_action == QueueAction::restart_stream)
+            {
+               auto trace = slot_tracer().trace("restart_stream", index);
+               result = queue_controller.restart_stream(stream);
+               if (result != VHDERR_NOERROR)
+               {
+                  std::cout << "Error when restarting the stream with a new slot queue depth" << " ["
+                            << to_string(result) << "]" << std::endl;
+                  break;
+               }
+            }
+
+            if (index == 0)
+               startup_profiler.mark("first frame");
 
-            viewer.process_escape_key();
-            viewer.render_iteration();
+            {
+               auto trace = slot_tracer().trace("viewer", index);
+               viewer.process_escape_key();
+               viewer.render_iteration();
+            }
 
             index++;
          }
@@ -402,12 +1017,19 @@ int main(int argc, char* argv[])
 #endif
          viewer.release();
 
-         stop_monitoring = true;
-         monitoring_thread.join();
+         stop_monitoring_thread();
+
+         const FlightStopReason stop_reason =
+             exit                                                    ? FlightStopReason::user
+             : !node_server.is_enabled                               ? FlightStopReason::node_disabled
+             : previous_transport_params != active_transport_params ? FlightStopReason::transport_changed
+             : sdp != previous_sdp                                   ? FlightStopReason::sdp_changed
+                                                                     : FlightStopReason::error;
+         flight_recorder.record_event(FlightRecordType::deactivation, static_cast<uint32_t>(stop_reason));
 
          VHD_ERRORCODE result_stop_stream; //temporary variable to not overwrite result if an error occured in the transmission loop
 
-         result_stop_stream = static_cast<VHD_ERRORCODE>(VHD_StopStream(stream));
+         result_stop_stream = board_backend().stop_stream(stream);
          if (result_stop_stream != VHDERR_NOERROR)
          {
             std::cout << "Error when stopping the stream" << " [" << to_string(result_stop_stream) << "]" << std::endl;
@@ -417,24 +1039,32 @@ int main(int argc, char* argv[])
    }
 
 
+   if (board)
+      leave_multicast(board, multicast_group);
+
    if(stream)
    {
-      result = static_cast<VHD_ERRORCODE>(VHD_CloseStreamHandle(stream));
+      result = board_backend().close_stream_handle(stream);
       if (result != VHDERR_NOERROR)
          std::cout << "Error when closing the stream" << " [" << to_string(result) << "]" << std::endl;
    }
 
    if (board)
-   {
-      leave_multicast(board, multicast_group);
-      result = static_cast<VHD_ERRORCODE>(VHD_CloseBoardHandle(board));
-      if (result != VHDERR_NOERROR)
-         std::cout << "Error when closing the board handle" << " [" << to_string(result) << "]" << std::endl;
-   }
+      multicast_membership().flush(board);
+   ptp_monitor.stop();
+   if (simulated_backend)
+      simulated_backend->print_statistics();
+   queue_controller.print_statistics();
+   stream_watchdog.print_statistics();
+   multicast_membership().print_statistics();
+   shm_output.print_statistics();
+   close_all_boards(boards);
 
    close_keyboard();
 
    node_server.stop();
+   gate.flush();
+   gate.print_statistics();
 
    return 0;
 }
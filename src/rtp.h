@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file rtp.h
+   @brief This file contains the decoding of the RTP header and of the ST 2110-20 payload header.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+/*!
+   @brief Sample row data header of a ST 2110-20 packet
+*/
+struct St2110_20SampleRowData
+{
+   uint16_t length /*! Number of bytes of the segment */;
+   bool field /*! Second field of an interlaced frame */;
+   uint16_t row_number;
+   uint16_t offset /*! Position of the first pixel of the segment in the row */;
+   const uint8_t* data /*! Pixel groups of the segment */;
+};
+
+/*!
+   @brief ST 2110-20 RTP packet
+*/
+struct St2110_20Packet
+{
+   static const uint32_t max_nb_sample_row_data = 8;
+
+   bool marker /*! Last packet of the frame or field */;
+   uint8_t payload_type;
+   uint32_t sequence_number /*! Extended sequence number, 32 bits */;
+   uint32_t timestamp /*! RTP timestamp in 90 kHz ticks */;
+   uint32_t ssrc;
+   uint32_t nb_sample_row_data;
+   St2110_20SampleRowData sample_row_data[max_nb_sample_row_data];
+};
+
+/*!
+   @brief Decode the RTP header and the ST 2110-20 payload header of a UDP payload
+
+   @returns False if the payload is not a valid RTP packet or if its sample row data do not fit in it
+*/
+inline bool parse_st2110_20_packet(const uint8_t* payload /*!< [in] UDP payload*/,
+                                   uint32_t payload_size /*!< [in] Size of the UDP payload*/,
+                                   St2110_20Packet& packet /*!< [out] Decoded packet, pointing into the payload*/)
+{
+   if (payload_size < 12 || (payload[0] >> 6) != 2)
+      return false;
+
+   uint32_t header_size = 12 + (payload[0] & 0x0f) * 4u;
+   if ((payload[0] & 0x10) && payload_size >= header_size + 4) // header extension
+      header_size += 4 + ((payload[header_size + 2] << 8) | payload[header_size + 3]) * 4u;
+   if (payload[0] & 0x20) // padding
+   {
+      if (payload[payload_size - 1] > payload_size)
+         return false;
+      payload_size -= payload[payload_size - 1];
+   }
+   if (payload_size < header_size + 2 + 6)
+      return false;
+
+   packet.marker = (payload[1] & 0x80) != 0;
+   packet.payload_type = payload[1] & 0x7f;
+   packet.timestamp = (static_cast<uint32_t>(payload[4]) << 24) | (static_cast<uint32_t>(payload[5]) << 16) |
+                      (static_cast<uint32_t>(payload[6]) << 8) | payload[7];
+   packet.ssrc = (static_cast<uint32_t>(payload[8]) << 24) | (static_cast<uint32_t>(payload[9]) << 16) |
+                 (static_cast<uint32_t>(payload[10]) << 8) | payload[11];
+
+   const uint8_t* header = payload + header_size;
+   packet.sequence_number = (static_cast<uint32_t>(header[0]) << 24) | (static_cast<uint32_t>(header[1]) << 16) |
+                            (static_cast<uint32_t>(payload[2]) << 8) | payload[3];
+   header += 2;
+
+   // Sample row data headers, chained by their continuation bit, followed by the segments in the same order
+   packet.nb_sample_row_data = 0;
+   bool continuation = true;
+   while (continuation)
+   {
+      if (header + 6 > payload + payload_size || packet.nb_sample_row_data == St2110_20Packet::max_nb_sample_row_data)
+         return false;
+      St2110_20SampleRowData& sample_row_data = packet.sample_row_data[packet.nb_sample_row_data++];
+      sample_row_data.length = static_cast<uint16_t>((header[0] << 8) | header[1]);
+      sample_row_data.field = (header[2] & 0x80) != 0;
+      sample_row_data.row_number = static_cast<uint16_t>(((header[2] & 0x7f) << 8) | header[3]);
+      continuation = (header[4] & 0x80) != 0;
+      sample_row_data.offset = static_cast<uint16_t>(((header[4] & 0x7f) << 8) | header[5]);
+      header += 6;
+   }
+
+   const uint8_t* data = header;
+   for (uint32_t i = 0; i < packet.nb_sample_row_data; i++)
+   {
+      if (data + packet.sample_row_data[i].length > payload + payload_size)
+         return false;
+      packet.sample_row_data[i].data = data;
+      data += packet.sample_row_data[i].length;
+   }
+   return true;
+}
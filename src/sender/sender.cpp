@@ -17,7 +17,9 @@
 #include <vector>
 #include <string>
 #include <cstring>
+#include <future>
 #include <thread>
+#include <chrono>
 
 #if defined(__GNUC__) && !defined(__APPLE__)
 #include <stdint-gcc.h>
@@ -40,8 +42,24 @@
 #include "nmos/node_server.h"
 
 #include "../tools.h"
+#include "../async_log_gate.h"
+#include "../board_backend.h"
+#include "../board_reconciler.h"
 #include "../nmos_tools.h"
+#include "../numa.h"
+#include "../flight_recorder.h"
+#include "../frame_buffer_pool.h"
+#include "../ptp_monitor.h"
+#include "../queue_controller.h"
+#include "../realtime.h"
+#include "../simulated_board.h"
+#include "../slot_tracer.h"
+#include "../startup_profiler.h"
+#include "../stream_watchdog.h"
+#include "../packetizer.h"
 #include "pattern.h"
+#include "shm_frame_source.h"
+#include "udp_transmitter.h"
 
 #if defined(__APPLE__)
 #include "VideoMasterHD/VideoMasterHD_Core.h"
@@ -54,10 +72,25 @@
 #include "VideoMasterHD_Ip_ST2110_20.h"
 #endif
 
+/*!
+   @brief Why a transmission loop stopped, for the flight recorder
+*/
+static FlightStopReason get_stop_reason(bool exit, bool is_node_enabled, bool is_transport_changed)
+{
+   if (exit)
+      return FlightStopReason::user;
+   if (!is_node_enabled)
+      return FlightStopReason::node_disabled;
+   if (is_transport_changed)
+      return FlightStopReason::transport_changed;
+   return FlightStopReason::error;
+}
+
 int main(int argc, char* argv[])
 {
    //VHD parameters
-   const uint32_t board_id = 1;
+   const uint32_t board_id = 1; // Board used for streaming, all the boards of the host are opened
+   const std::string board_state_directory = BoardReconciler::get_default_state_directory(); // Cost of the board settings kept across runs, one file per board, to log the time saved when they are already in place
 
    //Media NIC
    const std::string media_nic_name = "delta" + std::to_string(board_id);  //Streaming network interface controller
@@ -67,17 +100,72 @@ int main(int argc, char* argv[])
    const bool media_nic_dhcp = false; // Streaming network interface controller DHCP enabled
 
    // Stream parameters
-   const uint32_t destination_address = 0xe0000001; // IP destination address
-   const uint16_t destination_udp_port = 1025; // UDP destination port
+   const Ipv4Endpoint destination = {Ipv4Address(0xe0000001), 1025}; // IP destination address and UDP port
    const uint32_t destination_ssrc = 0x12345600; // SSRC destination
    const auto video_standard = VHD_ST2110_20_VIDEOSTD_1920x1080p60; // Streaming video standard
+   const VideoFormat video_format = default_video_format; // Sampling and depth sent on the network, e.g. {VHD_ST2110_20_SAMPLING_RGB_444, VHD_ST2110_20_DEPTH_12BIT}
 
    // NMOS parameters
    const std::string management_nic_ip = "192.168.0.10"; // Management network interface controller
-   const uint32_t default_destination_address =
-       destination_address; // default IP destination address used for resolving "auto" nmos parameter
-   const uint16_t default_destination_udp_port =
-       destination_udp_port; // default UDP destination port used for resolving "auto" nmos parameter IP address
+   const Ipv4Endpoint default_destination =
+       destination; // default IP destination address and UDP port used for resolving "auto" nmos parameters
+
+   // PTP parameters
+   const bool wait_for_ptp_lock = false; // Opt-in: start the stream only once the PTP is locked within threshold, the PTP is monitored either way
+   const int64_t ptp_lock_threshold_ns = 1000; // Maximum absolute PTP offset to be considered locked
+
+   // Software transmission parameters
+   const bool software_transmission = false; // Packetize and send the frames from the host instead of the board
+   const Ipv4Address software_source_ip = Ipv4Address(0x7f000001); // Local address of the software transmission
+   const PacingClock software_pacing_clock = PacingClock::tai; // Clock on which the frames are paced
+
+   // Shared-memory input parameters
+   const std::string shm_input_name = ""; // Frame ring of another process to send (e.g. "/nmos_vhd_tx"), empty to send the pattern
+   const LateFramePolicy shm_input_late_policy = LateFramePolicy::repeat_last; // What is sent when the producer has no new frame
+
+   // Flight recorder parameters
+   const std::string flight_recorder_path = "sender_flight_recorder.bin"; // If set, the stream status and events are kept in this memory-mapped ring file, read it with flight_decoder
+   const uint32_t flight_recorder_records = 36000; // Records of 64 bytes kept in the file, one per 100 ms status or event (about 1 hour)
+
+   // Simulated board parameters
+   const bool simulated_board = false; // Run the sample loops on a simulated board instead of a DELTACAST IP Card
+   const SimulatedBoardConfig simulated_board_config = {}; // Slot cadence, drops and PTP behaviour of the simulated board
+
+   // Frame buffer parameters
+   const bool frame_buffers_huge_pages = true; // Allocate the frame buffers from 2 MiB huge pages when available
+   const bool frame_buffers_locked = false; // Lock the frame buffers in memory (needs RLIMIT_MEMLOCK)
+
+   // Slot queue parameters
+   const QueueTuningConfig queue_tuning_config = {
+       false, // Tune the queue and IO timeout to the margin and drops, a grow restarts the stream (glitch on air)
+       4,     // Initial queue depth in slots
+       2,     // Minimum queue depth in slots
+       8};    // Maximum queue depth in slots, bounds the latency added by the queue
+
+   // Stall watchdog parameters
+   const StreamWatchdogConfig stream_watchdog_config = {
+       false,                            // Opt-in: recover the stream when no slot completes instead of stopping
+       10,                               // Frame periods without a completed slot before the stream is stalled
+       2,                                // Attempts of each stage: stream restart, stream re-open, board re-init
+       10,                               // Attempts before the stall is given up and the slot loop stops as without the watchdog
+       std::chrono::milliseconds(100),   // Delay between the first two attempts, doubled at every attempt
+       std::chrono::milliseconds(5000)}; // Maximum delay between two attempts
+
+   // Real-time parameters, e.g. {SchedulingPolicy::fifo, 80, "2"} runs the slot loop on an isolated CPU 2
+   const RealtimeConfig realtime_config = {
+       {SchedulingPolicy::other, 0, ""}, // Slot loop (the main thread once the node is ready)
+       {SchedulingPolicy::other, 0, ""}, // Producer workers
+       {SchedulingPolicy::other, 0, ""}, // Stream and PTP monitoring threads
+       {SchedulingPolicy::other, 0, ""}, // Control plane: NMOS node, HTTP server and other threads
+       false};                           // Lock the process memory (mlockall) and prefault the stack
+
+   // Logging parameters
+   const uint32_t log_queue_capacity = 4096; // Log records waiting for the background writer, 0 to write them synchronously
+
+   // Slot tracing parameters
+   const bool slot_tracing = false; // Trace the phases of every slot, dumped on 't' and at the first slot drop
+   const std::string slot_trace_path = "sender_slot_trace.json"; // Chrome trace-event JSON file of the dumps
+   const std::chrono::milliseconds slot_trace_window(5000); // Duration of the trace kept in a dump
 
    //Node parameters
    const std::string node_label = "VHD Tx Node";
@@ -88,7 +176,9 @@ int main(int argc, char* argv[])
    const int node_api_port = 3212; //port used by the node to expose its registry API
    const int connection_api_port = 3215; //port used by the node to expose its connection API
 
+   std::vector<BoardContext> boards;
    HANDLE board = nullptr, stream = nullptr, slot = nullptr;
+   int numa_node = -1;
    VHD_STREAMTYPE stream_type = VHD_ST_TX0;
    VHD_ERRORCODE result = VHDERR_NOERROR;
 
@@ -103,7 +193,12 @@ int main(int argc, char* argv[])
    //Buffer that will be created and filled by the API
    uint8_t* buffer = nullptr;
    ULONG buffer_size = 0, index = 0;
-   std::vector<uint8_t> video_pattern_buffer;
+   FrameBufferPool frame_buffer_pool;
+   FrameBuffer video_pattern_buffer;
+   QueueController queue_controller(queue_tuning_config, true);
+   std::unique_ptr<ShmFrameSource> shm_input;
+   FlightRecorder flight_recorder;
+   StreamWatchdog stream_watchdog(stream_watchdog_config, &flight_recorder);
    std::string sdp;
    nmos_tools::NodeServerSender::TransportParams resolve_auto_transport_params;
 
@@ -116,67 +211,54 @@ int main(int argc, char* argv[])
              << std::endl
              << std::endl;
 
-   result = static_cast<VHD_ERRORCODE>(VHD_OpenBoardHandle(board_id, &board, nullptr, 0ul));
-   if (result != VHDERR_NOERROR)
-   {
-      std::cout << "Error when opening the board handle" << " [" << to_string(result) << "]" << std::endl;
-   }
+   StartupProfiler startup_profiler;
+
+   resolve_auto_transport_params.source = {software_transmission ? software_source_ip : Ipv4Address(media_nic_ip), 2000};
+   resolve_auto_transport_params.destination = default_destination;
+
+   // In software transmission, the board is not used: the frames are packetized and sent by the host
+   St2110_20Packetizer packetizer(*find_video_standard_info(video_standard), destination_ssrc, video_format);
+   UdpTransmitter transmitter(packetizer, software_pacing_clock);
 
-   if(result == VHDERR_NOERROR)
+   SimulatedBoardBackend* simulated_backend = nullptr;
+   if (simulated_board && !software_transmission)
    {
-      result = configure_nic(board, media_nic_ip, media_nic_subnet_mask, media_nic_gateway, media_nic_dhcp);
-      if(result != VHDERR_NOERROR)
-      {
-         std::cout << "Error when configuring the NIC" << " [" << to_string(result) << "]" << std::endl;
-      }
-      resolve_auto_transport_params.ip_src = media_nic_ip;
-      resolve_auto_transport_params.port_src = 2000;
-      resolve_auto_transport_params.ip_dst = default_destination_address;
-      resolve_auto_transport_params.port_dst = default_destination_udp_port;
+      auto backend = std::make_unique<SimulatedBoardBackend>(simulated_board_config);
+      simulated_backend = backend.get();
+      select_board_backend(std::move(backend));
+      std::cout << "Running on a simulated board" << std::endl;
    }
-   if (result == VHDERR_NOERROR)
+
+   if (software_transmission && !St2110_20Packetizer::is_supported(video_format))
    {
-      result = get_nic_mac_address(board, media_nic_mac_address);
-      if(result != VHDERR_NOERROR)
-      {
-         std::cout << "Error when getting the MAC address" << " [" << to_string(result) << "]" << std::endl;
-      }
+      result = VHDERR_BADARG;
+      std::cout << "Error when packetizing " << to_string(video_format)
+                << ": only YCbCr-4:2:2 flows can be sent in software transmission" << std::endl;
    }
 
-   if (result == VHDERR_NOERROR)
+   if (result == VHDERR_NOERROR && !software_transmission)
    {
-      result = configure_stream(
-          board, stream, stream_type, video_standard, destination_address, destination_ssrc, destination_udp_port);
-      if (result != VHDERR_NOERROR)
-      {
-         std::cout << "Error when configuring the stream"
-                   << " [" << to_string(result) << "]" << std::endl;
-      }
+      auto phase = startup_profiler.phase("open boards");
+      result = open_all_boards(boards, board_id);
    }
-
-   // Generate the SDP
-   if (result == VHDERR_NOERROR)
+   if (result == VHDERR_NOERROR && !software_transmission && board_id >= boards.size())
    {
-      result = generate_sdp(board, stream, sdp);
-      if (result != VHDERR_NOERROR)
-      {
-         std::cout << "Error when generating the SDP" << " [" << to_string(result) << "]" << std::endl;
-      }
+      result = VHDERR_BADARG;
+      std::cout << "Board " << board_id << " not found (" << boards.size() << " board(s) detected)" << std::endl;
    }
 
-   if(result == VHDERR_NOERROR)
+   if (result == VHDERR_NOERROR && !software_transmission)
    {
-      //Extract details from video standard
-      result = get_video_standard_info(video_standard, frame_width, frame_height, frame_rate, interlaced, is_us);
+      board = boards[board_id].handle;
 
-      if(result == VHDERR_NOERROR)
-      {
-         //Video pattern generation
-         video_pattern_buffer.resize(frame_width * frame_height * PIXELSIZE_8BIT);
-         create_color_bar_pattern(video_pattern_buffer.data(), frame_height, frame_width);
-      }
+      // The transmission loop and its frame buffers live on the NUMA node local to the board
+      numa_node = boards[board_id].numa_node;
    }
 
+   // The threads created from now on (NMOS node, HTTP server) inherit the control plane scheduling
+   apply_thread_scheduling(ThreadRole::control_plane, realtime_config);
+   lock_process_memory(realtime_config);
+
    nmos::node_model node_model;
    nmos::experimental::log_model log_model;
    nmos::experimental::node_implementation node_implementation;
@@ -186,7 +268,9 @@ int main(int argc, char* argv[])
    std::filebuf access_log_buf;
    std::ostream access_log(&access_log_buf);
 
-   nmos::experimental::log_gate gate(error_log, access_log, log_model);
+   nmos::experimental::log_gate log_gate(error_log, access_log, log_model);
+   // The HTTP server threads only queue their log records, a background thread writes them
+   AsyncLogGate gate(log_gate, log_queue_capacity);
 
    std::cout << "Starting nmos node" << std::endl;
 
@@ -211,6 +295,7 @@ int main(int argc, char* argv[])
    log_model.settings = node_model.settings;
    log_model.level = nmos::fields::logging_level(log_model.settings);
 
+   // The MAC address and the SDP are given to the node server once the NIC and the stream are configured
    nmos_tools::NodeServerSender::TransportParams active_transport_params = resolve_auto_transport_params;
    nmos_tools::NodeServerSender node_server(node_model,
                                             log_model,
@@ -224,21 +309,198 @@ int main(int argc, char* argv[])
                                             media_nic_name,
                                             media_nic_mac_address,
                                             sdp);
+   node_server.set_video_format(video_format);
+
+   // The NMOS HTTP server and the pattern generation do not depend on the board configuration: they are brought up
+   // while the NIC and the stream are being configured
+   std::future<void> nmos_server_phase;
+   std::future<VHD_ERRORCODE> pattern_phase;
+   if (result == VHDERR_NOERROR)
+   {
+      nmos_server_phase = std::async(std::launch::async, [&] {
+         auto phase = startup_profiler.phase("nmos http server");
+         node_server.start();
+      });
+
+      pattern_phase = std::async(std::launch::async, [&] {
+         auto phase = startup_profiler.phase("pattern");
+
+         //Extract details from video standard
+         VHD_ERRORCODE pattern_result =
+             get_video_standard_info(video_standard, frame_width, frame_height, frame_rate, interlaced, is_us);
+         if (pattern_result == VHDERR_NOERROR)
+         {
+            //Video pattern generation, the pool also holds the frame buffer of the software transmission
+            if (frame_buffer_pool.allocate({frame_width * frame_height * PIXELSIZE_8BIT, 2, numa_node,
+                                            frame_buffers_huge_pages, frame_buffers_locked}))
+            {
+               video_pattern_buffer = frame_buffer_pool.acquire();
+               create_color_bar_pattern(video_pattern_buffer.data(), frame_height, frame_width);
+            }
+            else
+               pattern_result = VHDERR_OPERATIONFAILED;
+         }
+         return pattern_result;
+      });
+   }
+
+   if (result == VHDERR_NOERROR && software_transmission)
+   {
+      auto phase = startup_profiler.phase("socket");
+      if (!transmitter.open(resolve_auto_transport_params.source, destination))
+      {
+         result = VHDERR_OPERATIONFAILED;
+         std::cout << "Error when opening the transmission socket" << " [" << to_string(result) << "]" << std::endl;
+      }
+      media_nic_mac_address = "00-00-00-00-00-00";
+      sdp = packetizer.generate_sdp(resolve_auto_transport_params.source, destination);
+
+      node_server.set_stream_hooks({
+         [&](uint32_t& video_standard_value) {
+            video_standard_value = video_standard;
+            return true;
+         },
+         // the transmission loop follows the active transport parameters
+         [](const Ipv4Endpoint&) { return true; },
+         [&](const Ipv4Endpoint& new_destination, std::string& new_sdp) {
+            new_sdp = packetizer.generate_sdp(resolve_auto_transport_params.source, new_destination);
+            return true;
+         }});
+   }
+
+   // Only the settings the board does not hold already are applied, a warm restart neither bounces the link nor
+   // resets the PTP servo
+   BoardReconciler board_reconciler(board, software_transmission ? "" : board_state_directory);
+   bool ptp_lock_pending = false, board_state_reported = false;
+
+   if(result == VHDERR_NOERROR && !software_transmission)
+   {
+      auto phase = startup_profiler.phase("nic");
+      result = board_reconciler.reconcile_nic({media_nic_ip, media_nic_subnet_mask, media_nic_gateway, media_nic_dhcp});
+      if(result != VHDERR_NOERROR)
+      {
+         std::cout << "Error when configuring the NIC" << " [" << to_string(result) << "]" << std::endl;
+      }
+      if (result == VHDERR_NOERROR)
+      {
+         result = get_nic_mac_address(board, media_nic_mac_address);
+         if(result != VHDERR_NOERROR)
+         {
+            std::cout << "Error when getting the MAC address" << " [" << to_string(result) << "]" << std::endl;
+         }
+      }
+   }
+
+   if (result == VHDERR_NOERROR && !software_transmission)
+   {
+      auto phase = startup_profiler.phase("stream");
+      result = board_reconciler.reconcile_clock_system(find_video_standard_info(video_standard)->is_us);
+      if (result == VHDERR_NOERROR)
+         result = configure_stream(
+             board, stream, stream_type, video_standard, destination, destination_ssrc, video_format);
+      if (result != VHDERR_NOERROR)
+      {
+         std::cout << "Error when configuring the stream"
+                   << " [" << to_string(result) << "]" << std::endl;
+      }
+   }
 
-   if(!node_server.node_implementation_init())
+   // Generate the SDP
+   if (result == VHDERR_NOERROR && !software_transmission)
    {
-      result = VHDERR_FATALERROR;
-      std::cout << "Error when initializing the node server" << " [" << to_string(result) << "]" << std::endl;
+      auto phase = startup_profiler.phase("sdp");
+      result = generate_sdp(board, stream, sdp);
+      if (result != VHDERR_NOERROR)
+      {
+         std::cout << "Error when generating the SDP" << " [" << to_string(result) << "]" << std::endl;
+      }
+   }
+
+   if (pattern_phase.valid())
+   {
+      const VHD_ERRORCODE pattern_result = pattern_phase.get();
+      if (pattern_result != VHDERR_NOERROR)
+      {
+         std::cout << "Error when generating the video pattern" << " [" << to_string(pattern_result) << "]"
+                   << std::endl;
+         if (result == VHDERR_NOERROR)
+            result = pattern_result;
+      }
+   }
+   if (result == VHDERR_NOERROR && !shm_input_name.empty())
+   {
+      // The slots of the board rotate over several buffers, a skipped slot would send an older frame again
+      LateFramePolicy late_frame_policy = shm_input_late_policy;
+      if (!software_transmission && late_frame_policy == LateFramePolicy::skip)
+      {
+         std::cout << "The skip late frame policy needs the software transmission, the last frame is repeated instead"
+                   << std::endl;
+         late_frame_policy = LateFramePolicy::repeat_last;
+      }
+      shm_input = std::make_unique<ShmFrameSource>(shm_input_name, late_frame_policy, frame_width, frame_height);
+   }
+   if (nmos_server_phase.valid())
+      nmos_server_phase.get();
+
+   if (result == VHDERR_NOERROR)
+   {
+      auto phase = startup_profiler.phase("nmos resources");
+      node_server.set_media_nic_mac_address(media_nic_mac_address);
+      node_server.set_sdp(sdp);
+      if(!node_server.node_implementation_init())
+      {
+         result = VHDERR_FATALERROR;
+         std::cout << "Error when initializing the node server" << " [" << to_string(result) << "]" << std::endl;
+      }
    }
 
    if (result == VHDERR_NOERROR)
    {
-      node_server.start();
       std::cout << "NMOS: node ready for connections" << std::endl;
+      node_server.print_registration_statistics();
+      startup_profiler.mark("ready");
+      print_numa_placement_report(boards, video_pattern_buffer.size());
    }
 
    nmos_tools::NodeServerSender::TransportParams previous_transport_params = resolve_auto_transport_params;
 
+   PtpMonitor ptp_monitor(board, ptp_lock_threshold_ns);
+   if (result == VHDERR_NOERROR && !software_transmission)
+      ptp_monitor.start([&] { apply_thread_scheduling(ThreadRole::monitor, realtime_config); });
+
+   if (result == VHDERR_NOERROR && slot_tracing)
+   {
+      slot_tracer().enable(slot_trace_path, slot_trace_window);
+      slot_tracer().set_thread_name("transmission loop");
+   }
+
+   if (result == VHDERR_NOERROR && !flight_recorder_path.empty())
+   {
+      // The PTP of the board is not monitored in software transmission
+      if (!software_transmission)
+         flight_recorder.set_ptp_source(
+            [&] {
+               const PtpStatus status = ptp_monitor.get_status();
+               return FlightPtpStatus{static_cast<uint32_t>(status.state), status.locked_within_threshold,
+                                      status.offset_ns};
+            },
+            [](uint32_t state) { return to_string(static_cast<VHD_PTP_PORT_STATE>(state)); });
+      if (!flight_recorder.open(flight_recorder_path, flight_recorder_records, "sender"))
+         std::cout << "The stream status is not recorded" << std::endl;
+   }
+
+   // The main thread runs the slot loop from now on. Only then is it bound to the NUMA node of the board, so that
+   // the threads created before (NMOS node, HTTP server) are not, and a CPU list of the slot loop prevails.
+   if (result == VHDERR_NOERROR)
+   {
+      apply_thread_scheduling(ThreadRole::slot_loop, realtime_config);
+      if (numa_node >= 0 && realtime_config.slot_loop.cpus.empty() && !bind_current_thread_to_numa_node(numa_node))
+      {
+         std::cout << "Could not bind the transmission loop to NUMA node " << numa_node << std::endl;
+         numa_node = -1;
+      }
+   }
+
    //Get the system parameters and apply new PTP parameters
    nmos_tools::NmosPtpSystemParameters ptp_system_parameters = {};
    nmos_tools::NmosPtpSystemParameters previous_ptp_system_parameters = {0, 0};
@@ -256,24 +518,34 @@ int main(int argc, char* argv[])
             }
 
          //While the stream is disabled, we have to react to PTP changes
-         if(node_server.get_ptp_system_parameters(ptp_system_parameters)) //if get_ptp_system_parameters returns false,
+         if(!software_transmission &&
+            node_server.get_ptp_system_parameters(ptp_system_parameters)) //if get_ptp_system_parameters returns false,
                                                                           //it means that the PTP system parameters are not available
          {
             if(ptp_system_parameters != previous_ptp_system_parameters)
             {
-               std::cout << "Applying new PTP parameters: domain=" << ptp_system_parameters.domain_number << std::endl;
-               //ptp_system_parameters were changed, we need to update the ptp configuration
-               result = apply_ptp_parameters(board, static_cast<uint8_t>(ptp_system_parameters.domain_number),
-                  static_cast<uint8_t>(ptp_system_parameters.announce_receipt_timeout));
+               //ptp_system_parameters were changed, the ptp configuration is only set if the board does not hold it already
+               bool ptp_applied = false;
+               result = board_reconciler.reconcile_ptp(static_cast<uint8_t>(ptp_system_parameters.domain_number),
+                  static_cast<uint8_t>(ptp_system_parameters.announce_receipt_timeout), ptp_applied);
                if(result != VHDERR_NOERROR)
                {
                   exit = true;
                   break;
                }
+               std::cout << "PTP parameters: domain=" << ptp_system_parameters.domain_number
+                         << (ptp_applied ? " applied" : " already in place") << std::endl;
 
+               if (ptp_applied)
+               {
+                  ptp_monitor.restart_lock_detection();
+                  ptp_lock_pending = true;
+                  flight_recorder.record_event(FlightRecordType::ptp_configured,
+                                               static_cast<uint32_t>(ptp_system_parameters.domain_number));
+               }
                previous_ptp_system_parameters = ptp_system_parameters;
             }
-            print_ptp_status(board, static_cast<uint8_t>(ptp_system_parameters.domain_number),
+            ptp_monitor.print_status(static_cast<uint8_t>(ptp_system_parameters.domain_number),
                static_cast<uint8_t>(ptp_system_parameters.announce_receipt_timeout));
          }
 
@@ -284,10 +556,146 @@ int main(int argc, char* argv[])
       if (exit)
          break;
 
+      //Wait for the PTP to be locked within threshold before starting the stream
+      if (wait_for_ptp_lock && !software_transmission && !ptp_monitor.is_locked_within_threshold())
+      {
+         std::cout << std::endl << "Waiting for PTP lock (offset below " << ptp_lock_threshold_ns << " ns)..." << std::endl;
+         while (node_server.is_enabled && !ptp_monitor.wait_for_lock(std::chrono::milliseconds(100)))
+         {
+            if (_kbhit())
+            {
+               _getch();
+               exit = true;
+               break;
+            }
+            ptp_monitor.print_status(static_cast<uint8_t>(ptp_system_parameters.domain_number),
+               static_cast<uint8_t>(ptp_system_parameters.announce_receipt_timeout));
+         }
+         std::cout << std::endl;
+         if (exit)
+            break;
+         if (!node_server.is_enabled)
+            continue;
+         std::cout << "PTP locked in " << ptp_monitor.get_statistics().time_to_lock_s << " s" << std::endl;
+         flight_recorder.record_event(FlightRecordType::ptp_locked,
+                                      static_cast<uint32_t>(ptp_monitor.get_statistics().time_to_lock_s * 1000));
+         if (ptp_lock_pending)
+         {
+            board_reconciler.add_ptp_lock_time(std::chrono::microseconds(
+                static_cast<int64_t>(ptp_monitor.get_statistics().time_to_lock_s * 1e6)));
+            ptp_lock_pending = false;
+         }
+      }
+
+      if (!software_transmission && !board_state_reported)
+      {
+         board_reconciler.print_summary();
+         board_state_reported = true;
+      }
+
+      if (software_transmission)
+      {
+         if (previous_transport_params != active_transport_params)
+         {
+            transmitter.set_destination(active_transport_params.destination);
+            sdp = packetizer.generate_sdp(resolve_auto_transport_params.source, active_transport_params.destination);
+            previous_transport_params = active_transport_params;
+         }
+
+         std::cout << std::endl << "Generated Sdp : " << std::endl << sdp << std::endl;
+         std::cout << std::endl << "Software transmission started" << (transmitter.is_gso_enabled() ? " (UDP GSO)" : "")
+                   << ", press any key to stop..." << std::endl;
+         flight_recorder.record_event(FlightRecordType::activation, video_standard,
+                                      active_transport_params.destination.address.value(),
+                                      active_transport_params.destination.port);
+
+         FrameBuffer frame_buffer = frame_buffer_pool.acquire();
+         uint32_t line = 0;
+         auto last_statistics = std::chrono::steady_clock::now();
+         transmitter.reset_statistics();
+         //Software transmission loop
+         while (1)
+         {
+            if (_kbhit())
+            {
+               // 't' dumps the slot trace, any other key stops the transmission
+               if (_getch() == 't' && slot_tracer().is_enabled())
+                  slot_tracer().dump();
+               else
+               {
+                  exit = true;
+                  break;
+               }
+            }
+
+            if (!node_server.is_enabled || previous_transport_params != active_transport_params)
+               break;
+
+            if (shm_input)
+            {
+               ShmFillResult fill_result;
+               {
+                  auto trace = slot_tracer().trace("shm_input", index);
+                  fill_result = shm_input->fill(frame_buffer.data(), frame_buffer.size());
+               }
+               // Nothing is sent until the producer publishes a frame, it goes on the next epoch
+               if (fill_result == ShmFillResult::skipped)
+               {
+                  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                  continue;
+               }
+            }
+            else
+            {
+               {
+                  auto trace = slot_tracer().trace("copy", index);
+                  std::memcpy(frame_buffer.data(), video_pattern_buffer.data(), frame_buffer.size());
+               }
+
+               {
+                  auto trace = slot_tracer().trace("overlay", index);
+                  draw_white_line(frame_buffer.data(), line, frame_height, frame_width, interlaced);
+               }
+
+               line++;
+               if (line > frame_height - 1) line = 0;
+            }
+
+            bool is_sent;
+            {
+               auto trace = slot_tracer().trace("send_frame", index);
+               is_sent = transmitter.send_frame(frame_buffer.data());
+            }
+            if (!is_sent)
+            {
+               result = VHDERR_OPERATIONFAILED;
+               std::cout << std::endl << "Error when sending frame " << index << " [" << to_string(result) << "]" << std::endl;
+               break;
+            }
+
+            if (index == 0)
+               startup_profiler.mark("first frame");
+
+            index++;
+
+            if (std::chrono::steady_clock::now() - last_statistics >= std::chrono::seconds(1))
+            {
+               transmitter.print_statistics();
+               last_statistics = std::chrono::steady_clock::now();
+            }
+         }
+         std::cout << std::endl;
+         flight_recorder.record_event(FlightRecordType::deactivation,
+                                      static_cast<uint32_t>(get_stop_reason(exit, node_server.is_enabled,
+                                                                            previous_transport_params !=
+                                                                                active_transport_params)));
+         continue;
+      }
+
       if (previous_transport_params != active_transport_params)
       {
          // active parameters were changed, we need to update the stream
-         result = static_cast<VHD_ERRORCODE>(VHD_CloseStreamHandle(stream));
+         result = board_backend().close_stream_handle(stream);
          if (result != VHDERR_NOERROR)
             std::cout << "Error when closing the stream"
                       << " [" << to_string(result) << "]" << std::endl;
@@ -298,9 +706,9 @@ int main(int argc, char* argv[])
                                       stream,
                                       stream_type,
                                       video_standard,
-                                      active_transport_params.ip_dst,
+                                      active_transport_params.destination,
                                       destination_ssrc,
-                                      active_transport_params.port_dst);
+                                      video_format);
             if (result == VHDERR_NOERROR)
             {
                previous_transport_params = active_transport_params;
@@ -317,9 +725,16 @@ int main(int argc, char* argv[])
             result = generate_sdp(board, stream, sdp);
       }
 
+      if (result == VHDERR_NOERROR)
+      {
+         result = queue_controller.apply(stream, *find_video_standard_info(video_standard));
+         if (result != VHDERR_NOERROR)
+            std::cout << "Error when tuning the slot queue" << " [" << to_string(result) << "]" << std::endl;
+      }
+
       if(result == VHDERR_NOERROR)
       {
-         result = static_cast<VHD_ERRORCODE>(VHD_StartStream(stream));
+         result = board_backend().start_stream(stream);
          if (result != VHDERR_NOERROR)
          {
             std::cout << "Error when starting stream" << " [" << to_string(result) << "]" << std::endl;
@@ -330,66 +745,223 @@ int main(int argc, char* argv[])
       {
          std::cout << std::endl << "Generated Sdp : " << std::endl << sdp << std::endl;
          std::cout << std::endl << "Transmission started, press any key to stop..." << std::endl;
+         flight_recorder.record_event(FlightRecordType::activation, video_standard,
+                                      active_transport_params.destination.address.value(),
+                                      active_transport_params.destination.port);
 
          bool stop_monitoring = false;
-         std::thread monitoring_thread (monitor_tx_stream_status, stream, &stop_monitoring);
+         std::thread monitoring_thread;
+         // The monitoring is restarted when a recovery replaces the stream handle
+         const auto start_monitoring = [&] {
+            stop_monitoring = false;
+            monitoring_thread = std::thread([&] {
+               apply_thread_scheduling(ThreadRole::monitor, realtime_config);
+               monitor_tx_stream_status(stream, &stop_monitoring, numa_node, &queue_controller, &flight_recorder);
+            });
+         };
+         const auto stop_monitoring_thread = [&] {
+            stop_monitoring = true;
+            if (monitoring_thread.joinable())
+               monitoring_thread.join();
+         };
+         start_monitoring();
+
+         // A stalled stream is recovered inside the transmission loop with the same configuration, the SDP and
+         // the NMOS resources of the sender do not change
+         const VideoStandardInfo& video_standard_info = *find_video_standard_info(video_standard);
+         const auto restart_stream = [&] {
+            VHD_ERRORCODE status = board_backend().stop_stream(stream);
+            if (status == VHDERR_NOERROR)
+               status = queue_controller.apply(stream, video_standard_info);
+            if (status == VHDERR_NOERROR)
+               status = board_backend().start_stream(stream);
+            return status;
+         };
+         const auto reopen_stream = [&] {
+            stop_monitoring_thread();
+            if (stream != nullptr)
+            {
+               board_backend().stop_stream(stream);
+               board_backend().close_stream_handle(stream);
+               stream = nullptr;
+            }
+            VHD_ERRORCODE status = configure_stream(board, stream, stream_type, video_standard,
+                                                    previous_transport_params.destination, destination_ssrc,
+                                                    video_format);
+            if (status == VHDERR_NOERROR)
+               status = queue_controller.apply(stream, video_standard_info);
+            if (status == VHDERR_NOERROR)
+               status = board_backend().start_stream(stream);
+            if (status == VHDERR_NOERROR)
+               start_monitoring();
+            return status;
+         };
+         const auto reinit_board = [&] {
+            stop_monitoring_thread();
+            if (stream != nullptr)
+            {
+               board_backend().stop_stream(stream);
+               board_backend().close_stream_handle(stream);
+               stream = nullptr;
+            }
+            // The PTP monitor samples the handle from its thread, it is detached before the handle is closed
+            ptp_monitor.set_board_handle(nullptr);
+            if (board != nullptr)
+               board_backend().close_board_handle(board);
+            VHD_ERRORCODE status = board_backend().open_board_handle(board_id, &board, nullptr, 0);
+            if (status != VHDERR_NOERROR)
+               board = nullptr;
+            boards[board_id].handle = board;
+            board_reconciler.set_board_handle(board);
+            if (status == VHDERR_NOERROR)
+               ptp_monitor.set_board_handle(board);
+
+            // The settings are reconciled, a board that kept them across the re-init is not reconfigured
+            bool ptp_applied = false;
+            if (status == VHDERR_NOERROR)
+               status = board_reconciler.reconcile_nic(
+                   {media_nic_ip, media_nic_subnet_mask, media_nic_gateway, media_nic_dhcp});
+            if (status == VHDERR_NOERROR)
+               status = board_reconciler.reconcile_ptp(
+                   static_cast<uint8_t>(previous_ptp_system_parameters.domain_number),
+                   static_cast<uint8_t>(previous_ptp_system_parameters.announce_receipt_timeout), ptp_applied);
+            if (status == VHDERR_NOERROR)
+               status = board_reconciler.reconcile_clock_system(video_standard_info.is_us);
+            if (status == VHDERR_NOERROR)
+               status = reopen_stream();
+            return status;
+         };
+         const StreamRecoveryActions recovery_actions = {restart_stream, reopen_stream, reinit_board};
+         stream_watchdog.arm(video_standard_info);
          uint32_t line = 0;
          //Transmission loop
          while (1)
          {
             if (_kbhit())
             {
-               _getch();
-               exit = true;
-               break;
+               // 't' dumps the slot trace, any other key stops the transmission
+               if (_getch() == 't' && slot_tracer().is_enabled())
+                  slot_tracer().dump();
+               else
+               {
+                  exit = true;
+                  break;
+               }
             }
 
             if (!node_server.is_enabled || previous_transport_params != active_transport_params)
                break;
 
             // Try to lock the next slot.
-            result = static_cast<VHD_ERRORCODE>(VHD_LockSlotHandle(stream, &slot));
+            const auto lock_start = std::chrono::steady_clock::now();
+            {
+               auto trace = slot_tracer().trace("lock_slot", index);
+               result = board_backend().lock_slot_handle(stream, &slot);
+            }
 
             if (result != VHDERR_NOERROR)
             {
+               if (stream_watchdog.on_stall(recovery_actions, result))
+               {
+                  result = VHDERR_NOERROR; // The watchdog recovers the stream
+                  continue;
+               }
                std::cout << std::endl
                          << "Error when locking slot at slot " << index << " [" << to_string(result) << "]"
                          << std::endl;
                break;
             }
 
+            const QueueAction queue_action =
+                queue_controller.on_slot_locked(stream, std::chrono::steady_clock::now() - lock_start);
+
             //Get the video buffer associated to the slot.
-            result = static_cast<VHD_ERRORCODE>(VHD_GetSlotBuffer(slot, VHD_ST2110_BT_VIDEO, &buffer, &buffer_size));
+            {
+               auto trace = slot_tracer().trace("get_slot_buffer", index);
+               result = board_backend().get_slot_buffer(slot, VHD_ST2110_BT_VIDEO, &buffer, &buffer_size);
+            }
             if (result != VHDERR_NOERROR)
             {
                std::cout << std::endl << "Error when getting slot buffer at slot " << index << " [" << to_string(result) << "]" << std::endl;
             }
 
-            std::memcpy(buffer, video_pattern_buffer.data(), buffer_size);
+            if (shm_input)
+            {
+               ShmFillResult fill_result;
+               {
+                  auto trace = slot_tracer().trace("shm_input", index);
+                  fill_result = shm_input->fill(buffer, buffer_size);
+               }
+               // Every unlocked slot of the board is sent, a buffer left as it is would hold an older frame
+               if (fill_result == ShmFillResult::skipped)
+               {
+                  std::cout << std::endl << "Error when filling slot " << index << ": the late frame was skipped"
+                            << std::endl;
+                  result = VHDERR_BADARG;
+                  break;
+               }
+            }
+            else
+            {
+               {
+                  auto trace = slot_tracer().trace("copy", index);
+                  std::memcpy(buffer, video_pattern_buffer.data(), buffer_size);
+               }
 
-            draw_white_line(buffer, line, frame_height, frame_width, interlaced);
+               {
+                  auto trace = slot_tracer().trace("overlay", index);
+                  draw_white_line(buffer, line, frame_height, frame_width, interlaced);
+               }
 
-            line++;
-            if (line > frame_height - 1) line = 0;
+               line++;
+               if (line > frame_height - 1) line = 0;
+            }
 
             //Unlock the slot. pBuffer wont be available anymore
-            result = static_cast<VHD_ERRORCODE>(VHD_UnlockSlotHandle(slot));
+            {
+               auto trace = slot_tracer().trace("unlock_slot", index);
+               result = board_backend().unlock_slot_handle(slot);
+            }
 
             if (result != VHDERR_NOERROR)
             {
+               if (stream_watchdog.on_stall(recovery_actions, result))
+               {
+                  result = VHDERR_NOERROR; // The watchdog recovers the stream
+                  continue;
+               }
                std::cout << std::endl << "Error when unlocking slot at slot " << index << " [" << to_string(result) << "]" << std::endl;
                break;
             }
+            stream_watchdog.on_slot_completed();
+
+            if (queue_action == QueueAction::restart_stream)
+            {
+               auto trace = slot_tracer().trace("restart_stream", index);
+               result = queue_controller.restart_stream(stream);
+               if (result != VHDERR_NOERROR)
+               {
+                  std::cout << std::endl << "Error when restarting the stream with a new slot queue depth"
+                            << " [" << to_string(result) << "]" << std::endl;
+                  break;
+               }
+            }
+
+            if (index == 0)
+               startup_profiler.mark("first frame");
 
             index++;
          }
 
-         stop_monitoring = true;
-         monitoring_thread.join();
+         stop_monitoring_thread();
+         flight_recorder.record_event(FlightRecordType::deactivation,
+                                      static_cast<uint32_t>(get_stop_reason(exit, node_server.is_enabled,
+                                                                            previous_transport_params !=
+                                                                                active_transport_params)));
 
          VHD_ERRORCODE result_stop_stream; //temporary variable to not overwrite result if an error occured in the transmission loop
 
-         result_stop_stream = static_cast<VHD_ERRORCODE>(VHD_StopStream(stream));
+         result_stop_stream = board_backend().stop_stream(stream);
          if (result_stop_stream != VHDERR_NOERROR)
          {
             std::cout << "Error when stopping the stream"<< " [" << to_string(result_stop_stream) << "]" << std::endl;
@@ -400,14 +972,26 @@ int main(int argc, char* argv[])
 
    if(stream)
    {
-      result = static_cast<VHD_ERRORCODE>(VHD_CloseStreamHandle(stream));
+      result = board_backend().close_stream_handle(stream);
       if (result != VHDERR_NOERROR)
          std::cout << "Error when closing the stream" << " [" << to_string(result) << "]" << std::endl;
    }
 
+   ptp_monitor.stop();
+   if (simulated_backend)
+      simulated_backend->print_statistics();
+   frame_buffer_pool.print_statistics();
+   queue_controller.print_statistics();
+   stream_watchdog.print_statistics();
+   if (shm_input)
+      shm_input->print_statistics();
+   close_all_boards(boards);
+
    close_keyboard();
 
    node_server.stop();
+   gate.flush();
+   gate.print_statistics();
 
    return 0;
 }
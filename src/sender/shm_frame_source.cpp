@@ -0,0 +1,269 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "../pixel_conversion.h"
+#include "shm_frame_source.h"
+
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
+
+namespace
+{
+   // Cb Y0 Cr Y1 of a black pixel pair, as one little-endian word
+   const uint32_t yuv422_8_black = 0x10801080;
+
+   const std::chrono::seconds attach_check_period(1);
+}
+
+ShmFrameSource::ShmFrameSource(const std::string& name, LateFramePolicy late_frame_policy, uint32_t frame_width,
+                               uint32_t frame_height)
+    : m_name(name)
+    , m_late_frame_policy(late_frame_policy)
+    , m_frame_width(frame_width)
+    , m_frame_height(frame_height)
+{
+}
+
+ShmFillResult ShmFrameSource::fill(uint8_t* buffer, uint64_t buffer_size)
+{
+   m_statistics.nb_slots++;
+
+   const auto now = std::chrono::steady_clock::now();
+   if (now >= m_next_attach_check)
+   {
+      m_next_attach_check = now + attach_check_period;
+      if (m_reader.is_open() && is_producer_gone())
+         detach();
+      if (!m_reader.is_open())
+         attach();
+   }
+
+   // A frame overwritten while it was read may leave part of it in the buffer
+   bool is_buffer_written = false;
+   if (m_reader.is_open())
+   {
+      const auto copy_start = std::chrono::steady_clock::now();
+      ShmFrameInfo info;
+      ShmReadResult result;
+      do
+      {
+         result = m_reader.read_next(
+             [&](const uint8_t* frame, const ShmFrameInfo& frame_info) {
+                const bool is_copied = copy_frame(buffer, buffer_size, frame, frame_info);
+                is_buffer_written |= is_copied;
+                return is_copied;
+             },
+             info);
+      } while (result == ShmReadResult::overrun || result == ShmReadResult::rejected);
+
+      if (result == ShmReadResult::frame)
+      {
+         const double copy_us =
+             std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - copy_start).count();
+         m_copy_sum_us += copy_us;
+         m_statistics.max_copy_us = std::max(m_statistics.max_copy_us, copy_us);
+         m_nb_copies++;
+
+         m_last_frame_buffer = buffer;
+         m_has_frame = true;
+         m_late_run = 0;
+         m_statistics.nb_frames++;
+         return ShmFillResult::frame;
+      }
+      if (result == ShmReadResult::closed)
+      {
+         std::cout << std::endl << "The producer of " << m_name << " closed the ring" << std::endl;
+         detach();
+      }
+      if (is_buffer_written && buffer == m_last_frame_buffer)
+         m_last_frame_buffer = nullptr;
+   }
+
+   if (!m_has_frame)
+   {
+      fill_black(buffer, buffer_size);
+      m_statistics.nb_black_frames++;
+      return ShmFillResult::black;
+   }
+
+   m_statistics.nb_late_slots++;
+   m_statistics.max_late_run = std::max(m_statistics.max_late_run, ++m_late_run);
+   return fill_late(buffer, buffer_size, is_buffer_written);
+}
+
+ShmFrameSourceStatistics ShmFrameSource::get_statistics() const
+{
+   ShmFrameSourceStatistics statistics = m_statistics;
+   const ShmFrameRingReaderStatistics reader_statistics = m_reader.get_statistics();
+   statistics.nb_overruns += reader_statistics.nb_overruns;
+   statistics.nb_rejected_frames += reader_statistics.nb_rejected;
+   statistics.mean_copy_us = m_nb_copies ? m_copy_sum_us / m_nb_copies : 0.0;
+   return statistics;
+}
+
+void ShmFrameSource::print_statistics() const
+{
+   const ShmFrameSourceStatistics statistics = get_statistics();
+   std::cout << "Shared-memory input " << m_name << " (" << to_string(m_late_frame_policy)
+             << " when late): " << statistics.nb_frames << "/" << statistics.nb_slots << " frames - late: "
+             << statistics.nb_late_slots << " (longest run " << statistics.max_late_run
+             << ") - repeated: " << statistics.nb_repeated_frames << " - black: " << statistics.nb_black_frames
+             << " - skipped: " << statistics.nb_skipped_slots << " - overruns: " << statistics.nb_overruns
+             << " - rejected: " << statistics.nb_rejected_frames << " - attachments: " << statistics.nb_attachments
+             << " - copy: " << std::fixed << std::setprecision(1) << statistics.mean_copy_us << " us (max "
+             << statistics.max_copy_us << " us)" << std::defaultfloat << std::endl;
+}
+
+bool ShmFrameSource::attach()
+{
+   // The producer may not be started yet, the ring is looked for again at the next check
+   if (!m_reader.open(m_name, false))
+      return false;
+
+   m_statistics.nb_attachments++;
+   std::cout << std::endl << "Attached to the shared-memory ring " << m_name << " of process "
+             << m_reader.get_producer_pid() << std::endl;
+   return true;
+}
+
+void ShmFrameSource::detach()
+{
+   const ShmFrameRingReaderStatistics reader_statistics = m_reader.get_statistics();
+   m_statistics.nb_overruns += reader_statistics.nb_overruns;
+   m_statistics.nb_rejected_frames += reader_statistics.nb_rejected;
+   m_reader.close();
+   m_has_frame = false;
+   m_last_frame_buffer = nullptr;
+   m_late_run = 0;
+}
+
+bool ShmFrameSource::is_producer_gone() const
+{
+#if defined(_WIN32)
+   return false;
+#else
+   // A producer that crashed leaves its ring behind without closing it
+   const pid_t producer_pid = static_cast<pid_t>(m_reader.get_producer_pid());
+   return producer_pid > 0 && kill(producer_pid, 0) != 0 && errno == ESRCH;
+#endif
+}
+
+bool ShmFrameSource::copy_frame(uint8_t* buffer, uint64_t buffer_size, const uint8_t* frame,
+                                const ShmFrameInfo& info)
+{
+   // A producer that does not describe its frames is trusted on their size
+   if (info.format.frame_width && (info.format.frame_width != m_frame_width ||
+                                   info.format.frame_height != m_frame_height))
+      return false;
+
+   const uint64_t nb_pixels = static_cast<uint64_t>(m_frame_width) * m_frame_height;
+   const uint64_t frame_size = nb_pixels * yuv422_8_bytes_per_pixel;
+   if (buffer_size < frame_size)
+      return false;
+
+   switch (static_cast<ShmPixelLayout>(info.format.layout))
+   {
+   case ShmPixelLayout::unknown:
+   case ShmPixelLayout::yuv422_8:
+      if (info.frame_size != frame_size)
+         return false;
+      std::memcpy(buffer, frame, frame_size);
+      return true;
+   case ShmPixelLayout::yuv422_10:
+      if (info.frame_size != nb_pixels * yuv422_10_bytes_per_pixel)
+         return false;
+      convert_yuv422_10_to_yuv422_8(frame, buffer, static_cast<uint32_t>(nb_pixels));
+      return true;
+   default:
+      return false;
+   }
+}
+
+ShmFillResult ShmFrameSource::fill_late(uint8_t* buffer, uint64_t buffer_size, bool is_buffer_written)
+{
+   switch (m_late_frame_policy)
+   {
+   case LateFramePolicy::repeat_last:
+   {
+      // The software transmission sends the same buffer again and again, it still holds the last frame
+      if (buffer == m_last_frame_buffer)
+      {
+         m_statistics.nb_repeated_frames++;
+         return ShmFillResult::repeated;
+      }
+
+      // Otherwise the last frame is still in the ring, the producer writes its next frame in another slot
+      ShmFrameInfo info;
+      const auto copy_start = std::chrono::steady_clock::now();
+      if (m_reader.read_last(
+              [&](const uint8_t* frame, const ShmFrameInfo& frame_info) {
+                 return copy_frame(buffer, buffer_size, frame, frame_info);
+              },
+              info) == ShmReadResult::frame)
+      {
+         const double copy_us =
+             std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - copy_start).count();
+         m_copy_sum_us += copy_us;
+         m_statistics.max_copy_us = std::max(m_statistics.max_copy_us, copy_us);
+         m_nb_copies++;
+
+         m_last_frame_buffer = buffer;
+         m_statistics.nb_repeated_frames++;
+         return ShmFillResult::repeated;
+      }
+      break;
+   }
+   case LateFramePolicy::skip:
+      if (!is_buffer_written)
+      {
+         m_statistics.nb_skipped_slots++;
+         return ShmFillResult::skipped;
+      }
+      break;
+   case LateFramePolicy::black:
+      break;
+   }
+
+   fill_black(buffer, buffer_size);
+   m_statistics.nb_black_frames++;
+   return ShmFillResult::black;
+}
+
+void ShmFrameSource::fill_black(uint8_t* buffer, uint64_t buffer_size)
+{
+   const uint64_t frame_size = std::min<uint64_t>(
+       buffer_size, static_cast<uint64_t>(m_frame_width) * m_frame_height * yuv422_8_bytes_per_pixel);
+   for (uint64_t offset = 0; offset + sizeof(yuv422_8_black) <= frame_size; offset += sizeof(yuv422_8_black))
+      std::memcpy(buffer + offset, &yuv422_8_black, sizeof(yuv422_8_black));
+   if (buffer == m_last_frame_buffer)
+      m_last_frame_buffer = nullptr;
+}
+
+const char* to_string(LateFramePolicy policy)
+{
+   switch (policy)
+   {
+   case LateFramePolicy::repeat_last: return "repeat last";
+   case LateFramePolicy::black: return "black";
+   case LateFramePolicy::skip: return "skip";
+   default: return "unknown";
+   }
+}
@@ -0,0 +1,121 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file shm_frame_source.h
+   @brief This file contains the source of the sender that reads the frames rendered by another process of the host
+   from a shared-memory frame ring (shm_frame_ring.h).
+
+   @detail The frames are read in place from the ring and copied, or converted from the 10-bit layout, straight into
+   the buffer of the slot or of the software transmission, in a single pass. They must have the size of the video
+   standard of the sender and be laid out like its slot buffers, the fields one after the other for interlaced
+   standards. When the producer has no new frame for a slot, the late frame policy decides what is sent.
+*/
+
+#if defined(__GNUC__) && !defined(__APPLE__)
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <chrono>
+#include <string>
+
+#include "../shm_frame_ring.h"
+
+/*!
+   @brief What is sent when the producer has no new frame for a slot
+*/
+enum class LateFramePolicy
+{
+   repeat_last /*! The last frame of the producer is sent again */,
+   black /*! A black frame is sent */,
+   skip /*! The buffer is left as it is and the software transmission does not send the frame, not available to
+            the board whose slots would send the older frame they held */,
+};
+
+/*!
+   @brief What fill() did with the buffer
+*/
+enum class ShmFillResult
+{
+   frame /*! A new frame of the producer was written */,
+   repeated /*! The last frame of the producer was written again, or was still in the buffer */,
+   black /*! A black frame was written */,
+   skipped /*! The buffer was left as it is */,
+};
+
+struct ShmFrameSourceStatistics
+{
+   uint64_t nb_slots = 0 /*! Buffers filled */;
+   uint64_t nb_frames = 0 /*! Buffers filled with a new frame of the producer */;
+   uint64_t nb_late_slots = 0 /*! Buffers the producer had no new frame for */;
+   uint64_t nb_repeated_frames = 0;
+   uint64_t nb_black_frames = 0 /*! Including the buffers filled while no producer is attached */;
+   uint64_t nb_skipped_slots = 0;
+   uint64_t max_late_run = 0 /*! Longest run of consecutive late buffers */;
+   uint64_t nb_overruns = 0 /*! Frames of the producer lost because the sender fell more than the ring behind */;
+   uint64_t nb_rejected_frames = 0 /*! Frames of the producer that did not match the video standard */;
+   uint64_t nb_attachments = 0 /*! Times the sender attached to a ring */;
+   double mean_copy_us = 0.0 /*! Time to copy or convert a frame of the ring into the buffer */;
+   double max_copy_us = 0.0;
+};
+
+class ShmFrameSource
+{
+public:
+   ShmFrameSource(const std::string& name /*!< [in] POSIX shared memory name of the ring*/,
+                  LateFramePolicy late_frame_policy /*!< [in] What is sent when the producer is late*/,
+                  uint32_t frame_width /*!< [in] Width of the frames of the video standard*/,
+                  uint32_t frame_height /*!< [in] Height of the frames of the video standard*/);
+
+   ShmFrameSource(const ShmFrameSource&) = delete;
+   ShmFrameSource& operator=(const ShmFrameSource&) = delete;
+
+   /*!
+      @brief Fill a buffer with the next frame of the producer, or as the late frame policy says if there is none
+
+      @detail Until a producer is attached and has published a frame, the buffer is filled in black. The ring is
+      attached again when its producer closes it or exits, so the producer may be restarted at any time.
+   */
+   ShmFillResult fill(uint8_t* buffer /*!< [out] Buffer of the slot or of the software transmission*/,
+                      uint64_t buffer_size /*!< [in] Bytes of the buffer, a YUV 4:2:2 8-bit frame*/);
+
+   ShmFrameSourceStatistics get_statistics() const;
+   void print_statistics() const;
+
+private:
+   bool attach();
+   bool is_producer_gone() const;
+   bool copy_frame(uint8_t* buffer, uint64_t buffer_size, const uint8_t* frame, const ShmFrameInfo& info);
+   ShmFillResult fill_late(uint8_t* buffer, uint64_t buffer_size, bool is_buffer_written);
+   void fill_black(uint8_t* buffer, uint64_t buffer_size);
+   void detach();
+
+   std::string m_name;
+   LateFramePolicy m_late_frame_policy;
+   uint32_t m_frame_width;
+   uint32_t m_frame_height;
+   ShmFrameRingReader m_reader;
+   std::chrono::steady_clock::time_point m_next_attach_check;
+   const uint8_t* m_last_frame_buffer = nullptr /*! Buffer still holding the last frame of the producer */;
+   bool m_has_frame = false /*! A frame of the attached producer was written */;
+   uint64_t m_late_run = 0;
+   uint64_t m_nb_copies = 0;
+   double m_copy_sum_us = 0.0;
+   ShmFrameSourceStatistics m_statistics;
+};
+
+const char* to_string(LateFramePolicy policy);
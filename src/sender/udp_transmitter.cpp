@@ -0,0 +1,322 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "udp_transmitter.h"
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // <linux/udp.h>, Linux 4.18 and later
+#endif
+#endif
+
+namespace
+{
+   double get_thread_cpu_s()
+   {
+#if defined(__linux__)
+      timespec time;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+      return time.tv_sec + time.tv_nsec / 1e9;
+#else
+      return 0.0;
+#endif
+   }
+}
+
+UdpTransmitter::UdpTransmitter(St2110_20Packetizer& packetizer, PacingClock pacing_clock, uint32_t batch_size)
+    : m_packetizer(packetizer), m_pacing_clock(pacing_clock),
+      m_batch_size(std::max(1u, std::min(batch_size, max_batch_size)))
+{
+   m_batch_buffer.resize(static_cast<size_t>(m_batch_size) * m_packetizer.get_max_packet_size());
+}
+
+UdpTransmitter::~UdpTransmitter()
+{
+   close();
+}
+
+bool UdpTransmitter::open(const Ipv4Endpoint& source, const Ipv4Endpoint& destination)
+{
+   close();
+#if defined(__linux__)
+   m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+   if (m_socket < 0)
+   {
+      std::cout << "Error when creating the UDP socket [" << std::strerror(errno) << "]" << std::endl;
+      return false;
+   }
+
+   sockaddr_in source_address = {};
+   source_address.sin_family = AF_INET;
+   source_address.sin_addr.s_addr = htonl(source.address.value());
+   source_address.sin_port = htons(source.port);
+   if (bind(m_socket, reinterpret_cast<sockaddr*>(&source_address), sizeof(source_address)) != 0)
+   {
+      std::cout << "Error when binding the UDP socket to " << to_chars(source).c_str() << " ["
+                << std::strerror(errno) << "]" << std::endl;
+      close();
+      return false;
+   }
+
+   // Multicast goes out of the source interface, and is looped back for the tests on a single host
+   in_addr multicast_interface = {htonl(source.address.value())};
+   const int ttl = 64, loop = 1;
+   setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_IF, &multicast_interface, sizeof(multicast_interface));
+   setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+   setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+   // A frame is a few MB: keep a few batches in flight in the socket
+   const int send_buffer_size = static_cast<int>(4 * m_batch_buffer.size());
+   setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &send_buffer_size, sizeof(send_buffer_size));
+
+   // UDP GSO is enabled per message, probe the kernel support once
+   const int segment_size = static_cast<int>(m_packetizer.get_max_packet_size());
+   m_gso_enabled = setsockopt(m_socket, IPPROTO_UDP, UDP_SEGMENT, &segment_size, sizeof(segment_size)) == 0;
+   if (m_gso_enabled)
+   {
+      const int no_segmentation = 0;
+      setsockopt(m_socket, IPPROTO_UDP, UDP_SEGMENT, &no_segmentation, sizeof(no_segmentation));
+   }
+
+   m_destination = destination;
+   reset_statistics();
+   return true;
+#else
+   (void)source;
+   (void)destination;
+   std::cout << "The software transmission is only available on Linux" << std::endl;
+   return false;
+#endif
+}
+
+void UdpTransmitter::close()
+{
+#if defined(__linux__)
+   if (m_socket >= 0)
+      ::close(m_socket);
+#endif
+   m_socket = -1;
+}
+
+void UdpTransmitter::set_destination(const Ipv4Endpoint& destination)
+{
+   m_destination = destination;
+}
+
+void UdpTransmitter::reset_statistics()
+{
+   m_statistics = UdpTransmitterStatistics();
+   m_start_ns = 0;
+   m_pacing_error_sum_ns = 0.0;
+   m_nb_batches = 0;
+}
+
+uint64_t UdpTransmitter::now_ns() const
+{
+#if defined(__linux__)
+   timespec time;
+   clock_gettime(m_pacing_clock == PacingClock::tai ? CLOCK_TAI : CLOCK_REALTIME, &time);
+   return static_cast<uint64_t>(time.tv_sec) * 1000000000 + static_cast<uint64_t>(time.tv_nsec);
+#else
+   return 0;
+#endif
+}
+
+bool UdpTransmitter::send_frame(const uint8_t* frame)
+{
+   if (m_socket < 0)
+      return false;
+
+   const FramePeriod& period = m_packetizer.get_period();
+   const bool interlaced = m_packetizer.get_video_standard_info().interlaced;
+
+   // Next epoch, never twice the same one. For interlaced video, the frame starts on an even field epoch.
+   uint64_t epoch_index = std::max(period.index_at(now_ns()) + 1, m_last_epoch_index + 1);
+   if (interlaced && (epoch_index % 2))
+      epoch_index++;
+
+   if (m_start_ns == 0)
+      m_start_ns = period.epoch_ns(epoch_index);
+   const double start_cpu_s = get_thread_cpu_s();
+
+   bool success = send_field(frame, 0, epoch_index);
+   if (success && interlaced)
+      success = send_field(frame, 1, ++epoch_index);
+   m_last_epoch_index = epoch_index;
+
+   m_statistics.nb_frames++;
+   m_statistics.cpu_s += get_thread_cpu_s() - start_cpu_s;
+   const uint64_t now = now_ns();
+   m_statistics.elapsed_s = now > m_start_ns ? (now - m_start_ns) / 1e9 : 0.0;
+   return success;
+}
+
+bool UdpTransmitter::send_field(const uint8_t* frame, uint32_t field, uint64_t epoch_index)
+{
+   const FramePeriod& period = m_packetizer.get_period();
+   const uint32_t nb_packets = m_packetizer.get_nb_packets_per_period();
+   const St2110_21Timing timing =
+       get_st2110_21_timing(period, m_packetizer.get_video_standard_info().frame_height,
+                            m_packetizer.get_video_standard_info().interlaced, nb_packets);
+   const uint64_t epoch_ns = period.epoch_ns(epoch_index);
+   const uint32_t rtp_timestamp = period.epoch_rtp_time(epoch_index);
+
+   // A batch leaves back to back: it is kept within the burst the narrow senders are allowed, and has fully drained
+   // from the network compatibility model bucket by the time the next one is due
+   const uint32_t batch_size = std::min(m_batch_size, timing.cmax_narrow);
+
+   uint32_t packet_sizes[max_batch_size];
+   for (uint32_t first_packet = 0; first_packet < nb_packets; first_packet += batch_size)
+   {
+      const uint32_t nb_batch_packets = std::min(batch_size, nb_packets - first_packet);
+      uint8_t* packet = m_batch_buffer.data();
+      for (uint32_t i = 0; i < nb_batch_packets; i++)
+      {
+         packet_sizes[i] = m_packetizer.build_packet(frame, field, first_packet + i, rtp_timestamp, packet);
+         packet += packet_sizes[i];
+      }
+
+      // The batch leaves when its first packet is due on the gapped model
+      const uint64_t scheduled_ns =
+          epoch_ns + static_cast<uint64_t>(timing.tro_ns + first_packet * timing.trs_ns);
+#if defined(__linux__)
+      const timespec scheduled_time = {static_cast<time_t>(scheduled_ns / 1000000000),
+                                       static_cast<long>(scheduled_ns % 1000000000)};
+      clock_nanosleep(m_pacing_clock == PacingClock::tai ? CLOCK_TAI : CLOCK_REALTIME, TIMER_ABSTIME,
+                      &scheduled_time, nullptr);
+#endif
+      const uint64_t send_ns = now_ns();
+      const double pacing_error_ns = send_ns > scheduled_ns ? static_cast<double>(send_ns - scheduled_ns) : 0.0;
+      m_pacing_error_sum_ns += pacing_error_ns;
+      m_nb_batches++;
+      m_statistics.mean_pacing_error_ns = m_pacing_error_sum_ns / m_nb_batches;
+      m_statistics.max_pacing_error_ns = std::max(m_statistics.max_pacing_error_ns, pacing_error_ns);
+      if (pacing_error_ns > timing.trs_ns)
+         m_statistics.nb_late_batches++;
+
+      if (!send_batch(m_batch_buffer.data(), nb_batch_packets, packet_sizes))
+         return false;
+   }
+   return true;
+}
+
+bool UdpTransmitter::send_batch(uint8_t* packets, uint32_t nb_packets, const uint32_t* packet_sizes)
+{
+#if defined(__linux__)
+   sockaddr_in destination_address = {};
+   destination_address.sin_family = AF_INET;
+   destination_address.sin_addr.s_addr = htonl(m_destination.address.value());
+   destination_address.sin_port = htons(m_destination.port);
+
+   mmsghdr messages[max_batch_size] = {};
+   iovec iovecs[max_batch_size];
+   alignas(cmsghdr) char controls[max_batch_size][CMSG_SPACE(sizeof(uint16_t))];
+   uint32_t first_packets[max_batch_size + 1]; // First packet of each message, then nb_packets
+   uint32_t nb_messages = 0;
+
+   // With UDP GSO, every run of packets of the same size is a single super-packet
+   uint8_t* packet = packets;
+   for (uint32_t i = 0; i < nb_packets;)
+   {
+      first_packets[nb_messages] = i;
+      uint32_t nb_segments = 1;
+      while (m_gso_enabled && i + nb_segments < nb_packets && packet_sizes[i + nb_segments] == packet_sizes[i])
+         nb_segments++;
+
+      iovecs[nb_messages] = {packet, static_cast<size_t>(packet_sizes[i]) * nb_segments};
+      msghdr& message = messages[nb_messages].msg_hdr;
+      message.msg_name = &destination_address;
+      message.msg_namelen = sizeof(destination_address);
+      message.msg_iov = &iovecs[nb_messages];
+      message.msg_iovlen = 1;
+      if (nb_segments > 1)
+      {
+         message.msg_control = controls[nb_messages];
+         message.msg_controllen = sizeof(controls[nb_messages]);
+         cmsghdr* control = CMSG_FIRSTHDR(&message);
+         control->cmsg_level = IPPROTO_UDP;
+         control->cmsg_type = UDP_SEGMENT;
+         control->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+         const uint16_t segment_size = static_cast<uint16_t>(packet_sizes[i]);
+         std::memcpy(CMSG_DATA(control), &segment_size, sizeof(segment_size));
+      }
+
+      packet += static_cast<size_t>(packet_sizes[i]) * nb_segments;
+      i += nb_segments;
+      nb_messages++;
+   }
+   first_packets[nb_messages] = nb_packets;
+
+   const auto count_sent_packets = [&](uint32_t nb_sent_packets) {
+      for (uint32_t i = 0; i < nb_sent_packets; i++)
+         m_statistics.nb_bytes += packet_sizes[i];
+      m_statistics.nb_packets += nb_sent_packets;
+   };
+
+   uint32_t nb_sent_messages = 0;
+   while (nb_sent_messages < nb_messages)
+   {
+      const int result = sendmmsg(m_socket, messages + nb_sent_messages, nb_messages - nb_sent_messages, 0);
+      if (result < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         if (m_gso_enabled && (errno == EIO || errno == EINVAL))
+         {
+            // The egress device cannot segment, the packets not sent yet go as one message per packet
+            std::cout << "UDP GSO not supported on this route, disabled" << std::endl;
+            m_gso_enabled = false;
+            const uint32_t first_unsent_packet = first_packets[nb_sent_messages];
+            count_sent_packets(first_unsent_packet);
+            return send_batch(static_cast<uint8_t*>(iovecs[nb_sent_messages].iov_base),
+                              nb_packets - first_unsent_packet, packet_sizes + first_unsent_packet);
+         }
+         std::cout << "Error when sending on the UDP socket [" << std::strerror(errno) << "]" << std::endl;
+         return false;
+      }
+      nb_sent_messages += static_cast<uint32_t>(result);
+   }
+
+   count_sent_packets(nb_packets);
+   return true;
+#else
+   (void)packets;
+   (void)nb_packets;
+   (void)packet_sizes;
+   return false;
+#endif
+}
+
+void UdpTransmitter::print_statistics() const
+{
+   std::cout << "Software TX: " << m_statistics.nb_frames << " frames, " << static_cast<uint64_t>(m_statistics.get_packet_rate())
+             << " packets/s, " << m_statistics.get_gbps() << " Gbit/s, pacing error mean "
+             << static_cast<uint64_t>(m_statistics.mean_pacing_error_ns) << " ns max "
+             << static_cast<uint64_t>(m_statistics.max_pacing_error_ns) << " ns, " << m_statistics.nb_late_batches
+             << " late batches, CPU " << m_statistics.get_cpu_per_gbps() * 100 << " % of a core per Gbit/s"
+             << (m_gso_enabled ? " (GSO)" : "") << "        \r" << std::flush;
+}
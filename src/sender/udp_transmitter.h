@@ -0,0 +1,125 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file udp_transmitter.h
+   @brief This file contains the software transmission backend of the sender: the frames are packetized by
+   St2110_20Packetizer and sent over a standard UDP socket, paced on the ST 2110-21 narrow gapped model.
+
+   @detail The packets are sent by batches with sendmmsg, as UDP GSO super-packets when the kernel supports it. A
+   batch leaves when its first packet is due and holds at most the CMAX packets of the narrow model.
+   The frame epochs are taken from CLOCK_TAI, which is PTP time when the system clock is disciplined by a PTP
+   daemon (e.g. phc2sys), or from CLOCK_REALTIME. This backend is only available on Linux.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <vector>
+
+#include "../ipv4.h"
+#include "../packetizer.h"
+
+/*!
+   @brief Clock the frame epochs are aligned on
+*/
+enum class PacingClock
+{
+   tai /*! CLOCK_TAI, PTP time when the system clock follows a PTP grandmaster */,
+   system /*! CLOCK_REALTIME */
+};
+
+/*!
+   @brief Transmission statistics since the last reset
+*/
+struct UdpTransmitterStatistics
+{
+   uint64_t nb_frames = 0;
+   uint64_t nb_packets = 0;
+   uint64_t nb_bytes = 0 /*! UDP payload bytes */;
+   uint64_t nb_late_batches = 0 /*! Batches sent more than a drain period after their scheduled time */;
+   double elapsed_s = 0.0;
+   double cpu_s = 0.0 /*! CPU time of the transmission thread */;
+   double mean_pacing_error_ns = 0.0 /*! Mean delay between the scheduled and the actual send time of a batch */;
+   double max_pacing_error_ns = 0.0;
+
+   double get_packet_rate() const { return elapsed_s > 0.0 ? nb_packets / elapsed_s : 0.0; }
+   double get_gbps() const { return elapsed_s > 0.0 ? nb_bytes * 8 / elapsed_s / 1e9 : 0.0; }
+   /*! CPU load, in cores, needed to send 1 Gbit/s */
+   double get_cpu_per_gbps() const { return nb_bytes > 0 ? cpu_s / (nb_bytes * 8 / 1e9) : 0.0; }
+};
+
+class UdpTransmitter
+{
+public:
+   static const uint32_t max_batch_size = 64 /*! Largest number of UDP GSO segments */;
+
+   UdpTransmitter(St2110_20Packetizer& packetizer /*!< [in] Packetizer of the flow*/,
+                  PacingClock pacing_clock = PacingClock::tai /*!< [in] Clock of the frame epochs*/,
+                  uint32_t batch_size = 16 /*!< [in] Packets sent per system call, at most the narrow CMAX*/);
+   ~UdpTransmitter();
+
+   UdpTransmitter(const UdpTransmitter&) = delete;
+   UdpTransmitter& operator=(const UdpTransmitter&) = delete;
+
+   /*!
+      @brief Create the socket, bound to the source address
+
+      @returns True if the socket is ready
+   */
+   bool open(const Ipv4Endpoint& source /*!< [in] Local address and port*/,
+             const Ipv4Endpoint& destination /*!< [in] Destination address and port*/);
+   void close();
+
+   void set_destination(const Ipv4Endpoint& destination /*!< [in] New destination address and port*/);
+
+   /*!
+      @brief Send a frame at the next frame epoch, blocking until its last packet is sent
+
+      @returns False on a socket error
+   */
+   bool send_frame(const uint8_t* frame /*!< [in] Frame in the VHD_BUFPACK_VIDEO_YUV422_8 layout*/);
+
+   bool is_gso_enabled() const { return m_gso_enabled; }
+
+   UdpTransmitterStatistics get_statistics() const { return m_statistics; }
+   void reset_statistics();
+
+   void print_statistics() const;
+
+private:
+   bool send_field(const uint8_t* frame, uint32_t field, uint64_t epoch_index);
+   bool send_batch(uint8_t* packets, uint32_t nb_packets, const uint32_t* packet_sizes);
+   uint64_t now_ns() const;
+
+   St2110_20Packetizer& m_packetizer;
+   const PacingClock m_pacing_clock;
+   const uint32_t m_batch_size;
+
+   int m_socket = -1;
+   Ipv4Endpoint m_destination = {};
+   bool m_gso_enabled = false;
+   std::vector<uint8_t> m_batch_buffer;
+   uint64_t m_last_epoch_index = 0;
+
+   UdpTransmitterStatistics m_statistics;
+   uint64_t m_start_ns = 0;
+   double m_pacing_error_sum_ns = 0.0;
+   uint64_t m_nb_batches = 0;
+};
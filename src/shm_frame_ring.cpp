@@ -0,0 +1,439 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "pixel_conversion.h"
+#include "shm_frame_ring.h"
+#include "tools.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "the ring atomics must be lock-free to be shared between processes");
+
+namespace
+{
+   const uint64_t ring_alignment = 4096;
+
+   uint64_t round_up(uint64_t value, uint64_t multiple)
+   {
+      return (value + multiple - 1) / multiple * multiple;
+   }
+
+   void copy_format_string(char* destination, size_t destination_size, const std::string& value)
+   {
+      const size_t size = std::min(value.size(), destination_size - 1);
+      std::memcpy(destination, value.data(), size);
+      destination[size] = '\0';
+   }
+
+   std::string trim(const std::string& value)
+   {
+      const size_t begin = value.find_first_not_of(" \t\r");
+      if (begin == std::string::npos)
+         return "";
+      return value.substr(begin, value.find_last_not_of(" \t\r") - begin + 1);
+   }
+}
+
+ShmFrameRingWriter::~ShmFrameRingWriter()
+{
+   close();
+}
+
+bool ShmFrameRingWriter::create(const std::string& name, uint32_t nb_slots, uint64_t max_frame_size)
+{
+   close();
+
+#if defined(_WIN32)
+   (void)name;
+   (void)nb_slots;
+   (void)max_frame_size;
+   std::cout << "The shared-memory frame ring is only available on POSIX systems" << std::endl;
+   return false;
+#else
+   // The slot of the oldest frame is being overwritten while a new frame is published: 2 slots at least
+   if (nb_slots < 2 || !max_frame_size)
+   {
+      std::cout << "Invalid shared-memory frame ring: " << nb_slots << " slots of " << max_frame_size << " bytes"
+                << std::endl;
+      return false;
+   }
+
+   const uint64_t slot_offset = round_up(sizeof(ShmFrameRingHeader), ring_alignment);
+   const uint64_t frame_offset = round_up(sizeof(ShmFrameSlotHeader), ring_alignment);
+   const uint64_t slot_stride = frame_offset + round_up(max_frame_size, ring_alignment);
+   const uint64_t memory_size = slot_offset + nb_slots * slot_stride;
+
+   // A ring left by a previous run is replaced, its consumers keep their mapping until they detach
+   shm_unlink(name.c_str());
+   const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+   if (fd < 0)
+   {
+      std::cout << "Error creating the shared memory " << name << ": " << std::strerror(errno) << std::endl;
+      return false;
+   }
+   if (ftruncate(fd, static_cast<off_t>(memory_size)) != 0)
+   {
+      std::cout << "Error sizing the shared memory " << name << ": " << std::strerror(errno) << std::endl;
+      ::close(fd);
+      shm_unlink(name.c_str());
+      return false;
+   }
+
+   int flags = MAP_SHARED;
+#if defined(__linux__)
+   // The pages are faulted in now rather than by the first frames
+   flags |= MAP_POPULATE;
+#endif
+   void* memory = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, flags, fd, 0);
+   ::close(fd);
+   if (memory == MAP_FAILED)
+   {
+      std::cout << "Error mapping the shared memory " << name << ": " << std::strerror(errno) << std::endl;
+      shm_unlink(name.c_str());
+      return false;
+   }
+
+   // The object is zero-filled: every slot sequence is 0, no frame is published
+   m_name = name;
+   m_memory = static_cast<uint8_t*>(memory);
+   m_memory_size = memory_size;
+   m_header = reinterpret_cast<ShmFrameRingHeader*>(m_memory);
+   m_header->version = shm_frame_ring_version;
+   m_header->nb_slots = nb_slots;
+   m_header->producer_pid = static_cast<uint32_t>(getpid());
+   m_header->slot_offset = slot_offset;
+   m_header->slot_stride = slot_stride;
+   m_header->frame_offset = frame_offset;
+   m_header->max_frame_size = max_frame_size;
+   m_header->next_sequence.store(0, std::memory_order_relaxed);
+   m_header->state.store(static_cast<uint32_t>(ShmFrameRingState::live), std::memory_order_relaxed);
+   m_header->magic.store(shm_frame_ring_magic, std::memory_order_release);
+   m_next_sequence = 0;
+
+   std::cout << "Shared-memory frame ring " << name << ": " << nb_slots << " slots of " << max_frame_size
+             << " bytes" << std::endl;
+   return true;
+#endif
+}
+
+void ShmFrameRingWriter::set_format(const ShmFrameFormat& format)
+{
+   m_format = format;
+}
+
+bool ShmFrameRingWriter::publish(const uint8_t* frame, uint64_t frame_size, uint64_t slot_index)
+{
+   if (!m_header)
+      return false;
+   if (frame_size > m_header->max_frame_size)
+   {
+      m_statistics.nb_rejected_frames++;
+      return false;
+   }
+
+   const auto begin = std::chrono::steady_clock::now();
+   const uint64_t sequence = m_next_sequence++;
+   uint8_t* slot_memory = m_memory + m_header->slot_offset + (sequence % m_header->nb_slots) * m_header->slot_stride;
+   ShmFrameSlotHeader* slot = reinterpret_cast<ShmFrameSlotHeader*>(slot_memory);
+
+   // The odd sequence tells the consumers reading the previous frame of the slot that it is being overwritten
+   slot->sequence.store(2 * sequence + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   slot->capture_time_ns = static_cast<uint64_t>(
+       std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+           .count());
+   slot->slot_index = slot_index;
+   slot->frame_size = frame_size;
+   slot->format = m_format;
+   std::memcpy(slot_memory + m_header->frame_offset, frame, frame_size);
+
+   slot->sequence.store(2 * sequence + 2, std::memory_order_release);
+   m_header->next_sequence.store(sequence + 1, std::memory_order_release);
+
+   const double publish_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+   m_publish_sum_us += publish_us;
+   m_statistics.nb_frames++;
+   m_statistics.mean_publish_us = m_publish_sum_us / m_statistics.nb_frames;
+   m_statistics.max_publish_us = std::max(m_statistics.max_publish_us, publish_us);
+   return true;
+}
+
+void ShmFrameRingWriter::print_statistics() const
+{
+   if (!m_header)
+      return;
+
+   std::cout << "Shared-memory output " << m_name << ": " << m_statistics.nb_frames << " frames published - "
+             << m_statistics.nb_rejected_frames << " rejected - publish mean " << std::fixed << std::setprecision(1)
+             << m_statistics.mean_publish_us << " us, max " << m_statistics.max_publish_us << " us"
+             << std::defaultfloat << std::endl;
+}
+
+void ShmFrameRingWriter::close()
+{
+#if !defined(_WIN32)
+   if (!m_header)
+      return;
+
+   m_header->state.store(static_cast<uint32_t>(ShmFrameRingState::closed), std::memory_order_release);
+   munmap(m_memory, m_memory_size);
+   shm_unlink(m_name.c_str());
+#endif
+   m_memory = nullptr;
+   m_memory_size = 0;
+   m_header = nullptr;
+}
+
+ShmFrameRingReader::~ShmFrameRingReader()
+{
+   close();
+}
+
+bool ShmFrameRingReader::open(const std::string& name, bool report_errors)
+{
+   close();
+
+#if defined(_WIN32)
+   (void)name;
+   (void)report_errors;
+   std::cout << "The shared-memory frame ring is only available on POSIX systems" << std::endl;
+   return false;
+#else
+   const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+   if (fd < 0)
+   {
+      if (report_errors)
+         std::cout << "Error opening the shared memory " << name << ": " << std::strerror(errno) << std::endl;
+      return false;
+   }
+   struct stat status;
+   if (fstat(fd, &status) != 0 || static_cast<uint64_t>(status.st_size) < sizeof(ShmFrameRingHeader))
+   {
+      if (report_errors)
+         std::cout << "The shared memory " << name << " is not a frame ring" << std::endl;
+      ::close(fd);
+      return false;
+   }
+
+   const uint64_t memory_size = static_cast<uint64_t>(status.st_size);
+   void* memory = mmap(nullptr, memory_size, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (memory == MAP_FAILED)
+   {
+      if (report_errors)
+         std::cout << "Error mapping the shared memory " << name << ": " << std::strerror(errno) << std::endl;
+      return false;
+   }
+
+   const ShmFrameRingHeader* header = static_cast<const ShmFrameRingHeader*>(memory);
+   if (header->magic.load(std::memory_order_acquire) != shm_frame_ring_magic ||
+       header->version != shm_frame_ring_version || header->nb_slots < 2 ||
+       header->frame_offset < sizeof(ShmFrameSlotHeader) ||
+       header->slot_stride < header->frame_offset + header->max_frame_size ||
+       header->slot_offset + header->nb_slots * header->slot_stride > memory_size)
+   {
+      if (report_errors)
+         std::cout << "The shared memory " << name << " is not a frame ring of version " << shm_frame_ring_version
+                   << " or is not initialized yet" << std::endl;
+      munmap(memory, memory_size);
+      return false;
+   }
+
+   m_memory = static_cast<uint8_t*>(memory);
+   m_memory_size = memory_size;
+   m_header = header;
+   m_next_sequence = m_header->next_sequence.load(std::memory_order_acquire);
+   m_last_sequence = 0;
+   m_statistics = {};
+   return true;
+#endif
+}
+
+void ShmFrameRingReader::close()
+{
+#if !defined(_WIN32)
+   if (m_memory)
+      munmap(m_memory, m_memory_size);
+#endif
+   m_memory = nullptr;
+   m_memory_size = 0;
+   m_header = nullptr;
+}
+
+ShmReadResult ShmFrameRingReader::read_next(uint8_t* destination, uint64_t capacity, ShmFrameInfo& info)
+{
+   return read_next(
+       [&](const uint8_t* frame, const ShmFrameInfo& frame_info) {
+          if (frame_info.frame_size > capacity)
+             return false;
+          std::memcpy(destination, frame, frame_info.frame_size);
+          return true;
+       },
+       info);
+}
+
+ShmReadResult ShmFrameRingReader::read_next(const ShmFrameConsumer& consumer, ShmFrameInfo& info)
+{
+   if (!m_header)
+      return ShmReadResult::closed;
+
+   // The state is read first: once the ring is closed, next_sequence does not move anymore
+   const bool is_closed =
+       m_header->state.load(std::memory_order_acquire) == static_cast<uint32_t>(ShmFrameRingState::closed);
+   const uint64_t next_sequence = m_header->next_sequence.load(std::memory_order_acquire);
+   if (m_next_sequence >= next_sequence)
+      return is_closed ? ShmReadResult::closed : ShmReadResult::no_frame;
+
+   // The slot of the oldest frame may already be overwritten by the next one
+   const uint64_t oldest_sequence = next_sequence >= m_header->nb_slots ? next_sequence - m_header->nb_slots + 1 : 0;
+   if (m_next_sequence < oldest_sequence)
+   {
+      m_statistics.nb_overruns += oldest_sequence - m_next_sequence;
+      m_next_sequence = oldest_sequence;
+   }
+
+   const uint64_t sequence = m_next_sequence++;
+   const ShmReadResult result = read_sequence(sequence, consumer, info);
+   if (result == ShmReadResult::frame)
+   {
+      m_last_sequence = sequence + 1;
+      m_statistics.nb_frames++;
+   }
+   return result;
+}
+
+ShmReadResult ShmFrameRingReader::read_last(const ShmFrameConsumer& consumer, ShmFrameInfo& info)
+{
+   if (!m_header)
+      return ShmReadResult::closed;
+   if (!m_last_sequence)
+      return ShmReadResult::no_frame;
+   return read_sequence(m_last_sequence - 1, consumer, info);
+}
+
+uint32_t ShmFrameRingReader::get_producer_pid() const
+{
+   return m_header ? m_header->producer_pid : 0;
+}
+
+ShmReadResult ShmFrameRingReader::read_sequence(uint64_t sequence, const ShmFrameConsumer& consumer,
+                                                ShmFrameInfo& info)
+{
+   const ShmFrameSlotHeader* slot = get_slot(sequence);
+   const uint64_t slot_sequence = slot->sequence.load(std::memory_order_acquire);
+   if (slot_sequence != 2 * sequence + 2)
+   {
+      m_statistics.nb_overruns++;
+      return ShmReadResult::overrun;
+   }
+
+   info.sequence = sequence;
+   info.capture_time_ns = slot->capture_time_ns;
+   info.slot_index = slot->slot_index;
+   info.frame_size = std::min(slot->frame_size, m_header->max_frame_size);
+   info.format = slot->format;
+   const bool is_accepted = consumer(reinterpret_cast<const uint8_t*>(slot) + m_header->frame_offset, info);
+
+   // The frame is only valid if the producer did not start overwriting the slot meanwhile
+   std::atomic_thread_fence(std::memory_order_acquire);
+   if (slot->sequence.load(std::memory_order_relaxed) != slot_sequence)
+   {
+      m_statistics.nb_overruns++;
+      return ShmReadResult::overrun;
+   }
+   if (!is_accepted)
+   {
+      m_statistics.nb_rejected++;
+      return ShmReadResult::rejected;
+   }
+   return ShmReadResult::frame;
+}
+
+uint64_t ShmFrameRingReader::get_max_frame_size() const
+{
+   return m_header ? m_header->max_frame_size : 0;
+}
+
+const ShmFrameSlotHeader* ShmFrameRingReader::get_slot(uint64_t sequence) const
+{
+   return reinterpret_cast<const ShmFrameSlotHeader*>(m_memory + m_header->slot_offset +
+                                                      (sequence % m_header->nb_slots) * m_header->slot_stride);
+}
+
+ShmFrameFormat make_shm_frame_format(const VideoStandardInfo& video_standard_info, const std::string& sdp,
+                                     ShmPixelLayout layout)
+{
+   ShmFrameFormat format;
+   format.frame_width = video_standard_info.frame_width;
+   format.frame_height = video_standard_info.frame_height;
+   format.rate_numerator = video_standard_info.frame_rate * (video_standard_info.is_us ? 1000 : 1);
+   format.rate_denominator = video_standard_info.is_us ? 1001 : 1;
+   format.interlaced = video_standard_info.interlaced;
+   format.layout = static_cast<uint32_t>(layout);
+   format.line_size = video_standard_info.frame_width *
+                      (layout == ShmPixelLayout::yuv422_8 ? yuv422_8_bytes_per_pixel : yuv422_10_bytes_per_pixel);
+
+   // ST 2110-20 defaults, overridden by the format parameters of the SDP
+   std::string sampling = "YCbCr-4:2:2", colorimetry = "BT709", transfer_characteristic = "SDR";
+   format.depth = 10;
+
+   std::istringstream lines(sdp);
+   std::string line;
+   while (std::getline(lines, line))
+   {
+      if (line.compare(0, 7, "a=fmtp:") != 0)
+         continue;
+
+      // a=fmtp:<payload type> <parameter>=<value>; <parameter>=<value>; ...
+      std::istringstream parameters(line.substr(std::min(line.size(), line.find(' '))));
+      std::string parameter;
+      while (std::getline(parameters, parameter, ';'))
+      {
+         const size_t separator = parameter.find('=');
+         if (separator == std::string::npos)
+            continue;
+         const std::string name = trim(parameter.substr(0, separator));
+         const std::string value = trim(parameter.substr(separator + 1));
+         if (name == "sampling")
+            sampling = value;
+         else if (name == "colorimetry")
+            colorimetry = value;
+         else if (name == "TCS")
+            transfer_characteristic = value;
+         else if (name == "depth")
+            format.depth = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+      }
+      break;
+   }
+
+   copy_format_string(format.sampling, sizeof(format.sampling), sampling);
+   copy_format_string(format.colorimetry, sizeof(format.colorimetry), colorimetry);
+   copy_format_string(format.transfer_characteristic, sizeof(format.transfer_characteristic), transfer_characteristic);
+   return format;
+}
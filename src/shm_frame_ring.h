@@ -0,0 +1,283 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file shm_frame_ring.h
+   @brief This file contains the ring of video frames shared with other processes of the host through POSIX shared
+   memory.
+
+   @detail The ring has a single producer and any number of consumers. The producer never waits for the consumers:
+   every slot is protected by a sequence number (odd while the frame is written, even once it is published) that the
+   consumers check before and after reading the frame. A consumer that falls more than the ring behind skips the
+   frames it missed and counts them as overruns. The consumers map the ring read-only, so they may attach and detach
+   at any time without the producer noticing.
+
+   Layout: a ShmFrameRingHeader, then nb_slots slots of slot_stride bytes from slot_offset, each made of a
+   ShmFrameSlotHeader and, frame_offset bytes after it, the frame data.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+inline constexpr uint32_t shm_frame_ring_magic = 0x52465653 /*! "SVFR" */;
+inline constexpr uint32_t shm_frame_ring_version = 1;
+
+/*!
+   @brief Layout of the pixels of a frame in the ring
+*/
+enum class ShmPixelLayout : uint32_t
+{
+   unknown = 0,
+   yuv422_8 = 1 /*! VHD_BUFPACK_VIDEO_YUV422_8: Cb Y0 Cr Y1 on one byte per component */,
+   yuv422_10 = 2 /*! VHD_BUFPACK_VIDEO_YUV422_10: Cb Y0 Cr Y1 on 16-bit little-endian words, MSB aligned */,
+};
+
+enum class ShmFrameRingState : uint32_t
+{
+   live = 1 /*! The producer publishes frames */,
+   closed = 2 /*! The producer is gone, no more frame will be published */,
+};
+
+/*!
+   @brief Format of a frame, derived from the SDP of the stream it was received from
+*/
+struct ShmFrameFormat
+{
+   uint32_t frame_width = 0;
+   uint32_t frame_height = 0;
+   uint32_t rate_numerator = 0 /*! Frame rate as a fraction, field rate for interlaced video */;
+   uint32_t rate_denominator = 1;
+   uint32_t interlaced = 0;
+   uint32_t layout = 0 /*! ShmPixelLayout of the frame */;
+   uint32_t line_size = 0 /*! Bytes of a line of the frame */;
+   uint32_t depth = 0 /*! Bits per component of the stream */;
+   char sampling[16] = {} /*! Sampling of the stream, e.g. "YCbCr-4:2:2" */;
+   char colorimetry[16] = {} /*! Colorimetry of the stream, e.g. "BT709" */;
+   char transfer_characteristic[16] = {} /*! Transfer characteristic system of the stream, e.g. "SDR" */;
+};
+
+struct ShmFrameRingHeader
+{
+   std::atomic<uint32_t> magic /*! shm_frame_ring_magic, written last when the ring is created */;
+   uint32_t version;
+   uint32_t nb_slots;
+   uint32_t producer_pid;
+   uint64_t slot_offset /*! Offset of the first slot from the start of the ring */;
+   uint64_t slot_stride /*! Bytes between two slots */;
+   uint64_t frame_offset /*! Offset of the frame data from the start of a slot */;
+   uint64_t max_frame_size;
+   alignas(64) std::atomic<uint64_t> next_sequence /*! Sequence of the next frame to be published */;
+   std::atomic<uint32_t> state /*! ShmFrameRingState of the ring */;
+};
+
+struct ShmFrameSlotHeader
+{
+   std::atomic<uint64_t> sequence /*! 2 * frame sequence + 1 while the frame is written, + 2 once published */;
+   uint64_t capture_time_ns /*! Time the frame was received, nanoseconds since the UNIX epoch */;
+   uint64_t slot_index /*! Index of the slot the frame was received in */;
+   uint64_t frame_size;
+   ShmFrameFormat format;
+};
+
+/*!
+   @brief Frame read from the ring
+*/
+struct ShmFrameInfo
+{
+   uint64_t sequence = 0;
+   uint64_t capture_time_ns = 0;
+   uint64_t slot_index = 0;
+   uint64_t frame_size = 0;
+   ShmFrameFormat format;
+};
+
+enum class ShmReadResult
+{
+   frame /*! A frame was read */,
+   no_frame /*! No new frame yet */,
+   overrun /*! The producer overwrote the frame while it was read, or before, it is skipped */,
+   rejected /*! The frame does not fit in the destination, or its consumer refused it, it is skipped */,
+   closed /*! The producer closed the ring and every frame was read */,
+};
+
+/*!
+   @brief Consumer of a frame read in place from the ring, returns false to refuse the frame
+
+   @detail The frame data is only valid if read_next() returns ShmReadResult::frame afterwards: the consumer may
+   see a frame being overwritten by the producer.
+*/
+using ShmFrameConsumer = std::function<bool(const uint8_t* frame, const ShmFrameInfo& info)>;
+
+struct ShmFrameRingWriterStatistics
+{
+   uint64_t nb_frames = 0 /*! Frames published */;
+   uint64_t nb_rejected_frames = 0 /*! Frames larger than the slots */;
+   double mean_publish_us = 0.0 /*! Time to copy and publish a frame */;
+   double max_publish_us = 0.0;
+};
+
+struct ShmFrameRingReaderStatistics
+{
+   uint64_t nb_frames = 0 /*! Frames read */;
+   uint64_t nb_overruns = 0 /*! Frames lost because the producer overwrote them before or while they were read */;
+   uint64_t nb_rejected = 0 /*! Frames skipped because they did not fit in the destination or were refused */;
+};
+
+/*!
+   @brief Producer side of the ring: creates the shared memory object and publishes the frames
+*/
+class ShmFrameRingWriter
+{
+public:
+   ShmFrameRingWriter() = default;
+
+   /*!
+      @brief Mark the ring as closed for the consumers and remove its name
+   */
+   ~ShmFrameRingWriter();
+
+   ShmFrameRingWriter(const ShmFrameRingWriter&) = delete;
+   ShmFrameRingWriter& operator=(const ShmFrameRingWriter&) = delete;
+
+   /*!
+      @brief Create the ring, replacing any ring left with the same name
+
+      @returns true if the ring is created
+   */
+   bool create(const std::string& name /*!< [in] POSIX shared memory name, e.g. "/nmos_vhd_rx"*/,
+               uint32_t nb_slots /*!< [in] Frames kept in the ring*/,
+               uint64_t max_frame_size /*!< [in] Largest frame that will be published*/);
+
+   bool is_open() const { return m_header != nullptr; }
+
+   /*!
+      @brief Set the format of the frames published from now on
+   */
+   void set_format(const ShmFrameFormat& format /*!< [in] Format of the next frames*/);
+
+   /*!
+      @brief Copy a frame into the next slot of the ring and publish it, without waiting for the consumers
+
+      @returns false if the frame is larger than the slots
+   */
+   bool publish(const uint8_t* frame /*!< [in] Frame data*/,
+                uint64_t frame_size /*!< [in] Bytes of the frame*/,
+                uint64_t slot_index /*!< [in] Index of the slot the frame was received in*/);
+
+   ShmFrameRingWriterStatistics get_statistics() const { return m_statistics; }
+   void print_statistics() const;
+
+private:
+   void close();
+
+   std::string m_name;
+   uint8_t* m_memory = nullptr;
+   uint64_t m_memory_size = 0;
+   ShmFrameRingHeader* m_header = nullptr;
+   ShmFrameFormat m_format;
+   uint64_t m_next_sequence = 0;
+   double m_publish_sum_us = 0.0;
+   ShmFrameRingWriterStatistics m_statistics;
+};
+
+/*!
+   @brief Consumer side of the ring: maps it read-only and follows the frames published
+*/
+class ShmFrameRingReader
+{
+public:
+   ShmFrameRingReader() = default;
+   ~ShmFrameRingReader();
+
+   ShmFrameRingReader(const ShmFrameRingReader&) = delete;
+   ShmFrameRingReader& operator=(const ShmFrameRingReader&) = delete;
+
+   /*!
+      @brief Attach to a ring, the first frame read is the next one published
+
+      @returns true if the ring exists and is valid
+   */
+   bool open(const std::string& name /*!< [in] POSIX shared memory name of the ring*/,
+             bool report_errors = true /*!< [in] Print why the ring could not be opened*/);
+
+   /*!
+      @brief Detach from the ring
+   */
+   void close();
+
+   bool is_open() const { return m_header != nullptr; }
+
+   /*!
+      @brief Copy the next frame of the ring, without waiting for it
+
+      @detail After an overrun, the next frame read is the oldest one the producer is not about to overwrite.
+   */
+   ShmReadResult read_next(uint8_t* destination /*!< [out] Frame data*/,
+                           uint64_t capacity /*!< [in] Bytes available in destination*/,
+                           ShmFrameInfo& info /*!< [out] Description of the frame*/);
+
+   /*!
+      @brief Hand the next frame of the ring to a consumer that reads it in place, without waiting for it
+   */
+   ShmReadResult read_next(const ShmFrameConsumer& consumer /*!< [in] Copies or converts the frame*/,
+                           ShmFrameInfo& info /*!< [out] Description of the frame*/);
+
+   /*!
+      @brief Hand the last frame read again to a consumer, while the producer has not overwritten it
+
+      @returns ShmReadResult::no_frame if no frame was read yet
+   */
+   ShmReadResult read_last(const ShmFrameConsumer& consumer /*!< [in] Copies or converts the frame*/,
+                           ShmFrameInfo& info /*!< [out] Description of the frame*/);
+
+   /*!
+      @brief Largest frame of the ring, to size the destination of read_next()
+   */
+   uint64_t get_max_frame_size() const;
+
+   /*!
+      @brief Process that created the ring, 0 if the reader is not open
+   */
+   uint32_t get_producer_pid() const;
+
+   ShmFrameRingReaderStatistics get_statistics() const { return m_statistics; }
+
+private:
+   const ShmFrameSlotHeader* get_slot(uint64_t sequence) const;
+   ShmReadResult read_sequence(uint64_t sequence, const ShmFrameConsumer& consumer, ShmFrameInfo& info);
+
+   uint8_t* m_memory = nullptr;
+   uint64_t m_memory_size = 0;
+   const ShmFrameRingHeader* m_header = nullptr;
+   uint64_t m_next_sequence = 0;
+   uint64_t m_last_sequence = 0 /*! Sequence of the last frame read + 1, 0 if none */;
+   ShmFrameRingReaderStatistics m_statistics;
+};
+
+struct VideoStandardInfo;
+
+/*!
+   @brief Format of the frames of a stream, from its video standard and the format parameters of its SDP
+*/
+ShmFrameFormat make_shm_frame_format(const VideoStandardInfo& video_standard_info /*!< [in] Video standard*/,
+                                     const std::string& sdp /*!< [in] SDP of the stream*/,
+                                     ShmPixelLayout layout /*!< [in] Layout of the frames in the ring*/);
@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && !defined(__APPLE__)
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include "../shm_frame_ring.h"
+
+namespace
+{
+   const char* to_string(ShmPixelLayout layout)
+   {
+      switch (layout)
+      {
+      case ShmPixelLayout::yuv422_8: return "YUV 4:2:2 8-bit";
+      case ShmPixelLayout::yuv422_10: return "YUV 4:2:2 10-bit";
+      default: return "unknown layout";
+      }
+   }
+
+   void print_format(const ShmFrameFormat& format)
+   {
+      std::cout << "Format: " << format.frame_width << "x" << format.frame_height
+                << (format.interlaced ? "i " : "p ") << format.rate_numerator << "/" << format.rate_denominator
+                << " - " << format.sampling << " " << format.depth << "-bit " << format.colorimetry << " "
+                << format.transfer_characteristic << " - " << to_string(static_cast<ShmPixelLayout>(format.layout))
+                << ", " << format.line_size << " bytes per line" << std::endl;
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   if (argc < 2)
+   {
+      std::cout << "Usage: " << argv[0] << " <shared memory name> [--duration-s <s>] [--slow-ms <ms>]"
+                << " [--dump <file>]" << std::endl;
+      return -1;
+   }
+
+   const std::string name = argv[1];
+   uint32_t duration_s = 0;
+   uint32_t slow_ms = 0;
+   std::string dump_path;
+   for (int i = 2; i < argc; i++)
+   {
+      const std::string argument = argv[i];
+      if (argument == "--duration-s" && i + 1 < argc)
+         duration_s = std::stoul(argv[++i]);
+      else if (argument == "--slow-ms" && i + 1 < argc)
+         slow_ms = std::stoul(argv[++i]);
+      else if (argument == "--dump" && i + 1 < argc)
+         dump_path = argv[++i];
+      else
+      {
+         std::cout << "Unknown argument " << argument << std::endl;
+         return -1;
+      }
+   }
+
+   std::ofstream dump;
+   if (!dump_path.empty())
+   {
+      dump.open(dump_path, std::ios::binary | std::ios::trunc);
+      if (!dump)
+      {
+         std::cout << "Error when opening " << dump_path << std::endl;
+         return -1;
+      }
+   }
+
+   ShmFrameRingReader reader;
+   if (!reader.open(name))
+      return -1;
+
+   std::vector<uint8_t> frame(reader.get_max_frame_size());
+   ShmFrameInfo info;
+   ShmFrameFormat format;
+   const auto start = std::chrono::steady_clock::now();
+   auto report_time = start + std::chrono::seconds(1);
+   uint64_t nb_report_frames = 0;
+   double latency_sum_ms = 0.0;
+
+   while (!duration_s || std::chrono::steady_clock::now() - start < std::chrono::seconds(duration_s))
+   {
+      const ShmReadResult result = reader.read_next(frame.data(), frame.size(), info);
+      if (result == ShmReadResult::closed)
+      {
+         std::cout << "The producer closed the ring" << std::endl;
+         break;
+      }
+      if (result == ShmReadResult::frame)
+      {
+         if (std::memcmp(&format, &info.format, sizeof(format)) != 0)
+         {
+            format = info.format;
+            print_format(format);
+         }
+         nb_report_frames++;
+         latency_sum_ms += (std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::system_clock::now().time_since_epoch())
+                                .count() -
+                            static_cast<int64_t>(info.capture_time_ns)) /
+                           1e6;
+         if (dump.is_open())
+            dump.write(reinterpret_cast<const char*>(frame.data()), info.frame_size);
+         if (slow_ms)
+            std::this_thread::sleep_for(std::chrono::milliseconds(slow_ms));
+      }
+      else if (result == ShmReadResult::no_frame)
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+      if (std::chrono::steady_clock::now() >= report_time)
+      {
+         const ShmFrameRingReaderStatistics statistics = reader.get_statistics();
+         std::cout << "Frames: " << statistics.nb_frames << " (" << nb_report_frames << "/s) - overruns: "
+                   << statistics.nb_overruns << " - latency from capture: " << std::fixed << std::setprecision(2)
+                   << (nb_report_frames ? latency_sum_ms / nb_report_frames : 0.0) << " ms" << std::defaultfloat
+                   << std::endl;
+         nb_report_frames = 0;
+         latency_sum_ms = 0.0;
+         report_time += std::chrono::seconds(1);
+      }
+   }
+
+   const ShmFrameRingReaderStatistics statistics = reader.get_statistics();
+   std::cout << statistics.nb_frames << " frames read - " << statistics.nb_overruns << " overruns - "
+             << statistics.nb_rejected << " rejected" << std::endl;
+   return 0;
+}
@@ -0,0 +1,630 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "simulated_board.h"
+#include "tools.h"
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Ip_Board.h"
+#include "VideoMasterHD/VideoMasterHD_Ip_ST2110_20.h"
+#else
+#include "VideoMasterHD_Ip_Board.h"
+#include "VideoMasterHD_Ip_ST2110_20.h"
+#endif
+
+namespace
+{
+   const ULONG default_io_timeout_ms = 100;
+   const ULONG default_buffer_queue_depth = 4;
+
+   uint32_t get_bytes_per_pixel(ULONG buffer_packing)
+   {
+      switch (buffer_packing)
+      {
+      case VHD_BUFPACK_VIDEO_YUV422_8: return 2;
+      case VHD_BUFPACK_VIDEO_RGB_24:
+      case VHD_BUFPACK_VIDEO_YUV444_8: return 3;
+      default: return 4; // 10-bit components are stored on 16 bits, see St2110_20Depacketizer
+      }
+   }
+
+   uint64_t to_ns(std::chrono::steady_clock::duration duration)
+   {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+   }
+
+   bool is_transmission_stream(ULONG stream_type)
+   {
+      return stream_type == VHD_ST_TX0 || stream_type == VHD_ST_TX1 || stream_type == VHD_ST_TX2 ||
+             stream_type == VHD_ST_TX3;
+   }
+
+   void update_max(std::atomic<uint64_t>& maximum, uint64_t value)
+   {
+      uint64_t current = maximum.load(std::memory_order_relaxed);
+      while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+         ;
+   }
+}
+
+struct SimulatedBoardBackend::Board
+{
+   ULONG index;
+   std::unordered_map<ULONG, ULONG> properties;
+   std::unordered_map<ULONG, ULONG> ethernet_port_properties /*! Keyed by port << 16 | property */;
+   std::vector<ULONG> multicast_groups;
+   VHD_PTP_CONFIGURATION ptp_configuration = {};
+   std::chrono::steady_clock::time_point ptp_configuration_time /*! Start of the PTP lock sequence */;
+   std::mt19937_64 random;
+   bool stalled = false /*! A stall until the board is reopened was injected */;
+};
+
+struct SimulatedBoardBackend::Slot
+{
+   Stream* stream;
+   std::vector<uint8_t> buffer;
+   std::chrono::steady_clock::time_point lock_time;
+};
+
+struct SimulatedBoardBackend::Stream
+{
+   Board* board;
+   ULONG type;
+   std::unordered_map<ULONG, ULONG> properties;
+   bool started = false;
+
+   // Set when the stream starts, only used by the slot loop afterwards
+   std::vector<Slot> slots;
+   std::chrono::nanoseconds period{0};
+   std::chrono::nanoseconds io_timeout{0};
+   std::chrono::steady_clock::time_point start_time;
+   std::chrono::steady_clock::time_point next_slot_time;
+   uint64_t nb_datagrams_per_slot = 0;
+   uint64_t nb_produced_slots = 0;
+   uint64_t nb_locked_slots = 0;
+   uint64_t nb_slots_before_stall = 0 /*! Slots until the injected stall, 0 once stalled or without stall */;
+   bool stalled = false;
+   std::mt19937_64 random;
+
+   std::atomic<uint64_t> slots_count{0};
+   std::atomic<uint64_t> slots_dropped{0};
+   std::atomic<uint64_t> buffer_filling{0};
+
+   bool drop_next_slot(const SimulatedBoardConfig& config)
+   {
+      nb_produced_slots++;
+      if (config.drop_every && nb_produced_slots % config.drop_every == 0)
+         return true;
+      return config.drop_probability > 0.0 &&
+             std::uniform_real_distribution<double>(0.0, 1.0)(random) < config.drop_probability;
+   }
+
+   bool is_stalled() const { return stalled || board->stalled; }
+
+   void on_slot_locked(const SimulatedBoardConfig& config)
+   {
+      if (!nb_slots_before_stall || --nb_slots_before_stall)
+         return;
+      if (config.stall == SimulatedStall::until_board_reopen)
+         board->stalled = true;
+      else
+         stalled = true;
+   }
+};
+
+SimulatedBoardBackend::SimulatedBoardBackend(const SimulatedBoardConfig& config) : m_config(config)
+{
+}
+
+SimulatedBoardBackend::~SimulatedBoardBackend() = default;
+
+void SimulatedBoardBackend::wait(std::chrono::nanoseconds duration) const
+{
+   if (duration.count() > 0)
+      std::this_thread::sleep_for(duration);
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::get_api_info(ULONG* dll_version, ULONG* nb_boards)
+{
+   if (dll_version)
+      *dll_version = 0;
+   if (nb_boards)
+      *nb_boards = m_config.nb_boards;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::open_board_handle(ULONG board_index, HANDLE* board_handle, HANDLE, ULONG)
+{
+   if (board_index >= m_config.nb_boards || !board_handle)
+      return VHDERR_BADARG;
+
+   auto board = std::make_unique<Board>();
+   board->index = board_index;
+   board->ethernet_port_properties[VHD_IP_BRD_ETHERNETPORT_ETH_0 << 16 | VHD_IP_BRD_EP_FACTORY_MAC_ADDR_MSW] = 0x0200;
+   board->ethernet_port_properties[VHD_IP_BRD_ETHERNETPORT_ETH_0 << 16 | VHD_IP_BRD_EP_FACTORY_MAC_ADDR_LSW] =
+       board_index + 1;
+   board->ptp_configuration_time = std::chrono::steady_clock::now();
+   board->random.seed(m_config.seed * 1000 + board_index);
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   *board_handle = board.get();
+   m_boards.push_back(std::move(board));
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::close_board_handle(HANDLE board_handle)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   auto board = std::find_if(m_boards.begin(), m_boards.end(),
+                             [&](const std::unique_ptr<Board>& b) { return b.get() == board_handle; });
+   if (board == m_boards.end())
+      return VHDERR_INVALIDHANDLE;
+
+   m_streams.erase(std::remove_if(m_streams.begin(), m_streams.end(),
+                                  [&](const std::unique_ptr<Stream>& s) { return s->board == board->get(); }),
+                   m_streams.end());
+   m_boards.erase(board);
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::set_board_property(HANDLE board_handle, ULONG property, ULONG value)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   static_cast<Board*>(board_handle)->properties[property] = value;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::get_board_property(HANDLE board_handle, ULONG property, ULONG* value)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   const auto& properties = static_cast<Board*>(board_handle)->properties;
+   auto found = properties.find(property);
+   *value = found != properties.end() ? found->second : 0;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::get_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property,
+                                                                ULONG* value)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   const auto& properties = static_cast<Board*>(board_handle)->ethernet_port_properties;
+   auto found = properties.find(port << 16 | property);
+   *value = found != properties.end() ? found->second : 0;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::set_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property,
+                                                                ULONG value)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   static_cast<Board*>(board_handle)->ethernet_port_properties[port << 16 | property] = value;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::enable_dhcp(HANDLE board_handle, ULONG port)
+{
+   return set_ethernet_port_property(board_handle, port, VHD_IP_BRD_EP_DHCP_ENABLED, 1);
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::disable_dhcp(HANDLE board_handle, ULONG port)
+{
+   return set_ethernet_port_property(board_handle, port, VHD_IP_BRD_EP_DHCP_ENABLED, 0);
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::join_multicast_group(HANDLE board_handle, ULONG, ULONG group)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   static_cast<Board*>(board_handle)->multicast_groups.push_back(group);
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::leave_multicast_group(HANDLE board_handle, ULONG, ULONG group)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   auto& groups = static_cast<Board*>(board_handle)->multicast_groups;
+   auto found = std::find(groups.begin(), groups.end(), group);
+   if (found == groups.end())
+      return VHDERR_BADARG;
+   groups.erase(found);
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::get_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION* configuration)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   *configuration = static_cast<Board*>(board_handle)->ptp_configuration;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::set_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION configuration)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   Board* board = static_cast<Board*>(board_handle);
+   board->ptp_configuration = configuration;
+   // A new configuration restarts the lock sequence, as the port goes back through the listening state
+   board->ptp_configuration_time = std::chrono::steady_clock::now();
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::get_ptp_port_state(HANDLE board_handle, VHD_PTP_PORT_STATE* state,
+                                                        BOOL32* locked)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   const auto elapsed = std::chrono::steady_clock::now() - static_cast<Board*>(board_handle)->ptp_configuration_time;
+   if (elapsed < m_config.ptp_lock_time / 10)
+      *state = VHD_PTP_PORT_STATE_INITIALIZING;
+   else if (elapsed < m_config.ptp_lock_time)
+      *state = VHD_PTP_PORT_STATE_LISTENING;
+   else
+      *state = VHD_PTP_PORT_STATE_SLAVE;
+   *locked = *state == VHD_PTP_PORT_STATE_SLAVE;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::get_ptp_offset(HANDLE board_handle, LONG* offset_sec, LONG* offset_nsec)
+{
+   if (!board_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   Board* board = static_cast<Board*>(board_handle);
+   const auto elapsed = std::chrono::steady_clock::now() - board->ptp_configuration_time;
+
+   double offset_ns = static_cast<double>(m_config.ptp_initial_offset_ns);
+   if (elapsed >= m_config.ptp_lock_time)
+   {
+      const double slave_time_ms =
+          std::chrono::duration<double, std::milli>(elapsed - m_config.ptp_lock_time).count();
+      const double settling_time_ms = std::max(1.0, static_cast<double>(m_config.ptp_settling_time.count()));
+      offset_ns *= std::exp(-slave_time_ms / settling_time_ms);
+      if (m_config.ptp_jitter_ns > 0)
+         offset_ns += std::uniform_real_distribution<double>(-1.0, 1.0)(board->random) * m_config.ptp_jitter_ns;
+   }
+
+   const int64_t offset = static_cast<int64_t>(std::llround(offset_ns));
+   *offset_sec = static_cast<LONG>(offset / 1000000000);
+   *offset_nsec = static_cast<LONG>(offset % 1000000000);
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::open_stream_handle(HANDLE board_handle, ULONG stream_type, ULONG,
+                                                        BOOL32* setup_lock, HANDLE* stream_handle, HANDLE)
+{
+   if (!board_handle || !stream_handle)
+      return VHDERR_INVALIDHANDLE;
+
+   wait(m_config.reconfiguration_latency);
+
+   auto stream = std::make_unique<Stream>();
+   stream->board = static_cast<Board*>(board_handle);
+   stream->type = stream_type;
+   stream->properties[VHD_CORE_SP_IO_TIMEOUT] = default_io_timeout_ms;
+   stream->properties[VHD_CORE_SP_BUFFERQUEUE_DEPTH] = default_buffer_queue_depth;
+   stream->properties[VHD_CORE_SP_BUFFER_PACKING] = VHD_BUFPACK_VIDEO_YUV422_8;
+   if (m_config.stall != SimulatedStall::none)
+      stream->nb_slots_before_stall = m_config.stall_after_slots;
+   if (setup_lock)
+      *setup_lock = false;
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   stream->random.seed(m_config.seed * 1000 + 500 + m_nb_opened_streams++);
+   *stream_handle = stream.get();
+   m_streams.push_back(std::move(stream));
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::close_stream_handle(HANDLE stream_handle)
+{
+   wait(m_config.reconfiguration_latency);
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   auto stream = std::find_if(m_streams.begin(), m_streams.end(),
+                              [&](const std::unique_ptr<Stream>& s) { return s.get() == stream_handle; });
+   if (stream == m_streams.end())
+      return VHDERR_INVALIDHANDLE;
+
+   m_streams.erase(stream);
+   m_last_close = std::chrono::steady_clock::now();
+   m_reconfiguring = true;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::set_stream_property(HANDLE stream_handle, ULONG property, ULONG value)
+{
+   if (!stream_handle)
+      return VHDERR_INVALIDHANDLE;
+   std::lock_guard<std::mutex> lock(m_mutex);
+   Stream* stream = static_cast<Stream*>(stream_handle);
+   if (stream->started)
+   {
+      // The queue is allocated when the stream starts, the timeout is followed by the next slot lock
+      if (property == VHD_CORE_SP_BUFFERQUEUE_DEPTH)
+         return VHDERR_INVALIDCALL;
+      if (property == VHD_CORE_SP_IO_TIMEOUT)
+         stream->io_timeout = std::chrono::milliseconds(value);
+   }
+   stream->properties[property] = value;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::get_stream_property(HANDLE stream_handle, ULONG property, ULONG* value)
+{
+   if (!stream_handle)
+      return VHDERR_INVALIDHANDLE;
+   Stream* stream = static_cast<Stream*>(stream_handle);
+
+   // The counters are read by the monitoring threads while the slot loop runs
+   if (property == VHD_CORE_SP_SLOTS_COUNT)
+      *value = static_cast<ULONG>(stream->slots_count.load(std::memory_order_relaxed));
+   else if (property == VHD_CORE_SP_SLOTS_DROPPED)
+      *value = static_cast<ULONG>(stream->slots_dropped.load(std::memory_order_relaxed));
+   else if (property == VHD_CORE_SP_BUFFERQUEUE_FILLING)
+      *value = static_cast<ULONG>(stream->buffer_filling.load(std::memory_order_relaxed));
+   else
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto found = stream->properties.find(property);
+      if (property == VHD_IP_BRD_SP_DATAGRAM_COUNT)
+      {
+         // The datagrams flow at the nominal packet rate from the start of the stream
+         *value = stream->started ? static_cast<ULONG>(to_ns(std::chrono::steady_clock::now() - stream->start_time) *
+                                                       stream->nb_datagrams_per_slot / stream->period.count())
+                                  : 0;
+      }
+      else if (found == stream->properties.end())
+      {
+         // The jitter of the network side of the board is not simulated
+         if (property != VHD_IP_BRD_SP_JITTER_MAX)
+            return VHDERR_BADARG;
+         *value = 0;
+      }
+      else
+         *value = found->second;
+   }
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::start_stream(HANDLE stream_handle)
+{
+   if (!stream_handle)
+      return VHDERR_INVALIDHANDLE;
+   Stream* stream = static_cast<Stream*>(stream_handle);
+
+   wait(m_config.reconfiguration_latency);
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   if (stream->started)
+      return VHDERR_INVALIDCALL;
+
+   auto video_standard = stream->properties.find(VHD_ST2110_20_SP_VIDEO_STANDARD);
+   const VideoStandardInfo* info =
+       video_standard != stream->properties.end()
+           ? find_video_standard_info(static_cast<VHD_ST2110_20_VIDEO_STANDARD>(video_standard->second))
+           : nullptr;
+   if (!info)
+      return VHDERR_BADARG;
+
+   // frame_rate is the field rate for interlaced standards, and a slot holds a frame
+   stream->period = m_config.slot_period.count() > 0
+                        ? m_config.slot_period
+                        : std::chrono::nanoseconds(static_cast<int64_t>(
+                              1e9 * (info->is_us ? 1.001 : 1.0) * (info->interlaced ? 2 : 1) / info->frame_rate));
+   stream->io_timeout = std::chrono::milliseconds(stream->properties[VHD_CORE_SP_IO_TIMEOUT]);
+
+   const size_t frame_size = static_cast<size_t>(info->frame_width) * info->frame_height *
+                             get_bytes_per_pixel(stream->properties[VHD_CORE_SP_BUFFER_PACKING]);
+   stream->slots.resize(std::max<ULONG>(1, stream->properties[VHD_CORE_SP_BUFFERQUEUE_DEPTH]));
+   for (auto& slot : stream->slots)
+   {
+      slot.stream = stream;
+      slot.buffer.assign(frame_size, 0);
+   }
+
+   // 1200 bytes of 10-bit 4:2:2 video per datagram, as St2110_20Packetizer sends them
+   stream->nb_datagrams_per_slot =
+       (static_cast<uint64_t>(info->frame_width) * info->frame_height * 5 / 2 + 1199) / 1200;
+   stream->start_time = std::chrono::steady_clock::now();
+   stream->next_slot_time = stream->start_time + stream->period;
+   stream->nb_produced_slots = 0;
+   stream->nb_locked_slots = 0;
+   stream->slots_count = 0;
+   stream->slots_dropped = 0;
+   stream->buffer_filling = is_transmission_stream(stream->type) ? stream->slots.size() - 1 : 0;
+   stream->started = true;
+   if (m_config.stall == SimulatedStall::until_stream_restart)
+   {
+      stream->stalled = false;
+      stream->nb_slots_before_stall = m_config.stall_after_slots;
+   }
+
+   if (m_reconfiguring)
+   {
+      const double reconfiguration_ms =
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_last_close).count();
+      m_nb_reconfigurations++;
+      m_reconfiguration_sum_ms += reconfiguration_ms;
+      m_reconfiguration_max_ms = std::max(m_reconfiguration_max_ms, reconfiguration_ms);
+      m_reconfiguring = false;
+   }
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::stop_stream(HANDLE stream_handle)
+{
+   if (!stream_handle)
+      return VHDERR_INVALIDHANDLE;
+
+   wait(m_config.reconfiguration_latency);
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   Stream* stream = static_cast<Stream*>(stream_handle);
+   if (!stream->started)
+      return VHDERR_INVALIDCALL;
+   stream->started = false;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::lock_slot_handle(HANDLE stream_handle, HANDLE* slot_handle)
+{
+   if (!stream_handle || !slot_handle)
+      return VHDERR_INVALIDHANDLE;
+   Stream* stream = static_cast<Stream*>(stream_handle);
+   if (!stream->started)
+      return VHDERR_INVALIDCALL;
+
+   const auto lock_start = std::chrono::steady_clock::now();
+
+   // A stalled stream produces no slot, the lock times out
+   if (stream->is_stalled())
+   {
+      std::this_thread::sleep_for(stream->io_timeout);
+      return VHDERR_TIMEOUT;
+   }
+
+   if (!m_config.free_running)
+   {
+      // The board keeps its cadence: the slots the application was too late for, beyond the queue, are lost
+      const int64_t nb_late_slots = (lock_start - stream->next_slot_time) / stream->period;
+      const int64_t nb_missed_slots = nb_late_slots - static_cast<int64_t>(stream->slots.size()) + 1;
+      if (nb_missed_slots > 0)
+      {
+         stream->next_slot_time += nb_missed_slots * stream->period;
+         stream->nb_produced_slots += nb_missed_slots;
+         stream->slots_dropped += nb_missed_slots;
+         m_nb_dropped_slots.fetch_add(nb_missed_slots, std::memory_order_relaxed);
+      }
+   }
+
+   while (stream->drop_next_slot(m_config))
+   {
+      stream->slots_dropped++;
+      m_nb_dropped_slots.fetch_add(1, std::memory_order_relaxed);
+      if (!m_config.free_running)
+         stream->next_slot_time += stream->period;
+   }
+
+   if (!m_config.free_running)
+   {
+      if (stream->next_slot_time - lock_start > stream->io_timeout)
+      {
+         std::this_thread::sleep_for(stream->io_timeout);
+         return VHDERR_TIMEOUT;
+      }
+      std::this_thread::sleep_until(stream->next_slot_time);
+      stream->next_slot_time += stream->period;
+   }
+
+   wait(m_config.lock_latency);
+
+   Slot& slot = stream->slots[stream->nb_locked_slots++ % stream->slots.size()];
+   slot.lock_time = std::chrono::steady_clock::now();
+   stream->slots_count++;
+   stream->on_slot_locked(m_config);
+
+   // Slots already due behind the locked one: captured and waiting for the application in reception, missing
+   // from the queue of the board in transmission
+   uint64_t nb_due_slots = 0;
+   if (!m_config.free_running && slot.lock_time >= stream->next_slot_time)
+      nb_due_slots = std::min<uint64_t>((slot.lock_time - stream->next_slot_time) / stream->period + 1,
+                                        stream->slots.size() - 1);
+   stream->buffer_filling.store(is_transmission_stream(stream->type) ? stream->slots.size() - 1 - nb_due_slots
+                                                                      : nb_due_slots,
+                                std::memory_order_relaxed);
+
+   m_nb_slots.fetch_add(1, std::memory_order_relaxed);
+   m_lock_wait_sum_ns.fetch_add(to_ns(slot.lock_time - lock_start), std::memory_order_relaxed);
+
+   *slot_handle = &slot;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::get_slot_buffer(HANDLE slot_handle, ULONG, uint8_t** buffer,
+                                                     ULONG* buffer_size)
+{
+   if (!slot_handle)
+      return VHDERR_INVALIDHANDLE;
+   Slot* slot = static_cast<Slot*>(slot_handle);
+   *buffer = slot->buffer.data();
+   *buffer_size = static_cast<ULONG>(slot->buffer.size());
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE SimulatedBoardBackend::unlock_slot_handle(HANDLE slot_handle)
+{
+   if (!slot_handle)
+      return VHDERR_INVALIDHANDLE;
+   Slot* slot = static_cast<Slot*>(slot_handle);
+
+   const uint64_t hold_ns = to_ns(std::chrono::steady_clock::now() - slot->lock_time);
+   m_slot_hold_sum_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+   update_max(m_slot_hold_max_ns, hold_ns);
+   return VHDERR_NOERROR;
+}
+
+SimulatedBoardStatistics SimulatedBoardBackend::get_statistics() const
+{
+   SimulatedBoardStatistics statistics;
+   statistics.nb_slots = m_nb_slots.load(std::memory_order_relaxed);
+   if (statistics.nb_slots)
+   {
+      statistics.mean_slot_hold_ns =
+          static_cast<double>(m_slot_hold_sum_ns.load(std::memory_order_relaxed)) / statistics.nb_slots;
+      statistics.mean_lock_wait_ns =
+          static_cast<double>(m_lock_wait_sum_ns.load(std::memory_order_relaxed)) / statistics.nb_slots;
+   }
+   statistics.max_slot_hold_ns = static_cast<double>(m_slot_hold_max_ns.load(std::memory_order_relaxed));
+   statistics.nb_dropped_slots = m_nb_dropped_slots.load(std::memory_order_relaxed);
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   statistics.nb_reconfigurations = m_nb_reconfigurations;
+   if (m_nb_reconfigurations)
+      statistics.mean_reconfiguration_ms = m_reconfiguration_sum_ms / m_nb_reconfigurations;
+   statistics.max_reconfiguration_ms = m_reconfiguration_max_ms;
+   return statistics;
+}
+
+void SimulatedBoardBackend::print_statistics() const
+{
+   const SimulatedBoardStatistics statistics = get_statistics();
+   std::cout << std::fixed << std::setprecision(3) << "Simulated board: " << statistics.nb_slots << " slots ("
+             << statistics.nb_dropped_slots << " dropped), slot hold " << statistics.mean_slot_hold_ns / 1000
+             << " us (max " << statistics.max_slot_hold_ns / 1000 << " us), lock wait "
+             << statistics.mean_lock_wait_ns / 1000 << " us, " << statistics.nb_reconfigurations
+             << " reconfiguration(s) " << statistics.mean_reconfiguration_ms << " ms (max "
+             << statistics.max_reconfiguration_ms << " ms)" << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file simulated_board.h
+   @brief This file contains a simulated board, with its slot buffers in host memory, on which the samples run
+   without any DELTACAST IP Card.
+
+   @detail The slots of a started stream become available at the frame rate of its video standard, or at a fixed
+   cadence, with a configurable lock latency and slot drop injection. The PTP port goes from listening to slave
+   after a configurable time and its offset converges exponentially. Random behaviours are drawn from a seeded
+   generator, so that two runs with the same configuration see the same drops and offsets.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "board_backend.h"
+
+/*!
+   @brief Stall injected into the streams of the simulated boards: the slot locks time out until it is cleared
+*/
+enum class SimulatedStall
+{
+   none,
+   until_stream_restart /*! Cleared when the stream is stopped and started again */,
+   until_stream_reopen /*! Cleared when the stream is closed and opened again */,
+   until_board_reopen /*! Cleared when the board handle is closed and opened again */,
+};
+
+/*!
+   @brief Behaviour of the simulated boards
+*/
+struct SimulatedBoardConfig
+{
+   uint32_t nb_boards = 2 /*! Number of boards reported by get_api_info() */;
+
+   std::chrono::nanoseconds slot_period{0} /*! Slot cadence, 0 to follow the frame rate of the video standard */;
+   bool free_running = false /*! Slots available as soon as they are locked, to measure the loop overhead alone */;
+   std::chrono::nanoseconds lock_latency{0} /*! Added to every slot lock */;
+   std::chrono::nanoseconds reconfiguration_latency{0} /*! Added to every stream open, close, start and stop */;
+
+   uint32_t drop_every = 0 /*! Drop one slot every n slots, 0 to disable */;
+   double drop_probability = 0.0 /*! Probability that a slot is dropped */;
+
+   SimulatedStall stall = SimulatedStall::none /*! What clears a stall, to exercise the stall recovery */;
+   uint64_t stall_after_slots = 0 /*! Slots a stream produces before it stalls, 0 to disable */;
+
+   std::chrono::milliseconds ptp_lock_time{2000} /*! Time from the PTP (re)configuration to the slave state */;
+   int64_t ptp_initial_offset_ns = 20000 /*! Offset when the port becomes slave */;
+   std::chrono::milliseconds ptp_settling_time{500} /*! Time constant of the offset convergence */;
+   int64_t ptp_jitter_ns = 40 /*! Amplitude of the random noise added to the offset */;
+
+   uint64_t seed = 1 /*! Seed of the drops and PTP noise */;
+};
+
+/*!
+   @brief Slot loop measurements of the streams of the simulated boards
+*/
+struct SimulatedBoardStatistics
+{
+   uint64_t nb_slots = 0 /*! Slots locked by the application */;
+   uint64_t nb_dropped_slots = 0 /*! Slots injected as dropped or missed because the loop was late */;
+   double mean_slot_hold_ns = 0.0 /*! Mean time between a slot lock and its unlock, i.e. the loop overhead */;
+   double max_slot_hold_ns = 0.0;
+   double mean_lock_wait_ns = 0.0 /*! Mean time spent waiting for the next slot in lock_slot_handle() */;
+   uint64_t nb_reconfigurations = 0 /*! Streams closed then reopened and started */;
+   double mean_reconfiguration_ms = 0.0 /*! Mean time from a stream close to the start of the next stream */;
+   double max_reconfiguration_ms = 0.0;
+};
+
+class SimulatedBoardBackend : public BoardBackend
+{
+public:
+   explicit SimulatedBoardBackend(const SimulatedBoardConfig& config = {} /*!< [in] Behaviour of the boards*/);
+   ~SimulatedBoardBackend() override;
+
+   const char* get_name() const override { return "Simulated"; }
+
+   VHD_ERRORCODE get_api_info(ULONG* dll_version, ULONG* nb_boards) override;
+   VHD_ERRORCODE open_board_handle(ULONG board_index, HANDLE* board_handle, HANDLE state_change_event,
+                                   ULONG state_change_mask) override;
+   VHD_ERRORCODE close_board_handle(HANDLE board_handle) override;
+   VHD_ERRORCODE set_board_property(HANDLE board_handle, ULONG property, ULONG value) override;
+   VHD_ERRORCODE get_board_property(HANDLE board_handle, ULONG property, ULONG* value) override;
+
+   VHD_ERRORCODE get_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property, ULONG* value) override;
+   VHD_ERRORCODE set_ethernet_port_property(HANDLE board_handle, ULONG port, ULONG property, ULONG value) override;
+   VHD_ERRORCODE enable_dhcp(HANDLE board_handle, ULONG port) override;
+   VHD_ERRORCODE disable_dhcp(HANDLE board_handle, ULONG port) override;
+   VHD_ERRORCODE join_multicast_group(HANDLE board_handle, ULONG port, ULONG group) override;
+   VHD_ERRORCODE leave_multicast_group(HANDLE board_handle, ULONG port, ULONG group) override;
+
+   VHD_ERRORCODE get_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION* configuration) override;
+   VHD_ERRORCODE set_ptp_configuration(HANDLE board_handle, VHD_PTP_CONFIGURATION configuration) override;
+   VHD_ERRORCODE get_ptp_port_state(HANDLE board_handle, VHD_PTP_PORT_STATE* state, BOOL32* locked) override;
+   VHD_ERRORCODE get_ptp_offset(HANDLE board_handle, LONG* offset_sec, LONG* offset_nsec) override;
+
+   VHD_ERRORCODE open_stream_handle(HANDLE board_handle, ULONG stream_type, ULONG processing_mode,
+                                    BOOL32* setup_lock, HANDLE* stream_handle, HANDLE data_ready_event) override;
+   VHD_ERRORCODE close_stream_handle(HANDLE stream_handle) override;
+   VHD_ERRORCODE set_stream_property(HANDLE stream_handle, ULONG property, ULONG value) override;
+   VHD_ERRORCODE get_stream_property(HANDLE stream_handle, ULONG property, ULONG* value) override;
+   VHD_ERRORCODE start_stream(HANDLE stream_handle) override;
+   VHD_ERRORCODE stop_stream(HANDLE stream_handle) override;
+   VHD_ERRORCODE lock_slot_handle(HANDLE stream_handle, HANDLE* slot_handle) override;
+   VHD_ERRORCODE get_slot_buffer(HANDLE slot_handle, ULONG buffer_type, uint8_t** buffer,
+                                 ULONG* buffer_size) override;
+   VHD_ERRORCODE unlock_slot_handle(HANDLE slot_handle) override;
+
+   SimulatedBoardStatistics get_statistics() const;
+   void print_statistics() const;
+
+private:
+   struct Board;
+   struct Stream;
+   struct Slot;
+
+   void wait(std::chrono::nanoseconds duration) const;
+
+   const SimulatedBoardConfig m_config;
+
+   mutable std::mutex m_mutex;
+   std::vector<std::unique_ptr<Board>> m_boards;
+   std::vector<std::unique_ptr<Stream>> m_streams;
+   uint64_t m_nb_opened_streams = 0;
+
+   std::atomic<uint64_t> m_nb_slots{0};
+   std::atomic<uint64_t> m_nb_dropped_slots{0};
+   std::atomic<uint64_t> m_slot_hold_sum_ns{0};
+   std::atomic<uint64_t> m_slot_hold_max_ns{0};
+   std::atomic<uint64_t> m_lock_wait_sum_ns{0};
+   std::chrono::steady_clock::time_point m_last_close;
+   bool m_reconfiguring = false;
+   uint64_t m_nb_reconfigurations = 0;
+   double m_reconfiguration_sum_ms = 0.0;
+   double m_reconfiguration_max_ms = 0.0;
+};
@@ -0,0 +1,145 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "slot_tracer.h"
+
+namespace
+{
+   const char* const slots_dropped_event = "slots dropped";
+}
+
+void SlotTracer::enable(const std::string& dump_path, std::chrono::milliseconds window)
+{
+   std::lock_guard lock(m_mutex);
+   m_dump_path = dump_path;
+   m_window = window;
+   m_reference_timestamp = read_timestamp();
+   m_reference_time = std::chrono::steady_clock::now();
+   m_dumped_on_drop = false;
+   m_enabled.store(true, std::memory_order_release);
+}
+
+void SlotTracer::disable()
+{
+   m_enabled.store(false, std::memory_order_release);
+}
+
+void SlotTracer::set_thread_name(const std::string& name)
+{
+   ThreadRing* ring = get_thread_ring();
+   std::lock_guard lock(m_mutex);
+   ring->thread_name = name;
+}
+
+void SlotTracer::on_slots_dropped(uint64_t nb_slots_dropped)
+{
+   if (!is_enabled())
+      return;
+
+   const uint64_t now = read_timestamp();
+   get_thread_ring()->push({now, now, slots_dropped_event, nb_slots_dropped});
+
+   if (!m_dumped_on_drop.exchange(true))
+      dump();
+}
+
+bool SlotTracer::dump()
+{
+   std::string path;
+   std::chrono::milliseconds window;
+   {
+      std::lock_guard lock(m_mutex);
+      path = m_dump_path;
+      window = m_window;
+   }
+
+   if (!write_chrome_trace(path, window))
+   {
+      std::cout << std::endl << "Cannot write the slot trace to " << path << std::endl;
+      return false;
+   }
+   std::cout << std::endl << "Slot trace of the last " << window.count() << " ms written to " << path << std::endl;
+   return true;
+}
+
+SlotTracer::ThreadRing* SlotTracer::register_thread_ring()
+{
+   std::lock_guard lock(m_mutex);
+   m_rings.push_back(std::make_unique<ThreadRing>());
+   m_rings.back()->thread_name = "thread " + std::to_string(m_rings.size());
+   return m_rings.back().get();
+}
+
+bool SlotTracer::write_chrome_trace(const std::string& path, std::chrono::milliseconds window)
+{
+   std::ofstream output(path);
+   if (!output)
+      return false;
+
+   // The timestamps are converted to microseconds since enable() with the rate measured between enable() and now
+   const uint64_t now_timestamp = read_timestamp();
+   const double elapsed_us =
+       std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_reference_time).count();
+   const double ticks_per_us =
+       elapsed_us > 0.0 ? (now_timestamp - m_reference_timestamp) / elapsed_us : 1.0;
+   const double window_ticks = window.count() * 1000.0 * ticks_per_us;
+   const uint64_t window_begin = now_timestamp - m_reference_timestamp > window_ticks
+                                     ? now_timestamp - static_cast<uint64_t>(window_ticks)
+                                     : m_reference_timestamp;
+   const auto to_us = [&](uint64_t timestamp) {
+      return (static_cast<double>(timestamp) - static_cast<double>(m_reference_timestamp)) / ticks_per_us;
+   };
+
+   std::lock_guard lock(m_mutex);
+   output << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [" << std::fixed << std::setprecision(3);
+   bool is_first = true;
+   for (size_t tid = 0; tid < m_rings.size(); tid++)
+   {
+      const ThreadRing& ring = *m_rings[tid];
+      output << (is_first ? "\n" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+             << ", \"args\": {\"name\": \"" << ring.thread_name << "\"}}";
+      is_first = false;
+
+      // The oldest events may be overwritten while they are read, a margin of the ring is left out
+      const uint64_t nb_events = ring.nb_events.load(std::memory_order_acquire);
+      const uint64_t first_event = nb_events > ring_capacity ? nb_events - ring_capacity + ring_capacity / 16 : 0;
+      for (uint64_t i = first_event; i < nb_events; i++)
+      {
+         const Event& event = ring.events[i & (ring_capacity - 1)];
+         if (event.end < window_begin || event.begin < m_reference_timestamp)
+            continue;
+
+         output << ",\n{\"name\": \"" << event.name << "\", \"pid\": 1, \"tid\": " << tid
+                << ", \"ts\": " << to_us(event.begin);
+         if (event.name == slots_dropped_event)
+            output << ", \"ph\": \"i\", \"s\": \"g\", \"args\": {\"slots_dropped\": " << event.slot << "}}";
+         else
+            output << ", \"ph\": \"X\", \"cat\": \"slot\", \"dur\": " << to_us(event.end) - to_us(event.begin)
+                   << ", \"args\": {\"slot\": " << event.slot << "}}";
+      }
+   }
+   output << "\n]}\n";
+   return static_cast<bool>(output);
+}
+
+SlotTracer& slot_tracer()
+{
+   static SlotTracer tracer;
+   return tracer;
+}
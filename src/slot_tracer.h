@@ -0,0 +1,185 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file slot_tracer.h
+   @brief This file contains the tracer of the phases of every slot of the sample loops, exported as Chrome trace.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SLOT_TRACER_USE_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define SLOT_TRACER_USE_TSC
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*!
+   @brief Records the begin and end timestamps of the phases of every slot (lock, copy, overlay, unlock...)
+
+   @detail The tracer is always compiled in and toggled at runtime. Each thread records into its own ring buffer
+   without any lock, the cost of a traced phase being two timestamp reads and a few stores (TSC based on x86). The
+   last seconds of all the rings are dumped as Chrome trace-event JSON, to be opened in chrome://tracing or Perfetto,
+   on demand or at the first slot drop.
+*/
+class SlotTracer
+{
+public:
+   static constexpr uint32_t ring_capacity = 1 << 14; // events kept per thread, a power of two
+
+private:
+   struct Event
+   {
+      uint64_t begin;
+      uint64_t end;
+      const char* name;
+      uint64_t slot;
+   };
+
+   struct ThreadRing
+   {
+      std::string thread_name;
+      std::unique_ptr<Event[]> events = std::make_unique<Event[]>(ring_capacity);
+      std::atomic<uint64_t> nb_events{0};
+
+      void push(const Event& event)
+      {
+         const uint64_t index = nb_events.load(std::memory_order_relaxed);
+         events[index & (ring_capacity - 1)] = event;
+         nb_events.store(index + 1, std::memory_order_release);
+      }
+   };
+
+   static uint64_t read_timestamp()
+   {
+#if defined(SLOT_TRACER_USE_TSC)
+      return __rdtsc();
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+#endif
+   }
+
+public:
+   /*!
+      @brief Times a phase from its construction to its destruction, nothing is recorded while tracing is disabled
+   */
+   class Scope
+   {
+   public:
+      Scope(SlotTracer& tracer, const char* name, uint64_t slot)
+          : m_ring(tracer.is_enabled() ? tracer.get_thread_ring() : nullptr), m_name(name), m_slot(slot),
+            m_begin(m_ring ? read_timestamp() : 0)
+      {
+      }
+
+      ~Scope()
+      {
+         if (m_ring)
+            m_ring->push({m_begin, read_timestamp(), m_name, m_slot});
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+
+   private:
+      ThreadRing* m_ring;
+      const char* m_name;
+      uint64_t m_slot;
+      uint64_t m_begin;
+   };
+
+   SlotTracer() = default;
+
+   /*!
+      @brief Start tracing, the trace is dumped to dump_path at the first slot drop and by dump()
+   */
+   void enable(const std::string& dump_path /*!< [in] Path of the Chrome trace JSON file*/,
+               std::chrono::milliseconds window /*!< [in] Duration of the trace kept in a dump, before its time*/);
+
+   void disable();
+
+   bool is_enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+   /*!
+      @brief Start timing a phase of a slot, the phase ends when the returned object is destroyed
+
+      @detail The name must be a string literal, only its address is recorded.
+   */
+   Scope trace(const char* name /*!< [in] Name of the phase*/, uint64_t slot /*!< [in] Index of the slot*/)
+   {
+      return Scope(*this, name, slot);
+   }
+
+   /*!
+      @brief Name the calling thread in the dumped traces
+   */
+   void set_thread_name(const std::string& name /*!< [in] Name of the thread*/);
+
+   /*!
+      @brief Record that the board dropped slots, the trace is dumped the first time
+   */
+   void on_slots_dropped(uint64_t nb_slots_dropped /*!< [in] Total number of slots dropped by the stream*/);
+
+   /*!
+      @brief Dump the last window of the trace as Chrome trace-event JSON
+
+      @returns true if the trace has been written
+   */
+   bool dump();
+
+private:
+   ThreadRing* get_thread_ring()
+   {
+      // the ring of the calling thread is registered at its first traced phase and then cached
+      thread_local std::pair<const SlotTracer*, ThreadRing*> cached_ring = {nullptr, nullptr};
+      if (cached_ring.first != this)
+         cached_ring = {this, register_thread_ring()};
+      return cached_ring.second;
+   }
+
+   ThreadRing* register_thread_ring();
+   bool write_chrome_trace(const std::string& path, std::chrono::milliseconds window);
+
+   std::atomic<bool> m_enabled{false};
+   std::atomic<bool> m_dumped_on_drop{false};
+   std::string m_dump_path;
+   std::chrono::milliseconds m_window{0};
+   uint64_t m_reference_timestamp = 0;
+   std::chrono::steady_clock::time_point m_reference_time;
+
+   std::mutex m_mutex;
+   std::vector<std::unique_ptr<ThreadRing>> m_rings;
+};
+
+/*!
+   @brief Tracer shared by the sample loops and the stream monitoring
+*/
+SlotTracer& slot_tracer();
@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file st2110_timing.h
+   @brief This file contains the ST 2110 timing helpers shared by the software packetizer and the analyzer: PTP
+   epochs of a frame rate, RTP time and the ST 2110-21 gapped timing model.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <algorithm>
+
+inline constexpr uint64_t rtp_clock_rate = 90000;
+
+/*!
+   @brief Frame period as the exact fraction denominator / numerator of a second, so that the PTP epochs of
+   1000/1001 rates do not drift
+*/
+struct FramePeriod
+{
+   uint64_t numerator;
+   uint64_t denominator;
+
+   /*!
+      @brief Index of the epoch a time falls in, times being counted from the PTP epoch
+   */
+   uint64_t index_at(uint64_t time_ns) const
+   {
+      const uint64_t scaled_seconds = (time_ns / 1000000000) * numerator;
+      return scaled_seconds / denominator +
+             ((scaled_seconds % denominator) * 1000000000 + (time_ns % 1000000000) * numerator) /
+                 (denominator * 1000000000);
+   }
+
+   uint64_t epoch_ns(uint64_t index) const
+   {
+      const uint64_t scaled_index = index * denominator;
+      return (scaled_index / numerator) * 1000000000 + (scaled_index % numerator) * 1000000000 / numerator;
+   }
+
+   /*!
+      @brief RTP timestamp of the frame sampled at an epoch
+   */
+   uint32_t epoch_rtp_time(uint64_t index) const
+   {
+      const uint64_t scaled_index = index * denominator;
+      return static_cast<uint32_t>((scaled_index / numerator) * rtp_clock_rate +
+                                   (scaled_index % numerator) * rtp_clock_rate / numerator);
+   }
+
+   double ns() const { return 1e9 * static_cast<double>(denominator) / static_cast<double>(numerator); }
+};
+
+inline uint32_t to_rtp_time(uint64_t time_ns)
+{
+   return static_cast<uint32_t>((time_ns / 1000000000) * rtp_clock_rate +
+                                (time_ns % 1000000000) * rtp_clock_rate / 1000000000);
+}
+
+/*!
+   @brief Total number of lines and default read offset (in lines) of a raster, per frame
+*/
+struct RasterTiming
+{
+   uint32_t frame_height;
+   bool interlaced;
+   uint32_t total_lines;
+   uint32_t tro_lines;
+};
+
+inline constexpr RasterTiming raster_timings[] = {
+   {480, true, 525, 20},
+   {486, true, 525, 20},
+   {487, true, 525, 20},
+   {576, true, 625, 26},
+   {720, false, 750, 28},
+   {1080, true, 1125, 22},
+   {1080, false, 1125, 43},
+   {2160, false, 2250, 86},
+};
+
+inline RasterTiming get_raster_timing(uint32_t frame_height, bool interlaced)
+{
+   for (const RasterTiming& raster_timing : raster_timings)
+   {
+      if (raster_timing.frame_height == frame_height && raster_timing.interlaced == interlaced)
+         return raster_timing;
+   }
+   // Unknown raster, scale the 1080 lines one
+   return {frame_height, interlaced, frame_height * 1125 / 1080, frame_height * 43 / 1080};
+}
+
+/*!
+   @brief Parameters of the ST 2110-21 gapped model, per frame for progressive video and per field for interlaced
+   video
+*/
+struct St2110_21Timing
+{
+   double tframe_ns /*! Period of one RTP timestamp (frame or field) */;
+   double trs_ns /*! Drain period of the packets */;
+   double tro_ns /*! Default read offset from the epoch */;
+   double ractive /*! Ratio of active lines */;
+   uint32_t cmax_narrow /*! Largest burst of packets of the narrow senders (network compatibility model) */;
+};
+
+inline St2110_21Timing get_st2110_21_timing(const FramePeriod& period /*!< [in] Period of one RTP timestamp*/,
+                                            uint32_t frame_height /*!< [in] Active lines of the frame*/,
+                                            bool interlaced /*!< [in] True if the video is interlaced*/,
+                                            uint32_t nb_packets /*!< [in] Packets per frame, per field if interlaced*/)
+{
+   const RasterTiming raster_timing = get_raster_timing(frame_height, interlaced);
+   const double lines_per_period = raster_timing.total_lines / (interlaced ? 2.0 : 1.0);
+
+   St2110_21Timing timing;
+   timing.tframe_ns = period.ns();
+   timing.ractive = static_cast<double>(frame_height) / raster_timing.total_lines;
+   timing.trs_ns = timing.tframe_ns * timing.ractive / nb_packets;
+   timing.tro_ns = timing.tframe_ns * raster_timing.tro_lines / lines_per_period;
+   timing.cmax_narrow =
+       std::max(4u, static_cast<uint32_t>(nb_packets / (43200 * timing.ractive * timing.tframe_ns / 1e9)));
+   return timing;
+}
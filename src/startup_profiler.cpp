@@ -0,0 +1,76 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "startup_profiler.h"
+
+namespace
+{
+   double to_ms(StartupProfiler::clock::duration duration)
+   {
+      return std::chrono::duration<double, std::milli>(duration).count();
+   }
+}
+
+StartupProfiler::Phase::Phase(StartupProfiler& profiler, std::string name)
+    : m_profiler(profiler), m_name(std::move(name)), m_begin(clock::now())
+{
+}
+
+StartupProfiler::Phase::~Phase()
+{
+   m_profiler.record(m_name, m_begin, clock::now());
+}
+
+StartupProfiler::StartupProfiler() : m_start(clock::now())
+{
+}
+
+StartupProfiler::Phase StartupProfiler::phase(const std::string& name)
+{
+   return Phase(*this, name);
+}
+
+void StartupProfiler::record(const std::string& name, clock::time_point begin, clock::time_point end)
+{
+   std::lock_guard lock(m_mutex);
+   m_phases.push_back({name, begin, end});
+}
+
+void StartupProfiler::mark(const std::string& milestone)
+{
+   const auto now = clock::now();
+
+   std::lock_guard lock(m_mutex);
+   if (std::find(m_marked.begin(), m_marked.end(), milestone) != m_marked.end())
+      return;
+   m_marked.push_back(milestone);
+
+   std::vector<Record> phases = m_phases;
+   std::sort(phases.begin(), phases.end(), [](const Record& a, const Record& b) { return a.begin < b.begin; });
+
+   std::cout << std::endl << "Startup: time to " << milestone << " = " << std::fixed << std::setprecision(1)
+             << to_ms(now - m_start) << " ms" << std::endl;
+   for (const auto& phase : phases)
+   {
+      std::cout << "\t" << std::left << std::setw(20) << phase.name << std::right << " [" << std::setw(8)
+                << to_ms(phase.begin - m_start) << " .. " << std::setw(8) << to_ms(phase.end - m_start)
+                << " ms] " << std::setw(8) << to_ms(phase.end - phase.begin) << " ms" << std::endl;
+   }
+   std::cout << std::defaultfloat;
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file startup_profiler.h
+   @brief This file contains the profiler used to time the startup phases of the samples.
+*/
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+   @brief Records the duration of the startup phases and the time at which milestones are reached
+
+   @detail Phases may run concurrently from several threads. All times are relative to the construction of the
+   profiler.
+*/
+class StartupProfiler
+{
+public:
+   using clock = std::chrono::steady_clock;
+
+   /*!
+      @brief Times a phase from its construction to its destruction
+   */
+   class Phase
+   {
+   public:
+      Phase(StartupProfiler& profiler, std::string name);
+      ~Phase();
+
+      Phase(const Phase&) = delete;
+      Phase& operator=(const Phase&) = delete;
+
+   private:
+      StartupProfiler& m_profiler;
+      std::string m_name;
+      clock::time_point m_begin;
+   };
+
+   StartupProfiler();
+
+   /*!
+      @brief Start timing a phase, the phase ends when the returned object is destroyed
+   */
+   Phase phase(const std::string& name /*!< [in] Name of the phase*/);
+
+   /*!
+      @brief Record a milestone (e.g. "ready", "first frame") and print the phase breakdown up to it
+   */
+   void mark(const std::string& milestone /*!< [in] Name of the milestone*/);
+
+private:
+   struct Record
+   {
+      std::string name;
+      clock::time_point begin;
+      clock::time_point end;
+   };
+
+   void record(const std::string& name, clock::time_point begin, clock::time_point end);
+
+   const clock::time_point m_start;
+   std::mutex m_mutex;
+   std::vector<Record> m_phases;
+   std::vector<std::string> m_marked;
+};
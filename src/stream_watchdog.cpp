@@ -0,0 +1,206 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "flight_recorder.h"
+#include "stream_watchdog.h"
+
+StreamWatchdog::StreamWatchdog(const StreamWatchdogConfig& config, FlightRecorder* flight_recorder)
+    : m_config(config), m_flight_recorder(flight_recorder)
+{
+}
+
+void StreamWatchdog::arm(const VideoStandardInfo& video_standard_info)
+{
+   if (!m_config.enabled)
+      return;
+
+   // A slot holds a frame, frame_rate is the field rate for interlaced standards
+   m_frame_period = std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(static_cast<int64_t>(
+       1e9 * (video_standard_info.is_us ? 1.001 : 1.0) * (video_standard_info.interlaced ? 2 : 1) /
+       video_standard_info.frame_rate)));
+   m_stall_threshold = m_frame_period * std::max<uint32_t>(1, m_config.stall_frame_periods);
+   m_last_progress = clock::now();
+   reset_stall();
+   m_given_up = false;
+}
+
+bool StreamWatchdog::on_stall(const StreamRecoveryActions& actions, VHD_ERRORCODE error)
+{
+   if (!m_config.enabled || m_given_up)
+      return false;
+
+   const bool failed = error != VHDERR_TIMEOUT;
+   const auto now = clock::now();
+   if (!m_stalled)
+   {
+      if (!failed && now - m_last_progress < m_stall_threshold)
+         return true;
+
+      reset_stall();
+      m_stalled = true;
+      m_stall_begin = m_last_progress;
+      m_next_attempt = now;
+      m_statistics.nb_stalls++;
+      std::cout << std::endl << "Stream stalled";
+      if (failed)
+         std::cout << " on an error [" << to_string(error) << "]";
+      std::cout << ": no slot completed for " << std::fixed << std::setprecision(0)
+                << std::chrono::duration<double, std::milli>(now - m_last_progress).count() << " ms"
+                << std::defaultfloat << std::endl;
+   }
+   // The stream is given the stall threshold to complete a slot after an attempt that succeeded
+   else if (!failed && now - std::max(m_last_progress, m_last_attempt) < m_stall_threshold)
+      return true;
+
+   if (now < m_next_attempt)
+   {
+      if (failed)
+         std::this_thread::sleep_for(std::min<clock::duration>(m_next_attempt - now, m_frame_period));
+      return true;
+   }
+
+   // A stall given up stays so until a slot completes or the watchdog is armed again, so that the slot loop that
+   // keeps waiting on the timeouts does not run the recovery again
+   const uint32_t max_attempts_per_stall = std::max<uint32_t>(1, m_config.max_attempts_per_stall);
+   const StreamRecoveryStage stage =
+       m_nb_stall_attempts < max_attempts_per_stall ? next_stage(actions) : StreamRecoveryStage::none;
+   if (stage == StreamRecoveryStage::none)
+   {
+      std::cout << "Stall recovery given up after " << m_nb_stall_attempts << " attempts" << std::endl;
+      m_statistics.nb_given_up_stalls++;
+      reset_stall();
+      m_given_up = true;
+      return false;
+   }
+
+   VHD_ERRORCODE result = VHDERR_NOERROR;
+   switch (stage)
+   {
+   case StreamRecoveryStage::restart_stream:
+      m_statistics.nb_stream_restarts++;
+      result = actions.restart_stream();
+      break;
+   case StreamRecoveryStage::reopen_stream:
+      m_statistics.nb_stream_reopens++;
+      result = actions.reopen_stream();
+      break;
+   case StreamRecoveryStage::reinit_board:
+      m_statistics.nb_board_reinits++;
+      result = actions.reinit_board();
+      break;
+   default:
+      break;
+   }
+   if (result != VHDERR_NOERROR)
+      m_statistics.nb_failed_attempts++;
+
+   m_last_attempt = clock::now();
+   const uint32_t nb_doublings = std::min<uint32_t>(m_nb_stall_attempts - 1, 20);
+   const auto backoff = std::min<std::chrono::milliseconds>(m_config.max_backoff,
+                                                            m_config.initial_backoff * (int64_t(1) << nb_doublings));
+   m_next_attempt = m_last_attempt + backoff;
+
+   std::cout << "Stall recovery: " << to_string(stage) << " (attempt " << m_nb_stall_attempts << ") "
+             << (result == VHDERR_NOERROR ? "done" : "failed [" + to_string(result) + "]") << ", "
+             << (m_nb_stall_attempts < max_attempts_per_stall ? "next attempt" : "given up") << " in "
+             << backoff.count() << " ms if no slot completes" << std::endl;
+   if (m_flight_recorder)
+      m_flight_recorder->record_event(FlightRecordType::stall_recovery, static_cast<uint32_t>(stage), 0, 0,
+                                      static_cast<uint32_t>(result));
+   return true;
+}
+
+void StreamWatchdog::print_statistics() const
+{
+   if (!m_config.enabled)
+      return;
+
+   std::cout << "Stream watchdog: " << m_statistics.nb_stalls << " stalls - " << m_statistics.nb_recoveries
+             << " recovered - " << m_statistics.nb_given_up_stalls
+             << " given up - mean time to recovery " << std::fixed << std::setprecision(1)
+             << m_statistics.mean_time_to_recovery_ms << " ms, max " << m_statistics.max_time_to_recovery_ms
+             << " ms" << std::defaultfloat << " - stream restarts: " << m_statistics.nb_stream_restarts
+             << " - stream re-opens: " << m_statistics.nb_stream_reopens
+             << " - board re-inits: " << m_statistics.nb_board_reinits
+             << " - failed attempts: " << m_statistics.nb_failed_attempts << std::endl;
+}
+
+StreamRecoveryStage StreamWatchdog::next_stage(const StreamRecoveryActions& actions)
+{
+   const auto has_action = [&](StreamRecoveryStage stage) {
+      switch (stage)
+      {
+      case StreamRecoveryStage::restart_stream: return static_cast<bool>(actions.restart_stream);
+      case StreamRecoveryStage::reopen_stream: return static_cast<bool>(actions.reopen_stream);
+      case StreamRecoveryStage::reinit_board: return static_cast<bool>(actions.reinit_board);
+      default: return false;
+      }
+   };
+
+   // The stages run in order, the last stage with an action is attempted again until the stall ends or is given up
+   const uint32_t attempts_per_stage = std::max<uint32_t>(1, m_config.attempts_per_stage);
+   if (m_stage == StreamRecoveryStage::none || m_nb_stage_attempts >= attempts_per_stage)
+   {
+      StreamRecoveryStage stage = m_stage;
+      while (stage != StreamRecoveryStage::reinit_board)
+      {
+         stage = static_cast<StreamRecoveryStage>(static_cast<uint32_t>(stage) + 1);
+         if (has_action(stage))
+         {
+            m_stage = stage;
+            m_nb_stage_attempts = 0;
+            break;
+         }
+      }
+   }
+   if (m_stage == StreamRecoveryStage::none)
+      return StreamRecoveryStage::none;
+
+   m_nb_stage_attempts++;
+   m_nb_stall_attempts++;
+   return m_stage;
+}
+
+void StreamWatchdog::end_stall()
+{
+   const double time_to_recovery_ms =
+       std::chrono::duration<double, std::milli>(m_last_progress - m_stall_begin).count();
+   m_statistics.nb_recoveries++;
+   m_time_to_recovery_sum_ms += time_to_recovery_ms;
+   m_statistics.mean_time_to_recovery_ms = m_time_to_recovery_sum_ms / m_statistics.nb_recoveries;
+   m_statistics.max_time_to_recovery_ms = std::max(m_statistics.max_time_to_recovery_ms, time_to_recovery_ms);
+
+   std::cout << "Stream recovered in " << std::fixed << std::setprecision(0) << time_to_recovery_ms << " ms by "
+             << (m_stage == StreamRecoveryStage::none ? "itself" : to_string(m_stage)) << " - mean time to recovery "
+             << m_statistics.mean_time_to_recovery_ms << " ms over " << m_statistics.nb_recoveries << " recoveries"
+             << std::defaultfloat << std::endl;
+   if (m_flight_recorder)
+      m_flight_recorder->record_event(FlightRecordType::recovered, static_cast<uint32_t>(time_to_recovery_ms));
+   reset_stall();
+}
+
+void StreamWatchdog::reset_stall()
+{
+   m_stalled = false;
+   m_stage = StreamRecoveryStage::none;
+   m_nb_stage_attempts = 0;
+   m_nb_stall_attempts = 0;
+   m_last_attempt = clock::time_point();
+   m_next_attempt = clock::time_point();
+}
@@ -0,0 +1,183 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file stream_watchdog.h
+   @brief This file contains the stall watchdog of the slot loops and their staged recovery.
+
+   @detail A stream is stalled when no slot completed within stall_frame_periods frame periods, e.g. when every
+   slot lock times out, or as soon as the slot loop fails. The watchdog then runs the recovery stages in order, each
+   one attempts_per_stage times before the next one: the stream restart, the stream re-open, and the board re-init.
+   The attempts are spaced by a backoff that doubles at every attempt, and an attempt that succeeded is given
+   stall_frame_periods frame periods to complete a slot before the next one. The stall ends at the first completed
+   slot, the time to recovery is counted from the last slot completed before the stall. After max_attempts_per_stall
+   attempts, or when the slot loop has no recovery action, the stall is given up and the slot loop handles the
+   failure as without the watchdog.
+
+   The slot loop keeps running during the recovery, so the NMOS node and its resources are left as they are.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <chrono>
+#include <functional>
+
+#include "tools.h"
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Core.h"
+#else
+#include "VideoMasterHD_Core.h"
+#endif
+
+class FlightRecorder;
+
+struct StreamWatchdogConfig
+{
+   bool enabled = false /*! Recover the stalled streams, else the slot loop handles the failures as before */;
+   uint32_t stall_frame_periods = 10 /*! Frame periods without a completed slot before the stream is stalled */;
+   uint32_t attempts_per_stage = 2 /*! Attempts of a recovery stage before the next one */;
+   uint32_t max_attempts_per_stall = 10 /*! Attempts before the stall is given up, the last stage being repeated */;
+   std::chrono::milliseconds initial_backoff{100} /*! Delay before the second attempt, doubled at every attempt */;
+   std::chrono::milliseconds max_backoff{5000};
+};
+
+enum class StreamRecoveryStage : uint32_t
+{
+   none = 0,
+   restart_stream = 1 /*! Stop and start the stream */,
+   reopen_stream = 2 /*! Close the stream, open, configure and start it again */,
+   reinit_board = 3 /*! Close the board handle, open and configure the board again, then re-open the stream */,
+};
+
+/*!
+   @brief Recovery actions of a slot loop, a stage without action is skipped
+*/
+struct StreamRecoveryActions
+{
+   std::function<VHD_ERRORCODE()> restart_stream;
+   std::function<VHD_ERRORCODE()> reopen_stream;
+   std::function<VHD_ERRORCODE()> reinit_board;
+};
+
+struct StreamWatchdogStatistics
+{
+   uint64_t nb_stalls = 0;
+   uint64_t nb_recoveries = 0 /*! Stalls ended by a completed slot */;
+   uint64_t nb_given_up_stalls = 0 /*! Stalls left to the slot loop after max_attempts_per_stall attempts */;
+   uint64_t nb_stream_restarts = 0;
+   uint64_t nb_stream_reopens = 0;
+   uint64_t nb_board_reinits = 0;
+   uint64_t nb_failed_attempts = 0 /*! Recovery actions that returned an error */;
+   double mean_time_to_recovery_ms = 0.0;
+   double max_time_to_recovery_ms = 0.0;
+};
+
+/*!
+   @brief Stall detection and staged recovery of one stream, driven from its slot loop
+*/
+class StreamWatchdog
+{
+public:
+   StreamWatchdog(const StreamWatchdogConfig& config /*!< [in] Stall threshold and recovery backoff*/,
+                  FlightRecorder* flight_recorder = nullptr /*!< [in] Recorder of the stalls and recoveries*/);
+
+   StreamWatchdog(const StreamWatchdog&) = delete;
+   StreamWatchdog& operator=(const StreamWatchdog&) = delete;
+
+   bool is_enabled() const { return m_config.enabled; }
+
+   /*!
+      @brief Start watching a stream, to be called every time the slot loop starts
+
+      @detail A stall still open, e.g. when the slot loop stopped on a deactivation during the recovery, is abandoned
+      without being counted as a recovery.
+   */
+   void arm(const VideoStandardInfo& video_standard_info /*!< [in] Video standard of the stream*/);
+
+   /*!
+      @brief Account for a completed slot, to be called by the slot loop after each slot unlock, ends a stall
+   */
+   void on_slot_completed()
+   {
+      if (!m_config.enabled)
+         return;
+      m_last_progress = clock::now();
+      m_given_up = false;
+      if (m_stalled)
+         end_stall();
+   }
+
+   /*!
+      @brief Account for a slot lock that timed out or a failure of the slot loop, and run the recovery stage due
+
+      @detail While the next attempt is not due, a failure waits at most one frame period before returning, so that
+      the slot loop neither spins nor stops reading the keyboard.
+
+      @returns false if the watchdog is disabled or the stall is given up (until a slot completes), the slot loop
+      then handles the failure as before
+   */
+   bool on_stall(const StreamRecoveryActions& actions /*!< [in] Recovery actions of the slot loop*/,
+                 VHD_ERRORCODE error /*!< [in] VHDERR_TIMEOUT for a slot lock timeout, else a failure of the loop*/);
+
+   StreamWatchdogStatistics get_statistics() const { return m_statistics; }
+
+   void print_statistics() const;
+
+private:
+   using clock = std::chrono::steady_clock;
+
+   StreamRecoveryStage next_stage(const StreamRecoveryActions& actions);
+   void end_stall();
+   void reset_stall();
+
+   const StreamWatchdogConfig m_config;
+   FlightRecorder* const m_flight_recorder;
+   clock::duration m_stall_threshold{0};
+   clock::duration m_frame_period{0};
+   clock::time_point m_last_progress = clock::now();
+
+   bool m_stalled = false;
+   clock::time_point m_stall_begin;
+   clock::time_point m_last_attempt;
+   clock::time_point m_next_attempt;
+   StreamRecoveryStage m_stage = StreamRecoveryStage::none;
+   uint32_t m_nb_stage_attempts = 0;
+   uint32_t m_nb_stall_attempts = 0;
+   bool m_given_up = false /*! The last stall was given up, cleared by a completed slot or arm() */;
+
+   double m_time_to_recovery_sum_ms = 0.0;
+   StreamWatchdogStatistics m_statistics;
+};
+
+/*!
+   @brief Name of a recovery stage
+
+   @detail Inline so that the flight decoder can name the recorded stages without linking the watchdog.
+*/
+inline const char* to_string(StreamRecoveryStage stage /*!< [in] Recovery stage*/)
+{
+   switch (stage)
+   {
+   case StreamRecoveryStage::restart_stream: return "stream restart";
+   case StreamRecoveryStage::reopen_stream: return "stream re-open";
+   case StreamRecoveryStage::reinit_board: return "board re-init";
+   default: return "none";
+   }
+}
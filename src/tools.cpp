@@ -23,6 +23,11 @@
 #include <vector>
 
 #include "tools.h"
+#include "board_backend.h"
+#include "flight_recorder.h"
+#include "multicast_membership.h"
+#include "queue_controller.h"
+#include "slot_tracer.h"
 
 #if defined(__APPLE__)
 #include "VideoMasterHD/VideoMasterHD_Ip_Board.h"
@@ -50,16 +55,16 @@ VHD_ERRORCODE get_nic_mac_address(HANDLE board_handle, std::string& mac_address)
    VHD_ERRORCODE result;
    ULONG mac_lsw, mac_msw;
 
-   result = static_cast<VHD_ERRORCODE>(VHD_GetEthernetPortProperty(
-       board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_FACTORY_MAC_ADDR_LSW, &mac_lsw));
+   result = board_backend().get_ethernet_port_property(
+       board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_FACTORY_MAC_ADDR_LSW, &mac_lsw);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error getting MAC address LSW: " << to_string(result) << std::endl;
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_GetEthernetPortProperty(
-       board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_FACTORY_MAC_ADDR_MSW, &mac_msw));
+   result = board_backend().get_ethernet_port_property(
+       board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_FACTORY_MAC_ADDR_MSW, &mac_msw);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error getting MAC address MSW: " << to_string(result) << std::endl;
@@ -91,143 +96,15 @@ VHD_ERRORCODE get_nic_mac_address(HANDLE board_handle, std::string& mac_address)
 VHD_ERRORCODE get_video_standard_info(VHD_ST2110_20_VIDEO_STANDARD video_standard,
    uint32_t& frame_width, uint32_t& frame_height, uint32_t& frame_rate, bool& interlaced, bool& is_us)
 {
-   switch (video_standard)
-   {
-   case VHD_ST2110_20_VIDEOSTD_720x480i59:
-   case VHD_ST2110_20_VIDEOSTD_720x487i59:
-      frame_width = 720;
-      frame_height = (video_standard == VHD_ST2110_20_VIDEOSTD_720x480i59) ? 480 : 487;
-      frame_rate = 60;
-      interlaced = true;
-      is_us = true;
-      break;
-   case VHD_ST2110_20_VIDEOSTD_720x576i50:
-      frame_width = 720;
-      frame_height = 576;
-      frame_rate = 50;
-      interlaced = true;
-      is_us = false;
-      break;
-   case VHD_ST2110_20_VIDEOSTD_1280x720p50:
-   case VHD_ST2110_20_VIDEOSTD_1280x720p59:
-   case VHD_ST2110_20_VIDEOSTD_1280x720p60:
-      frame_width = 1280;
-      frame_height = 720;
-      frame_rate = (video_standard == VHD_ST2110_20_VIDEOSTD_1280x720p50) ? 50 : 60;
-      interlaced = false;
-      is_us = (video_standard == VHD_ST2110_20_VIDEOSTD_1280x720p59);
-      break;
-   case VHD_ST2110_20_VIDEOSTD_1920x1080i50:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080i59:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080i60:
-      frame_width = 1920;
-      frame_height = 1080;
-
-      frame_rate = (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080i50) ? 50 : 60;
-      interlaced = true;
-      is_us = (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080i59);
-      break;
-   case VHD_ST2110_20_VIDEOSTD_1920x1080p23:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080p24:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080p25:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080p29:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080p30:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080p50:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080p59:
-   case VHD_ST2110_20_VIDEOSTD_1920x1080p60:
-      frame_width = 1920;
-      frame_height = 1080;
-      interlaced = false;
-      frame_rate = (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p23) ? 24 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p24) ? 24 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p25) ? 25 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p29) ? 30 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p30) ? 30 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p50) ? 50 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p59) ? 60 : 60;
-      is_us = (video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p23 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p29 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_1920x1080p59);
-      break;
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p23:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p24:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p25:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p29:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p30:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p47:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p48:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p50:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p59:
-   case VHD_ST2110_20_VIDEOSTD_2048x1080p60:
-      frame_width = 2048;
-      frame_height = 1080;
-      interlaced = false;
-      frame_rate = (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p23) ? 24 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p24) ? 24 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p25) ? 25 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p29) ? 30 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p30) ? 30 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p47) ? 48 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p48) ? 48 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p50) ? 50 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p59) ? 60 : 60;
-      is_us = (video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p23 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p29 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p47 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_2048x1080p59);
-      break;
-   case VHD_ST2110_20_VIDEOSTD_3840x2160p23:
-   case VHD_ST2110_20_VIDEOSTD_3840x2160p24:
-   case VHD_ST2110_20_VIDEOSTD_3840x2160p25:
-   case VHD_ST2110_20_VIDEOSTD_3840x2160p29:
-   case VHD_ST2110_20_VIDEOSTD_3840x2160p30:
-   case VHD_ST2110_20_VIDEOSTD_3840x2160p50:
-   case VHD_ST2110_20_VIDEOSTD_3840x2160p59:
-   case VHD_ST2110_20_VIDEOSTD_3840x2160p60:
-      frame_width = 3840;
-      frame_height = 2160;
-      interlaced = false;
-      frame_rate = (video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p23) ? 24 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p24) ? 24 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p25) ? 25 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p29) ? 30 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p30) ? 30 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p50) ? 50 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p59) ? 60 : 60;
-      is_us = (video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p23 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p29 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_3840x2160p59);
-      break;
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p23:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p24:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p25:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p29:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p30:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p47:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p48:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p50:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p59:
-   case VHD_ST2110_20_VIDEOSTD_4096x2160p60:
-      frame_width = 4096;
-      frame_height = 2160;
-      interlaced = false;
-      frame_rate = (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p23) ? 24 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p24) ? 24 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p25) ? 25 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p29) ? 30 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p30) ? 30 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p47) ? 48 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p48) ? 48 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p50) ? 50 :
-         (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p59) ? 60 : 60;
-      is_us = (video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p23 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p29 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p47 ||
-         video_standard == VHD_ST2110_20_VIDEOSTD_4096x2160p59);
-      break;
-   default:
+   const VideoStandardInfo* info = find_video_standard_info(video_standard);
+   if (!info)
       return VHDERR_BADARG;
-   }
+
+   frame_width = info->frame_width;
+   frame_height = info->frame_height;
+   frame_rate = info->frame_rate;
+   interlaced = info->interlaced;
+   is_us = info->is_us;
    return VHDERR_NOERROR;
 }
 
@@ -239,7 +116,7 @@ VHD_ERRORCODE configure_nic(HANDLE board_handle, uint32_t ip_address, uint32_t s
    if (!is_dhcp_enabled)
    {
       // Disable DHCP
-      result = static_cast<VHD_ERRORCODE>(VHD_DisableDHCP(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0));
+      result = board_backend().disable_dhcp(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0);
       if (result != VHDERR_NOERROR)
       {
          std::cout << "Error disabling DHCP: " << to_string(result) << std::endl;
@@ -247,8 +124,8 @@ VHD_ERRORCODE configure_nic(HANDLE board_handle, uint32_t ip_address, uint32_t s
       }
 
       // Set IP address
-      result = static_cast<VHD_ERRORCODE>(
-          VHD_SetEthernetPortProperty(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_IP_ADDR, ip_address));
+      result = board_backend(
+          ).set_ethernet_port_property(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_IP_ADDR, ip_address);
       if (result != VHDERR_NOERROR)
       {
          std::cout << "Error setting IP address: " << to_string(result) << std::endl;
@@ -256,8 +133,8 @@ VHD_ERRORCODE configure_nic(HANDLE board_handle, uint32_t ip_address, uint32_t s
       }
 
       // Set subnet mask
-      result = static_cast<VHD_ERRORCODE>(VHD_SetEthernetPortProperty(
-          board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_SUBNET_MASK, subnet_mask));
+      result = board_backend().set_ethernet_port_property(
+          board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_SUBNET_MASK, subnet_mask);
       if (result != VHDERR_NOERROR)
       {
          std::cout << "Error setting subnet mask: " << to_string(result) << std::endl;
@@ -265,8 +142,8 @@ VHD_ERRORCODE configure_nic(HANDLE board_handle, uint32_t ip_address, uint32_t s
       }
 
       // Set gateway
-      result = static_cast<VHD_ERRORCODE>(VHD_SetEthernetPortProperty(
-          board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_GATEWAY_ADDR, gateway));
+      result = board_backend().set_ethernet_port_property(
+          board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_GATEWAY_ADDR, gateway);
       if (result != VHDERR_NOERROR)
       {
          std::cout << "Error setting gateway: " << to_string(result) << std::endl;
@@ -276,7 +153,7 @@ VHD_ERRORCODE configure_nic(HANDLE board_handle, uint32_t ip_address, uint32_t s
    else
    {
       // Enable DHCP
-      result = static_cast<VHD_ERRORCODE>(VHD_EnableDHCP(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0));
+      result = board_backend().enable_dhcp(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0);
       if (result != VHDERR_NOERROR)
       {
          std::cout << "Error enabling DHCP: " << to_string(result) << std::endl;
@@ -287,13 +164,23 @@ VHD_ERRORCODE configure_nic(HANDLE board_handle, uint32_t ip_address, uint32_t s
    return VHDERR_NOERROR;
 }
 
+VHD_ERRORCODE reconcile_board_property(HANDLE board_handle, ULONG property, ULONG value, bool* applied)
+{
+   ULONG current = 0;
+   const bool in_place = board_backend().get_board_property(board_handle, property, &current) == VHDERR_NOERROR &&
+                         current == value;
+   if (applied)
+      *applied = !in_place;
+   return in_place ? VHDERR_NOERROR : board_backend().set_board_property(board_handle, property, value);
+}
+
 VHD_ERRORCODE configure_stream(HANDLE board_handle,
                                HANDLE& stream_handle,
                                VHD_STREAMTYPE stream_type,
                                VHD_ST2110_20_VIDEO_STANDARD video_standard,
-                               uint32_t destination_ip,
+                               const Ipv4Endpoint& destination,
                                uint32_t destination_ssrc,
-                               uint16_t destination_udp_port)
+                               const VideoFormat& video_format)
 {
    VHD_ERRORCODE result;
    uint32_t frame_width;
@@ -307,111 +194,104 @@ VHD_ERRORCODE configure_stream(HANDLE board_handle,
       std::cout << "Error getting video standard info: " << to_string(result) << std::endl;
       return result;
    }
-   if (is_us)
-      VHD_SetBoardProperty(board_handle, VHD_SDI_BP_CLOCK_SYSTEM, VHD_CLOCKDIV_1001);
-   else
-      VHD_SetBoardProperty(board_handle, VHD_SDI_BP_CLOCK_SYSTEM, VHD_CLOCKDIV_1);
+   // Setting the clock system again when the board already runs on it would only disturb its clocks
+   reconcile_board_property(board_handle, VHD_SDI_BP_CLOCK_SYSTEM, is_us ? VHD_CLOCKDIV_1001 : VHD_CLOCKDIV_1);
 
-   result = static_cast<VHD_ERRORCODE>(VHD_OpenStreamHandle(
-       board_handle, stream_type, VHD_ST2110_STPROC_DISJOINED_VIDEO, nullptr, &stream_handle, nullptr));
+   result = board_backend().open_stream_handle(
+       board_handle, stream_type, VHD_ST2110_STPROC_DISJOINED_VIDEO, nullptr, &stream_handle, nullptr);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error opening stream handle: " << to_string(result) << std::endl;
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_CORE_SP_BUFFER_PACKING, VHD_BUFPACK_VIDEO_YUV422_8));
+   result = board_backend().set_stream_property(stream_handle, VHD_CORE_SP_BUFFER_PACKING, VHD_BUFPACK_VIDEO_YUV422_8);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting buffer packing: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(stream_handle, VHD_CORE_SP_IO_TIMEOUT, 200));
+   result = board_backend().set_stream_property(stream_handle, VHD_CORE_SP_IO_TIMEOUT, 200);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting IO timeout: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_CORE_SP_TRANSFER_SCHEME, VHD_TRANSFER_SLAVED));
+   result = board_backend().set_stream_property(stream_handle, VHD_CORE_SP_TRANSFER_SCHEME, VHD_TRANSFER_SLAVED);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting transfer scheme: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(stream_handle, VHD_IP_BRD_BP_ARP_TIMEOUT, 10000));
+   result = board_backend().set_stream_property(stream_handle, VHD_IP_BRD_BP_ARP_TIMEOUT, 10000);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting ARP timeout: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(stream_handle, VHD_IP_BRD_SP_IP_DST, destination_ip));
+   result = board_backend().set_stream_property(stream_handle, VHD_IP_BRD_SP_IP_DST, destination.address.value());
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting destination IP: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(stream_handle, VHD_IP_BRD_SP_SSRC, destination_ssrc));
+   result = board_backend().set_stream_property(stream_handle, VHD_IP_BRD_SP_SSRC, destination_ssrc);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting SSRC: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_IP_BRD_SP_UDP_PORT_DST, destination_udp_port));
+   result = board_backend().set_stream_property(stream_handle, VHD_IP_BRD_SP_UDP_PORT_DST, destination.port);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting destination UDP port: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_ST2110_20_SP_SAMPLING, VHD_ST2110_20_SAMPLING_YUV_422));
+   // The card converts the YUV 4:2:2 8-bit slots to the sampling and depth sent on the network
+   result = board_backend().set_stream_property(stream_handle, VHD_ST2110_20_SP_SAMPLING, video_format.sampling);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting sampling: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_ST2110_20_SP_DEPTH, VHD_ST2110_20_DEPTH_10BIT));
+   result = board_backend().set_stream_property(stream_handle, VHD_ST2110_20_SP_DEPTH, video_format.depth);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting depth: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(
-       stream_handle, VHD_ST2110_20_SP_TRAFFIC_SHAPING_MODE, VHD_ST2110_20_TRAFFIC_SHAPING_MODE_LINEAR));
+   result = board_backend().set_stream_property(
+       stream_handle, VHD_ST2110_20_SP_TRAFFIC_SHAPING_MODE, VHD_ST2110_20_TRAFFIC_SHAPING_MODE_LINEAR);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting traffic shaping mode: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_ST2110_20_SP_VIDEO_STANDARD, video_standard));
+   result = board_backend().set_stream_property(stream_handle, VHD_ST2110_20_SP_VIDEO_STANDARD, video_standard);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting video standard: " << to_string(result) << std::endl;
-      VHD_CloseStreamHandle(stream_handle);
+      board_backend().close_stream_handle(stream_handle);
       return result;
    }
 
@@ -420,16 +300,15 @@ VHD_ERRORCODE configure_stream(HANDLE board_handle,
 
 VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
                                         std::string sdp,
-                                        const uint32_t destination_ip_overrides,
-                                        const uint16_t destination_udp_port_overrides,
+                                        const Ipv4Endpoint& destination_overrides,
                                         HANDLE stream_handle,
-                                        uint32_t& multicast_group)
+                                        Ipv4Address& multicast_group)
 {
    VHD_ERRORCODE result;
    HANDLE sdp_parser_handle = NULL;
    ULONG video_standard, sampling, depth, udp_port, ip_address;
 
-   multicast_group = 0u;
+   multicast_group = Ipv4Address();
 
    // const-cast
    result = static_cast<VHD_ERRORCODE>(
@@ -486,17 +365,18 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
    }
 
    // Override destination IP and UDP port if provided
-   if (destination_ip_overrides != 0)
+   if (!destination_overrides.address.is_unspecified())
    {
-      ip_address = destination_ip_overrides;
+      ip_address = destination_overrides.address.value();
    }
-   if (destination_udp_port_overrides != 0)
+   if (destination_overrides.port != 0)
    {
-      udp_port = destination_udp_port_overrides;
+      udp_port = destination_overrides.port;
    }
+   const Ipv4Endpoint destination = {Ipv4Address(ip_address), static_cast<uint16_t>(udp_port)};
 
    // Configure board properties
-   result = static_cast<VHD_ERRORCODE>(VHD_SetBoardProperty(board_handle, VHD_IP_BRD_BP_RX0_UDP_PORT, udp_port));
+   result = board_backend().set_board_property(board_handle, VHD_IP_BRD_BP_RX0_UDP_PORT, udp_port);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting board UDP port: " << to_string(result) << std::endl;
@@ -504,23 +384,20 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
       return result;
    }
 
-   if ((ip_address & 0xF0000000) == 0xE0000000)
-   { // Check if IP address is multicast
-      // Join multicast group
-      result =
-          static_cast<VHD_ERRORCODE>(VHD_JoinMulticastGroup(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, ip_address));
+   if (destination.address.is_multicast())
+   {
+      // Join multicast group, unless the board is already a member
+      result = multicast_membership().join(board_handle, destination.address, stream_handle);
       if (result != VHDERR_NOERROR)
       {
-         std::cout << "Error joining multicast group: " << to_string(result) << std::endl;
          VHD_CloseSDPParserHandle(sdp_parser_handle);
          return result;
       }
-      multicast_group = ip_address;
+      multicast_group = destination.address;
    }
 
    // Configure stream properties
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_CORE_SP_TRANSFER_SCHEME, VHD_TRANSFER_SLAVED));
+   result = board_backend().set_stream_property(stream_handle, VHD_CORE_SP_TRANSFER_SCHEME, VHD_TRANSFER_SLAVED);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting transfer scheme: " << to_string(result) << std::endl;
@@ -528,8 +405,7 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_SetStreamProperty(stream_handle, VHD_ST2110_20_SP_VIDEO_STANDARD, video_standard));
+   result = board_backend().set_stream_property(stream_handle, VHD_ST2110_20_SP_VIDEO_STANDARD, video_standard);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error setting video standard: " << to_string(result) << std::endl;
@@ -537,21 +413,21 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(stream_handle, VHD_ST2110_20_SP_SAMPLING, sampling));
+   result = board_backend().set_stream_property(stream_handle, VHD_ST2110_20_SP_SAMPLING, sampling);
    if (result != VHDERR_NOERROR) {
       std::cout << "Error setting sampling: " << to_string(result) << std::endl;
       VHD_CloseSDPParserHandle(sdp_parser_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(stream_handle, VHD_ST2110_20_SP_DEPTH, depth));
+   result = board_backend().set_stream_property(stream_handle, VHD_ST2110_20_SP_DEPTH, depth);
    if (result != VHDERR_NOERROR) {
       std::cout << "Error setting depth: " << to_string(result) << std::endl;
       VHD_CloseSDPParserHandle(sdp_parser_handle);
       return result;
    }
 
-   result = static_cast<VHD_ERRORCODE>(VHD_SetStreamProperty(stream_handle, VHD_CORE_SP_BUFFER_PACKING, VHD_BUFPACK_VIDEO_YUV422_10));
+   result = board_backend().set_stream_property(stream_handle, VHD_CORE_SP_BUFFER_PACKING, VHD_BUFPACK_VIDEO_YUV422_10);
    if (result != VHDERR_NOERROR) {
       std::cout << "Error setting buffer packing: " << to_string(result) << std::endl;
       VHD_CloseSDPParserHandle(sdp_parser_handle);
@@ -559,7 +435,7 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
    }
 
    // Set destination IP for filtering
-   result = static_cast<VHD_ERRORCODE>(VHD_SetBoardProperty(board_handle, VHD_IP_BRD_SP_IP_DST, ip_address));
+   result = board_backend().set_board_property(board_handle, VHD_IP_BRD_SP_IP_DST, ip_address);
    if (result != VHDERR_NOERROR) {
       std::cout << "Error setting VHD_IP_BRD_SP_IP_DST: " << to_string(result) << std::endl;
       VHD_CloseSDPParserHandle(sdp_parser_handle);
@@ -567,7 +443,7 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
    }
 
    // Set destination IP for SPS filtering
-   result = static_cast<VHD_ERRORCODE>(VHD_SetBoardProperty(board_handle, VHD_IP_BRD_SP_SPS_IP_DST, ip_address));
+   result = board_backend().set_board_property(board_handle, VHD_IP_BRD_SP_SPS_IP_DST, ip_address);
    if (result != VHDERR_NOERROR) {
       std::cout << "Error setting VHD_IP_BRD_SP_SPS_IP_DST: " << to_string(result) << std::endl;
       VHD_CloseSDPParserHandle(sdp_parser_handle);
@@ -575,7 +451,7 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
    }
 
    // Set UDP port for filtering
-   result = static_cast<VHD_ERRORCODE>(VHD_SetBoardProperty(board_handle, VHD_IP_BRD_SP_UDP_PORT_DST, udp_port));
+   result = board_backend().set_board_property(board_handle, VHD_IP_BRD_SP_UDP_PORT_DST, udp_port);
    if (result != VHDERR_NOERROR) {
       std::cout << "Error setting VHD_IP_BRD_SP_UDP_PORT_DST: " << to_string(result) << std::endl;
       VHD_CloseSDPParserHandle(sdp_parser_handle);
@@ -585,7 +461,7 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
    // Set filtering mask
    const ULONG FilteringMask_UL = VHD_IP_FILTER_IP_ADDR_DEST | VHD_IP_FILTER_UDP_PORT_DEST;
    result =
-       static_cast<VHD_ERRORCODE>(VHD_SetBoardProperty(board_handle, VHD_IP_BRD_SP_FILTERING_MASK, FilteringMask_UL));
+       board_backend().set_board_property(board_handle, VHD_IP_BRD_SP_FILTERING_MASK, FilteringMask_UL);
    if (result != VHDERR_NOERROR) {
       std::cout << "Error setting VHD_IP_BRD_SP_FILTERING_MASK: " << to_string(result) << std::endl;
       VHD_CloseSDPParserHandle(sdp_parser_handle);
@@ -602,8 +478,7 @@ VHD_ERRORCODE configure_stream_from_sdp(HANDLE board_handle,
              << VHD_ST2110_20_SAMPLING_ToPrettyString(static_cast<VHD_ST2110_20_SAMPLING>(sampling)) << std::endl;
    std::cout << "\t\tDepth: " << VHD_ST2110_20_DEPTH_ToPrettyString(static_cast<VHD_ST2110_20_DEPTH>(depth))
              << std::endl;
-   std::cout << "\tUDP port: " << udp_port << std::endl;
-   std::cout << "\tIP address: " << ip_address << std::endl;
+   std::cout << "\tDestination: " << to_chars(destination).c_str() << std::endl;
 
    VHD_CloseSDPParserHandle(sdp_parser_handle);
    return VHDERR_NOERROR;
@@ -625,38 +500,41 @@ VHD_ERRORCODE generate_sdp(HANDLE board_handle, HANDLE stream_handle, std::strin
    ULONG dest_ip_address;
    ULONG dest_port;
    ULONG video_standard;
+   ULONG sampling;
    ULONG bit_depth;
 
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_GetEthernetPortProperty(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_IP_ADDR, &ip_address));
+   result = board_backend(
+       ).get_ethernet_port_property(board_handle, VHD_IP_BRD_ETHERNETPORT_ETH_0, VHD_IP_BRD_EP_IP_ADDR, &ip_address);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error getting IP address: " << to_string(result) << std::endl;
       return result;
    }
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_GetStreamProperty(stream_handle, VHD_IP_BRD_SP_IP_DST, &dest_ip_address));
+   result = board_backend().get_stream_property(stream_handle, VHD_IP_BRD_SP_IP_DST, &dest_ip_address);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error getting destination IP address: " << to_string(result) << std::endl;
       return result;
    }
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_GetStreamProperty(stream_handle, VHD_IP_BRD_SP_UDP_PORT_DST, &dest_port));
+   result = board_backend().get_stream_property(stream_handle, VHD_IP_BRD_SP_UDP_PORT_DST, &dest_port);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error getting destination UDP port: " << to_string(result) << std::endl;
       return result;
    }
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_GetStreamProperty(stream_handle, VHD_ST2110_20_SP_VIDEO_STANDARD, &video_standard));
+   result = board_backend().get_stream_property(stream_handle, VHD_ST2110_20_SP_VIDEO_STANDARD, &video_standard);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error getting video standard: " << to_string(result) << std::endl;
       return result;
    }
-   result = static_cast<VHD_ERRORCODE>(
-       VHD_GetStreamProperty(stream_handle, VHD_ST2110_20_SP_DEPTH, &bit_depth));
+   result = board_backend().get_stream_property(stream_handle, VHD_ST2110_20_SP_SAMPLING, &sampling);
+   if (result != VHDERR_NOERROR)
+   {
+      std::cout << "Error getting sampling: " << to_string(result) << std::endl;
+      return result;
+   }
+   result = board_backend().get_stream_property(stream_handle, VHD_ST2110_20_SP_DEPTH, &bit_depth);
    if (result != VHDERR_NOERROR)
    {
       std::cout << "Error getting bit depth: " << to_string(result) << std::endl;
@@ -702,7 +580,7 @@ VHD_ERRORCODE generate_sdp(HANDLE board_handle, HANDLE stream_handle, std::strin
    VHD_SetSDPStreamProperty(sdp_parser_handle, VHD_SDP_STREAM_PROPERTY_VIDEO_RTP_PAYLOAD_ID, 98);
    VHD_SetSDPStreamProperty(sdp_parser_handle, VHD_SDP_STREAM_PROPERTY_VIDEO_DESTINATION_UDP_PORT, dest_port);
    VHD_SetSDPStreamProperty(sdp_parser_handle, VHD_SDP_STREAM_PROPERTY_VIDEO_STANDARD, video_standard);
-   VHD_SetSDPStreamProperty(sdp_parser_handle, VHD_SDP_STREAM_PROPERTY_VIDEO_SAMPLING, VHD_ST2110_20_SAMPLING_YUV_422);
+   VHD_SetSDPStreamProperty(sdp_parser_handle, VHD_SDP_STREAM_PROPERTY_VIDEO_SAMPLING, sampling);
    VHD_SetSDPStreamProperty(sdp_parser_handle, VHD_SDP_STREAM_PROPERTY_VIDEO_BIT_DEPTH, bit_depth);
    std::strcpy(work_buffer, colorimetry);
    VHD_SetSDPStringStreamProperty(sdp_parser_handle,
@@ -729,23 +607,21 @@ VHD_ERRORCODE generate_sdp(HANDLE board_handle, HANDLE stream_handle, std::strin
    return result;
 }
 
-VHD_ERRORCODE leave_multicast(HANDLE board, uint32_t& multicast_group)
+VHD_ERRORCODE leave_multicast(HANDLE board, Ipv4Address& multicast_group)
 {
     VHD_ERRORCODE result = VHDERR_NOERROR;
-    if (multicast_group != 0u)
+    if (!multicast_group.is_unspecified())
     {
-        result = static_cast<VHD_ERRORCODE>(VHD_LeaveMulticastGroup(board, VHD_IP_BRD_ETHERNETPORT_ETH_0, multicast_group));
-        if (result != VHDERR_NOERROR)
-            std::cout << "Error when leaving the multicast group" << " [" << to_string(result) << "]" << std::endl;
-        multicast_group = 0u;
+        result = multicast_membership().leave(board, multicast_group);
+        multicast_group = Ipv4Address();
     }
     return result;
 }
 
-VHD_ERRORCODE apply_ptp_parameters(HANDLE board_handle, uint8_t domain_number, uint8_t announce_receipt_timeout)
+VHD_ERRORCODE make_ptp_configuration(HANDLE board_handle, uint8_t domain_number, uint8_t announce_receipt_timeout,
+                                     VHD_PTP_CONFIGURATION& ptp_config)
 {
    VHD_ERRORCODE result;
-   VHD_PTP_CONFIGURATION ptp_config;
    VHD_PTP_DEFAULTDS default_ds;
    VHD_PTP_PORTDS port_ds;
 
@@ -758,7 +634,7 @@ VHD_ERRORCODE apply_ptp_parameters(HANDLE board_handle, uint8_t domain_number, u
    }
 
    // Get the current PTP configuration
-   result = static_cast<VHD_ERRORCODE>(VHD_GetPTPConfiguration(board_handle, &ptp_config));
+   result = board_backend().get_ptp_configuration(board_handle, &ptp_config);
    if (result != VHDERR_NOERROR)
    {
       std::cout << std::endl << "Error when getting the PTP config" << " [" << to_string(result) << "]" << std::endl;
@@ -770,9 +646,18 @@ VHD_ERRORCODE apply_ptp_parameters(HANDLE board_handle, uint8_t domain_number, u
    ptp_config.PortDS = port_ds;
    ptp_config.DefaultDS.DomainNumber = domain_number;
    ptp_config.PortDS.AnnounceReceiptTimeout = announce_receipt_timeout;
+   return VHDERR_NOERROR;
+}
+
+VHD_ERRORCODE apply_ptp_parameters(HANDLE board_handle, uint8_t domain_number, uint8_t announce_receipt_timeout)
+{
+   VHD_PTP_CONFIGURATION ptp_config;
+   VHD_ERRORCODE result = make_ptp_configuration(board_handle, domain_number, announce_receipt_timeout, ptp_config);
+   if (result != VHDERR_NOERROR)
+      return result;
 
    // Set the updated PTP configuration
-   result = static_cast<VHD_ERRORCODE>(VHD_SetPTPConfiguration(board_handle, ptp_config));
+   result = board_backend().set_ptp_configuration(board_handle, ptp_config);
    if (result != VHDERR_NOERROR)
    {
       std::cout << std::endl << "Error when setting the PTP config" << " [" << to_string(result) << "]" << std::endl;
@@ -781,79 +666,92 @@ VHD_ERRORCODE apply_ptp_parameters(HANDLE board_handle, uint8_t domain_number, u
    return result;
 }
 
-VHD_ERRORCODE print_ptp_status(HANDLE board_handle, uint8_t domain_number, uint8_t announce_receipt_timeout)
+namespace
 {
-    VHD_ERRORCODE result;
-    VHD_PTP_PORT_STATE ptp_state;
-    BOOL32 locked;
-    LONG offset_sec = 0u, offset_nsec = 0u;
-
-    result = static_cast<VHD_ERRORCODE>(VHD_GetPTPPortState(board_handle, &ptp_state, &locked));
-    if (result != VHDERR_NOERROR)
-    {
-        std::cout << std::endl << "Error when getting the PTP port state" << " [" << to_string(result) << "]" << std::endl;
-        return result;
-    }
-
-    result = static_cast<VHD_ERRORCODE>(VHD_GetPTPOffset(board_handle, &offset_sec, &offset_nsec));
-    if (result != VHDERR_NOERROR)
-    {
-        std::cout << std::endl << "Error when getting the PTP offset" << " [" << to_string(result) << "]" << std::endl;
-        return result;
-    }
-
-    // Calculate total offset in seconds
-    double total_offset = offset_sec + (offset_nsec / 1e9);
-
-    std::cout << "PTP : Domain Number = " << static_cast<int>(domain_number)
-              << " Announce Receipt Timeout = " << static_cast<int>(announce_receipt_timeout)
-              << " State = " << to_string(ptp_state)
-              << " (Offset : " << total_offset << " seconds)                 \r" << std::flush;
-
-    return VHDERR_NOERROR;
+   FlightStreamSample make_flight_stream_sample(ULONG slots_count, ULONG slots_dropped, ULONG jitter_max,
+                                                ULONG datagram_count, uint32_t slot_timeouts)
+   {
+      FlightStreamSample sample;
+      sample.slots_count = static_cast<uint32_t>(slots_count);
+      sample.slots_dropped = static_cast<uint32_t>(slots_dropped);
+      sample.jitter_max = static_cast<uint32_t>(jitter_max);
+      sample.datagram_count = static_cast<uint32_t>(datagram_count);
+      sample.slot_timeouts = slot_timeouts;
+      return sample;
+   }
 }
 
 using namespace std::chrono_literals;
-void monitor_rx_stream_status(HANDLE stream_handle, bool* request_stop, uint32_t* timeout)
+void monitor_rx_stream_status(HANDLE stream_handle, bool* request_stop, uint32_t* timeout, int numa_node,
+                              const QueueController* queue_controller, FlightRecorder* flight_recorder)
 {
    ULONG SlotsCount = 0;
    ULONG SlotsDropped = 0;
    ULONG JitterMax = 0;
    ULONG DatagramCount = 0;
+   ULONG PreviousSlotsDropped = 0;
 
    while (!*request_stop)
    {
-      VHD_GetStreamProperty(stream_handle, VHD_CORE_SP_SLOTS_COUNT, &SlotsCount);
-      VHD_GetStreamProperty(stream_handle, VHD_CORE_SP_SLOTS_DROPPED, &SlotsDropped);
-      VHD_GetStreamProperty(stream_handle, VHD_IP_BRD_SP_JITTER_MAX, &JitterMax);
-      VHD_GetStreamProperty(stream_handle, VHD_IP_BRD_SP_DATAGRAM_COUNT, &DatagramCount);
+      board_backend().get_stream_property(stream_handle, VHD_CORE_SP_SLOTS_COUNT, &SlotsCount);
+      board_backend().get_stream_property(stream_handle, VHD_CORE_SP_SLOTS_DROPPED, &SlotsDropped);
+      board_backend().get_stream_property(stream_handle, VHD_IP_BRD_SP_JITTER_MAX, &JitterMax);
+      board_backend().get_stream_property(stream_handle, VHD_IP_BRD_SP_DATAGRAM_COUNT, &DatagramCount);
+
+      if (SlotsDropped > PreviousSlotsDropped)
+         slot_tracer().on_slots_dropped(SlotsDropped);
+      PreviousSlotsDropped = SlotsDropped;
+
+      if (flight_recorder)
+         flight_recorder->record_stream_sample(make_flight_stream_sample(SlotsCount, SlotsDropped, JitterMax,
+                                                                         DatagramCount, *timeout));
 
       std::cout << "SlotCount: " << SlotsCount << " - SlotDropped: " << SlotsDropped
                 << " - JitterMax: " << JitterMax << " - DatagramCount: " << DatagramCount
-                << " - Timeout: " << *timeout << "                      \r" << std::flush;
+                << " - Timeout: " << *timeout;
+      if (numa_node >= 0)
+         std::cout << " - NUMA: " << numa_node;
+      if (queue_controller)
+         queue_controller->print_status();
+      std::cout << "                      \r" << std::flush;
 
       std::this_thread::sleep_for(100ms);
    }
 }
 
-void monitor_tx_stream_status(HANDLE stream_handle, bool* request_stop)
+void monitor_tx_stream_status(HANDLE stream_handle, bool* request_stop, int numa_node,
+                              const QueueController* queue_controller, FlightRecorder* flight_recorder)
 {
    ULONG SlotsCount = 0;
    ULONG SlotsDropped = 0;
    ULONG JitterMax = 0;
    ULONG DatagramCount = 0;
+   ULONG PreviousSlotsDropped = 0;
 
    while (!*request_stop)
    {
-      VHD_GetStreamProperty(stream_handle, VHD_CORE_SP_SLOTS_COUNT, &SlotsCount);
-      VHD_GetStreamProperty(stream_handle, VHD_CORE_SP_SLOTS_DROPPED, &SlotsDropped);
-      VHD_GetStreamProperty(stream_handle, VHD_IP_BRD_SP_JITTER_MAX, &JitterMax);
-      VHD_GetStreamProperty(stream_handle, VHD_IP_BRD_SP_DATAGRAM_COUNT, &DatagramCount);
+      board_backend().get_stream_property(stream_handle, VHD_CORE_SP_SLOTS_COUNT, &SlotsCount);
+      board_backend().get_stream_property(stream_handle, VHD_CORE_SP_SLOTS_DROPPED, &SlotsDropped);
+      board_backend().get_stream_property(stream_handle, VHD_IP_BRD_SP_JITTER_MAX, &JitterMax);
+      board_backend().get_stream_property(stream_handle, VHD_IP_BRD_SP_DATAGRAM_COUNT, &DatagramCount);
+
+      if (SlotsDropped > PreviousSlotsDropped)
+         slot_tracer().on_slots_dropped(SlotsDropped);
+      PreviousSlotsDropped = SlotsDropped;
+
+      if (flight_recorder)
+         flight_recorder->record_stream_sample(make_flight_stream_sample(SlotsCount, SlotsDropped, JitterMax,
+                                                                         DatagramCount, 0));
 
       std::cout << "SlotCount: " << SlotsCount
                 << " - SlotDropped: " << SlotsDropped
                 << " - JitterMax: " << JitterMax
-                << " - DatagramCount: " << DatagramCount << "                      \r" << std::flush;
+                << " - DatagramCount: " << DatagramCount;
+      if (numa_node >= 0)
+         std::cout << " - NUMA: " << numa_node;
+      if (queue_controller)
+         queue_controller->print_status();
+      std::cout << "                      \r" << std::flush;
 
       std::this_thread::sleep_for(100ms);
    }
@@ -39,6 +39,9 @@
 #include "VideoMasterHD_Ip_ST2110_20.h"
 #endif
 
+#include "ipv4.h"
+#include "video_format.h"
+
 /*!
    @brief Convert VHD_PTP_PORT_STATE to string
 
@@ -61,6 +64,88 @@ std::string to_string(VHD_ERRORCODE error_code /*!< [in] VHD_ERRORCODE to conver
 VHD_ERRORCODE get_nic_mac_address(HANDLE board_handle /*!< [in] Board handle*/,
     std::string& mac_address /*!< [out] MAC address of the NIC*/);
 
+/*!
+   @brief Description of a supported video standard
+*/
+struct VideoStandardInfo
+{
+   VHD_ST2110_20_VIDEO_STANDARD video_standard;
+   uint32_t frame_width /*! Width of the video frame in pixels */;
+   uint32_t frame_height /*! Height of the video frame in pixels */;
+   uint32_t frame_rate /*! Frame rate, rounded up for US standards (field rate for interlaced standards) */;
+   bool interlaced /*! True if the video is interlaced */;
+   bool is_us /*! True if the rate is to be divided by 1.001 */;
+};
+
+/*!
+   @brief Table of the supported video standards, usable at compile time
+*/
+inline constexpr VideoStandardInfo video_standard_infos[] = {
+   {VHD_ST2110_20_VIDEOSTD_720x480i59, 720, 480, 60, true, true},
+   {VHD_ST2110_20_VIDEOSTD_720x487i59, 720, 487, 60, true, true},
+   {VHD_ST2110_20_VIDEOSTD_720x576i50, 720, 576, 50, true, false},
+   {VHD_ST2110_20_VIDEOSTD_1280x720p50, 1280, 720, 50, false, false},
+   {VHD_ST2110_20_VIDEOSTD_1280x720p59, 1280, 720, 60, false, true},
+   {VHD_ST2110_20_VIDEOSTD_1280x720p60, 1280, 720, 60, false, false},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080i50, 1920, 1080, 50, true, false},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080i59, 1920, 1080, 60, true, true},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080i60, 1920, 1080, 60, true, false},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080p23, 1920, 1080, 24, false, true},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080p24, 1920, 1080, 24, false, false},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080p25, 1920, 1080, 25, false, false},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080p29, 1920, 1080, 30, false, true},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080p30, 1920, 1080, 30, false, false},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080p50, 1920, 1080, 50, false, false},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080p59, 1920, 1080, 60, false, true},
+   {VHD_ST2110_20_VIDEOSTD_1920x1080p60, 1920, 1080, 60, false, false},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p23, 2048, 1080, 24, false, true},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p24, 2048, 1080, 24, false, false},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p25, 2048, 1080, 25, false, false},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p29, 2048, 1080, 30, false, true},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p30, 2048, 1080, 30, false, false},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p47, 2048, 1080, 48, false, true},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p48, 2048, 1080, 48, false, false},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p50, 2048, 1080, 50, false, false},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p59, 2048, 1080, 60, false, true},
+   {VHD_ST2110_20_VIDEOSTD_2048x1080p60, 2048, 1080, 60, false, false},
+   {VHD_ST2110_20_VIDEOSTD_3840x2160p23, 3840, 2160, 24, false, true},
+   {VHD_ST2110_20_VIDEOSTD_3840x2160p24, 3840, 2160, 24, false, false},
+   {VHD_ST2110_20_VIDEOSTD_3840x2160p25, 3840, 2160, 25, false, false},
+   {VHD_ST2110_20_VIDEOSTD_3840x2160p29, 3840, 2160, 30, false, true},
+   {VHD_ST2110_20_VIDEOSTD_3840x2160p30, 3840, 2160, 30, false, false},
+   {VHD_ST2110_20_VIDEOSTD_3840x2160p50, 3840, 2160, 50, false, false},
+   {VHD_ST2110_20_VIDEOSTD_3840x2160p59, 3840, 2160, 60, false, true},
+   {VHD_ST2110_20_VIDEOSTD_3840x2160p60, 3840, 2160, 60, false, false},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p23, 4096, 2160, 24, false, true},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p24, 4096, 2160, 24, false, false},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p25, 4096, 2160, 25, false, false},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p29, 4096, 2160, 30, false, true},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p30, 4096, 2160, 30, false, false},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p47, 4096, 2160, 48, false, true},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p48, 4096, 2160, 48, false, false},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p50, 4096, 2160, 50, false, false},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p59, 4096, 2160, 60, false, true},
+   {VHD_ST2110_20_VIDEOSTD_4096x2160p60, 4096, 2160, 60, false, false},
+};
+
+inline constexpr uint32_t nb_video_standard_infos =
+    static_cast<uint32_t>(sizeof(video_standard_infos) / sizeof(video_standard_infos[0]));
+
+/*!
+   @brief Look a video standard up in video_standard_infos
+
+   @returns The description of the video standard, nullptr if the video standard is not supported
+*/
+constexpr const VideoStandardInfo* find_video_standard_info(VHD_ST2110_20_VIDEO_STANDARD video_standard)
+{
+   for (uint32_t i = 0; i < nb_video_standard_infos; i++)
+   {
+      if (video_standard_infos[i].video_standard == video_standard)
+         return &video_standard_infos[i];
+   }
+   return nullptr;
+}
+
 /*!
    @brief Get video standard info
 
@@ -89,6 +174,16 @@ VHD_ERRORCODE configure_nic(HANDLE board_handle /*!< [in] Board handle.*/,
    bool     is_dhcp_enabled /*!< [in] If true, the NIC will be configured to use DHCP.*/
 );
 
+/*!
+   @brief Get a board property and set it only if it differs from value
+
+   @returns The function returns the status of its execution as VHD_ERRORCODE
+*/
+VHD_ERRORCODE reconcile_board_property(HANDLE board_handle /*!< [in] Board handle*/,
+                                       ULONG property /*!< [in] Board property*/,
+                                       ULONG value /*!< [in] Desired value*/,
+                                       bool* applied = nullptr /*!< [out] True if the property was set*/);
+
 /*!
    @brief This function configures a TX stream based on the given parameters.
 
@@ -98,9 +193,9 @@ VHD_ERRORCODE configure_stream(HANDLE board_handle /*!< [in] Board handle*/,
                                HANDLE& stream_handle /*!< [out] Handle of the created stream*/,
                                VHD_STREAMTYPE stream_type /*!< [in] Type of the stream to configure*/,
                                VHD_ST2110_20_VIDEO_STANDARD video_standard /*!< [in] Video standard of the stream*/,
-                               uint32_t destination_ip /*!< [in] Destination IP of the stream*/,
+                               const Ipv4Endpoint& destination /*!< [in] Destination IP and UDP port of the stream*/,
                                uint32_t destination_ssrc /*!< [in] Destination SSRC of the stream*/,
-                               uint16_t destination_udp_port /*!< [in] Destination UDP port of the stream*/
+                               const VideoFormat& video_format = default_video_format /*!< [in] Sampling and depth sent on the network*/
 );
 
 /*!
@@ -110,10 +205,9 @@ VHD_ERRORCODE configure_stream(HANDLE board_handle /*!< [in] Board handle*/,
 */
 VHD_ERRORCODE configure_stream_from_sdp(HANDLE board /*!< [in] Board handle*/,
                                         std::string sdp /*!< [in] SDP from which informations will be extracted*/,
-                                        const uint32_t destination_ip_overrides /*!< [in] To override the destination IP contained in the SDP.*/,
-                                        const uint16_t destination_udp_port_ovverrides /*!< [in] To override the destination UDP port contained in the SDP.*/,
+                                        const Ipv4Endpoint& destination_overrides /*!< [in] To override the destination IP and UDP port contained in the SDP, each one only if not 0.*/,
                                         HANDLE stream /*!< [in] Handle of the created stream */,
-                                        uint32_t& multicast_group /*!< [out] Multicast group the has been joined, 0 if none */
+                                        Ipv4Address& multicast_group /*!< [out] Multicast group the has been joined, unspecified if none */
 );
 
 /*!
@@ -127,12 +221,26 @@ VHD_ERRORCODE generate_sdp(HANDLE board_handle  /*!< [in] VCS context used by th
 );
 
 /*!
-   @brief This function leaves a multicast group
+   @brief This function releases the multicast group joined by configure_stream_from_sdp
+
+   @detail The board leaves the group once no stream has used it for the leave delay of multicast_membership().
 
    @returns The function returns the status of its execution as VHD_ERRORCODE
 */
 VHD_ERRORCODE leave_multicast(HANDLE board /*!< [in] Board handle*/,
-                              uint32_t& multicast_group /*!< [inout] Multicast group to leave*/);
+                              Ipv4Address& multicast_group /*!< [inout] Multicast group to leave*/);
+
+/*!
+   @brief This function builds the PTP configuration of the ST2059-2 profile with the given parameters, from the
+   current configuration of the board.
+
+   @returns The function returns the status of its execution as VHD_ERRORCODE
+*/
+VHD_ERRORCODE make_ptp_configuration(HANDLE board_handle /*!< [in] Board handle.*/,
+                                     uint8_t domain_number /*!< [in] Domain number of the PTP service*/,
+                                     uint8_t announce_receipt_timeout /*!< [in] Announce receipt timeout in seconds*/,
+                                     VHD_PTP_CONFIGURATION& ptp_config /*!< [out] PTP configuration to set*/
+);
 
 /*! 
    @brief This function applies the PTP parameters.
@@ -145,23 +253,26 @@ VHD_ERRORCODE apply_ptp_parameters(HANDLE board_handle /*!< [in] Board handle.*/
                                    uint8_t announce_receipt_timeout /*!< [in] Announce receipt timeout in seconds*/
 );
 
-/*!
-   @brief This function prints the status of the PTP service
-
-   @returns The function returns the status of its execution as VHD_ERRORCODE
-*/
-VHD_ERRORCODE print_ptp_status(HANDLE board_handle /*!< [in] Board handle.*/,
-                               uint8_t domain_number /*!< [in] Domain number of the PTP service*/,
-                               uint8_t announce_receipt_timeout /*!< [in] Announce receipt timeout in seconds*/
-
-);
+class QueueController;
+class FlightRecorder;
 
 /*!
    @brief This function monitor RX stream status
+
+   @detail numa_node is the NUMA node the reception loop is bound to, -1 if not bound. The status of the slot queue
+   is shown when a queue controller is given. Every status is also appended to the flight recorder when one is given.
 */
-void monitor_rx_stream_status(HANDLE stream_handle, bool* request_stop, uint32_t* timeout);
+void monitor_rx_stream_status(HANDLE stream_handle, bool* request_stop, uint32_t* timeout, int numa_node = -1,
+                              const QueueController* queue_controller = nullptr,
+                              FlightRecorder* flight_recorder = nullptr);
 
 /*!
    @brief This function monitor TX stream status
+
+   @detail numa_node is the NUMA node the transmission loop is bound to, -1 if not bound. The status of the slot
+   queue is shown when a queue controller is given. Every status is also appended to the flight recorder when one is
+   given.
 */
-void monitor_tx_stream_status(HANDLE stream_handle, bool* request_stop);
+void monitor_tx_stream_status(HANDLE stream_handle, bool* request_stop, int numa_node = -1,
+                              const QueueController* queue_controller = nullptr,
+                              FlightRecorder* flight_recorder = nullptr);
@@ -0,0 +1,172 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+/*!
+   @file video_constraints.h
+   @brief This file contains the compile-time compaction of the supported video standards into the formats
+   advertised in the receiver capabilities.
+
+   @detail Standards sharing width, height and interlace mode are merged into a single format enumerating their
+   grain rates. The static_assert at the end of this file catches a compaction that drops a grain rate, and the
+   caps_check tool checks the constraint sets built from the compacted formats against a reference list of the
+   formats of the video standards.
+*/
+
+#include "tools.h"
+
+/*!
+   @brief Grain rate of a video standard, as advertised in the IS-04 caps
+*/
+struct GrainRate
+{
+   uint32_t numerator;
+   uint32_t denominator;
+};
+
+/*!
+   @brief Get the grain rate of a video standard
+
+   @detail The grain of an interlaced standard is a frame, its rate is half the field rate.
+*/
+constexpr GrainRate get_grain_rate(const VideoStandardInfo& info)
+{
+   const uint32_t frame_rate = info.interlaced ? info.frame_rate / 2 : info.frame_rate; // frame rate *is* divisible by 2
+   return info.is_us ? GrainRate{frame_rate * 1000, 1001} : GrainRate{frame_rate, 1};
+}
+
+constexpr bool operator==(const GrainRate& lhs, const GrainRate& rhs)
+{
+   return lhs.numerator == rhs.numerator && lhs.denominator == rhs.denominator;
+}
+
+inline constexpr uint32_t max_grain_rates_per_format = 16;
+
+/*!
+   @brief Video standards sharing the same frame geometry
+*/
+struct CompactedVideoFormat
+{
+   uint32_t frame_width;
+   uint32_t frame_height;
+   bool interlaced;
+   uint32_t nb_grain_rates;
+   GrainRate grain_rates[max_grain_rates_per_format];
+};
+
+struct CompactedVideoFormats
+{
+   uint32_t nb_formats;
+   CompactedVideoFormat formats[nb_video_standard_infos];
+};
+
+/*!
+   @brief Merge the supported video standards sharing width, height and interlace mode
+*/
+constexpr CompactedVideoFormats compact_video_standards()
+{
+   CompactedVideoFormats result{};
+
+   for (uint32_t i = 0; i < nb_video_standard_infos; i++)
+   {
+      const VideoStandardInfo& info = video_standard_infos[i];
+      const GrainRate grain_rate = get_grain_rate(info);
+
+      uint32_t format_index = 0;
+      while (format_index < result.nb_formats &&
+             !(result.formats[format_index].frame_width == info.frame_width &&
+               result.formats[format_index].frame_height == info.frame_height &&
+               result.formats[format_index].interlaced == info.interlaced))
+         format_index++;
+
+      CompactedVideoFormat& format = result.formats[format_index];
+      if (format_index == result.nb_formats)
+      {
+         format.frame_width = info.frame_width;
+         format.frame_height = info.frame_height;
+         format.interlaced = info.interlaced;
+         result.nb_formats++;
+      }
+
+      bool known_grain_rate = false;
+      for (uint32_t j = 0; j < format.nb_grain_rates; j++)
+         known_grain_rate = known_grain_rate || format.grain_rates[j] == grain_rate;
+
+      // a full format is caught by the static_assert below
+      if (!known_grain_rate && format.nb_grain_rates < max_grain_rates_per_format)
+         format.grain_rates[format.nb_grain_rates++] = grain_rate;
+   }
+
+   return result;
+}
+
+inline constexpr CompactedVideoFormats compacted_video_formats = compact_video_standards();
+
+/*!
+   @brief Check if a video standard is accepted by the compacted formats
+*/
+constexpr bool is_accepted(const CompactedVideoFormats& formats, const VideoStandardInfo& info)
+{
+   const GrainRate grain_rate = get_grain_rate(info);
+   for (uint32_t i = 0; i < formats.nb_formats; i++)
+   {
+      const CompactedVideoFormat& format = formats.formats[i];
+      if (format.frame_width != info.frame_width || format.frame_height != info.frame_height ||
+          format.interlaced != info.interlaced)
+         continue;
+      for (uint32_t j = 0; j < format.nb_grain_rates; j++)
+      {
+         if (format.grain_rates[j] == grain_rate)
+            return true;
+      }
+   }
+   return false;
+}
+
+/*!
+   @brief Check that the compacted formats accept every supported video standard, and nothing else
+
+   @detail Every (geometry, grain rate) pair of the compacted formats is built from a supported standard, so
+   accepting all of them with no more pairs than distinct standards means the accepted sets are identical.
+*/
+constexpr bool accepts_exactly_supported_video_standards(const CompactedVideoFormats& formats)
+{
+   uint32_t nb_distinct_standards = 0;
+   for (uint32_t i = 0; i < nb_video_standard_infos; i++)
+   {
+      if (!is_accepted(formats, video_standard_infos[i]))
+         return false;
+
+      bool duplicate = false;
+      for (uint32_t j = 0; j < i; j++)
+      {
+         duplicate = duplicate || (video_standard_infos[j].frame_width == video_standard_infos[i].frame_width &&
+                                   video_standard_infos[j].frame_height == video_standard_infos[i].frame_height &&
+                                   video_standard_infos[j].interlaced == video_standard_infos[i].interlaced &&
+                                   get_grain_rate(video_standard_infos[j]) == get_grain_rate(video_standard_infos[i]));
+      }
+      if (!duplicate)
+         nb_distinct_standards++;
+   }
+
+   uint32_t nb_pairs = 0;
+   for (uint32_t i = 0; i < formats.nb_formats; i++)
+      nb_pairs += formats.formats[i].nb_grain_rates;
+
+   return nb_pairs == nb_distinct_standards;
+}
+
+static_assert(accepts_exactly_supported_video_standards(compacted_video_formats),
+              "The compacted video formats must accept exactly the supported video standards");
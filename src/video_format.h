@@ -0,0 +1,198 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (c) DELTACAST.TV. All rights reserved.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at * * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+/*!
+   @file video_format.h
+   @brief This file contains the ST 2110-20 video formats, the sampling and the component depth of a flow, and the
+   geometry of their pixel groups.
+
+   @detail The pixel groups follow ST 2110-20 (RFC 4175): the components of a pixel group are sent as one big-endian
+   bit stream, in the order Cb Y0 Cr Y1 for YCbCr-4:2:2, Cb Y Cr for YCbCr-4:4:4, R G B for RGB and Y00 Y01 Y10 Y11 Cb
+   Cr for YCbCr-4:2:0, whose pixel groups cover two lines.
+*/
+
+#if defined(__GNUC__) && !(defined(__APPLE__))
+#include <stdint-gcc.h>
+#else
+#include <stdint.h>
+#endif
+
+#include <string>
+
+#if defined(__APPLE__)
+#include "VideoMasterHD/VideoMasterHD_Ip_ST2110_20.h"
+#else
+#include "VideoMasterHD_Ip_ST2110_20.h"
+#endif
+
+/*!
+   @brief Sampling and component depth of a ST 2110-20 flow
+*/
+struct VideoFormat
+{
+   VHD_ST2110_20_SAMPLING sampling;
+   VHD_ST2110_20_DEPTH depth;
+};
+
+constexpr bool operator==(const VideoFormat& lhs, const VideoFormat& rhs)
+{
+   return lhs.sampling == rhs.sampling && lhs.depth == rhs.depth;
+}
+
+constexpr bool operator!=(const VideoFormat& lhs, const VideoFormat& rhs)
+{
+   return !(lhs == rhs);
+}
+
+inline constexpr VideoFormat default_video_format = {VHD_ST2110_20_SAMPLING_YUV_422, VHD_ST2110_20_DEPTH_10BIT};
+
+inline constexpr VHD_ST2110_20_SAMPLING video_samplings[] = {
+    VHD_ST2110_20_SAMPLING_YUV_422,
+    VHD_ST2110_20_SAMPLING_YUV_444,
+    VHD_ST2110_20_SAMPLING_YUV_420,
+    VHD_ST2110_20_SAMPLING_RGB_444,
+};
+
+inline constexpr VHD_ST2110_20_DEPTH video_depths[] = {
+    VHD_ST2110_20_DEPTH_8BIT,
+    VHD_ST2110_20_DEPTH_10BIT,
+    VHD_ST2110_20_DEPTH_12BIT,
+};
+
+/*!
+   @brief Geometry of the pixel group of a video format
+*/
+struct PixelGroup
+{
+   uint32_t size /*! Bytes of a pixel group */;
+   uint32_t nb_pixels /*! Pixels of a pixel group, on each of its lines */;
+   uint32_t nb_lines /*! Lines covered by a pixel group, 2 for YCbCr-4:2:0 */;
+   uint32_t nb_components /*! Components of a pixel group */;
+};
+
+/*!
+   @brief Bits of a component
+
+   @returns 0 if the depth is not supported
+*/
+constexpr uint32_t get_component_depth(VHD_ST2110_20_DEPTH depth)
+{
+   switch (depth)
+   {
+   case VHD_ST2110_20_DEPTH_8BIT: return 8;
+   case VHD_ST2110_20_DEPTH_10BIT: return 10;
+   case VHD_ST2110_20_DEPTH_12BIT: return 12;
+   default: return 0;
+   }
+}
+
+/*!
+   @brief Name of a sampling in the SDP and in the IS-04 flows and caps
+
+   @returns nullptr if the sampling is not supported
+*/
+constexpr const char* get_sampling_name(VHD_ST2110_20_SAMPLING sampling)
+{
+   switch (sampling)
+   {
+   case VHD_ST2110_20_SAMPLING_YUV_422: return "YCbCr-4:2:2";
+   case VHD_ST2110_20_SAMPLING_YUV_444: return "YCbCr-4:4:4";
+   case VHD_ST2110_20_SAMPLING_YUV_420: return "YCbCr-4:2:0";
+   case VHD_ST2110_20_SAMPLING_RGB_444: return "RGB";
+   default: return nullptr;
+   }
+}
+
+/*!
+   @brief Get the pixel group of a video format: the fewest pixels whose components fill whole bytes
+
+   @returns A pixel group of 0 bytes if the format is not supported
+*/
+constexpr PixelGroup get_pixel_group(const VideoFormat& format)
+{
+   // Components of the smallest block of pixels of the sampling
+   uint32_t nb_pixels = 1, nb_lines = 1, nb_components = 3;
+   switch (format.sampling)
+   {
+   case VHD_ST2110_20_SAMPLING_YUV_422: nb_pixels = 2; nb_components = 4; break;
+   case VHD_ST2110_20_SAMPLING_YUV_444:
+   case VHD_ST2110_20_SAMPLING_RGB_444: break;
+   case VHD_ST2110_20_SAMPLING_YUV_420: nb_pixels = 2; nb_lines = 2; nb_components = 6; break;
+   default: return {0, 0, 0, 0};
+   }
+
+   const uint32_t depth = get_component_depth(format.depth);
+   if (!depth)
+      return {0, 0, 0, 0};
+   uint32_t nb_blocks = 1;
+   while (nb_blocks * nb_components * depth % 8)
+      nb_blocks++;
+   return {nb_blocks * nb_components * depth / 8, nb_blocks * nb_pixels, nb_lines, nb_blocks * nb_components};
+}
+
+static_assert(get_pixel_group({VHD_ST2110_20_SAMPLING_YUV_422, VHD_ST2110_20_DEPTH_10BIT}).size == 5 &&
+                  get_pixel_group({VHD_ST2110_20_SAMPLING_YUV_444, VHD_ST2110_20_DEPTH_10BIT}).size == 15 &&
+                  get_pixel_group({VHD_ST2110_20_SAMPLING_RGB_444, VHD_ST2110_20_DEPTH_12BIT}).size == 9 &&
+                  get_pixel_group({VHD_ST2110_20_SAMPLING_YUV_420, VHD_ST2110_20_DEPTH_10BIT}).nb_pixels == 4 &&
+                  get_pixel_group({VHD_ST2110_20_SAMPLING_YUV_420, VHD_ST2110_20_DEPTH_8BIT}).size == 6,
+              "the pixel groups must follow ST 2110-20");
+
+/*!
+   @brief Find the depth of a number of bits per component
+
+   @returns false if the depth is not supported
+*/
+inline bool find_video_depth(uint32_t bits /*!< [in] Bits per component*/,
+                             VHD_ST2110_20_DEPTH& depth /*!< [out] Depth*/)
+{
+   for (VHD_ST2110_20_DEPTH candidate : video_depths)
+   {
+      if (get_component_depth(candidate) == bits)
+      {
+         depth = candidate;
+         return true;
+      }
+   }
+   return false;
+}
+
+/*!
+   @brief Find the sampling of a SDP sampling name, e.g. "YCbCr-4:2:2"
+
+   @returns false if the sampling is not supported
+*/
+inline bool find_video_sampling(const std::string& name /*!< [in] Sampling name*/,
+                                VHD_ST2110_20_SAMPLING& sampling /*!< [out] Sampling*/)
+{
+   for (VHD_ST2110_20_SAMPLING candidate : video_samplings)
+   {
+      if (name == get_sampling_name(candidate))
+      {
+         sampling = candidate;
+         return true;
+      }
+   }
+   return false;
+}
+
+/*!
+   @brief Description of a video format, e.g. "YCbCr-4:2:2 10-bit"
+*/
+inline std::string to_string(const VideoFormat& format)
+{
+   const char* sampling_name = get_sampling_name(format.sampling);
+   return std::string(sampling_name ? sampling_name : "unknown sampling") + " " +
+          std::to_string(get_component_depth(format.depth)) + "-bit";
+}